@@ -0,0 +1,321 @@
+/*
+ * Optional off-thread camera classification (AsyncClassification=1).
+ *
+ * In this mode SetVertexShaderConstantF only appends the upload to the current
+ * frame's arena and forwards the call. Present hands the finished frame to a
+ * worker thread, which runs the classifier over it in submission order and
+ * records the WORLD/VIEW/PROJECTION in effect at every draw. The worker runs
+ * while the game starts the following frame; the first draw of that frame waits
+ * up to kAsyncClassifierMaxWaitMs for it and then consumes the result by draw
+ * index, so frame N draws with the transforms of frame N - 1.
+ *
+ * Hand-off is lock-free: two frame slots and two result slots, exchanged with
+ * acquire/release stores, plus an event the worker sets when it is done. When
+ * the worker overruns the wait, that frame keeps the older result and is
+ * counted as late; a frame that is finished while the worker is still busy is
+ * dropped and counted, never queued.
+ *
+ * The render thread latches the published result only at the first draw of a
+ * frame and before submitting one, and the worker only ever writes the result
+ * slot that is not published, so a latched result is never written while it is
+ * being read.
+ *
+ * The same hand-off passes ownership of the classifier state (learned layouts,
+ * published matrices and sources, profile status) back and forth. The worker
+ * touches it only between a submit and its release of m_submitted; while
+ * WorkerIdle() is true the render thread owns it until the next EndFrame, and
+ * nobody takes a lock.
+ */
+#pragma once
+
+#include <windows.h>
+#include <d3d9types.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "proxy_heap.h"
+
+// Camera state the classifier resolves and EmitFixedFunctionTransforms sends.
+struct ResolvedTransforms {
+    D3DMATRIX world = {};
+    D3DMATRIX view = {};
+    D3DMATRIX proj = {};
+    bool hasWorld = false;
+    bool hasView = false;
+    bool hasProj = false;
+};
+
+// A manual overlay binding read out of the shader's accumulated constants on
+// the render thread, since only that thread owns the constant snapshots.
+struct CapturedManualMatrix {
+    D3DMATRIX matrix;
+    int baseRegister;
+    int rows;
+};
+
+enum AsyncRecordKind : uint8_t {
+    AsyncRecord_Upload = 0,
+    AsyncRecord_Draw,
+    AsyncRecord_BeginScene
+};
+
+struct AsyncClassifierRecord {
+    AsyncRecordKind kind;
+    // One bit per matrix slot with a CapturedManualMatrix at manualOffset, in slot order.
+    uint8_t manualMask;
+    bool stableKey;
+    uint32_t shaderHash;
+    uintptr_t shaderKey;
+    UINT startRegister;
+    UINT vector4fCount;
+    uint32_t dataOffset;
+    uint32_t manualOffset;
+};
+
+// One frame of recorded calls. Cleared, not freed, between frames.
+struct AsyncClassifierFrame {
+    std::vector<AsyncClassifierRecord> records;
+    std::vector<float> constants;
+    std::vector<CapturedManualMatrix> manual;
+    uint64_t frameNumber = 0;
+    bool mgrrUseAutoProjection = false;
+
+    void Clear() {
+        records.clear();
+        constants.clear();
+        manual.clear();
+    }
+};
+
+struct AsyncClassifierResult {
+    // Transforms in effect at each draw of the classified frame, in draw order.
+    std::vector<ResolvedTransforms> draws;
+    ResolvedTransforms final;
+    uint64_t frameNumber = 0;
+};
+
+// Runs on the worker: classify frame in order and fill result.
+typedef void (*AsyncClassifyFrameFn)(const AsyncClassifierFrame& frame, AsyncClassifierResult* result);
+
+// Longest the first draw of a frame waits for the previous frame's result.
+static constexpr DWORD kAsyncClassifierMaxWaitMs = 4;
+
+class AsyncClassifierPipeline {
+public:
+    bool Start(AsyncClassifyFrameFn classify) {
+        if (m_running) {
+            return true;
+        }
+        m_classify = classify;
+        m_stop.store(false, std::memory_order_relaxed);
+        m_event = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+        m_done = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+        // The worker holds a reference on the proxy until it exits, so the code it
+        // runs is never unmapped under it and Stop never has to wait for it.
+        m_module = nullptr;
+        GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                           reinterpret_cast<LPCSTR>(&AsyncClassifierPipeline::WorkerThread), &m_module);
+        if (m_event && m_done) {
+            m_thread = CreateThread(nullptr, 0, WorkerThread, this, 0, nullptr);
+        }
+        if (!m_thread) {
+            if (m_event) {
+                CloseHandle(m_event);
+                m_event = nullptr;
+            }
+            if (m_done) {
+                CloseHandle(m_done);
+                m_done = nullptr;
+            }
+            if (m_module) {
+                FreeLibrary(m_module);
+                m_module = nullptr;
+            }
+            return false;
+        }
+        QueryPerformanceFrequency(&m_frequency);
+        m_running = true;
+        return true;
+    }
+
+    // Signals the worker to exit and returns without waiting for it: this runs
+    // under the loader lock at DLL detach. The events stay open for the worker.
+    // Returns true when the worker is known not to be inside a frame, i.e. the
+    // classifier state it owns is consistent.
+    bool Stop() {
+        if (!m_running) {
+            return true;
+        }
+        m_running = false;
+        m_stop.store(true, std::memory_order_release);
+        SetEvent(m_event);
+        CloseHandle(m_thread);
+        m_thread = nullptr;
+        return !m_processing.load(std::memory_order_acquire);
+    }
+
+    bool Running() const { return m_running; }
+
+    // Render thread: true once the worker has finished the last submitted frame.
+    bool WorkerIdle() const { return m_submitted.load(std::memory_order_acquire) < 0; }
+
+    // Render thread: append one upload to the frame being recorded.
+    void RecordUpload(uintptr_t shaderKey,
+                      uint32_t shaderHash,
+                      bool stableKey,
+                      UINT startRegister,
+                      UINT vector4fCount,
+                      const float* data,
+                      uint8_t manualMask,
+                      const CapturedManualMatrix* manual,
+                      int manualCount) {
+        AsyncClassifierFrame& frame = m_frames[m_recording];
+        AsyncClassifierRecord record = {};
+        record.kind = AsyncRecord_Upload;
+        record.manualMask = manualMask;
+        record.stableKey = stableKey;
+        record.shaderHash = shaderHash;
+        record.shaderKey = shaderKey;
+        record.startRegister = startRegister;
+        record.vector4fCount = data ? vector4fCount : 0;
+        record.dataOffset = static_cast<uint32_t>(frame.constants.size());
+        record.manualOffset = static_cast<uint32_t>(frame.manual.size());
+        if (data) {
+            frame.constants.insert(frame.constants.end(), data, data + static_cast<size_t>(vector4fCount) * 4);
+        }
+        frame.manual.insert(frame.manual.end(), manual, manual + manualCount);
+        frame.records.push_back(record);
+    }
+
+    void RecordEvent(AsyncRecordKind kind) {
+        AsyncClassifierRecord record = {};
+        record.kind = kind;
+        m_frames[m_recording].records.push_back(record);
+    }
+
+    // Render thread, once per Present. While the worker is still busy (it overran
+    // the wait at this frame's first draw) the recorded frame is dropped;
+    // otherwise it is submitted. The latch is refreshed first so the worker's next
+    // target slot is never the latched one.
+    void EndFrame(uint64_t frameNumber, bool mgrrUseAutoProjection) {
+        AsyncClassifierFrame& frame = m_frames[m_recording];
+        if (m_submitted.load(std::memory_order_acquire) >= 0) {
+            m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+            frame.Clear();
+            return;
+        }
+        m_latched = m_published.load(std::memory_order_acquire);
+        frame.frameNumber = frameNumber;
+        frame.mgrrUseAutoProjection = mgrrUseAutoProjection;
+        ResetEvent(m_done);
+        m_submitted.store(m_recording, std::memory_order_release);
+        SetEvent(m_event);
+        m_recording ^= 1;
+        m_frames[m_recording].Clear();
+    }
+
+    // Render thread, at the first draw of a frame: waits (bounded) for the frame
+    // submitted at the last Present, then latches the newest result. A frame the
+    // worker has not finished in time keeps the older result and counts as late.
+    void BeginFrameDraws() {
+        if (m_submitted.load(std::memory_order_acquire) >= 0) {
+            WaitForSingleObject(m_done, kAsyncClassifierMaxWaitMs);
+            if (m_submitted.load(std::memory_order_acquire) >= 0) {
+                m_lateFrames.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        m_latched = m_published.load(std::memory_order_acquire);
+    }
+
+    // Transforms the worker resolved for the same draw of the latched frame. Draws
+    // past the end of that frame reuse its final state.
+    const ResolvedTransforms* ResolvedForDraw(uint32_t drawIndex) const {
+        if (m_latched < 0) {
+            return nullptr;
+        }
+        const AsyncClassifierResult& result = m_results[m_latched];
+        return drawIndex < result.draws.size() ? &result.draws[drawIndex] : &result.final;
+    }
+
+    // Frames between the one being rendered and the one its transforms came from.
+    uint64_t LatencyFrames(uint64_t currentFrame) const {
+        return m_latched >= 0 ? currentFrame - m_results[m_latched].frameNumber : 0;
+    }
+
+    uint64_t ProcessedFrames() const { return m_processedFrames.load(std::memory_order_relaxed); }
+    uint64_t DroppedFrames() const { return m_droppedFrames.load(std::memory_order_relaxed); }
+    uint64_t LateFrames() const { return m_lateFrames.load(std::memory_order_relaxed); }
+    double LastProcessMs() const { return m_lastProcessMicros.load(std::memory_order_relaxed) / 1000.0; }
+    double MaxProcessMs() const { return m_maxProcessMicros.load(std::memory_order_relaxed) / 1000.0; }
+
+private:
+    static DWORD WINAPI WorkerThread(LPVOID parameter) {
+        AsyncClassifierPipeline* pipeline = static_cast<AsyncClassifierPipeline*>(parameter);
+        pipeline->Run();
+        if (pipeline->m_module) {
+            FreeLibraryAndExitThread(pipeline->m_module, 0);
+        }
+        return 0;
+    }
+
+    void Run() {
+        ScopedProxyThreadStack ownStack;
+        while (!m_stop.load(std::memory_order_acquire)) {
+            WaitForSingleObject(m_event, 100);
+            const int slot = m_submitted.load(std::memory_order_acquire);
+            if (slot < 0 || m_stop.load(std::memory_order_acquire)) {
+                continue;
+            }
+            m_processing.store(true, std::memory_order_release);
+            LARGE_INTEGER start = {};
+            QueryPerformanceCounter(&start);
+
+            const int target = m_published.load(std::memory_order_relaxed) == 0 ? 1 : 0;
+            AsyncClassifierResult& result = m_results[target];
+            result.draws.clear();
+            result.frameNumber = m_frames[slot].frameNumber;
+            m_classify(m_frames[slot], &result);
+
+            LARGE_INTEGER end = {};
+            QueryPerformanceCounter(&end);
+            const uint32_t micros = static_cast<uint32_t>((end.QuadPart - start.QuadPart) * 1000000 / m_frequency.QuadPart);
+            m_lastProcessMicros.store(micros, std::memory_order_relaxed);
+            if (micros > m_maxProcessMicros.load(std::memory_order_relaxed)) {
+                m_maxProcessMicros.store(micros, std::memory_order_relaxed);
+            }
+            m_processedFrames.fetch_add(1, std::memory_order_relaxed);
+
+            m_published.store(target, std::memory_order_release);
+            m_submitted.store(-1, std::memory_order_release);
+            m_processing.store(false, std::memory_order_release);
+            SetEvent(m_done);
+        }
+    }
+
+    AsyncClassifyFrameFn m_classify = nullptr;
+    HANDLE m_thread = nullptr;
+    HANDLE m_event = nullptr;
+    // Manual-reset; reset at submit, set when the worker finishes a frame.
+    HANDLE m_done = nullptr;
+    HMODULE m_module = nullptr;
+    LARGE_INTEGER m_frequency = {};
+    bool m_running = false;
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_processing{false};
+
+    AsyncClassifierFrame m_frames[2];
+    AsyncClassifierResult m_results[2];
+    int m_recording = 0;
+    int m_latched = -1;
+    // Frame slot handed to the worker, -1 while it is idle.
+    std::atomic<int> m_submitted{-1};
+    // Result slot holding the newest finished frame, -1 before the first one.
+    std::atomic<int> m_published{-1};
+
+    std::atomic<uint64_t> m_processedFrames{0};
+    std::atomic<uint64_t> m_droppedFrames{0};
+    std::atomic<uint64_t> m_lateFrames{0};
+    std::atomic<uint32_t> m_lastProcessMicros{0};
+    std::atomic<uint32_t> m_maxProcessMicros{0};
+};
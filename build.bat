@@ -16,10 +16,21 @@ if errorlevel 1 (
     exit /b 1
 )
 
+REM Optional arguments, in any order and combination ("build.bat profile etw"):
+REM   profile - compiles in the overlay Profiler tab timers
+REM   etw     - also sends PerfMarkers regions to the ETW provider *CameraProxy
+set PROFILE_DEFINE=
+set ETW_DEFINE=
+for %%A in (%*) do (
+    if /I "%%~A"=="profile" set PROFILE_DEFINE=/DCAMERA_PROXY_PROFILER=1
+    if /I "%%~A"=="etw" set ETW_DEFINE=/DCAMERA_PROXY_ETW=1
+)
+set PROXY_DEFINES=%PROFILE_DEFINE% %ETW_DEFINE%
+
 REM Build 32-bit DLL (DMC4 is 32-bit)
 echo.
 echo Compiling for x86 (32-bit)...
-cl /LD /EHsc /O2 /MD d3d9_proxy.cpp imgui/imgui.cpp imgui/imgui_draw.cpp imgui/imgui_tables.cpp imgui/imgui_widgets.cpp imgui/backends/imgui_impl_dx9.cpp imgui/backends/imgui_impl_win32.cpp /link /DEF:d3d9.def /OUT:d3d9.dll
+cl /LD /EHsc /O2 /MD %PROXY_DEFINES% d3d9_proxy.cpp camera_reconstruction.cpp imgui/imgui.cpp imgui/imgui_draw.cpp imgui/imgui_tables.cpp imgui/imgui_widgets.cpp imgui/backends/imgui_impl_dx9.cpp imgui/backends/imgui_impl_win32.cpp /link /DEF:d3d9.def /OUT:d3d9.dll
 
 if errorlevel 1 (
     echo.
@@ -0,0 +1,30 @@
+@echo off
+REM Build script for the camera reconstruction benchmark (camera_bench.exe)
+REM Run this from a Visual Studio Developer Command Prompt
+
+echo Building camera reconstruction benchmark...
+
+where cl >nul 2>&1
+if errorlevel 1 (
+    echo ERROR: cl.exe not found. Please run this from a Visual Studio Developer Command Prompt.
+    pause
+    exit /b 1
+)
+
+REM Same compiler flags as the proxy DLL so the numbers match what players run
+cl /EHsc /O2 /MD camera_bench.cpp camera_reconstruction.cpp /Fe:camera_bench.exe
+
+if errorlevel 1 (
+    echo.
+    echo BUILD FAILED!
+    pause
+    exit /b 1
+)
+
+echo.
+echo BUILD SUCCESSFUL!
+echo.
+echo Usage:
+echo   camera_bench.exe                      synthetic workloads
+echo   camera_bench.exe camera_proxy.trace   synthetic plus a captured trace
+echo.
@@ -0,0 +1,565 @@
+/**
+ * Standalone benchmark for camera_reconstruction.
+ *
+ * Build with build_bench.bat from a Visual Studio Developer Command Prompt:
+ *   camera_bench.exe                    synthetic workloads only
+ *   camera_bench.exe camera_proxy.trace synthetic plus a captured upload stream
+ *
+ * The animated-constants workload pairs a camera block with per-upload scalar
+ * constants and reports how often the learned-layout lock holds there.
+ *
+ * Every workload runs once per kernel table (scalar reference, then SSE2 when the
+ * CPU has it) and reports uploads/sec, ns per classification, decompositions/sec
+ * (with and without CameraDerivationCache) and memory scanner GB/s. The captured workload replays the
+ * SetVertexShaderConstantF payloads of a trace recorded from the overlay Profiler
+ * tab, once with full scans only and once through the learned-layout lock the
+ * proxy uses (LayoutLockThreshold=8).
+ */
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "camera_reconstruction.h"
+#include "constant_trace.h"
+
+static constexpr int kBenchLockThreshold = 8;
+static constexpr int kBenchBonePaletteMinBones = 8;
+static constexpr size_t kScanChunkFloats = 16 * 1024;
+
+static volatile uint64_t g_benchSink = 0;
+
+static double NowSeconds() {
+    static LARGE_INTEGER frequency = {};
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return static_cast<double>(counter.QuadPart) / static_cast<double>(frequency.QuadPart);
+}
+
+// Deterministic xorshift so runs are comparable across builds.
+static uint32_t g_benchRandomState = 0x12345678u;
+
+static float RandomFloat(float lo, float hi) {
+    g_benchRandomState ^= g_benchRandomState << 13;
+    g_benchRandomState ^= g_benchRandomState >> 17;
+    g_benchRandomState ^= g_benchRandomState << 5;
+    return lo + (hi - lo) * (static_cast<float>(g_benchRandomState & 0xFFFFFF) / 16777215.0f);
+}
+
+static D3DMATRIX MakeRotation(float yaw, float pitch) {
+    const float cy = cosf(yaw), sy = sinf(yaw);
+    const float cp = cosf(pitch), sp = sinf(pitch);
+    D3DMATRIX m = {};
+    m._11 = cy;       m._12 = 0.0f; m._13 = -sy;
+    m._21 = sy * sp;  m._22 = cp;   m._23 = cy * sp;
+    m._31 = sy * cp;  m._32 = -sp;  m._33 = cy * cp;
+    m._44 = 1.0f;
+    return m;
+}
+
+static D3DMATRIX MakeView() {
+    D3DMATRIX m = MakeRotation(RandomFloat(-3.1f, 3.1f), RandomFloat(-1.2f, 1.2f));
+    m._41 = RandomFloat(-500.0f, 500.0f);
+    m._42 = RandomFloat(-50.0f, 50.0f);
+    m._43 = RandomFloat(-500.0f, 500.0f);
+    return m;
+}
+
+static D3DMATRIX MakeWorld() {
+    D3DMATRIX m = MakeRotation(RandomFloat(-3.1f, 3.1f), 0.0f);
+    const float scale = RandomFloat(0.5f, 4.0f);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            m.m[r][c] *= scale;
+        }
+    }
+    m._41 = RandomFloat(-1000.0f, 1000.0f);
+    m._42 = RandomFloat(-100.0f, 100.0f);
+    m._43 = RandomFloat(-1000.0f, 1000.0f);
+    return m;
+}
+
+static D3DMATRIX MakeProjection() {
+    D3DMATRIX m = {};
+    CreateProjectionMatrix(&m, RandomFloat(0.6f, 1.4f), RandomFloat(1.3f, 2.4f), 0.1f, 5000.0f);
+    return m;
+}
+
+static void AppendRows(std::vector<float>& out, const D3DMATRIX& m, int rows, bool transposed) {
+    const D3DMATRIX src = transposed ? TransposeMatrix(m) : m;
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < 4; c++) {
+            out.push_back(src.m[r][c]);
+        }
+    }
+}
+
+struct BenchUpload {
+    uint64_t shaderKey;
+    UINT startRegister;
+    UINT vector4fCount;
+    std::vector<float> data;
+};
+
+// Per draw: a transposed world/view/projection block, a 4x3 bone palette and a
+// small block of non-matrix material constants.
+static std::vector<BenchUpload> BuildSyntheticUploads(int frames) {
+    std::vector<BenchUpload> uploads;
+    for (int frame = 0; frame < frames; frame++) {
+        const D3DMATRIX view = MakeView();
+        const D3DMATRIX projection = MakeProjection();
+        for (int draw = 0; draw < 32; draw++) {
+            BenchUpload camera = { 1, 0, 12, {} };
+            AppendRows(camera.data, MakeWorld(), 4, true);
+            AppendRows(camera.data, view, 4, true);
+            AppendRows(camera.data, projection, 4, true);
+            uploads.push_back(camera);
+
+            BenchUpload palette = { 2, 20, 0, {} };
+            for (int bone = 0; bone < 24; bone++) {
+                D3DMATRIX b = MakeRotation(RandomFloat(-3.1f, 3.1f), RandomFloat(-1.0f, 1.0f));
+                b._41 = RandomFloat(-2.0f, 2.0f);
+                AppendRows(palette.data, b, 3, true);
+            }
+            palette.vector4fCount = static_cast<UINT>(palette.data.size() / 4);
+            uploads.push_back(palette);
+
+            BenchUpload material = { 3, 12, 6, {} };
+            for (int i = 0; i < 24; i++) {
+                material.data.push_back(RandomFloat(0.0f, 1.0f));
+            }
+            uploads.push_back(material);
+        }
+    }
+    return uploads;
+}
+
+// Per draw: world/view/projection followed by eight registers of animated material
+// and time constants that change with every upload.
+static std::vector<BenchUpload> BuildAnimatedConstantUploads(int frames) {
+    std::vector<BenchUpload> uploads;
+    for (int frame = 0; frame < frames; frame++) {
+        const D3DMATRIX view = MakeView();
+        const D3DMATRIX projection = MakeProjection();
+        for (int draw = 0; draw < 32; draw++) {
+            BenchUpload upload = { 5, 0, 20, {} };
+            AppendRows(upload.data, MakeWorld(), 4, true);
+            AppendRows(upload.data, view, 4, true);
+            AppendRows(upload.data, projection, 4, true);
+            const float time = static_cast<float>(frame * 32 + draw) * 0.016f;
+            const float constants[32] = {
+                RandomFloat(0.0f, 1.0f), 0.0f, 0.0f, 0.0f,    // tint
+                RandomFloat(0.5f, 2.0f), 0.0f, 0.0f, 0.0f,    // light intensity
+                time, 0.0f, 0.0f, 0.0f,                        // time
+                RandomFloat(0.0f, 0.01f), 0.0f, 0.0f, 0.0f,   // fog density
+                RandomFloat(0.0f, 1.0f), 0.0f, 0.0f, 0.0f,    // uv scroll
+                RandomFloat(0.0f, 64.0f), 0.0f, 0.0f, 0.0f,   // specular power
+                RandomFloat(0.0f, 1.0f), 0.0f, 0.0f, 0.0f,    // alpha ref
+                sinf(time), 0.0f, 0.0f, 0.0f,                  // wind phase
+            };
+            upload.data.insert(upload.data.end(), constants, constants + 32);
+            uploads.push_back(upload);
+        }
+    }
+    return uploads;
+}
+
+// Bulk uploader: every draw re-sends c0-c255 with only the world matrix changed.
+static std::vector<BenchUpload> BuildBulkUploads(int frames) {
+    std::vector<BenchUpload> uploads;
+    std::vector<float> registers(256 * 4);
+    for (float& value : registers) {
+        value = RandomFloat(0.0f, 1.0f);
+    }
+    for (int frame = 0; frame < frames; frame++) {
+        std::vector<float> camera;
+        AppendRows(camera, MakeView(), 4, true);
+        AppendRows(camera, MakeProjection(), 4, true);
+        memcpy(registers.data() + 4 * 4, camera.data(), camera.size() * sizeof(float));
+        for (int draw = 0; draw < 32; draw++) {
+            std::vector<float> world;
+            AppendRows(world, MakeWorld(), 4, true);
+            memcpy(registers.data(), world.data(), world.size() * sizeof(float));
+            uploads.push_back({ 4, 0, 256, registers });
+        }
+    }
+    return uploads;
+}
+
+// Incremental scans against the previous upload of the same range, as the proxy
+// does with per-register change serials. Also checks every result against a full
+// scan of the same upload.
+static void BenchIncrementalScan(const char* label, const std::vector<BenchUpload>& uploads) {
+    if (uploads.empty()) {
+        return;
+    }
+    struct Previous {
+        std::vector<float> data;
+        std::vector<UploadMatrixMatch> matches;
+    };
+    std::unordered_map<unsigned long long, Previous> previous;
+    std::vector<UploadMatrixMatch> matches;
+    std::vector<UploadMatrixMatch> reference;
+    uint64_t matchCount = 0;
+    uint64_t windowsScanned = 0;
+    uint64_t mismatches = 0;
+    const int passes = (std::max)(1, static_cast<int>(20000 / uploads.size()));
+
+    double elapsed = 0.0;
+    for (int pass = 0; pass < passes; pass++) {
+        for (const BenchUpload& upload : uploads) {
+            if (upload.vector4fCount < 3 || upload.vector4fCount > 256) {
+                continue;
+            }
+            const unsigned long long key = LearnedLayoutKey(static_cast<uint32_t>(upload.shaderKey ^ (upload.shaderKey >> 32)),
+                                                            upload.startRegister, upload.vector4fCount);
+            auto it = previous.find(key);
+            const double start = NowSeconds();
+            matches.clear();
+            if (it == previous.end()) {
+                matchCount += ScanUploadForMatrices(upload.data.data(), upload.startRegister, upload.vector4fCount, &matches);
+                windowsScanned += upload.vector4fCount * 2;
+                it = previous.emplace(key, Previous{}).first;
+            } else {
+                uint32_t changed[256 / 32] = {};
+                for (UINT i = 0; i < upload.vector4fCount; i++) {
+                    if (memcmp(&upload.data[i * 4], &it->second.data[i * 4], 4 * sizeof(float)) != 0) {
+                        changed[i >> 5] |= 1u << (i & 31);
+                    }
+                }
+                UINT scanned = 0;
+                matchCount += ScanUploadForMatricesIncremental(upload.data.data(), upload.startRegister,
+                                                               upload.vector4fCount, changed, it->second.matches,
+                                                               &matches, nullptr, &scanned);
+                windowsScanned += scanned;
+            }
+            elapsed += NowSeconds() - start;
+            it->second.data = upload.data;
+            it->second.matches = matches;
+            if (pass == 0) {
+                reference.clear();
+                ScanUploadForMatrices(upload.data.data(), upload.startRegister, upload.vector4fCount, &reference);
+                bool same = reference.size() == matches.size();
+                for (size_t i = 0; same && i < matches.size(); i++) {
+                    same = memcmp(&reference[i], &matches[i], sizeof(UploadMatrixMatch)) == 0;
+                }
+                mismatches += same ? 0 : 1;
+            }
+        }
+    }
+    const double total = static_cast<double>(uploads.size()) * passes;
+    g_benchSink += matchCount;
+    printf("  %-38s %10.0f uploads/s  %8.1f ns/upload  windows/upload %.1f  mismatches %llu\n",
+           label, total / elapsed, elapsed * 1e9 / total, windowsScanned / total,
+           static_cast<unsigned long long>(mismatches));
+}
+
+static bool LoadCapturedUploads(const char* path, std::vector<BenchUpload>* out) {
+    ConstantTraceReader reader;
+    if (!reader.Open(path)) {
+        return false;
+    }
+    TraceRecordHeader header = {};
+    std::vector<uint8_t> payload;
+    uint64_t shaderKey = 0;
+    while (reader.Next(&header, &payload)) {
+        if (header.type == TraceRecord_SetVertexShader && payload.size() >= sizeof(uint64_t)) {
+            memcpy(&shaderKey, payload.data(), sizeof(shaderKey));
+        } else if (header.type == TraceRecord_SetVertexShaderConstantF && payload.size() >= 2 * sizeof(uint32_t)) {
+            uint32_t start = 0;
+            uint32_t count = 0;
+            memcpy(&start, payload.data(), sizeof(start));
+            memcpy(&count, payload.data() + sizeof(start), sizeof(count));
+            if (payload.size() < 2 * sizeof(uint32_t) + count * 4 * sizeof(float)) {
+                continue;
+            }
+            BenchUpload upload = { shaderKey, start, count, std::vector<float>(count * 4) };
+            memcpy(upload.data.data(), payload.data() + 2 * sizeof(uint32_t), count * 4 * sizeof(float));
+            out->push_back(upload);
+        }
+    }
+    return true;
+}
+
+static void BenchUploadScan(const char* label, const std::vector<BenchUpload>& uploads, bool useLearnedLayouts,
+                            bool excludeBonePalettes = false) {
+    if (uploads.empty()) {
+        return;
+    }
+    std::unordered_map<unsigned long long, LearnedUploadLayout> layouts;
+    std::unordered_map<unsigned long long, BonePaletteTracker> palettes;
+    uint64_t paletteUploads = 0;
+    std::vector<UploadMatrixMatch> matches;
+    uint64_t matchCount = 0;
+    uint64_t lockedUploads = 0;
+    const int passes = (std::max)(1, static_cast<int>(200000 / uploads.size()));
+
+    const double start = NowSeconds();
+    for (int pass = 0; pass < passes; pass++) {
+        for (const BenchUpload& upload : uploads) {
+            if (upload.vector4fCount < 3) {
+                continue;
+            }
+            const unsigned long long key = LearnedLayoutKey(static_cast<uint32_t>(upload.shaderKey ^ (upload.shaderKey >> 32)),
+                                                            upload.startRegister, upload.vector4fCount);
+            LearnedUploadLayout* learned = nullptr;
+            if (useLearnedLayouts) {
+                learned = &layouts[key];
+                if (learned->locked) {
+                    D3DMATRIX validated[kMaxLearnedLayoutWindows];
+                    if (ValidateLearnedLayout(*learned, upload.data.data(), upload.startRegister,
+                                              upload.vector4fCount, validated)) {
+                        matchCount += learned->windowCount;
+                        lockedUploads++;
+                        continue;
+                    }
+                    learned->locked = false;
+                    learned->consistentScans = 0;
+                }
+            }
+            BonePaletteRange palette;
+            const bool excludePalette = excludeBonePalettes &&
+                UpdateBonePaletteTracker(palettes[key], upload.data.data(), upload.startRegister, upload.vector4fCount,
+                                         kBenchBonePaletteMinBones, 2, &palette);
+            paletteUploads += excludePalette ? 1 : 0;
+            matches.clear();
+            matchCount += ScanUploadForMatrices(upload.data.data(), upload.startRegister, upload.vector4fCount, &matches,
+                                                excludePalette ? &palette : nullptr);
+            if (learned) {
+                LearnedLayoutWindow found[kMaxLearnedLayoutWindows + 1];
+                int foundCount = 0;
+                for (const UploadMatrixMatch& match : matches) {
+                    if (foundCount <= kMaxLearnedLayoutWindows) {
+                        found[foundCount++] = match.window;
+                    }
+                }
+                LearnUploadLayout(*learned, found, foundCount, kBenchLockThreshold);
+            }
+        }
+    }
+    const double elapsed = NowSeconds() - start;
+    const double total = static_cast<double>(uploads.size()) * passes;
+    g_benchSink += matchCount;
+    printf("  %-38s %10.0f uploads/s  %8.1f ns/upload  matches/upload %.2f",
+           label, total / elapsed, elapsed * 1e9 / total, matchCount / total);
+    if (useLearnedLayouts) {
+        printf("  locked %.1f%%", 100.0 * lockedUploads / total);
+    }
+    if (excludeBonePalettes) {
+        printf("  palettes %.1f%%", 100.0 * paletteUploads / total);
+    }
+    printf("\n");
+}
+
+static void BenchClassification() {
+    std::vector<D3DMATRIX> matrices;
+    for (int i = 0; i < 1024; i++) {
+        switch (i % 4) {
+            case 0: matrices.push_back(MakeView()); break;
+            case 1: matrices.push_back(MakeProjection()); break;
+            case 2: matrices.push_back(MakeWorld()); break;
+            default: matrices.push_back(MultiplyMatrix(MakeView(), MakeProjection())); break;
+        }
+    }
+    const int passes = 2000;
+    uint64_t classes = 0;
+    const double start = NowSeconds();
+    for (int pass = 0; pass < passes; pass++) {
+        for (const D3DMATRIX& m : matrices) {
+            classes += ClassifyMatrixDeterministic(m, 4, 12, 0, 0);
+        }
+    }
+    const double elapsed = NowSeconds() - start;
+    const double total = static_cast<double>(matrices.size()) * passes;
+    g_benchSink += classes;
+    printf("  %-38s %10.1f ns/classification\n", "ClassifyMatrixDeterministic", elapsed * 1e9 / total);
+}
+
+static void BenchDecomposition() {
+    std::vector<D3DMATRIX> worlds;
+    std::vector<D3DMATRIX> mvps;
+    for (int i = 0; i < 512; i++) {
+        const D3DMATRIX world = MakeWorld();
+        worlds.push_back(world);
+        mvps.push_back(MultiplyMatrix(MultiplyMatrix(world, MakeView()), MakeProjection()));
+    }
+    const int passes = 1000;
+    uint64_t succeeded = 0;
+    const double start = NowSeconds();
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < mvps.size(); i++) {
+            D3DMATRIX world = {};
+            D3DMATRIX view = {};
+            D3DMATRIX projection = {};
+            const bool withWorld = (i & 1) != 0;
+            succeeded += TryDecomposeCombinedMVP(mvps[i], &worlds[i], withWorld, &world, &view, &projection, nullptr) ? 1 : 0;
+        }
+    }
+    const double elapsed = NowSeconds() - start;
+    const double total = static_cast<double>(mvps.size()) * passes;
+    g_benchSink += succeeded;
+    printf("  %-38s %10.0f decompositions/s  %8.1f ns each  (%.0f%% succeeded)\n",
+           "TryDecomposeCombinedMVP", total / elapsed, elapsed * 1e9 / total, 100.0 * succeeded / total);
+}
+
+// One camera per 512-upload frame: identity-world draws re-upload the same
+// view-projection (combined-MVP path), and MGR-style uploads pair it with the same
+// projection (view derivation path). Run with and without CameraDerivationCache.
+static void BenchCameraDerivationCache() {
+    const int frames = 1000;
+    const int uploadsPerFrame = 512;
+    std::vector<D3DMATRIX> projections;
+    std::vector<D3DMATRIX> viewProjections;
+    for (int i = 0; i < 64; i++) {
+        const D3DMATRIX projection = MakeProjection();
+        projections.push_back(projection);
+        viewProjections.push_back(MultiplyMatrix(MakeView(), projection));
+    }
+    for (int cached = 0; cached < 2; cached++) {
+        CameraDerivationCache cache;
+        CameraDerivationCache* cachePtr = cached ? &cache : nullptr;
+        uint64_t succeeded = 0;
+        double start = NowSeconds();
+        for (int frame = 0; frame < frames; frame++) {
+            const D3DMATRIX& viewProjection = viewProjections[frame % viewProjections.size()];
+            for (int i = 0; i < uploadsPerFrame; i++) {
+                D3DMATRIX world = {};
+                D3DMATRIX view = {};
+                D3DMATRIX projection = {};
+                succeeded += TryDecomposeCombinedMVP(viewProjection, nullptr, false, &world, &view, &projection,
+                                                     nullptr, cachePtr) ? 1 : 0;
+            }
+        }
+        double elapsed = NowSeconds() - start;
+        const double total = static_cast<double>(frames) * uploadsPerFrame;
+        printf("  %-38s %10.0f decompositions/s  %8.1f ns each  (%.0f%% succeeded)\n",
+               cached ? "repeated VP decomposition, cached" : "repeated VP decomposition",
+               total / elapsed, elapsed * 1e9 / total, 100.0 * succeeded / total);
+
+        start = NowSeconds();
+        for (int frame = 0; frame < frames; frame++) {
+            const size_t camera = frame % projections.size();
+            for (int i = 0; i < uploadsPerFrame; i++) {
+                D3DMATRIX view = {};
+                succeeded += DeriveViewFromViewProjection(projections[camera], viewProjections[camera], &view,
+                                                          cachePtr) ? 1 : 0;
+                g_benchSink += static_cast<uint64_t>(view._41 != 0.0f);
+            }
+        }
+        elapsed = NowSeconds() - start;
+        g_benchSink += succeeded;
+        printf("  %-38s %10.0f derivations/s    %8.1f ns each",
+               cached ? "view from VP, cached" : "view from VP", total / elapsed, elapsed * 1e9 / total);
+        if (cached) {
+            printf("  (hits: %.1f%% decomposition, %.1f%% inverse)",
+                   100.0 * cache.decompositionHits / (std::max)(1ull, cache.decompositionHits + cache.decompositionMisses),
+                   100.0 * cache.projectionHits / (std::max)(1ull, cache.projectionHits + cache.projectionMisses));
+        }
+        printf("\n");
+    }
+}
+
+static bool CountScanHit(void* context, size_t, const D3DMATRIX&, bool) {
+    (*static_cast<uint64_t*>(context))++;
+    return true;
+}
+
+// 64 MB of heap-like noise (small integers, pointers-as-floats, unit floats) with a
+// view and projection matrix planted every 256 KB, scanned in the proxy's chunk size.
+static void BenchMemoryScan() {
+    const size_t floatCount = 16u * 1024u * 1024u;
+    std::vector<float> memory(floatCount);
+    for (size_t i = 0; i < floatCount; i++) {
+        switch (i % 7) {
+            case 0: memory[i] = 0.0f; break;
+            case 1: memory[i] = static_cast<float>(i & 0xFF); break;
+            case 2: {
+                uint32_t bits = 0x00400000u + static_cast<uint32_t>(i);
+                memcpy(&memory[i], &bits, sizeof(bits));
+                break;
+            }
+            default: memory[i] = RandomFloat(-1.0f, 1.0f); break;
+        }
+    }
+    for (size_t offset = 1024; offset + 32 < floatCount; offset += 64 * 1024) {
+        const D3DMATRIX view = MakeView();
+        const D3DMATRIX projection = MakeProjection();
+        memcpy(&memory[offset], &view, sizeof(view));
+        memcpy(&memory[offset + 16], &projection, sizeof(projection));
+    }
+
+    std::vector<uint8_t> flags(kScanChunkFloats + 15);
+    std::vector<uint8_t> okRun(flags.size());
+    std::vector<uint8_t> nextSignificant(flags.size());
+    uint64_t hits = 0;
+    const int passes = 4;
+    const double start = NowSeconds();
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t chunk = 0; chunk < floatCount; chunk += kScanChunkFloats) {
+            const size_t windowCount = (std::min)(kScanChunkFloats, floatCount - chunk);
+            const size_t readCount = (std::min)(floatCount - chunk, windowCount + 15);
+            ScanFloatsForCameraMatrices(memory.data() + chunk, readCount, windowCount,
+                                        flags.data(), okRun.data(), nextSignificant.data(),
+                                        CountScanHit, &hits);
+        }
+    }
+    const double elapsed = NowSeconds() - start;
+    const double bytes = static_cast<double>(floatCount) * sizeof(float) * passes;
+    g_benchSink += hits;
+    printf("  %-38s %10.2f GB/s  (%llu hits per pass)\n",
+           "ScanFloatsForCameraMatrices", bytes / elapsed / 1e9,
+           static_cast<unsigned long long>(hits / passes));
+}
+
+int main(int argc, char** argv) {
+    const char* tracePath = argc > 1 ? argv[1] : nullptr;
+    SetReconstructionConfig(ReconstructionConfig{});
+
+    const std::vector<BenchUpload> synthetic = BuildSyntheticUploads(64);
+    const std::vector<BenchUpload> bulk = BuildBulkUploads(16);
+    const std::vector<BenchUpload> animated = BuildAnimatedConstantUploads(64);
+    std::vector<BenchUpload> captured;
+    if (tracePath) {
+        if (!LoadCapturedUploads(tracePath, &captured)) {
+            fprintf(stderr, "Cannot read trace %s\n", tracePath);
+            return 1;
+        }
+        printf("Captured trace %s: %zu constant uploads\n", tracePath, captured.size());
+    }
+
+    for (int simd = 0; simd < 2; simd++) {
+        SelectMatrixKernels(simd != 0);
+        if (simd && strcmp(ActiveMatrixKernels().name, "scalar") == 0) {
+            break;
+        }
+        printf("\n[%s kernels]\n", ActiveMatrixKernels().name);
+        BenchUploadScan("synthetic uploads, full scan", synthetic, false);
+        BenchUploadScan("synthetic uploads, learned layouts", synthetic, true);
+        BenchUploadScan("synthetic uploads, palettes excluded", synthetic, false, true);
+        BenchUploadScan("animated constants, full scan", animated, false);
+        BenchUploadScan("animated constants, learned layouts", animated, true);
+        BenchUploadScan("bulk c0-c255 uploads, full scan", bulk, false);
+        BenchIncrementalScan("bulk c0-c255 uploads, incremental", bulk);
+        BenchIncrementalScan("synthetic uploads, incremental", synthetic);
+        if (!captured.empty()) {
+            BenchUploadScan("captured uploads, full scan", captured, false);
+            BenchUploadScan("captured uploads, learned layouts", captured, true);
+            BenchUploadScan("captured uploads, palettes excluded", captured, false, true);
+            BenchIncrementalScan("captured uploads, incremental", captured);
+        }
+        BenchClassification();
+        BenchDecomposition();
+        BenchCameraDerivationCache();
+        BenchMemoryScan();
+    }
+    printf("\n(sink %llu)\n", static_cast<unsigned long long>(g_benchSink));
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Shared-memory camera export: layout and reader for external tools.
+ *
+ * This is a diagnostic export and is off by default. With SharedCameraExport=1 the proxy creates a named file mapping
+ * ("Local\<SharedCameraExportName>", or "Local\<name>_<pid>" when another
+ * process already owns the name) and rewrites it in place at every Present.
+ * The mapping holds one CameraProxySharedHeader followed by nothing else; the
+ * header's size field is sizeof(CameraProxySharedHeader) of the writer.
+ *
+ * Consistency uses a sequence lock: the writer makes `sequence` odd with
+ * InterlockedExchange, updates `frame`, then makes it even again the same way,
+ * so both stores are full barriers around the frame. A reader copies `frame` between two reads
+ * of `sequence` and retries when they differ or are odd, so readers never block
+ * the game and need no handles beyond the mapping itself:
+ *
+ *   HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, "Local\\CameraProxyCamera");
+ *   const CameraProxySharedHeader* shared = static_cast<const CameraProxySharedHeader*>(
+ *       MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(CameraProxySharedHeader)));
+ *   CameraProxySharedFrame frame;
+ *   if (CameraProxyReadShared(shared, &frame)) { ... }
+ *
+ * Everything is plain fixed-width data (matrices row-major, D3DMATRIX order) so
+ * tools in other languages can map the same layout. The version is bumped on
+ * any layout change.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#define CAMERA_PROXY_SHARED_MAGIC 0x4D414350u  // 'PCAM'
+#define CAMERA_PROXY_SHARED_VERSION 1u
+
+enum CameraProxySharedSlot {
+    CameraProxySharedSlot_World = 0,
+    CameraProxySharedSlot_View,
+    CameraProxySharedSlot_Projection,
+    CameraProxySharedSlot_MVP,
+    CameraProxySharedSlot_Count
+};
+
+// Where a matrix came from; mirrors the proxy's MatrixSourceInfo.
+struct CameraProxySharedSource {
+    uint8_t valid;
+    uint8_t manual;
+    uint8_t transposed;
+    uint8_t rows;
+    int32_t baseRegister;
+    int32_t extractedFromRegister;
+    uint32_t shaderHash;
+    uint64_t shaderKey;
+    char sourceLabel[48];
+};
+
+struct CameraProxySharedFrame {
+    float matrices[CameraProxySharedSlot_Count][16];
+    // Bit n set = matrices[n] holds a detected matrix for this frame.
+    uint32_t validMask;
+    // ProjectionHandedness: 0 unknown, 1 left-handed, 2 right-handed.
+    int32_t handedness;
+    float fovRadians;
+    float frameTimeMs;
+    CameraProxySharedSource sources[CameraProxySharedSlot_Count];
+
+    uint64_t frame;
+    // QueryPerformanceCounter at the Present that published this frame.
+    int64_t presentCounter;
+    uint64_t constantUploads;
+    uint64_t constantFastPathUploads;
+    uint64_t transformsSent;
+    uint64_t transformsSkipped;
+    uint64_t passDrawsSkipped;
+    uint64_t screenSpaceDrawsSkipped;
+    // Present housekeeping cost of the previous frame.
+    uint32_t presentTaskMicros;
+    uint32_t reserved;
+};
+
+struct CameraProxySharedHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t processId;
+    // Odd while the writer is inside an update. Written only with InterlockedExchange.
+    uint32_t sequence;
+    uint32_t reserved;
+    CameraProxySharedFrame frame;
+};
+
+// The view is mapped read-only, so the reader cannot use interlocked operations;
+// volatile only forces a fresh load, the ordering comes from the fences.
+static inline uint32_t CameraProxyLoadSequence(const CameraProxySharedHeader* shared) {
+    return *static_cast<const volatile uint32_t*>(&shared->sequence);
+}
+
+// Copies the latest complete frame. Returns false when the mapping is not a
+// compatible export or the writer kept it busy for every attempt.
+static inline bool CameraProxyReadShared(const CameraProxySharedHeader* shared, CameraProxySharedFrame* out,
+                                         int maxAttempts = 64) {
+    if (!shared || !out || shared->magic != CAMERA_PROXY_SHARED_MAGIC ||
+        shared->version != CAMERA_PROXY_SHARED_VERSION || shared->size < sizeof(CameraProxySharedHeader)) {
+        return false;
+    }
+    for (int attempt = 0; attempt < maxAttempts; ++attempt) {
+        const uint32_t before = CameraProxyLoadSequence(shared);
+        if (before & 1u) {
+            continue;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        memcpy(out, &shared->frame, sizeof(*out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (CameraProxyLoadSequence(shared) == before) {
+            return true;
+        }
+    }
+    return false;
+}
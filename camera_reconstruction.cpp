@@ -0,0 +1,1381 @@
+/**
+ * Camera matrix reconstruction for the camera proxy (see camera_reconstruction.h).
+ *
+ * Moved out of d3d9_proxy.cpp unchanged apart from the config source: the FOV
+ * window and decomposition switches come from ReconstructionConfig instead of the
+ * proxy's ini state. The scalar kernels below are the references that the SSE2
+ * versions in matrix_kernels.h must match.
+ */
+#include "camera_reconstruction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static ReconstructionConfig g_reconstructionConfig = {};
+// Bumped whenever cached derivations may no longer match a fresh computation.
+static uint32_t g_derivationGeneration = 1;
+
+void SetReconstructionConfig(const ReconstructionConfig& config) {
+    g_reconstructionConfig = config;
+    g_derivationGeneration++;
+}
+
+const ReconstructionConfig& GetReconstructionConfig() {
+    return g_reconstructionConfig;
+}
+
+// Scalar reference kernels; the SSE2 versions in matrix_kernels.h must match them.
+static D3DMATRIX MultiplyMatrixScalar(const D3DMATRIX& a, const D3DMATRIX& b);
+static D3DMATRIX TransposeMatrixScalar(const D3DMATRIX& mat);
+static bool LooksLikeMatrixScalar(const float* data);
+static bool LooksLikeViewStrictScalar(const D3DMATRIX& m);
+static bool ProjectionOffDiagonalWithinScalar(const D3DMATRIX& m, float epsilon);
+static bool InvertMatrix4x4Scalar(const D3DMATRIX& in, D3DMATRIX* out, float* outDeterminant);
+static void OrthonormalizeViewMatrixScalar(D3DMATRIX* view);
+static void ClassifyScanFloatsScalar(const float* data, size_t count, uint8_t* flags);
+
+static const MatrixKernelTable kScalarMatrixKernels = {
+    "scalar",
+    MultiplyMatrixScalar,
+    TransposeMatrixScalar,
+    LooksLikeMatrixScalar,
+    LooksLikeViewStrictScalar,
+    ProjectionOffDiagonalWithinScalar,
+    InvertMatrix4x4Scalar,
+    OrthonormalizeViewMatrixScalar,
+    ClassifyScanFloatsScalar
+};
+
+static const MatrixKernelTable kSSE2MatrixKernels = {
+    "SSE2",
+    MultiplyMatrixSSE2,
+    TransposeMatrixSSE2,
+    LooksLikeMatrixSSE2,
+    LooksLikeViewStrictSSE2,
+    ProjectionOffDiagonalWithinSSE2,
+    InvertMatrix4x4SSE2,
+    OrthonormalizeViewMatrixSSE2,
+    ClassifyScanFloatsSSE2
+};
+
+static const MatrixKernelTable* g_matrixKernels = &kScalarMatrixKernels;
+static CpuFeatures g_cpuFeatures = {};
+
+void SelectMatrixKernels(bool allowSimd) {
+    g_cpuFeatures = DetectCpuFeatures();
+    g_matrixKernels = (allowSimd && g_cpuFeatures.sse2) ? &kSSE2MatrixKernels : &kScalarMatrixKernels;
+    g_derivationGeneration++;
+}
+
+const MatrixKernelTable& ActiveMatrixKernels() {
+    return *g_matrixKernels;
+}
+
+const CpuFeatures& DetectedCpuFeatures() {
+    return g_cpuFeatures;
+}
+
+D3DMATRIX MultiplyMatrix(const D3DMATRIX& a, const D3DMATRIX& b) {
+    return g_matrixKernels->multiply(a, b);
+}
+
+D3DMATRIX TransposeMatrix(const D3DMATRIX& mat) {
+    return g_matrixKernels->transpose(mat);
+}
+
+bool LooksLikeMatrix(const float* data) {
+    return g_matrixKernels->looksLikeMatrix(data);
+}
+
+bool LooksLikeViewStrict(const D3DMATRIX& m) {
+    return g_matrixKernels->looksLikeViewStrict(m);
+}
+
+bool InvertMatrix4x4Deterministic(const D3DMATRIX& in, D3DMATRIX* out, float* outDeterminant) {
+    return g_matrixKernels->invert(in, out, outDeterminant);
+}
+
+void OrthonormalizeViewMatrix(D3DMATRIX* view) {
+    g_matrixKernels->orthonormalizeView(view);
+}
+
+static D3DMATRIX TransposeMatrixScalar(const D3DMATRIX& mat) {
+    D3DMATRIX out = {};
+    out._11 = mat._11; out._12 = mat._21; out._13 = mat._31; out._14 = mat._41;
+    out._21 = mat._12; out._22 = mat._22; out._23 = mat._32; out._24 = mat._42;
+    out._31 = mat._13; out._32 = mat._23; out._33 = mat._33; out._34 = mat._43;
+    out._41 = mat._14; out._42 = mat._24; out._43 = mat._34; out._44 = mat._44;
+    return out;
+}
+
+D3DMATRIX InvertSimpleRigidView(const D3DMATRIX& view) {
+    D3DMATRIX out = {};
+    out._11 = view._11; out._12 = view._21; out._13 = view._31;
+    out._21 = view._12; out._22 = view._22; out._23 = view._32;
+    out._31 = view._13; out._32 = view._23; out._33 = view._33;
+    out._44 = 1.0f;
+    out._41 = -(view._41 * out._11 + view._42 * out._21 + view._43 * out._31);
+    out._42 = -(view._41 * out._12 + view._42 * out._22 + view._43 * out._32);
+    out._43 = -(view._41 * out._13 + view._42 * out._23 + view._43 * out._33);
+    return out;
+}
+
+const char* GameProfileLabel(GameProfileKind profile) {
+    switch (profile) {
+        case GameProfile_DevilMayCry4: return "DevilMayCry4";
+        case GameProfile_MetalGearRising: return "MetalGearRising";
+        case GameProfile_None:
+        default:
+            return "None";
+    }
+}
+
+GameProfileKind ParseGameProfile(const char* profileName) {
+    if (!profileName || profileName[0] == '\0') {
+        return GameProfile_None;
+    }
+    if (_stricmp(profileName, "MetalGearRising") == 0 ||
+        _stricmp(profileName, "MGR") == 0 ||
+        _stricmp(profileName, "MetalGearRisingRevengeance") == 0) {
+        return GameProfile_MetalGearRising;
+    }
+    if (_stricmp(profileName, "DevilMayCry4") == 0 ||
+        _stricmp(profileName, "DMC4") == 0 ||
+        _stricmp(profileName, "DevilMayCry4Original") == 0) {
+        return GameProfile_DevilMayCry4;
+    }
+    return GameProfile_None;
+}
+
+static bool InvertMatrix4x4Scalar(const D3DMATRIX& in, D3DMATRIX* out, float* outDeterminant) {
+    if (!out) {
+        return false;
+    }
+
+    const float* m = reinterpret_cast<const float*>(&in);
+    float inv[16] = {};
+
+    inv[0] = m[5]  * m[10] * m[15] -
+             m[5]  * m[11] * m[14] -
+             m[9]  * m[6]  * m[15] +
+             m[9]  * m[7]  * m[14] +
+             m[13] * m[6]  * m[11] -
+             m[13] * m[7]  * m[10];
+
+    inv[4] = -m[4]  * m[10] * m[15] +
+              m[4]  * m[11] * m[14] +
+              m[8]  * m[6]  * m[15] -
+              m[8]  * m[7]  * m[14] -
+              m[12] * m[6]  * m[11] +
+              m[12] * m[7]  * m[10];
+
+    inv[8] = m[4]  * m[9] * m[15] -
+             m[4]  * m[11] * m[13] -
+             m[8]  * m[5] * m[15] +
+             m[8]  * m[7] * m[13] +
+             m[12] * m[5] * m[11] -
+             m[12] * m[7] * m[9];
+
+    inv[12] = -m[4]  * m[9] * m[14] +
+               m[4]  * m[10] * m[13] +
+               m[8]  * m[5] * m[14] -
+               m[8]  * m[6] * m[13] -
+               m[12] * m[5] * m[10] +
+               m[12] * m[6] * m[9];
+
+    inv[1] = -m[1]  * m[10] * m[15] +
+              m[1]  * m[11] * m[14] +
+              m[9]  * m[2] * m[15] -
+              m[9]  * m[3] * m[14] -
+              m[13] * m[2] * m[11] +
+              m[13] * m[3] * m[10];
+
+    inv[5] = m[0]  * m[10] * m[15] -
+             m[0]  * m[11] * m[14] -
+             m[8]  * m[2] * m[15] +
+             m[8]  * m[3] * m[14] +
+             m[12] * m[2] * m[11] -
+             m[12] * m[3] * m[10];
+
+    inv[9] = -m[0]  * m[9] * m[15] +
+              m[0]  * m[11] * m[13] +
+              m[8]  * m[1] * m[15] -
+              m[8]  * m[3] * m[13] -
+              m[12] * m[1] * m[11] +
+              m[12] * m[3] * m[9];
+
+    inv[13] = m[0]  * m[9] * m[14] -
+              m[0]  * m[10] * m[13] -
+              m[8]  * m[1] * m[14] +
+              m[8]  * m[2] * m[13] +
+              m[12] * m[1] * m[10] -
+              m[12] * m[2] * m[9];
+
+    inv[2] = m[1]  * m[6] * m[15] -
+             m[1]  * m[7] * m[14] -
+             m[5]  * m[2] * m[15] +
+             m[5]  * m[3] * m[14] +
+             m[13] * m[2] * m[7] -
+             m[13] * m[3] * m[6];
+
+    inv[6] = -m[0]  * m[6] * m[15] +
+              m[0]  * m[7] * m[14] +
+              m[4]  * m[2] * m[15] -
+              m[4]  * m[3] * m[14] -
+              m[12] * m[2] * m[7] +
+              m[12] * m[3] * m[6];
+
+    inv[10] = m[0]  * m[5] * m[15] -
+              m[0]  * m[7] * m[13] -
+              m[4]  * m[1] * m[15] +
+              m[4]  * m[3] * m[13] +
+              m[12] * m[1] * m[7] -
+              m[12] * m[3] * m[5];
+
+    inv[14] = -m[0]  * m[5] * m[14] +
+               m[0]  * m[6] * m[13] +
+               m[4]  * m[1] * m[14] -
+               m[4]  * m[2] * m[13] -
+               m[12] * m[1] * m[6] +
+               m[12] * m[2] * m[5];
+
+    inv[3] = -m[1] * m[6] * m[11] +
+              m[1] * m[7] * m[10] +
+              m[5] * m[2] * m[11] -
+              m[5] * m[3] * m[10] -
+              m[9] * m[2] * m[7] +
+              m[9] * m[3] * m[6];
+
+    inv[7] = m[0] * m[6] * m[11] -
+             m[0] * m[7] * m[10] -
+             m[4] * m[2] * m[11] +
+             m[4] * m[3] * m[10] +
+             m[8] * m[2] * m[7] -
+             m[8] * m[3] * m[6];
+
+    inv[11] = -m[0] * m[5] * m[11] +
+               m[0] * m[7] * m[9] +
+               m[4] * m[1] * m[11] -
+               m[4] * m[3] * m[9] -
+               m[8] * m[1] * m[7] +
+               m[8] * m[3] * m[5];
+
+    inv[15] = m[0] * m[5] * m[10] -
+              m[0] * m[6] * m[9] -
+              m[4] * m[1] * m[10] +
+              m[4] * m[2] * m[9] +
+              m[8] * m[1] * m[6] -
+              m[8] * m[2] * m[5];
+
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (outDeterminant) {
+        *outDeterminant = det;
+    }
+    if (fabsf(det) <= 1e-8f) {
+        return false;
+    }
+
+    const float detInv = 1.0f / det;
+    float* dst = reinterpret_cast<float*>(out);
+    for (int i = 0; i < 16; i++) {
+        dst[i] = inv[i] * detInv;
+    }
+    return true;
+}
+
+bool TryBuildMatrixFromConstantUpdate(const float* constantData,
+                                      UINT startRegister,
+                                      UINT vector4fCount,
+                                      int baseRegister,
+                                      int rows,
+                                      bool transposed,
+                                      D3DMATRIX* outMatrix) {
+    if (!constantData || !outMatrix || rows < 3 || rows > 4) {
+        return false;
+    }
+    if (baseRegister < 0) {
+        return false;
+    }
+    if (startRegister > static_cast<UINT>(baseRegister) ||
+        startRegister + vector4fCount < static_cast<UINT>(baseRegister + rows)) {
+        return false;
+    }
+
+    int offset = (baseRegister - static_cast<int>(startRegister)) * 4;
+    const float* m = constantData + offset;
+    D3DMATRIX out = {};
+
+    if (!transposed) {
+        out._11 = m[0]; out._12 = m[1]; out._13 = m[2]; out._14 = m[3];
+        out._21 = m[4]; out._22 = m[5]; out._23 = m[6]; out._24 = m[7];
+        out._31 = m[8]; out._32 = m[9]; out._33 = m[10]; out._34 = m[11];
+        if (rows == 4) {
+            out._41 = m[12]; out._42 = m[13]; out._43 = m[14]; out._44 = m[15];
+        } else {
+            out._41 = 0.0f; out._42 = 0.0f; out._43 = 0.0f; out._44 = 1.0f;
+        }
+    } else {
+        out._11 = m[0]; out._21 = m[1]; out._31 = m[2]; out._41 = m[3];
+        out._12 = m[4]; out._22 = m[5]; out._32 = m[6]; out._42 = m[7];
+        out._13 = m[8]; out._23 = m[9]; out._33 = m[10]; out._43 = m[11];
+        if (rows == 4) {
+            out._14 = m[12]; out._24 = m[13]; out._34 = m[14]; out._44 = m[15];
+        } else {
+            out._14 = 0.0f; out._24 = 0.0f; out._34 = 0.0f; out._44 = 1.0f;
+        }
+    }
+
+    *outMatrix = out;
+    return true;
+}
+
+// Check if matrix values are valid
+static bool LooksLikeMatrixScalar(const float* data) {
+    float sum = 0;
+    for (int i = 0; i < 16; i++) {
+        if (!std::isfinite(data[i])) return false;
+        sum += fabsf(data[i]);
+    }
+    if (sum < 0.001f || sum > 10000.0f) return false;
+    return true;
+}
+
+static void ClassifyScanFloatsScalar(const float* data, size_t count, uint8_t* flags) {
+    for (size_t i = 0; i < count; ++i) {
+        const float a = fabsf(data[i]);
+        flags[i] = static_cast<uint8_t>((a <= 10000.0f ? 1 : 0) | (a >= 0.00005f ? 2 : 0));
+    }
+}
+
+static float Dot3(float ax, float ay, float az, float bx, float by, float bz) {
+    return ax * bx + ay * by + az * bz;
+}
+
+static float Determinant3x3(const D3DMATRIX& m) {
+    return m._11 * (m._22 * m._33 - m._23 * m._32) -
+           m._12 * (m._21 * m._33 - m._23 * m._31) +
+           m._13 * (m._21 * m._32 - m._22 * m._31);
+}
+
+static bool LooksLikeViewStrictScalar(const D3DMATRIX& m) {
+    float row0len = sqrtf(Dot3(m._11, m._12, m._13, m._11, m._12, m._13));
+    float row1len = sqrtf(Dot3(m._21, m._22, m._23, m._21, m._22, m._23));
+    float row2len = sqrtf(Dot3(m._31, m._32, m._33, m._31, m._32, m._33));
+
+    if (fabsf(row0len - 1.0f) > 0.05f) return false;
+    if (fabsf(row1len - 1.0f) > 0.05f) return false;
+    if (fabsf(row2len - 1.0f) > 0.05f) return false;
+
+    if (fabsf(Dot3(m._11, m._12, m._13, m._21, m._22, m._23)) > 0.05f) return false;
+    if (fabsf(Dot3(m._11, m._12, m._13, m._31, m._32, m._33)) > 0.05f) return false;
+    if (fabsf(Dot3(m._21, m._22, m._23, m._31, m._32, m._33)) > 0.05f) return false;
+
+    if (fabsf(m._14) > 0.01f || fabsf(m._24) > 0.01f || fabsf(m._34) > 0.01f) return false;
+    if (fabsf(m._44 - 1.0f) > 0.01f) return false;
+
+    float det = Determinant3x3(m);
+    if (fabsf(det - 1.0f) > 0.1f) return false;
+
+    return true;
+}
+
+bool LooksLikeProjectionStrict(const D3DMATRIX& m) {
+    return AnalyzeProjectionMatrixNumeric(m, nullptr);
+}
+
+bool IsTypicalProjectionMatrix(const D3DMATRIX& m) {
+    ProjectionAnalysis analysis = {};
+    if (!AnalyzeProjectionMatrixNumeric(m, &analysis) || !analysis.valid) {
+        return false;
+    }
+
+    const bool perspectiveTermsLookValid =
+        fabsf(m._14) <= 0.05f &&
+        fabsf(m._24) <= 0.05f &&
+        fabsf(m._44) <= 0.05f &&
+        fabsf(fabsf(m._34) - 1.0f) <= 0.05f;
+
+    return perspectiveTermsLookValid;
+}
+
+static bool ProjectionOffDiagonalWithinScalar(const D3DMATRIX& m, float epsilon) {
+    if (fabsf(m._12) > epsilon || fabsf(m._13) > epsilon ||
+        fabsf(m._21) > epsilon || fabsf(m._23) > epsilon ||
+        fabsf(m._31) > epsilon || fabsf(m._32) > epsilon) {
+        return false;
+    }
+    return !(fabsf(m._14) > epsilon || fabsf(m._24) > epsilon);
+}
+
+bool AnalyzeProjectionMatrixNumeric(const D3DMATRIX& m, ProjectionAnalysis* out) {
+    constexpr float kZeroEpsilon = 0.02f;
+    constexpr float kPerspectiveEpsilon = 0.05f;
+
+    if (!std::isfinite(m._11) || !std::isfinite(m._22) || !std::isfinite(m._33) ||
+        !std::isfinite(m._34) || !std::isfinite(m._43) || !std::isfinite(m._44)) {
+        return false;
+    }
+
+    if (!g_matrixKernels->projectionOffDiagonalWithin(m, kZeroEpsilon)) {
+        return false;
+    }
+
+    if (fabsf(fabsf(m._34) - 1.0f) > kPerspectiveEpsilon) {
+        return false;
+    }
+
+    if (fabsf(m._44) > kPerspectiveEpsilon) {
+        return false;
+    }
+
+    if (fabsf(m._11) < 0.001f || fabsf(m._22) < 0.001f) {
+        return false;
+    }
+
+    if (fabsf(m._33) < 0.0001f || fabsf(m._43) < 0.0001f) {
+        return false;
+    }
+
+    const float fov = 2.0f * atanf(1.0f / fabsf(m._22));
+    if (!std::isfinite(fov) || fov < g_reconstructionConfig.minFOV || fov > g_reconstructionConfig.maxFOV) {
+        return false;
+    }
+
+    if (out) {
+        out->valid = true;
+        out->fovRadians = fov;
+        out->handedness = (m._34 >= 0.0f) ? ProjectionHandedness_Left : ProjectionHandedness_Right;
+    }
+    return true;
+}
+
+const char* ProjectionHandednessLabel(ProjectionHandedness handedness) {
+    switch (handedness) {
+        case ProjectionHandedness_Left: return "LH";
+        case ProjectionHandedness_Right: return "RH";
+        default: return "Unknown";
+    }
+}
+
+bool HasPerspectiveComponent(const D3DMATRIX& m) {
+    return fabsf(m._34) > 0.5f && fabsf(m._44) < 0.5f;
+}
+
+bool IsAffineMatrixNoPerspective(const D3DMATRIX& m) {
+    return fabsf(m._14) < 0.02f && fabsf(m._24) < 0.02f && fabsf(m._34) < 0.02f && fabsf(m._44 - 1.0f) < 0.02f;
+}
+
+bool IsLikelyBoneTransform(const D3DMATRIX& m,
+                           int rows,
+                           UINT vectorCountInUpload,
+                           UINT uploadStartReg,
+                           UINT candidateBaseReg) {
+    if (!IsAffineMatrixNoPerspective(m)) {
+        return false;
+    }
+
+    const float tx = m._41;
+    const float ty = m._42;
+    const float tz = m._43;
+    const float translationLen = sqrtf(tx * tx + ty * ty + tz * tz);
+
+    const float r0 = sqrtf(Dot3(m._11, m._12, m._13, m._11, m._12, m._13));
+    const float r1 = sqrtf(Dot3(m._21, m._22, m._23, m._21, m._22, m._23));
+    const float r2 = sqrtf(Dot3(m._31, m._32, m._33, m._31, m._32, m._33));
+    const bool nearUnitRows = fabsf(r0 - 1.0f) < 0.25f && fabsf(r1 - 1.0f) < 0.25f && fabsf(r2 - 1.0f) < 0.25f;
+
+    const bool appearsInLargePaletteUpload =
+        rows == 3 && vectorCountInUpload >= 12 && candidateBaseReg >= uploadStartReg &&
+        candidateBaseReg + 2 < uploadStartReg + vectorCountInUpload;
+
+    return nearUnitRows && translationLen < 50.0f && appearsInLargePaletteUpload;
+}
+
+bool LooksLikeWorldStrict(const D3DMATRIX& m,
+                          int rows,
+                          UINT vectorCountInUpload,
+                          UINT uploadStartReg,
+                          UINT candidateBaseReg) {
+    if (!IsAffineMatrixNoPerspective(m)) return false;
+    if (LooksLikeViewStrict(m)) return false;
+
+    const float det = Determinant3x3(m);
+    if (!std::isfinite(det) || fabsf(det) < 0.0001f) return false;
+
+    if (IsLikelyBoneTransform(m, rows, vectorCountInUpload, uploadStartReg, candidateBaseReg)) {
+        return false;
+    }
+    return true;
+}
+
+MatrixClassification ClassifyMatrixDeterministic(const D3DMATRIX& m,
+                                                 int rows,
+                                                 UINT vectorCountInUpload,
+                                                 UINT uploadStartReg,
+                                                 UINT candidateBaseReg) {
+    if (LooksLikeProjectionStrict(m)) {
+        return MatrixClass_Projection;
+    }
+    if (HasPerspectiveComponent(m)) {
+        return MatrixClass_CombinedPerspective;
+    }
+    if (LooksLikeViewStrict(m)) {
+        return MatrixClass_View;
+    }
+    if (LooksLikeWorldStrict(m, rows, vectorCountInUpload, uploadStartReg, candidateBaseReg)) {
+        return MatrixClass_World;
+    }
+    return MatrixClass_None;
+}
+
+static D3DMATRIX MultiplyMatrixScalar(const D3DMATRIX& a, const D3DMATRIX& b) {
+    D3DMATRIX out = {};
+    out._11 = a._11*b._11 + a._12*b._21 + a._13*b._31 + a._14*b._41;
+    out._12 = a._11*b._12 + a._12*b._22 + a._13*b._32 + a._14*b._42;
+    out._13 = a._11*b._13 + a._12*b._23 + a._13*b._33 + a._14*b._43;
+    out._14 = a._11*b._14 + a._12*b._24 + a._13*b._34 + a._14*b._44;
+
+    out._21 = a._21*b._11 + a._22*b._21 + a._23*b._31 + a._24*b._41;
+    out._22 = a._21*b._12 + a._22*b._22 + a._23*b._32 + a._24*b._42;
+    out._23 = a._21*b._13 + a._22*b._23 + a._23*b._33 + a._24*b._43;
+    out._24 = a._21*b._14 + a._22*b._24 + a._23*b._34 + a._24*b._44;
+
+    out._31 = a._31*b._11 + a._32*b._21 + a._33*b._31 + a._34*b._41;
+    out._32 = a._31*b._12 + a._32*b._22 + a._33*b._32 + a._34*b._42;
+    out._33 = a._31*b._13 + a._32*b._23 + a._33*b._33 + a._34*b._43;
+    out._34 = a._31*b._14 + a._32*b._24 + a._33*b._34 + a._34*b._44;
+
+    out._41 = a._41*b._11 + a._42*b._21 + a._43*b._31 + a._44*b._41;
+    out._42 = a._41*b._12 + a._42*b._22 + a._43*b._32 + a._44*b._42;
+    out._43 = a._41*b._13 + a._42*b._23 + a._43*b._33 + a._44*b._43;
+    out._44 = a._41*b._14 + a._42*b._24 + a._43*b._34 + a._44*b._44;
+    return out;
+}
+
+bool IsIdentityMatrix(const D3DMATRIX& m, float tolerance) {
+    return fabsf(m._11 - 1.0f) < tolerance &&
+           fabsf(m._22 - 1.0f) < tolerance &&
+           fabsf(m._33 - 1.0f) < tolerance &&
+           fabsf(m._44 - 1.0f) < tolerance &&
+           fabsf(m._12) < tolerance &&
+           fabsf(m._13) < tolerance &&
+           fabsf(m._14) < tolerance &&
+           fabsf(m._21) < tolerance &&
+           fabsf(m._23) < tolerance &&
+           fabsf(m._24) < tolerance &&
+           fabsf(m._31) < tolerance &&
+           fabsf(m._32) < tolerance &&
+           fabsf(m._34) < tolerance &&
+           fabsf(m._41) < tolerance &&
+           fabsf(m._42) < tolerance &&
+           fabsf(m._43) < tolerance;
+}
+
+float MatrixIdentityMaxError(const D3DMATRIX& m) {
+    const D3DMATRIX identity = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    const float* a = reinterpret_cast<const float*>(&m);
+    const float* b = reinterpret_cast<const float*>(&identity);
+    float maxErr = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        maxErr = (std::max)(maxErr, fabsf(a[i] - b[i]));
+    }
+    return maxErr;
+}
+
+bool MatrixClose(const D3DMATRIX& a, const D3DMATRIX& b, float tolerance) {
+    const float* pa = reinterpret_cast<const float*>(&a);
+    const float* pb = reinterpret_cast<const float*>(&b);
+    for (int i = 0; i < 16; i++) {
+        if (fabsf(pa[i] - pb[i]) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Extract FOV from projection matrix
+float ExtractFOV(const D3DMATRIX& proj) {
+    if (fabsf(proj._22) < 0.001f) return 0;
+    return 2.0f * atanf(1.0f / fabsf(proj._22));
+}
+
+// Check if matrix looks like projection
+bool LooksLikeProjection(const D3DMATRIX& m) {
+    return AnalyzeProjectionMatrixNumeric(m, nullptr);
+}
+
+// Create a standard perspective projection matrix
+void CreateProjectionMatrix(D3DMATRIX* out, float fovY, float aspect, float zNear, float zFar) {
+    float yScale = 1.0f / tanf(fovY / 2.0f);
+    float xScale = yScale / aspect;
+    memset(out, 0, sizeof(D3DMATRIX));
+    out->_11 = xScale;
+    out->_22 = yScale;
+    out->_33 = zFar / (zFar - zNear);
+    out->_34 = 1.0f;
+    out->_43 = -zNear * zFar / (zFar - zNear);
+}
+
+void CreateProjectionMatrixWithHandedness(D3DMATRIX* out,
+                                          float fovY,
+                                          float aspect,
+                                          float zNear,
+                                          float zFar,
+                                          ProjectionHandedness handedness) {
+    CreateProjectionMatrix(out, fovY, aspect, zNear, zFar);
+    if (handedness == ProjectionHandedness_Right) {
+        out->_33 = zFar / (zNear - zFar);
+        out->_34 = -1.0f;
+        out->_43 = zNear * zFar / (zNear - zFar);
+    }
+}
+
+static void OrthonormalizeViewMatrixScalar(D3DMATRIX* view) {
+    if (!view) {
+        return;
+    }
+
+    float r0x = view->_11, r0y = view->_12, r0z = view->_13;
+    float r1x = view->_21, r1y = view->_22, r1z = view->_23;
+
+    const float len0 = sqrtf(Dot3(r0x, r0y, r0z, r0x, r0y, r0z));
+    if (len0 > 1e-6f) {
+        r0x /= len0; r0y /= len0; r0z /= len0;
+    }
+
+    float dot01 = Dot3(r1x, r1y, r1z, r0x, r0y, r0z);
+    r1x -= dot01 * r0x;
+    r1y -= dot01 * r0y;
+    r1z -= dot01 * r0z;
+
+    const float len1 = sqrtf(Dot3(r1x, r1y, r1z, r1x, r1y, r1z));
+    if (len1 > 1e-6f) {
+        r1x /= len1; r1y /= len1; r1z /= len1;
+    }
+
+    const float r2x = r0y * r1z - r0z * r1y;
+    const float r2y = r0z * r1x - r0x * r1z;
+    const float r2z = r0x * r1y - r0y * r1x;
+
+    view->_11 = r0x; view->_12 = r0y; view->_13 = r0z; view->_14 = 0.0f;
+    view->_21 = r1x; view->_22 = r1y; view->_23 = r1z; view->_24 = 0.0f;
+    view->_31 = r2x; view->_32 = r2y; view->_33 = r2z; view->_34 = 0.0f;
+    view->_44 = 1.0f;
+}
+
+bool TryExtractProjectionFromCombined(const D3DMATRIX& combined,
+                                      ProjectionAnalysis* outAnalysis,
+                                      D3DMATRIX* outProjection,
+                                      bool forceDecomposition) {
+    if (!outProjection) {
+        return false;
+    }
+
+    const float sx = sqrtf(Dot3(combined._11, combined._12, combined._13,
+                                combined._11, combined._12, combined._13));
+    const float sy = sqrtf(Dot3(combined._21, combined._22, combined._23,
+                                combined._21, combined._22, combined._23));
+    if (!std::isfinite(sx) || !std::isfinite(sy) || sx < 1e-5f || sy < 1e-5f) {
+        return false;
+    }
+
+    const float fov = 2.0f * atanf(1.0f / sy);
+    const float aspect = sy / sx;
+    if (!forceDecomposition) {
+        if (!std::isfinite(fov) || fov < g_reconstructionConfig.minFOV || fov > g_reconstructionConfig.maxFOV) {
+            return false;
+        }
+    }
+
+    const float det = Determinant3x3(combined);
+    ProjectionHandedness handedness = ProjectionHandedness_Unknown;
+    if (std::isfinite(det)) {
+        handedness = (det < 0.0f) ? ProjectionHandedness_Right : ProjectionHandedness_Left;
+    }
+
+    CreateProjectionMatrixWithHandedness(outProjection,
+                                         fov,
+                                         (std::max)(0.1f, aspect),
+                                         0.1f,
+                                         1000.0f,
+                                         handedness);
+
+    if (outAnalysis) {
+        outAnalysis->valid = true;
+        outAnalysis->fovRadians = fov;
+        outAnalysis->handedness = handedness;
+    }
+    return true;
+}
+
+static void SyncDerivationCache(CameraDerivationCache* cache) {
+    if (cache->generation == g_derivationGeneration) {
+        return;
+    }
+    for (int i = 0; i < CameraDerivationCache::kEntries; i++) {
+        cache->projections[i].used = false;
+        cache->decompositions[i].used = false;
+    }
+    cache->generation = g_derivationGeneration;
+}
+
+bool InvertProjectionCached(const D3DMATRIX& projection,
+                            D3DMATRIX* outInverse,
+                            float* outFovRadians,
+                            CameraDerivationCache* cache) {
+    if (!cache) {
+        if (outFovRadians) {
+            *outFovRadians = ExtractFOV(projection);
+        }
+        return InvertMatrix4x4Deterministic(projection, outInverse, nullptr);
+    }
+    SyncDerivationCache(cache);
+    for (const CameraDerivationCache::ProjectionEntry& entry : cache->projections) {
+        if (entry.used && memcmp(&entry.projection, &projection, sizeof(D3DMATRIX)) == 0) {
+            cache->projectionHits++;
+            *outInverse = entry.inverse;
+            if (outFovRadians) {
+                *outFovRadians = entry.fovRadians;
+            }
+            return entry.invertible;
+        }
+    }
+    cache->projectionMisses++;
+    CameraDerivationCache::ProjectionEntry& entry = cache->projections[cache->nextProjection];
+    cache->nextProjection = (cache->nextProjection + 1) % CameraDerivationCache::kEntries;
+    entry.used = true;
+    entry.projection = projection;
+    entry.inverse = {};
+    entry.invertible = InvertMatrix4x4Deterministic(projection, &entry.inverse, nullptr);
+    entry.fovRadians = ExtractFOV(projection);
+    *outInverse = entry.inverse;
+    if (outFovRadians) {
+        *outFovRadians = entry.fovRadians;
+    }
+    return entry.invertible;
+}
+
+bool DeriveViewFromViewProjection(const D3DMATRIX& projection,
+                                  const D3DMATRIX& viewProjection,
+                                  D3DMATRIX* outView,
+                                  CameraDerivationCache* cache) {
+    D3DMATRIX projectionInv = {};
+    if (!outView || !InvertProjectionCached(projection, &projectionInv, nullptr, cache)) {
+        return false;
+    }
+    *outView = MultiplyMatrix(projectionInv, viewProjection);
+    OrthonormalizeViewMatrix(outView);
+    return true;
+}
+
+// Projection extraction and view derivation from a view-projection matrix; the part
+// of the decomposition that does not depend on the object.
+static bool DecomposeViewProjection(const D3DMATRIX& viewProjection,
+                                    D3DMATRIX* outView,
+                                    D3DMATRIX* outProjection,
+                                    ProjectionAnalysis* outAnalysis,
+                                    CameraDerivationCache* cache) {
+    if (!TryExtractProjectionFromCombined(viewProjection, outAnalysis, outProjection,
+                                          g_reconstructionConfig.combinedMVPForceDecomposition)) {
+        return false;
+    }
+    return DeriveViewFromViewProjection(*outProjection, viewProjection, outView, cache);
+}
+
+bool TryDecomposeCombinedMVP(const D3DMATRIX& mvp,
+                             const D3DMATRIX* worldOptional,
+                             bool worldAvailable,
+                             D3DMATRIX* outWorld,
+                             D3DMATRIX* outView,
+                             D3DMATRIX* outProjection,
+                             ProjectionAnalysis* outProjectionAnalysis,
+                             CameraDerivationCache* cache) {
+    if (!outWorld || !outView || !outProjection) {
+        return false;
+    }
+
+    D3DMATRIX world = {};
+    D3DMATRIX viewProjection = {};
+
+    if (worldAvailable && worldOptional) {
+        world = *worldOptional;
+        D3DMATRIX worldInv = {};
+        if (!InvertMatrix4x4Deterministic(world, &worldInv, nullptr)) {
+            return false;
+        }
+        viewProjection = MultiplyMatrix(mvp, worldInv);
+    } else {
+        CreateIdentityMatrix(&world);
+        viewProjection = mvp;
+    }
+
+    ProjectionAnalysis analysis = {};
+    D3DMATRIX projection = {};
+    D3DMATRIX view = {};
+    if (cache) {
+        SyncDerivationCache(cache);
+        const CameraDerivationCache::DecompositionEntry* hit = nullptr;
+        for (const CameraDerivationCache::DecompositionEntry& entry : cache->decompositions) {
+            if (entry.used && memcmp(&entry.viewProjection, &viewProjection, sizeof(D3DMATRIX)) == 0) {
+                hit = &entry;
+                break;
+            }
+        }
+        if (hit) {
+            cache->decompositionHits++;
+        } else {
+            cache->decompositionMisses++;
+            CameraDerivationCache::DecompositionEntry& entry = cache->decompositions[cache->nextDecomposition];
+            cache->nextDecomposition = (cache->nextDecomposition + 1) % CameraDerivationCache::kEntries;
+            entry.used = true;
+            entry.viewProjection = viewProjection;
+            entry.analysis = {};
+            entry.succeeded = DecomposeViewProjection(viewProjection, &entry.view, &entry.projection,
+                                                      &entry.analysis, cache);
+            hit = &entry;
+        }
+        if (!hit->succeeded) {
+            return false;
+        }
+        view = hit->view;
+        projection = hit->projection;
+        analysis = hit->analysis;
+    } else if (!DecomposeViewProjection(viewProjection, &view, &projection, &analysis, nullptr)) {
+        return false;
+    }
+
+    *outWorld = world;
+    *outView = view;
+    *outProjection = projection;
+    if (outProjectionAnalysis) {
+        *outProjectionAnalysis = analysis;
+    }
+    return true;
+}
+
+// Create an identity matrix
+void CreateIdentityMatrix(D3DMATRIX* out) {
+    memset(out, 0, sizeof(D3DMATRIX));
+    out->_11 = out->_22 = out->_33 = out->_44 = 1.0f;
+}
+
+// Try to extract camera position from MVP-like matrix
+void ExtractCameraFromMVP(const D3DMATRIX& mvp, D3DMATRIX* viewOut) {
+    // The MVP matrix has rotation in the upper 3x3 and translation in column 4
+    // We can try to extract a view matrix by normalizing the rotation part
+    CreateIdentityMatrix(viewOut);
+
+    // Extract rotation vectors (may be scaled by projection)
+    float r0len = sqrtf(mvp._11*mvp._11 + mvp._12*mvp._12 + mvp._13*mvp._13);
+    float r1len = sqrtf(mvp._21*mvp._21 + mvp._22*mvp._22 + mvp._23*mvp._23);
+    float r2len = sqrtf(mvp._31*mvp._31 + mvp._32*mvp._32 + mvp._33*mvp._33);
+
+    if (r0len > 0.001f && r1len > 0.001f && r2len > 0.001f) {
+        // Normalize to get rotation
+        viewOut->_11 = mvp._11 / r0len; viewOut->_12 = mvp._12 / r0len; viewOut->_13 = mvp._13 / r0len;
+        viewOut->_21 = mvp._21 / r1len; viewOut->_22 = mvp._22 / r1len; viewOut->_23 = mvp._23 / r1len;
+        viewOut->_31 = mvp._31 / r2len; viewOut->_32 = mvp._32 / r2len; viewOut->_33 = mvp._33 / r2len;
+
+        // Translation (approximate - this is complex with combined matrices)
+        viewOut->_41 = mvp._14 / r0len;
+        viewOut->_42 = mvp._24 / r1len;
+        viewOut->_43 = mvp._34 / r2len;
+    }
+}
+
+// Check if matrix looks like view matrix (orthonormal rotation + translation)
+bool LooksLikeView(const D3DMATRIX& m) {
+    float row0len = sqrtf(m._11*m._11 + m._12*m._12 + m._13*m._13);
+    float row1len = sqrtf(m._21*m._21 + m._22*m._22 + m._23*m._23);
+    float row2len = sqrtf(m._31*m._31 + m._32*m._32 + m._33*m._33);
+
+    if (fabsf(row0len - 1.0f) > 0.1f) return false;
+    if (fabsf(row1len - 1.0f) > 0.1f) return false;
+    if (fabsf(row2len - 1.0f) > 0.1f) return false;
+
+    if (fabsf(m._14) > 0.01f || fabsf(m._24) > 0.01f || fabsf(m._34) > 0.01f) return false;
+    if (fabsf(m._44 - 1.0f) > 0.01f) return false;
+
+    return true;
+}
+
+RegisterLayoutProfile BuildProfileLayout(GameProfileKind profile) {
+    RegisterLayoutProfile layout = {};
+    if (profile == GameProfile_MetalGearRising) {
+        layout.projectionBase = MgrProfileRegisters::kProjection;
+        layout.viewProjectionBase = MgrProfileRegisters::kViewProjection;
+        layout.viewInverseBase = MgrProfileRegisters::kViewInverse;
+        layout.worldBase = MgrProfileRegisters::kWorld;
+        layout.worldViewBase = MgrProfileRegisters::kWorldView;
+    } else if (profile == GameProfile_DevilMayCry4) {
+        layout.combinedMvpBase = Dmc4ProfileRegisters::kCombinedMvp;
+        layout.worldBase = Dmc4ProfileRegisters::kCombinedMvp;
+        layout.viewInverseBase = Dmc4ProfileRegisters::kView;
+        layout.projectionBase = Dmc4ProfileRegisters::kProjection;
+    }
+    return layout;
+}
+
+unsigned long long LearnedLayoutKey(uint32_t shaderHash, UINT startRegister, UINT vector4fCount) {
+    return (static_cast<unsigned long long>(shaderHash) << 32) |
+           (static_cast<unsigned long long>(startRegister & 0xFFFFu) << 16) |
+           static_cast<unsigned long long>(vector4fCount & 0xFFFFu);
+}
+
+// Folds one full scan into the learned layout. Any new or changed window restarts the
+// consistency count; a scan that only reproduces known windows advances it. A range
+// with no matrices never locks: it is exactly the range a camera can appear in later.
+void LearnUploadLayout(LearnedUploadLayout& layout,
+                       const LearnedLayoutWindow* found,
+                       int foundCount,
+                       int lockThreshold) {
+    bool consistent = foundCount == layout.windowCount;
+    for (int i = 0; i < foundCount && consistent; i++) {
+        const LearnedLayoutWindow& a = found[i];
+        const LearnedLayoutWindow& b = layout.windows[i];
+        consistent = a.baseRegister == b.baseRegister && a.rows == b.rows &&
+                     a.orientation == b.orientation && a.classification == b.classification;
+    }
+    if (!consistent) {
+        layout.overflowed = foundCount > kMaxLearnedLayoutWindows;
+        layout.windowCount = (std::min)(foundCount, kMaxLearnedLayoutWindows);
+        for (int i = 0; i < layout.windowCount; i++) {
+            layout.windows[i] = found[i];
+        }
+        layout.consistentScans = 0;
+        return;
+    }
+    layout.consistentScans++;
+    if (!layout.overflowed && layout.windowCount > 0 && lockThreshold > 0 &&
+        layout.consistentScans >= lockThreshold) {
+        layout.locked = true;
+        layout.uploadsUntilCandidateCheck = 0;
+    }
+}
+
+bool LooksLikeBoneBlock(const float* registers, UINT boneStride) {
+    if (boneStride != 3 && boneStride != 4) {
+        return false;
+    }
+    for (UINT i = 0; i < boneStride * 4; i++) {
+        if (!std::isfinite(registers[i])) {
+            return false;
+        }
+    }
+    if (boneStride == 4 && (fabsf(registers[12]) > 1e-4f || fabsf(registers[13]) > 1e-4f ||
+                            fabsf(registers[14]) > 1e-4f || fabsf(registers[15] - 1.0f) > 1e-4f)) {
+        return false;
+    }
+    // 3x3 part: r[i] = xyz of register i, column j = component j of all three.
+    float rowLen[3];
+    float colLen[3];
+    for (int i = 0; i < 3; i++) {
+        const float* r = registers + i * 4;
+        rowLen[i] = sqrtf(Dot3(r[0], r[1], r[2], r[0], r[1], r[2]));
+        colLen[i] = sqrtf(Dot3(registers[i], registers[4 + i], registers[8 + i],
+                               registers[i], registers[4 + i], registers[8 + i]));
+        if (rowLen[i] < 0.05f || rowLen[i] > 20.0f || colLen[i] < 0.05f || colLen[i] > 20.0f) {
+            return false;
+        }
+    }
+    static const int kPairs[3][2] = { {0, 1}, {0, 2}, {1, 2} };
+    bool rowsOrthogonal = true;
+    bool colsOrthogonal = true;
+    for (const auto& pair : kPairs) {
+        const float* a = registers + pair[0] * 4;
+        const float* b = registers + pair[1] * 4;
+        const float rowDot = Dot3(a[0], a[1], a[2], b[0], b[1], b[2]);
+        const float colDot = Dot3(registers[pair[0]], registers[4 + pair[0]], registers[8 + pair[0]],
+                                  registers[pair[1]], registers[4 + pair[1]], registers[8 + pair[1]]);
+        rowsOrthogonal = rowsOrthogonal && fabsf(rowDot) <= 0.1f * rowLen[pair[0]] * rowLen[pair[1]];
+        colsOrthogonal = colsOrthogonal && fabsf(colDot) <= 0.1f * colLen[pair[0]] * colLen[pair[1]];
+    }
+    return rowsOrthogonal || colsOrthogonal;
+}
+
+static bool ClassifyUploadWindow(const float* constantData,
+                                 UINT startRegister,
+                                 UINT vector4fCount,
+                                 UINT offset,
+                                 UINT rows,
+                                 UploadMatrixMatch* outMatch);
+
+// A bone block at offset that the structural scan would not read as a camera:
+// world matrices and rigid bones look alike, views and projections must not be hidden.
+static bool IsPaletteBone(const float* constantData,
+                          UINT startRegister,
+                          UINT vector4fCount,
+                          UINT offset,
+                          UINT boneStride) {
+    if (!LooksLikeBoneBlock(constantData + offset * 4, boneStride)) {
+        return false;
+    }
+    UploadMatrixMatch match = {};
+    if (offset + 4 <= vector4fCount &&
+        ClassifyUploadWindow(constantData, startRegister, vector4fCount, offset, 4, &match)) {
+        const MatrixClassification classification = match.window.classification;
+        return classification != MatrixClass_View && classification != MatrixClass_Projection;
+    }
+    return true;
+}
+
+bool DetectBonePaletteRange(const float* constantData,
+                            UINT startRegister,
+                            UINT vector4fCount,
+                            int minBones,
+                            BonePaletteRange* outRange) {
+    if (!constantData || !outRange || minBones <= 0 || vector4fCount < static_cast<UINT>(minBones) * 3u) {
+        return false;
+    }
+    UINT bestOffset = 0;
+    UINT bestBones = 0;
+    UINT bestStride = 3;
+    for (UINT stride : {3u, 4u}) {
+        for (UINT phase = 0; phase < stride; phase++) {
+            UINT runOffset = phase;
+            UINT runBones = 0;
+            for (UINT offset = phase; offset + stride <= vector4fCount; offset += stride) {
+                if (!IsPaletteBone(constantData, startRegister, vector4fCount, offset, stride)) {
+                    runBones = 0;
+                    continue;
+                }
+                if (runBones == 0) {
+                    runOffset = offset;
+                }
+                runBones++;
+                if (runBones > bestBones) {
+                    bestBones = runBones;
+                    bestOffset = runOffset;
+                    bestStride = stride;
+                }
+            }
+        }
+    }
+    if (bestBones < static_cast<UINT>(minBones)) {
+        return false;
+    }
+    outRange->startRegister = startRegister + bestOffset;
+    outRange->registerCount = bestBones * bestStride;
+    outRange->boneStride = bestStride;
+    return true;
+}
+
+bool UpdateBonePaletteTracker(BonePaletteTracker& tracker,
+                              const float* constantData,
+                              UINT startRegister,
+                              UINT vector4fCount,
+                              int minBones,
+                              int confirmUploads,
+                              BonePaletteRange* outRange) {
+    if (!constantData || !outRange || minBones <= 0 || vector4fCount < static_cast<UINT>(minBones) * 3u) {
+        return false;
+    }
+    if (tracker.confirmed) {
+        // Spot-check the first and last bone instead of re-walking the whole run.
+        const BonePaletteRange& range = tracker.range;
+        const UINT first = range.startRegister - startRegister;
+        const UINT last = first + range.registerCount - range.boneStride;
+        if (range.startRegister >= startRegister && first + range.registerCount <= vector4fCount &&
+            range.registerCount % range.boneStride == 0 &&
+            IsPaletteBone(constantData, startRegister, vector4fCount, first, range.boneStride) &&
+            IsPaletteBone(constantData, startRegister, vector4fCount, last, range.boneStride)) {
+            *outRange = range;
+            return true;
+        }
+        tracker.confirmed = false;
+        tracker.detections = 0;
+        tracker.invalidations++;
+    }
+
+    BonePaletteRange found;
+    if (!DetectBonePaletteRange(constantData, startRegister, vector4fCount, minBones, &found)) {
+        tracker.detections = 0;
+        return false;
+    }
+    if (tracker.detections > 0 && found.startRegister == tracker.range.startRegister &&
+        found.registerCount == tracker.range.registerCount && found.boneStride == tracker.range.boneStride) {
+        tracker.detections++;
+    } else {
+        tracker.range = found;
+        tracker.detections = 1;
+    }
+    tracker.confirmed = tracker.detections >= (std::max)(1, confirmUploads);
+    *outRange = found;
+    return true;
+}
+
+// One window of the structural scan: direct, then the transposed and inverse-view
+// probes as configured.
+static bool ClassifyUploadWindow(const float* constantData,
+                                 UINT startRegister,
+                                 UINT vector4fCount,
+                                 UINT offset,
+                                 UINT rows,
+                                 UploadMatrixMatch* outMatch) {
+    const UINT baseReg = startRegister + offset;
+    D3DMATRIX mat = {};
+    if (!TryBuildMatrixFromConstantUpdate(constantData + offset * 4, baseReg, rows,
+                                          static_cast<int>(baseReg), static_cast<int>(rows),
+                                          false, &mat)) {
+        return false;
+    }
+
+    LayoutOrientation orientation = LayoutOrientation_Direct;
+    MatrixClassification finalClass = ClassifyMatrixDeterministic(mat, static_cast<int>(rows), vector4fCount, startRegister, baseReg);
+    if (finalClass == MatrixClass_None && g_reconstructionConfig.probeTransposedLayouts) {
+        D3DMATRIX t = TransposeMatrix(mat);
+        MatrixClassification transposedClass = ClassifyMatrixDeterministic(t, static_cast<int>(rows), vector4fCount, startRegister, baseReg);
+        if (transposedClass != MatrixClass_None) {
+            mat = t;
+            finalClass = transposedClass;
+            orientation = LayoutOrientation_Transposed;
+        }
+    }
+    // Only an affine window can be a camera world matrix; the probe ignores the
+    // fourth column, so without this any rotation block (a bone) reads as a view.
+    if (finalClass == MatrixClass_None && g_reconstructionConfig.probeInverseView && rows == 4u &&
+        IsAffineMatrixNoPerspective(mat)) {
+        D3DMATRIX inverseView = InvertSimpleRigidView(mat);
+        MatrixClassification inverseClass = ClassifyMatrixDeterministic(inverseView, static_cast<int>(rows), vector4fCount, startRegister, baseReg);
+        if (inverseClass == MatrixClass_View) {
+            mat = inverseView;
+            finalClass = inverseClass;
+            orientation = LayoutOrientation_InverseView;
+        }
+    }
+    if (finalClass == MatrixClass_None) {
+        return false;
+    }
+    outMatch->window.baseRegister = static_cast<int>(baseReg);
+    outMatch->window.rows = static_cast<int>(rows);
+    outMatch->window.orientation = orientation;
+    outMatch->window.classification = finalClass;
+    outMatch->matrix = mat;
+    return true;
+}
+
+// Shared walk of ScanUploadForMatrices and ScanUploadForMatricesIncremental.
+// Without changedRegisters every window is classified.
+static size_t ScanUploadWindows(const float* constantData,
+                                UINT startRegister,
+                                UINT vector4fCount,
+                                const uint32_t* changedRegisters,
+                                const std::vector<UploadMatrixMatch>* previousMatches,
+                                std::vector<UploadMatrixMatch>* outMatches,
+                                const BonePaletteRange* excluded,
+                                UINT* outWindowsScanned) {
+    // Excluded registers as upload offsets [excludeBegin, excludeEnd).
+    UINT excludeBegin = 0;
+    UINT excludeEnd = 0;
+    if (excluded && excluded->registerCount > 0 && excluded->startRegister >= startRegister) {
+        excludeBegin = excluded->startRegister - startRegister;
+        excludeEnd = (std::min)(excludeBegin + excluded->registerCount, vector4fCount);
+    }
+    const size_t before = outMatches->size();
+    // Position in previousMatches, which is in the same (rows 4 then 3, ascending
+    // base register) order as this walk.
+    size_t previous = 0;
+    auto scanOrder = [](int rows, int baseRegister) {
+        return (static_cast<long long>(rows == 4 ? 0 : 1) << 32) | static_cast<unsigned int>(baseRegister);
+    };
+    UINT windowsScanned = 0;
+    for (UINT rows : {4u, 3u}) {
+        if (vector4fCount < rows) {
+            continue;
+        }
+        for (UINT offset = 0; offset + rows <= vector4fCount; ++offset) {
+            if (offset < excludeEnd && offset + rows > excludeBegin) {
+                offset = excludeEnd - 1;
+                continue;
+            }
+            const UINT baseReg = startRegister + offset;
+            if (changedRegisters) {
+                bool windowChanged = false;
+                for (UINT reg = offset; reg < offset + rows && !windowChanged; ++reg) {
+                    windowChanged = (changedRegisters[reg >> 5] & (1u << (reg & 31))) != 0;
+                }
+                const long long order = scanOrder(static_cast<int>(rows), static_cast<int>(baseReg));
+                while (previous < previousMatches->size() &&
+                       scanOrder((*previousMatches)[previous].window.rows,
+                                 (*previousMatches)[previous].window.baseRegister) < order) {
+                    previous++;
+                }
+                if (!windowChanged) {
+                    // Same registers as the previous scan, so the same outcome.
+                    if (previous < previousMatches->size() &&
+                        scanOrder((*previousMatches)[previous].window.rows,
+                                  (*previousMatches)[previous].window.baseRegister) == order) {
+                        outMatches->push_back((*previousMatches)[previous]);
+                    }
+                    continue;
+                }
+            }
+            windowsScanned++;
+            UploadMatrixMatch match = {};
+            if (ClassifyUploadWindow(constantData, startRegister, vector4fCount, offset, rows, &match)) {
+                outMatches->push_back(match);
+            }
+        }
+    }
+    if (outWindowsScanned) {
+        *outWindowsScanned = windowsScanned;
+    }
+    return outMatches->size() - before;
+}
+
+size_t ScanUploadForMatrices(const float* constantData,
+                             UINT startRegister,
+                             UINT vector4fCount,
+                             std::vector<UploadMatrixMatch>* outMatches,
+                             const BonePaletteRange* excluded) {
+    if (!constantData || !outMatches) {
+        return 0;
+    }
+    return ScanUploadWindows(constantData, startRegister, vector4fCount, nullptr, nullptr, outMatches, excluded, nullptr);
+}
+
+size_t ScanUploadForMatricesIncremental(const float* constantData,
+                                        UINT startRegister,
+                                        UINT vector4fCount,
+                                        const uint32_t* changedRegisters,
+                                        const std::vector<UploadMatrixMatch>& previousMatches,
+                                        std::vector<UploadMatrixMatch>* outMatches,
+                                        const BonePaletteRange* excluded,
+                                        UINT* outWindowsScanned) {
+    if (!constantData || !outMatches || !changedRegisters) {
+        return 0;
+    }
+    return ScanUploadWindows(constantData, startRegister, vector4fCount, changedRegisters, &previousMatches,
+                             outMatches, excluded, outWindowsScanned);
+}
+
+// LooksLikeMatrix for a 3- or 4-row window: finite, and neither all zero nor huge.
+static bool LooksLikeMatrixRows(const float* data, UINT rows) {
+    if (rows == 4u) {
+        return LooksLikeMatrix(data);
+    }
+    float sum = 0.0f;
+    for (UINT i = 0; i < rows * 4u; i++) {
+        if (!std::isfinite(data[i])) {
+            return false;
+        }
+        sum += fabsf(data[i]);
+    }
+    return sum >= 0.001f && sum <= 10000.0f;
+}
+
+// True when a window no learned window overlaps classifies as a camera matrix
+// (view, projection or combined), i.e. the upload gained a camera the layout does
+// not know about. World windows are not counted: per-object constants change
+// there from draw to draw without the camera layout changing.
+static bool HasUncoveredCameraCandidate(const LearnedUploadLayout& layout,
+                                        const float* constantData,
+                                        UINT startRegister,
+                                        UINT vector4fCount) {
+    for (UINT rows : {4u, 3u}) {
+        if (vector4fCount < rows) {
+            continue;
+        }
+        for (UINT offset = 0; offset + rows <= vector4fCount; ++offset) {
+            const int baseReg = static_cast<int>(startRegister + offset);
+            bool overlaps = false;
+            for (int w = 0; w < layout.windowCount && !overlaps; w++) {
+                overlaps = baseReg < layout.windows[w].baseRegister + layout.windows[w].rows &&
+                           baseReg + static_cast<int>(rows) > layout.windows[w].baseRegister;
+            }
+            if (overlaps || !LooksLikeMatrixRows(constantData + offset * 4, rows)) {
+                continue;
+            }
+            UploadMatrixMatch match = {};
+            if (ClassifyUploadWindow(constantData, startRegister, vector4fCount, offset, rows, &match) &&
+                match.window.classification != MatrixClass_World) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool ValidateLearnedLayout(LearnedUploadLayout& layout,
+                           const float* constantData,
+                           UINT startRegister,
+                           UINT vector4fCount,
+                           D3DMATRIX* outMatrices) {
+    if (layout.windowCount <= 0) {
+        return false;
+    }
+    for (int i = 0; i < layout.windowCount; i++) {
+        const LearnedLayoutWindow& window = layout.windows[i];
+        const UINT baseReg = static_cast<UINT>(window.baseRegister);
+        D3DMATRIX mat = {};
+        if (!TryBuildMatrixFromConstantUpdate(constantData, startRegister, vector4fCount,
+                                              window.baseRegister, window.rows, false, &mat)) {
+            return false;
+        }
+        if (window.orientation == LayoutOrientation_Transposed) {
+            mat = TransposeMatrix(mat);
+        } else if (window.orientation == LayoutOrientation_InverseView) {
+            mat = InvertSimpleRigidView(mat);
+        }
+        if (ClassifyMatrixDeterministic(mat, window.rows, vector4fCount, startRegister, baseReg) !=
+            window.classification) {
+            return false;
+        }
+        outMatrices[i] = mat;
+    }
+    if (layout.uploadsUntilCandidateCheck > 0) {
+        layout.uploadsUntilCandidateCheck--;
+        return true;
+    }
+    layout.uploadsUntilCandidateCheck = kLearnedLayoutCandidateCheckInterval - 1;
+    return !HasUncoveredCameraCandidate(layout, constantData, startRegister, vector4fCount);
+}
+
+// okRun/nextSignificant are filled backwards from the prefilter flags so each
+// window is rejected in O(1) unless it can pass LooksLikeMatrix; the strict
+// classifiers then decide.
+bool ScanFloatsForCameraMatrices(const float* data,
+                                 size_t floatCount,
+                                 size_t windowCount,
+                                 uint8_t* flags,
+                                 uint8_t* okRun,
+                                 uint8_t* nextSignificant,
+                                 CameraMatrixHitCallback onHit,
+                                 void* context) {
+    g_matrixKernels->classifyScanFloats(data, floatCount, flags);
+    uint8_t run = 0;
+    uint8_t distance = 16;
+    for (size_t i = floatCount; i-- > 0;) {
+        run = (flags[i] & 1) ? static_cast<uint8_t>((std::min)(run + 1, 16)) : 0;
+        distance = (flags[i] & 2) ? 0 : static_cast<uint8_t>((std::min)(distance + 1, 16));
+        okRun[i] = run;
+        nextSignificant[i] = distance;
+    }
+
+    for (size_t i = 0; i < windowCount; i++) {
+        if (okRun[i] < 16 || nextSignificant[i] >= 16) {
+            continue;
+        }
+        const float* window = data + i;
+        if (!LooksLikeMatrix(window)) {
+            continue;
+        }
+        D3DMATRIX mat = {};
+        memcpy(&mat, window, sizeof(D3DMATRIX));
+        const bool looksView = LooksLikeViewStrict(mat);
+        const bool looksProj = !looksView && LooksLikeProjectionStrict(mat);
+        if (!looksView && !looksProj) {
+            continue;
+        }
+        if (!onHit(context, i, mat, looksView)) {
+            return false;
+        }
+    }
+    return true;
+}
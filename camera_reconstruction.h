@@ -0,0 +1,396 @@
+/**
+ * Camera matrix reconstruction for the camera proxy.
+ *
+ * Structural classifiers, combined-MVP decomposition, register layout profiles,
+ * the per-upload structural scan and the memory scanner's window scan. Nothing in
+ * here touches a device, the ini file or the log: inputs are plain constant data
+ * and D3DMATRIX values, and the few tunables live in ReconstructionConfig. The
+ * same code is linked into d3d9.dll and camera_bench.exe (see build_bench.bat).
+ *
+ * Not thread-safe to reconfigure: call SetReconstructionConfig and
+ * SelectMatrixKernels before classification starts or from the thread that
+ * classifies. The scan functions themselves only read that state.
+ */
+#pragma once
+
+#include <windows.h>
+#include <d3d9types.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "matrix_kernels.h"
+
+struct ReconstructionConfig {
+    // Field-of-view limits (radians) for strict projection classification.
+    float minFOV = 0.1f;
+    float maxFOV = 2.5f;
+    bool probeTransposedLayouts = true;
+    bool probeInverseView = true;
+    bool combinedMVPForceDecomposition = false;
+};
+
+void SetReconstructionConfig(const ReconstructionConfig& config);
+const ReconstructionConfig& GetReconstructionConfig();
+
+enum ProjectionHandedness {
+    ProjectionHandedness_Unknown = 0,
+    ProjectionHandedness_Left,
+    ProjectionHandedness_Right
+};
+
+struct ProjectionAnalysis {
+    bool valid = false;
+    float fovRadians = 0.0f;
+    ProjectionHandedness handedness = ProjectionHandedness_Unknown;
+};
+
+enum MatrixClassification {
+    MatrixClass_None = 0,
+    MatrixClass_World,
+    MatrixClass_View,
+    MatrixClass_Projection,
+    MatrixClass_CombinedPerspective
+};
+
+// -----------------------------------------------------------------------------
+// Matrix kernels
+// -----------------------------------------------------------------------------
+
+struct MatrixKernelTable {
+    const char* name;
+    D3DMATRIX (*multiply)(const D3DMATRIX& a, const D3DMATRIX& b);
+    D3DMATRIX (*transpose)(const D3DMATRIX& m);
+    bool (*looksLikeMatrix)(const float* data);
+    bool (*looksLikeViewStrict)(const D3DMATRIX& m);
+    bool (*projectionOffDiagonalWithin)(const D3DMATRIX& m, float epsilon);
+    bool (*invert)(const D3DMATRIX& in, D3DMATRIX* out, float* outDeterminant);
+    void (*orthonormalizeView)(D3DMATRIX* view);
+    void (*classifyScanFloats)(const float* data, size_t count, uint8_t* flags);
+};
+
+// Picks the SSE2 table when allowed and supported, otherwise the scalar reference.
+void SelectMatrixKernels(bool allowSimd);
+const MatrixKernelTable& ActiveMatrixKernels();
+const CpuFeatures& DetectedCpuFeatures();
+
+D3DMATRIX MultiplyMatrix(const D3DMATRIX& a, const D3DMATRIX& b);
+D3DMATRIX TransposeMatrix(const D3DMATRIX& mat);
+bool LooksLikeMatrix(const float* data);
+bool LooksLikeViewStrict(const D3DMATRIX& m);
+bool InvertMatrix4x4Deterministic(const D3DMATRIX& in, D3DMATRIX* out, float* outDeterminant = nullptr);
+void OrthonormalizeViewMatrix(D3DMATRIX* view);
+
+// -----------------------------------------------------------------------------
+// Classification and decomposition
+// -----------------------------------------------------------------------------
+
+bool AnalyzeProjectionMatrixNumeric(const D3DMATRIX& m, ProjectionAnalysis* out);
+const char* ProjectionHandednessLabel(ProjectionHandedness handedness);
+bool LooksLikeProjectionStrict(const D3DMATRIX& m);
+bool IsTypicalProjectionMatrix(const D3DMATRIX& m);
+bool HasPerspectiveComponent(const D3DMATRIX& m);
+bool IsAffineMatrixNoPerspective(const D3DMATRIX& m);
+bool IsLikelyBoneTransform(const D3DMATRIX& m,
+                           int rows,
+                           UINT vectorCountInUpload,
+                           UINT uploadStartReg,
+                           UINT candidateBaseReg);
+bool LooksLikeWorldStrict(const D3DMATRIX& m,
+                          int rows,
+                          UINT vectorCountInUpload,
+                          UINT uploadStartReg,
+                          UINT candidateBaseReg);
+MatrixClassification ClassifyMatrixDeterministic(const D3DMATRIX& m,
+                                                 int rows,
+                                                 UINT vectorCountInUpload,
+                                                 UINT uploadStartReg,
+                                                 UINT candidateBaseReg);
+
+bool IsIdentityMatrix(const D3DMATRIX& m, float tolerance);
+float MatrixIdentityMaxError(const D3DMATRIX& m);
+bool MatrixClose(const D3DMATRIX& a, const D3DMATRIX& b, float tolerance);
+D3DMATRIX InvertSimpleRigidView(const D3DMATRIX& view);
+void CreateIdentityMatrix(D3DMATRIX* out);
+
+float ExtractFOV(const D3DMATRIX& proj);
+bool LooksLikeProjection(const D3DMATRIX& m);
+bool LooksLikeView(const D3DMATRIX& m);
+void ExtractCameraFromMVP(const D3DMATRIX& mvp, D3DMATRIX* viewOut);
+void CreateProjectionMatrix(D3DMATRIX* out, float fovY, float aspect, float zNear, float zFar);
+void CreateProjectionMatrixWithHandedness(D3DMATRIX* out,
+                                          float fovY,
+                                          float aspect,
+                                          float zNear,
+                                          float zFar,
+                                          ProjectionHandedness handedness);
+
+// Exact-match memo for derivations that only change with the projection, which is
+// usually at most once a frame. It maps a projection to its inverse and FOV, and a
+// view-projection to its decomposed projection, analysis and view. Keys are
+// compared bytewise (cheaper than hashing at this size), so a hit returns exactly
+// what the full path computes. Entries are dropped when SetReconstructionConfig or
+// SelectMatrixKernels runs.
+struct CameraDerivationCache {
+    static constexpr int kEntries = 4;
+
+    struct ProjectionEntry {
+        bool used = false;
+        bool invertible = false;
+        D3DMATRIX projection = {};
+        D3DMATRIX inverse = {};
+        float fovRadians = 0.0f;
+    };
+
+    struct DecompositionEntry {
+        bool used = false;
+        bool succeeded = false;
+        D3DMATRIX viewProjection = {};
+        D3DMATRIX view = {};
+        D3DMATRIX projection = {};
+        ProjectionAnalysis analysis;
+    };
+
+    ProjectionEntry projections[kEntries];
+    DecompositionEntry decompositions[kEntries];
+    int nextProjection = 0;
+    int nextDecomposition = 0;
+    uint32_t generation = 0;
+    unsigned long long projectionHits = 0;
+    unsigned long long projectionMisses = 0;
+    unsigned long long decompositionHits = 0;
+    unsigned long long decompositionMisses = 0;
+};
+
+// Inverse and ExtractFOV of projection, through cache when given. Returns false
+// when the projection is singular.
+bool InvertProjectionCached(const D3DMATRIX& projection,
+                            D3DMATRIX* outInverse,
+                            float* outFovRadians,
+                            CameraDerivationCache* cache);
+
+// View as orthonormalized inverse(projection) * viewProjection.
+bool DeriveViewFromViewProjection(const D3DMATRIX& projection,
+                                  const D3DMATRIX& viewProjection,
+                                  D3DMATRIX* outView,
+                                  CameraDerivationCache* cache = nullptr);
+
+bool TryExtractProjectionFromCombined(const D3DMATRIX& combined,
+                                      ProjectionAnalysis* outAnalysis,
+                                      D3DMATRIX* outProjection,
+                                      bool forceDecomposition);
+// With a cache, a repeated view-projection (the same camera, or MVP * inverse(world)
+// for per-object uploads with a known world) skips projection extraction and inversion.
+bool TryDecomposeCombinedMVP(const D3DMATRIX& mvp,
+                             const D3DMATRIX* worldOptional,
+                             bool worldAvailable,
+                             D3DMATRIX* outWorld,
+                             D3DMATRIX* outView,
+                             D3DMATRIX* outProjection,
+                             ProjectionAnalysis* outProjectionAnalysis,
+                             CameraDerivationCache* cache = nullptr);
+
+// Builds a matrix from rows of an upload; 3-row windows get an implicit 0,0,0,1 row.
+bool TryBuildMatrixFromConstantUpdate(const float* constantData,
+                                      UINT startRegister,
+                                      UINT vector4fCount,
+                                      int baseRegister,
+                                      int rows,
+                                      bool transposed,
+                                      D3DMATRIX* outMatrix);
+
+// -----------------------------------------------------------------------------
+// Game profiles
+// -----------------------------------------------------------------------------
+
+enum GameProfileKind {
+    GameProfile_None = 0,
+    GameProfile_MetalGearRising,
+    GameProfile_DevilMayCry4
+};
+
+struct RegisterLayoutProfile {
+    int combinedMvpBase = -1;
+    int projectionBase = -1;
+    int viewInverseBase = -1;
+    int worldBase = -1;
+    int viewProjectionBase = -1;
+    int worldViewBase = -1;
+};
+
+// Register bases the strict profiles read. BuildProfileLayout publishes the same
+// values for the overlay, the log and the known-transform register mask.
+struct MgrProfileRegisters {
+    static constexpr int kProjection = 4;
+    static constexpr int kViewProjection = 8;
+    static constexpr int kViewInverse = 12;
+    static constexpr int kWorld = 16;
+    static constexpr int kWorldView = 20;
+};
+
+struct Dmc4ProfileRegisters {
+    // Original DMC4 fixed layout; the combined MVP register also carries world.
+    static constexpr int kCombinedMvp = 0;
+    static constexpr int kView = 4;
+    static constexpr int kProjection = 8;
+};
+
+const char* GameProfileLabel(GameProfileKind profile);
+GameProfileKind ParseGameProfile(const char* profileName);
+RegisterLayoutProfile BuildProfileLayout(GameProfileKind profile);
+
+// -----------------------------------------------------------------------------
+// Upload layout learning and structural scan
+// -----------------------------------------------------------------------------
+
+// How a structural match was recovered from the raw registers.
+enum LayoutOrientation {
+    LayoutOrientation_Direct = 0,
+    LayoutOrientation_Transposed,
+    LayoutOrientation_InverseView
+};
+
+struct LearnedLayoutWindow {
+    int baseRegister = -1;
+    int rows = 0;
+    LayoutOrientation orientation = LayoutOrientation_Direct;
+    MatrixClassification classification = MatrixClass_None;
+};
+
+static constexpr int kMaxLearnedLayoutWindows = 8;
+// Locked uploads between two checks of the uncovered registers for a new camera.
+static constexpr int kLearnedLayoutCandidateCheckInterval = 16;
+
+// Structural matches seen for one (shader bytecode, upload range) pair. Once the same
+// non-empty set has been produced by LayoutLockThreshold consecutive full scans,
+// uploads to that range only re-validate these windows. Every
+// kLearnedLayoutCandidateCheckInterval-th upload also checks that no register
+// outside them forms a new camera matrix.
+struct LearnedUploadLayout {
+    LearnedLayoutWindow windows[kMaxLearnedLayoutWindows] = {};
+    int windowCount = 0;
+    int consistentScans = 0;
+    bool overflowed = false;
+    bool locked = false;
+    unsigned int validationFailures = 0;
+    // Key came from a bytecode hash (not a per-run pointer), so it can be persisted.
+    bool stableKey = false;
+    // Pre-seeded from the on-disk layout cache and not yet contradicted by an upload.
+    bool seededFromCache = false;
+    // Validated uploads left until the next uncovered-window check; 0 = check now.
+    int uploadsUntilCandidateCheck = 0;
+};
+
+unsigned long long LearnedLayoutKey(uint32_t shaderHash, UINT startRegister, UINT vector4fCount);
+void LearnUploadLayout(LearnedUploadLayout& layout,
+                       const LearnedLayoutWindow* found,
+                       int foundCount,
+                       int lockThreshold);
+
+struct UploadMatrixMatch {
+    LearnedLayoutWindow window;
+    D3DMATRIX matrix;
+};
+
+// -----------------------------------------------------------------------------
+// Bone palettes
+// -----------------------------------------------------------------------------
+
+// A run of consecutive skinning matrices inside one upload, all with the same
+// stride: 3 registers (4x3) or 4 registers whose last one is (0,0,0,1).
+struct BonePaletteRange {
+    UINT startRegister = 0;
+    UINT registerCount = 0;
+    UINT boneStride = 3;
+};
+
+// Palette seen for one (shader bytecode, upload range) pair. A range found by
+// confirmUploads consecutive detections is only spot-checked afterwards.
+struct BonePaletteTracker {
+    BonePaletteRange range;
+    int detections = 0;
+    bool confirmed = false;
+    unsigned int invalidations = 0;
+};
+
+// boneStride registers (3 or 4) that read as one bone: finite, non-degenerate,
+// with orthogonal rows or columns in the 3x3 part (allows non-uniform scale). At
+// stride 4 the fourth register must be (0,0,0,1).
+bool LooksLikeBoneBlock(const float* registers, UINT boneStride);
+
+// Longest run of at least minBones consecutive bone blocks of one stride at any
+// register phase. A run never covers a 4-row window that classifies as View or
+// Projection, so a camera block next to a palette stays visible.
+bool DetectBonePaletteRange(const float* constantData,
+                            UINT startRegister,
+                            UINT vector4fCount,
+                            int minBones,
+                            BonePaletteRange* outRange);
+
+// Folds one upload into the tracker. Returns true with outRange set when part of
+// the upload is a bone palette that structural detection should skip.
+bool UpdateBonePaletteTracker(BonePaletteTracker& tracker,
+                              const float* constantData,
+                              UINT startRegister,
+                              UINT vector4fCount,
+                              int minBones,
+                              int confirmUploads,
+                              BonePaletteRange* outRange);
+
+// Full structural scan of one SetVertexShaderConstantF upload: every 4-row then
+// every 3-row window, direct first, then transposed and inverse-view probes as
+// configured. Windows overlapping excluded (a bone palette) are skipped. Matches
+// are appended in scan order with the matrix already in its classified
+// orientation. Returns the number of matches appended.
+size_t ScanUploadForMatrices(const float* constantData,
+                             UINT startRegister,
+                             UINT vector4fCount,
+                             std::vector<UploadMatrixMatch>* outMatches,
+                             const BonePaletteRange* excluded = nullptr);
+
+// ScanUploadForMatrices for an upload whose previous scan (same shader, range and
+// exclusion) produced previousMatches. Only windows touching a register set in
+// changedRegisters (bit i = upload offset i) are classified; the others repeat
+// their previous outcome, so the result equals a full scan of the same data.
+// outWindowsScanned, if given, receives the number of windows classified.
+size_t ScanUploadForMatricesIncremental(const float* constantData,
+                                        UINT startRegister,
+                                        UINT vector4fCount,
+                                        const uint32_t* changedRegisters,
+                                        const std::vector<UploadMatrixMatch>& previousMatches,
+                                        std::vector<UploadMatrixMatch>* outMatches,
+                                        const BonePaletteRange* excluded = nullptr,
+                                        UINT* outWindowsScanned = nullptr);
+
+// Re-checks every window of a locked layout against a new upload. Fills
+// outMatrices[0..windowCount) and returns true only if all windows still classify
+// as learned, so a layout change never half-applies. On the first upload and then
+// every kLearnedLayoutCandidateCheckInterval uploads it also fails if an uncovered
+// window classifies as a view, projection or combined matrix, which catches a
+// camera appearing next to the known windows. Animated non-matrix constants do
+// not unlock the layout.
+bool ValidateLearnedLayout(LearnedUploadLayout& layout,
+                           const float* constantData,
+                           UINT startRegister,
+                           UINT vector4fCount,
+                           D3DMATRIX* outMatrices);
+
+// -----------------------------------------------------------------------------
+// Memory window scan
+// -----------------------------------------------------------------------------
+
+// Called for every 16-float window that passes the strict view or projection
+// classifier. Return false to stop the scan.
+typedef bool (*CameraMatrixHitCallback)(void* context, size_t floatIndex, const D3DMATRIX& matrix, bool looksView);
+
+// Scans every 16-float window starting in [0, windowCount) of data (floatCount must
+// cover windowCount + 15 floats where readable). flags/okRun/nextSignificant are
+// caller scratch of floatCount bytes each. Returns false if the callback stopped it.
+bool ScanFloatsForCameraMatrices(const float* data,
+                                 size_t floatCount,
+                                 size_t windowCount,
+                                 uint8_t* flags,
+                                 uint8_t* okRun,
+                                 uint8_t* nextSignificant,
+                                 CameraMatrixHitCallback onHit,
+                                 void* context);
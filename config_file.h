@@ -0,0 +1,548 @@
+/*
+ * camera_proxy.ini reading, batched writing and hot reload.
+ *
+ * ConfigIniFile reads the file once and answers every lookup from memory,
+ * instead of one GetPrivateProfile* call (and one file parse) per key. It
+ * follows the rules the proxy relied on: [section] headers, key=value lines,
+ * case-insensitive names, surrounding blanks and one pair of quotes stripped
+ * from values, first occurrence of a key wins.
+ *
+ * WriteConfigIniValues merges a batch of keys into one section and rewrites the
+ * file once, keeping comments, ordering and line endings.
+ *
+ * ConfigFileWatcher owns a thread that flushes queued writes in batches and,
+ * when given a reload callback, watches the ini's directory. It calls the
+ * callback on that thread whenever the ini's timestamp changes for any reason
+ * other than its own flush. Changes to other files in the directory (the log
+ * sits next to the ini) are filtered out by name.
+ *
+ * QueueWrite never takes a lock and never touches the file: writes are pushed
+ * onto a lock-free list that the watcher thread takes whole, so the render
+ * thread never waits on the flush. QueueFileJob hands the same thread one
+ * pre-serialized file (the layout cache) to write.
+ */
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class ConfigIniFile {
+public:
+    // Returns false for a missing or unreadable file; lookups then return defaults.
+    bool Load(const char* path, const char* section) {
+        m_entries.clear();
+        std::string text;
+        if (!ReadConfigFileText(path, &text)) {
+            return false;
+        }
+        bool inSection = false;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t end = text.find('\n', pos);
+            if (end == std::string::npos) {
+                end = text.size();
+            }
+            std::string line = Trim(text.substr(pos, end - pos));
+            pos = end + 1;
+            if (line.empty() || line[0] == ';' || line[0] == '#') {
+                continue;
+            }
+            if (line[0] == '[') {
+                const size_t close = line.find(']');
+                inSection = close != std::string::npos &&
+                            _stricmp(Trim(line.substr(1, close - 1)).c_str(), section) == 0;
+                continue;
+            }
+            const size_t equals = line.find('=');
+            if (!inSection || equals == std::string::npos) {
+                continue;
+            }
+            std::string key = Trim(line.substr(0, equals));
+            if (key.empty() || Find(key.c_str())) {
+                continue;
+            }
+            std::string value = Trim(line.substr(equals + 1));
+            if (value.size() >= 2 && (value[0] == '"' || value[0] == '\'') && value.back() == value[0]) {
+                value = value.substr(1, value.size() - 2);
+            }
+            m_entries.emplace_back(std::move(key), std::move(value));
+        }
+        return true;
+    }
+
+    const char* GetString(const char* key, const char* defaultValue) const {
+        const std::string* value = Find(key);
+        return value ? value->c_str() : defaultValue;
+    }
+
+    void GetString(const char* key, const char* defaultValue, char* out, size_t outSize) const {
+        snprintf(out, outSize, "%s", GetString(key, defaultValue));
+    }
+
+    // Decimal or 0x-prefixed hex; a present key with no leading number reads as 0.
+    int GetInt(const char* key, int defaultValue) const {
+        const std::string* value = Find(key);
+        if (!value || value->empty()) {
+            return defaultValue;
+        }
+        const char* text = value->c_str();
+        const bool hex = text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+        return static_cast<int>(strtol(text, nullptr, hex ? 16 : 10));
+    }
+
+    bool GetBool(const char* key, bool defaultValue) const {
+        return GetInt(key, defaultValue ? 1 : 0) != 0;
+    }
+
+    float GetFloat(const char* key, float defaultValue) const {
+        const std::string* value = Find(key);
+        return value && !value->empty() ? static_cast<float>(atof(value->c_str())) : defaultValue;
+    }
+
+    static std::string Trim(const std::string& text) {
+        size_t begin = 0;
+        size_t end = text.size();
+        while (begin < end && (text[begin] == ' ' || text[begin] == '\t' || text[begin] == '\r')) begin++;
+        while (end > begin && (text[end - 1] == ' ' || text[end - 1] == '\t' || text[end - 1] == '\r')) end--;
+        return text.substr(begin, end - begin);
+    }
+
+    static bool ReadConfigFileText(const char* path, std::string* out) {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            return false;
+        }
+        char buffer[4096];
+        size_t read = 0;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            out->append(buffer, read);
+        }
+        fclose(file);
+        return true;
+    }
+
+private:
+    const std::string* Find(const char* key) const {
+        for (const auto& entry : m_entries) {
+            if (_stricmp(entry.first.c_str(), key) == 0) {
+                return &entry.second;
+            }
+        }
+        return nullptr;
+    }
+
+    std::vector<std::pair<std::string, std::string>> m_entries;
+};
+
+// Replaces each key's first line in section (or appends it at the end of the
+// section, creating the section if needed), then swaps the file in through
+// path.tmp so a crash mid-write never truncates the ini.
+static inline bool WriteConfigIniValues(const char* path,
+                                        const char* section,
+                                        const std::vector<std::pair<std::string, std::string>>& values) {
+    std::string text;
+    ConfigIniFile::ReadConfigFileText(path, &text);
+    const char* newline = text.find("\r\n") != std::string::npos || text.empty() ? "\r\n" : "\n";
+
+    std::vector<std::string> lines;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        lines.push_back(text.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    if (!lines.empty() && lines.back().empty()) {
+        lines.pop_back();
+    }
+    const std::string lineEnd = strcmp(newline, "\r\n") == 0 ? "\r" : "";
+    for (std::string& line : lines) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+    }
+
+    // [sectionBegin, sectionEnd) are the lines after the section header.
+    bool sectionFound = false;
+    size_t sectionBegin = lines.size();
+    size_t sectionEnd = lines.size();
+    for (size_t i = 0; i < lines.size(); i++) {
+        const std::string line = ConfigIniFile::Trim(lines[i]);
+        if (line.empty() || line[0] != '[') {
+            continue;
+        }
+        if (sectionFound) {
+            sectionEnd = i;
+            break;
+        }
+        const size_t close = line.find(']');
+        if (close != std::string::npos &&
+            _stricmp(ConfigIniFile::Trim(line.substr(1, close - 1)).c_str(), section) == 0) {
+            sectionFound = true;
+            sectionBegin = i + 1;
+        }
+    }
+    if (!sectionFound) {
+        lines.push_back(std::string("[") + section + "]");
+        sectionBegin = lines.size();
+        sectionEnd = lines.size();
+    }
+
+    for (const auto& value : values) {
+        bool replaced = false;
+        for (size_t i = sectionBegin; i < sectionEnd && !replaced; i++) {
+            const std::string line = ConfigIniFile::Trim(lines[i]);
+            const size_t equals = line.find('=');
+            if (line.empty() || line[0] == ';' || line[0] == '#' || equals == std::string::npos ||
+                _stricmp(ConfigIniFile::Trim(line.substr(0, equals)).c_str(), value.first.c_str()) != 0) {
+                continue;
+            }
+            lines[i] = ConfigIniFile::Trim(line.substr(0, equals)) + "=" + value.second;
+            replaced = true;
+        }
+        if (!replaced) {
+            // Keep appended keys ahead of the blank lines that separate sections.
+            size_t insertAt = sectionEnd;
+            while (insertAt > sectionBegin && ConfigIniFile::Trim(lines[insertAt - 1]).empty()) {
+                insertAt--;
+            }
+            lines.insert(lines.begin() + static_cast<std::ptrdiff_t>(insertAt), value.first + "=" + value.second);
+            sectionEnd++;
+        }
+    }
+
+    char tempPath[MAX_PATH + 8];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE* file = fopen(tempPath, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = true;
+    for (const std::string& line : lines) {
+        const std::string out = line + lineEnd + "\n";
+        ok = ok && fwrite(out.data(), 1, out.size(), file) == out.size();
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || !MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileA(tempPath);
+        return false;
+    }
+    return true;
+}
+
+class ConfigFileWatcher {
+public:
+    // Runs on the watcher thread after the ini changed on disk; nullptr = no watching.
+    typedef void (*ReloadFn)(const char* path);
+    // Runs on the watcher thread after a batch of queued writes was flushed.
+    typedef void (*FlushFn)(size_t keyCount, bool succeeded);
+    // Runs on the watcher thread (or in Stop) to write a QueueFileJob payload.
+    typedef void (*FileJobFn)(const char* path, const std::vector<uint8_t>& bytes);
+
+    bool Start(const char* path, const char* section, ReloadFn onReload, FlushFn onFlush) {
+        if (m_thread) {
+            return true;
+        }
+        snprintf(m_path, sizeof(m_path), "%s", path);
+        snprintf(m_section, sizeof(m_section), "%s", section);
+        m_onReload = onReload;
+        m_onFlush = onFlush;
+        m_lastWrite = ReadLastWriteTime();
+
+        if (m_onReload) {
+            char directory[MAX_PATH] = {};
+            snprintf(directory, sizeof(directory), "%s", path);
+            char* lastSlash = strrchr(directory, '\\');
+            if (lastSlash) {
+                *lastSlash = '\0';
+                snprintf(m_fileName, sizeof(m_fileName), "%s", lastSlash + 1);
+            } else {
+                snprintf(m_fileName, sizeof(m_fileName), "%s", path);
+                snprintf(directory, sizeof(directory), ".");
+            }
+            m_directory = CreateFileA(directory, FILE_LIST_DIRECTORY,
+                                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                      FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+            if (m_directory == INVALID_HANDLE_VALUE) {
+                m_directory = nullptr;
+            }
+            m_change = m_directory ? CreateEventA(nullptr, TRUE, FALSE, nullptr) : nullptr;
+            if (m_change && !ArmDirectoryWatch()) {
+                CloseHandle(m_change);
+                m_change = nullptr;
+            }
+        }
+        m_wake = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+        m_stop.store(false, std::memory_order_relaxed);
+        if (m_wake) {
+            m_thread = CreateThread(nullptr, 0, WatcherThread, this, 0, nullptr);
+        }
+        if (!m_thread) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    // Queued writes are flushed here on the calling thread, so nothing is lost
+    // even when the watcher thread is already gone at process exit. At process
+    // exit a killed thread may have died holding either lock, so the flush only
+    // tries them and drops the writes rather than hang the loader lock.
+    void Stop(bool processTerminating) {
+        if (m_thread) {
+            m_stop.store(true, std::memory_order_release);
+            SetEvent(m_wake);
+            if (!processTerminating) {
+                WaitForSingleObject(m_thread, 1000);
+            }
+        }
+        if (processTerminating) {
+            TryFlushPendingWritesAtExit();
+            // A job's writer may take locks a killed thread still holds.
+            delete m_fileJob.exchange(nullptr, std::memory_order_acq_rel);
+        } else {
+            FlushPendingWrites();
+            RunFileJob();
+        }
+        Close();
+    }
+
+    bool Running() const { return m_thread != nullptr; }
+
+    // Any thread, lock-free. A later value of the same key replaces an earlier
+    // one when the batch is flushed. The file is written by the watcher thread,
+    // or by Stop when there is none.
+    void QueueWrite(const char* key, const char* value) {
+        PendingWrite* write = new PendingWrite();
+        write->key = key;
+        write->value = value;
+        write->next = m_pending.load(std::memory_order_relaxed);
+        while (!m_pending.compare_exchange_weak(write->next, write, std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+        }
+        if (m_wake) {
+            SetEvent(m_wake);
+        }
+    }
+
+    // Any thread, lock-free. There is one job slot: a job that has not run yet
+    // is dropped in favour of the newer one. Returns false, without taking the
+    // job, when no watcher thread is running.
+    bool QueueFileJob(const char* path, std::vector<uint8_t> bytes, FileJobFn write) {
+        if (!m_wake) {
+            return false;
+        }
+        FileJob* job = new FileJob();
+        job->path = path;
+        job->bytes = std::move(bytes);
+        job->write = write;
+        delete m_fileJob.exchange(job, std::memory_order_acq_rel);
+        SetEvent(m_wake);
+        return true;
+    }
+
+private:
+    static DWORD WINAPI WatcherThread(LPVOID parameter) {
+        static_cast<ConfigFileWatcher*>(parameter)->Run();
+        return 0;
+    }
+
+    struct PendingWrite {
+        PendingWrite* next = nullptr;
+        std::string key;
+        std::string value;
+    };
+
+    struct FileJob {
+        std::string path;
+        std::vector<uint8_t> bytes;
+        FileJobFn write = nullptr;
+    };
+
+    void RunFileJob() {
+        FileJob* job = m_fileJob.exchange(nullptr, std::memory_order_acq_rel);
+        if (job) {
+            job->write(job->path.c_str(), job->bytes);
+            delete job;
+        }
+    }
+
+    void Run() {
+        while (!m_stop.load(std::memory_order_acquire)) {
+            HANDLE handles[2] = { m_wake, m_change };
+            const DWORD handleCount = m_change ? 2 : 1;
+            const DWORD wait = WaitForMultipleObjects(handleCount, handles, FALSE, INFINITE);
+            if (m_stop.load(std::memory_order_acquire)) {
+                break;
+            }
+            const bool iniChanged = wait == WAIT_OBJECT_0 + 1 && TakeDirectoryChanges();
+            if (wait == WAIT_OBJECT_0 + 1 && !iniChanged) {
+                continue;
+            }
+            // Let a burst of overlay edits or an editor's multi-step save settle.
+            Sleep(kSettleMs);
+            FlushPendingWrites();
+            RunFileJob();
+            if (iniChanged) {
+                const ULONGLONG lastWrite = ReadLastWriteTime();
+                if (lastWrite != 0 && lastWrite != m_lastWrite) {
+                    m_lastWrite = lastWrite;
+                    m_onReload(m_path);
+                }
+            }
+        }
+        if (m_directory) {
+            CancelIoEx(m_directory, &m_overlapped);
+        }
+    }
+
+    bool ArmDirectoryWatch() {
+        memset(&m_overlapped, 0, sizeof(m_overlapped));
+        m_overlapped.hEvent = m_change;
+        return ReadDirectoryChangesW(m_directory, m_changeBuffer, sizeof(m_changeBuffer), FALSE,
+                                     FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, nullptr,
+                                     &m_overlapped, nullptr) != FALSE;
+    }
+
+    // Watcher thread, after m_change fired: true when any of the reported changes
+    // names the ini (or the list overflowed). Re-arms the watch.
+    bool TakeDirectoryChanges() {
+        DWORD bytes = 0;
+        const bool completed = GetOverlappedResult(m_directory, &m_overlapped, &bytes, FALSE) != FALSE;
+        ResetEvent(m_change);
+        bool iniChanged = !completed || bytes == 0;
+        for (DWORD offset = 0; completed && offset + sizeof(FILE_NOTIFY_INFORMATION) <= bytes && !iniChanged;) {
+            const FILE_NOTIFY_INFORMATION* info =
+                reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(m_changeBuffer + offset);
+            char name[MAX_PATH] = {};
+            const int length = WideCharToMultiByte(CP_ACP, 0, info->FileName,
+                                                   static_cast<int>(info->FileNameLength / sizeof(WCHAR)), name,
+                                                   static_cast<int>(sizeof(name) - 1), nullptr, nullptr);
+            iniChanged = length > 0 && _stricmp(name, m_fileName) == 0;
+            if (info->NextEntryOffset == 0) {
+                break;
+            }
+            offset += info->NextEntryOffset;
+        }
+        if (!ArmDirectoryWatch()) {
+            // Watching broke; the thread keeps flushing writes but stops reloading.
+            CloseHandle(m_change);
+            m_change = nullptr;
+        }
+        return iniChanged;
+    }
+
+    // Takes every queued write, oldest first, keeping the last value of each key.
+    std::vector<std::pair<std::string, std::string>> TakePendingWrites() {
+        std::vector<std::pair<std::string, std::string>> batch;
+        // Newest first.
+        PendingWrite* write = m_pending.exchange(nullptr, std::memory_order_acquire);
+        while (write) {
+            bool superseded = false;
+            for (const auto& pending : batch) {
+                superseded = superseded || _stricmp(pending.first.c_str(), write->key.c_str()) == 0;
+            }
+            if (!superseded) {
+                batch.emplace_back(std::move(write->key), std::move(write->value));
+            }
+            PendingWrite* next = write->next;
+            delete write;
+            write = next;
+        }
+        std::reverse(batch.begin(), batch.end());
+        return batch;
+    }
+
+    void FlushPendingWrites() {
+        std::vector<std::pair<std::string, std::string>> batch = TakePendingWrites();
+        if (batch.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_fileMutex);
+        // The rewrite keeps an edit that landed since the last check, but hides its
+        // timestamp, so report that edit here.
+        const bool externalEdit = m_onReload && ReadLastWriteTime() != m_lastWrite;
+        const bool ok = WriteConfigIniValues(m_path, m_section, batch);
+        m_lastWrite = ReadLastWriteTime();
+        if (m_onFlush) {
+            m_onFlush(batch.size(), ok);
+        }
+        if (externalEdit) {
+            m_onReload(m_path);
+        }
+    }
+
+    // No callbacks: the reload and flush handlers take locks of their own.
+    void TryFlushPendingWritesAtExit() {
+        std::unique_lock<std::mutex> fileLock(m_fileMutex, std::try_to_lock);
+        if (!fileLock.owns_lock()) {
+            return;
+        }
+        const std::vector<std::pair<std::string, std::string>> batch = TakePendingWrites();
+        if (!batch.empty()) {
+            WriteConfigIniValues(m_path, m_section, batch);
+        }
+    }
+
+    ULONGLONG ReadLastWriteTime() const {
+        WIN32_FILE_ATTRIBUTE_DATA data = {};
+        if (!GetFileAttributesExA(m_path, GetFileExInfoStandard, &data)) {
+            return 0;
+        }
+        return (static_cast<ULONGLONG>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+               data.ftLastWriteTime.dwLowDateTime;
+    }
+
+    void Close() {
+        if (m_thread) {
+            CloseHandle(m_thread);
+            m_thread = nullptr;
+        }
+        if (m_wake) {
+            CloseHandle(m_wake);
+            m_wake = nullptr;
+        }
+        // Closing the directory first cancels a read still pending on m_change.
+        if (m_directory) {
+            CloseHandle(m_directory);
+            m_directory = nullptr;
+        }
+        if (m_change) {
+            CloseHandle(m_change);
+            m_change = nullptr;
+        }
+    }
+
+    static constexpr DWORD kSettleMs = 200;
+
+    char m_path[MAX_PATH] = {};
+    char m_fileName[MAX_PATH] = {};
+    char m_section[64] = {};
+    ReloadFn m_onReload = nullptr;
+    FlushFn m_onFlush = nullptr;
+    HANDLE m_thread = nullptr;
+    HANDLE m_wake = nullptr;
+    // Manual-reset event of the overlapped ReadDirectoryChangesW on m_directory.
+    HANDLE m_change = nullptr;
+    HANDLE m_directory = nullptr;
+    OVERLAPPED m_overlapped = {};
+    alignas(DWORD) uint8_t m_changeBuffer[4096] = {};
+    std::atomic<bool> m_stop{false};
+    ULONGLONG m_lastWrite = 0;
+    // Only serializes a Stop() flush against a watcher thread that outlived its wait.
+    std::mutex m_fileMutex;
+    std::atomic<PendingWrite*> m_pending{nullptr};
+    std::atomic<FileJob*> m_fileJob{nullptr};
+};
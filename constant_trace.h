@@ -0,0 +1,280 @@
+/*
+ * Compact binary trace of the device calls that drive camera reconstruction.
+ *
+ * A trace is a TraceFileHeader followed by records, each a TraceRecordHeader
+ * plus payloadBytes of payload. Captures are written by WrappedD3D9Device when
+ * capture is active and are replayed by ReplayCameraTrace (d3d9_proxy.cpp)
+ * through a null device, so classifier changes can be profiled and diffed on
+ * real game traffic without a GPU.
+ *
+ * Payloads (little endian, as written by the x86 build):
+ *   Shader                   uint64 key, then the shader bytecode
+ *   SetVertexShader          uint64 key (0 = null shader)
+ *   SetVertexShaderConstantF uint32 start, uint32 count, float[count * 4]
+ *   SetViewport              D3DVIEWPORT9
+ *   BeginScene / Present     none
+ *   Draw                     uint32 TraceDrawKind, uint32 primitive type, uint32 primitive count
+ *   SetRenderTarget          TraceSurfacePayload for render target 0 (key 0 = null)
+ *   SetDepthStencilSurface   TraceSurfacePayload (key 0 = null)
+ *   SetFVF                   uint32 FVF
+ *   VertexDeclaration        uint64 key, then D3DVERTEXELEMENT9[] up to and including D3DDECL_END
+ *   SetVertexDeclaration     uint64 key (0 = null declaration)
+ *
+ * Shader and VertexDeclaration records are emitted lazily the first time the
+ * object is bound during a capture, keyed by the original interface pointer.
+ * Surfaces carry their description inline, since the render pass tracker keys
+ * passes on it.
+ *
+ * TraceMaxPayloadBytes bounds each record type; the writer never produces a
+ * larger record and the reader stops at one instead of allocating its claim.
+ */
+#pragma once
+
+#include <windows.h>
+#include <d3d9types.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+static const char kTraceMagic[4] = { 'C', 'P', 'T', 'R' };
+static constexpr uint32_t kTraceVersion = 2;
+
+struct TraceFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t reserved[2];
+};
+
+enum TraceRecordType : uint16_t {
+    TraceRecord_Shader = 1,
+    TraceRecord_SetVertexShader = 2,
+    TraceRecord_SetVertexShaderConstantF = 3,
+    TraceRecord_SetViewport = 4,
+    TraceRecord_BeginScene = 5,
+    TraceRecord_Present = 6,
+    TraceRecord_Draw = 7,
+    TraceRecord_SetRenderTarget = 8,
+    TraceRecord_SetDepthStencilSurface = 9,
+    TraceRecord_SetFVF = 10,
+    TraceRecord_VertexDeclaration = 11,
+    TraceRecord_SetVertexDeclaration = 12
+};
+
+enum TraceDrawKind : uint32_t {
+    TraceDraw_Primitive = 0,
+    TraceDraw_IndexedPrimitive = 1,
+    TraceDraw_PrimitiveUP = 2,
+    TraceDraw_IndexedPrimitiveUP = 3
+};
+
+struct TraceRecordHeader {
+    uint16_t type;
+    uint16_t reserved;
+    uint32_t payloadBytes;
+};
+
+struct TraceDrawPayload {
+    uint32_t kind;
+    uint32_t primitiveType;
+    uint32_t primitiveCount;
+};
+
+struct TraceSurfacePayload {
+    uint64_t key;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t usage;
+};
+
+// vs_3_0 float constant registers; matches kMaxConstantRegisters in d3d9_proxy.cpp.
+static constexpr uint32_t kTraceMaxConstantRegisters = 256;
+static constexpr uint32_t kTraceMaxShaderBytes = 1024 * 1024;
+// MAXD3DDECLLENGTH elements plus the D3DDECL_END terminator.
+static constexpr uint32_t kTraceMaxDeclarationElements = 64 + 1;
+
+// Largest legal payload of a record type. Unknown types carry none.
+static inline uint32_t TraceMaxPayloadBytes(uint16_t type) {
+    switch (type) {
+    case TraceRecord_Shader:
+        return sizeof(uint64_t) + kTraceMaxShaderBytes;
+    case TraceRecord_SetVertexShader:
+        return sizeof(uint64_t);
+    case TraceRecord_SetVertexShaderConstantF:
+        return 2 * sizeof(uint32_t) + kTraceMaxConstantRegisters * 4 * sizeof(float);
+    case TraceRecord_SetViewport:
+        return sizeof(D3DVIEWPORT9);
+    case TraceRecord_Draw:
+        return sizeof(TraceDrawPayload);
+    case TraceRecord_SetRenderTarget:
+    case TraceRecord_SetDepthStencilSurface:
+        return sizeof(TraceSurfacePayload);
+    case TraceRecord_SetFVF:
+        return sizeof(uint32_t);
+    case TraceRecord_VertexDeclaration:
+        return sizeof(uint64_t) + kTraceMaxDeclarationElements * sizeof(D3DVERTEXELEMENT9);
+    case TraceRecord_SetVertexDeclaration:
+        return sizeof(uint64_t);
+    default:
+        return 0;
+    }
+}
+
+// Appends records into a 4 MB buffer and hands full buffers to fwrite, so a
+// captured call costs one memcpy of its payload.
+class ConstantTraceWriter {
+public:
+    bool Open(const char* path) {
+        Close();
+        m_file = fopen(path, "wb");
+        if (!m_file) {
+            return false;
+        }
+        setvbuf(m_file, nullptr, _IONBF, 0);
+        m_buffer.resize(kBufferBytes);
+        m_used = 0;
+        m_records = 0;
+        m_bytes = 0;
+        m_emittedShaders.clear();
+        m_emittedDeclarations.clear();
+        TraceFileHeader header = {};
+        memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+        header.version = kTraceVersion;
+        Append(&header, sizeof(header));
+        return true;
+    }
+
+    void Close() {
+        if (!m_file) {
+            return;
+        }
+        Flush();
+        fclose(m_file);
+        m_file = nullptr;
+    }
+
+    bool IsOpen() const { return m_file != nullptr; }
+    unsigned long long RecordCount() const { return m_records; }
+    unsigned long long ByteCount() const { return m_bytes; }
+
+    void Write(TraceRecordType type, const void* a, size_t aBytes, const void* b = nullptr, size_t bBytes = 0) {
+        TraceRecordHeader header = {};
+        header.type = type;
+        header.payloadBytes = static_cast<uint32_t>(aBytes + bBytes);
+        Append(&header, sizeof(header));
+        if (aBytes) {
+            Append(a, aBytes);
+        }
+        if (bBytes) {
+            Append(b, bBytes);
+        }
+        m_records++;
+    }
+
+    // Returns true the first time a shader key is seen in this capture.
+    bool MarkShaderEmitted(uint64_t key) {
+        return m_emittedShaders.insert(key).second;
+    }
+
+    // The shader at key was destroyed; a new shader at the same address is re-emitted.
+    void ForgetShader(uint64_t key) {
+        m_emittedShaders.erase(key);
+    }
+
+    // Same bookkeeping for vertex declarations.
+    bool MarkDeclarationEmitted(uint64_t key) {
+        return m_emittedDeclarations.insert(key).second;
+    }
+
+    void ForgetDeclaration(uint64_t key) {
+        m_emittedDeclarations.erase(key);
+    }
+
+private:
+    static constexpr size_t kBufferBytes = 4 * 1024 * 1024;
+
+    void Append(const void* data, size_t bytes) {
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        while (bytes > 0) {
+            if (m_used == m_buffer.size()) {
+                Flush();
+            }
+            const size_t chunk = (bytes < m_buffer.size() - m_used) ? bytes : m_buffer.size() - m_used;
+            memcpy(m_buffer.data() + m_used, src, chunk);
+            m_used += chunk;
+            src += chunk;
+            bytes -= chunk;
+            m_bytes += chunk;
+        }
+    }
+
+    void Flush() {
+        if (m_file && m_used > 0) {
+            fwrite(m_buffer.data(), 1, m_used, m_file);
+        }
+        m_used = 0;
+    }
+
+    FILE* m_file = nullptr;
+    std::vector<uint8_t> m_buffer;
+    size_t m_used = 0;
+    unsigned long long m_records = 0;
+    unsigned long long m_bytes = 0;
+    std::unordered_set<uint64_t> m_emittedShaders;
+    std::unordered_set<uint64_t> m_emittedDeclarations;
+};
+
+// Sequential reader; Next() fills the header and payload of the next record.
+class ConstantTraceReader {
+public:
+    ~ConstantTraceReader() { Close(); }
+
+    bool Open(const char* path) {
+        Close();
+        m_file = fopen(path, "rb");
+        if (!m_file) {
+            return false;
+        }
+        setvbuf(m_file, nullptr, _IOFBF, 1024 * 1024);
+        TraceFileHeader header = {};
+        if (fread(&header, sizeof(header), 1, m_file) != 1 ||
+            memcmp(header.magic, kTraceMagic, sizeof(header.magic)) != 0 ||
+            header.version != kTraceVersion) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (m_file) {
+            fclose(m_file);
+            m_file = nullptr;
+        }
+        m_oversized = false;
+    }
+
+    // Returns false at the end of the trace, on a short read, or at a record whose
+    // payloadBytes exceeds TraceMaxPayloadBytes (see Oversized()).
+    bool Next(TraceRecordHeader* header, std::vector<uint8_t>* payload) {
+        if (!m_file || fread(header, sizeof(*header), 1, m_file) != 1) {
+            return false;
+        }
+        if (header->payloadBytes > TraceMaxPayloadBytes(header->type)) {
+            m_oversized = true;
+            return false;
+        }
+        payload->resize(header->payloadBytes);
+        return header->payloadBytes == 0 ||
+               fread(payload->data(), 1, header->payloadBytes, m_file) == header->payloadBytes;
+    }
+
+    // The last Next() stopped at an oversized record; its header is still filled in.
+    bool Oversized() const { return m_oversized; }
+
+private:
+    FILE* m_file = nullptr;
+    bool m_oversized = false;
+};
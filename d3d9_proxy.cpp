@@ -5,7 +5,7 @@
  * vertex shader constants, and provides them via SetTransform().
  *
  * Build with Visual Studio Developer Command Prompt:
- *   cl /LD /EHsc d3d9_proxy.cpp /link /DEF:d3d9.def /OUT:d3d9.dll
+ *   cl /LD /EHsc d3d9_proxy.cpp camera_reconstruction.cpp /link /DEF:d3d9.def /OUT:d3d9.dll
  *
  * Setup:
  * 1. Place this compiled d3d9.dll in the game folder
@@ -24,8 +24,10 @@
 #include <cstdlib>
 #include <deque>
 #include <limits>
-#include <mutex>
+#include <atomic>
 #include <cassert>
+#include <new>
+#include <emmintrin.h>
 
 #define IMGUI_IMPL_WIN32_DISABLE_GAMEPAD
 #define IMGUI_DEFINE_MATH_OPERATORS
@@ -33,33 +35,43 @@
 #include "imgui/imgui.h"
 #include "imgui/backends/imgui_impl_dx9.h"
 #include "imgui/backends/imgui_impl_win32.h"
+#include "camera_reconstruction.h"
+#include "proxy_profiler.h"
+#include "proxy_markers.h"
+#include "constant_trace.h"
+#include "layout_cache.h"
+#include "async_classifier.h"
+#include "config_file.h"
+#include "render_pass_tracker.h"
+#include "present_scheduler.h"
+#include "camera_proxy_shared.h"
+#include "null_d3d9_device.h"
+#include "proxy_heap.h"
 
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd,
                                                              UINT msg,
                                                              WPARAM wParam,
                                                              LPARAM lParam);
 
-bool LooksLikeMatrix(const float* data);
-static void LogMsg(const char* fmt, ...);
-static bool LooksLikeViewStrict(const D3DMATRIX& m);
-static bool LooksLikeProjectionStrict(const D3DMATRIX& m);
-float ExtractFOV(const D3DMATRIX& proj);
-
-enum ProjectionHandedness {
-    ProjectionHandedness_Unknown = 0,
-    ProjectionHandedness_Left,
-    ProjectionHandedness_Right
-};
-
-struct ProjectionAnalysis {
-    bool valid = false;
-    float fovRadians = 0.0f;
-    ProjectionHandedness handedness = ProjectionHandedness_Unknown;
-};
+// Every C++ allocation of the DLL comes from the proxy heap, so the memory scanner
+// can leave the proxy's own copies of the camera out (see proxy_heap.h).
+void* operator new(size_t bytes) {
+    if (void* block = ProxyHeapAlloc(bytes)) {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t bytes) { return operator new(bytes); }
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept { return ProxyHeapAlloc(bytes); }
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept { return ProxyHeapAlloc(bytes); }
+void operator delete(void* block) noexcept { ProxyHeapFree(block); }
+void operator delete[](void* block) noexcept { ProxyHeapFree(block); }
+void operator delete(void* block, size_t) noexcept { ProxyHeapFree(block); }
+void operator delete[](void* block, size_t) noexcept { ProxyHeapFree(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { ProxyHeapFree(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { ProxyHeapFree(block); }
 
-static bool AnalyzeProjectionMatrixNumeric(const D3DMATRIX& m, ProjectionAnalysis* out);
-static const char* ProjectionHandednessLabel(ProjectionHandedness handedness);
-void CreateIdentityMatrix(D3DMATRIX* out);
+static void LogMsg(const char* fmt, ...);
 class WrappedD3D9Device;
 
 #pragma comment(lib, "user32.lib")
@@ -76,10 +88,38 @@ struct ProxyConfig {
     int memoryScannerIntervalSec = 0;
     int memoryScannerMaxResults = 25;
     char memoryScannerModule[MAX_PATH] = {};
+    bool memoryScannerAllRegions = false;
+    int memoryScannerThreads = 0;
+    char traceCapturePath[MAX_PATH] = "camera_proxy.trace";
+    bool traceCaptureOnStart = false;
+    bool layoutCacheEnabled = true;
+    char layoutCacheFile[MAX_PATH] = "camera_proxy_layouts.bin";
     bool useRemixRuntime = true;
     char remixDllName[MAX_PATH] = "d3d9_remix.dll";
     bool emitFixedFunctionTransforms = true;
+    bool emitTransformsOnChangeOnly = false;
+    bool useSimdMatrixKernels = true;
+    bool asyncClassification = false;
+    bool configHotReload = true;
+    bool passFiltering = true;
+    char passPolicies[512] = "";
+    bool skipScreenSpaceDraws = true;
+    char screenSpaceShaders[512] = "";
     char gameProfile[64] = "";
+    int presentTaskBudgetUs = 200;
+    bool sharedCameraExport = false;
+    bool perfMarkers = false;
+    bool forceFlipEx = false;
+    int maxFrameLatency = 0;
+    char sharedCameraExportName[64] = "CameraProxyCamera";
+
+    // Mirrored into their g_ globals by ApplyConfigGlobals.
+    bool probeTransposedLayouts = true;
+    bool probeInverseView = true;
+    int layoutLockThreshold = 8;
+    int bonePaletteMinBones = 8;
+    int overrideScopeMode = 0;
+    int overrideNFrames = 3;
 
     // Diagnostic mode - log ALL shader constant updates
     bool logAllConstants = false;
@@ -129,27 +169,18 @@ struct CombinedMVPDebugState {
     ProjectionHandedness handedness = ProjectionHandedness_Unknown;
 };
 
-enum GameProfileKind {
-    GameProfile_None = 0,
-    GameProfile_MetalGearRising,
-    GameProfile_DevilMayCry4
-};
-
-struct RegisterLayoutProfile {
-    int combinedMvpBase = -1;
-    int projectionBase = -1;
-    int viewInverseBase = -1;
-    int worldBase = -1;
-    int viewProjectionBase = -1;
-    int worldViewBase = -1;
-};
-
 static GameProfileKind g_activeGameProfile = GameProfile_None;
 static RegisterLayoutProfile g_profileLayout = {};
 static bool g_profileViewDerivedFromInverse = false;
 static bool g_profileCoreRegistersSeen[3] = { false, false, false }; // proj, viewInv, world
 static bool g_profileOptionalRegistersSeen[2] = { false, false }; // VP, WV
 static char g_profileStatusMessage[256] = "";
+// Constant text last copied into g_profileStatusMessage (nullptr after a formatted
+// message), so per-upload status updates only copy when the text changes.
+static const char* g_profileStatusText = nullptr;
+// Why the strict profiles skipped the last draw. Written at draws on the render
+// thread, apart from g_profileStatusMessage, which the classifier owns.
+static char g_profileDrawStatusMessage[256] = "";
 static bool g_profileDisableStructuralDetection = false;
 static bool g_mgrProjCapturedThisFrame = false;
 static bool g_mgrViewCapturedThisFrame = false;
@@ -157,6 +188,11 @@ static bool g_mgrWorldCapturedForDraw = false;
 static bool g_mgrProjectionRegisterValid = false;
 
 static ProxyConfig g_config;
+static char g_configIniPath[MAX_PATH] = "camera_proxy.ini";
+static ConfigFileWatcher g_configWatcher;
+// Newest camera_proxy.ini parsed by the watcher thread; Present takes and applies it.
+static std::atomic<ProxyConfig*> g_reloadedConfig{nullptr};
+static unsigned int g_configReloadCount = 0;
 static HMODULE g_hD3D9 = nullptr;
 static FILE* g_logFile = nullptr;
 static int g_frameCount = 0;
@@ -184,6 +220,9 @@ enum MatrixSlot {
 struct ManualMatrixBinding {
     bool enabled = false;
     uintptr_t shaderKey = 0;
+    // Bytecode hash of the bound shader (0 if unknown). A binding restored from the
+    // layout cache starts with shaderKey = 0 and adopts the first shader with this hash.
+    uint32_t shaderHash = 0;
     int baseRegister = -1;
     int rows = 4;
 };
@@ -205,12 +244,14 @@ static MatrixSourceInfo g_matrixSources[MatrixSlot_Count] = {};
 static ManualMatrixBinding g_manualBindings[MatrixSlot_Count] = {};
 static void UpdateMatrixSource(MatrixSlot slot,
                                uintptr_t shaderKey,
+                               uint32_t shaderHash,
                                int baseRegister,
                                int rows,
                                bool transposed,
                                bool manual,
                                const char* sourceLabel = nullptr,
                                int extractedFromRegister = -1);
+static const char* MatrixSlotLabel(MatrixSlot slot);
 
 static bool g_imguiInitialized = false;
 static HWND g_imguiHwnd = nullptr;
@@ -230,13 +271,40 @@ static bool g_enableShaderEditing = false;
 static bool g_requestManualEmit = false;
 static char g_manualEmitStatus[192] = "";
 static char g_matrixAssignStatus[256] = "";
+static char g_profilerStatus[128] = "";
+
+// Binary trace capture (constant_trace.h). Start/stop requests from the overlay
+// are applied at the next Present so the trace always begins on a frame edge.
+static ConstantTraceWriter g_traceWriter;
+static bool g_traceCaptureRequested = false;
+static bool g_traceStopRequested = false;
+static bool g_traceReplayActive = false;
+static char g_traceStatus[256] = "";
 static int g_manualAssignRows = 4;
 static bool g_projectionDetectedByNumericStructure = false;
 static float g_projectionDetectedFovRadians = 0.0f;
 static int g_projectionDetectedRegister = -1;
 static ProjectionHandedness g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
 static CombinedMVPDebugState g_combinedMvpDebug = {};
-static char g_customProjectionStatus[256] = "";
+// Experimental custom projection is rebuilt only when its inputs change:
+// overlay edits bump the generation, the device drops its copy on viewport
+// size changes, render target 0 changes, Reset and state-block Apply.
+struct CustomProjectionStatusInfo {
+    bool active = false;
+    bool usedAuto = false;
+    UINT width = 0;
+    UINT height = 0;
+    float aspect = 0.0f;
+};
+
+static uint32_t g_customProjectionGeneration = 1;
+static CustomProjectionStatusInfo g_customProjectionStatusInfo = {};
+static const char* const kCustomProjectionAutoLabel = "experimental custom projection auto";
+static const char* const kCustomProjectionManualLabel = "experimental custom projection manual";
+
+static void InvalidateCustomProjectionCache() {
+    g_customProjectionGeneration++;
+}
 
 enum HotkeyAction {
     HotkeyAction_ToggleMenu = 0,
@@ -253,6 +321,8 @@ static int g_iniProjMatrixRegister = -1;
 static int g_iniWorldMatrixRegister = -1;
 
 static constexpr int kMaxConstantRegisters = 256;
+static_assert(kMaxConstantRegisters == static_cast<int>(kTraceMaxConstantRegisters),
+              "trace records must be able to hold every constant upload");
 static int g_selectedRegister = -1;
 static uintptr_t g_activeShaderKey = 0;
 static uintptr_t g_selectedShaderKey = 0;
@@ -265,49 +335,322 @@ enum OverrideScopeMode {
 
 static bool g_probeTransposedLayouts = true;
 static bool g_probeInverseView = true;
+static int g_layoutLockThreshold = 8;
+static int g_bonePaletteMinBones = 8;
 static int g_overrideScopeMode = Override_Sticky;
 static int g_overrideNFrames = 3;
-static std::unordered_map<uintptr_t, uint32_t> g_shaderBytecodeHashes = {};
 
-static bool TryGetShaderBytecodeHash(uintptr_t shaderKey, uint32_t* outHash) {
-    if (!outHash || shaderKey == 0) {
-        return false;
-    }
-    auto it = g_shaderBytecodeHashes.find(shaderKey);
-    if (it == g_shaderBytecodeHashes.end() || it->second == 0) {
-        return false;
-    }
-    *outHash = it->second;
-    return true;
-}
+// Float4 constant declared in a shader's CTAB comment block.
+struct ShaderConstantTableEntry {
+    char name[32] = {};
+    int registerIndex = -1;
+    int registerCount = 0;
+};
 
-struct ShaderConstantState {
+// Per-shader metadata gathered once from the bytecode handed to CreateVertexShader.
+struct VertexShaderRecord {
+    uint32_t bytecodeHash = 0;
+    uint32_t bytecodeSize = 0;
+    DWORD shaderVersion = 0;
+    int maxConstantRegister = -1;
+    std::vector<ShaderConstantTableEntry> constantTable;
+};
+
+// Constant editor overrides for one shader; allocated on the first edit.
+struct ShaderConstantOverrides {
     float constants[kMaxConstantRegisters][4] = {};
     bool valid[kMaxConstantRegisters] = {};
-    float overrideConstants[kMaxConstantRegisters][4] = {};
-    bool overrideValid[kMaxConstantRegisters] = {};
-    int overrideFramesRemaining[kMaxConstantRegisters] = {};
-    bool snapshotReady = false;
+    int framesRemaining[kMaxConstantRegisters] = {};
+};
+
+// Welford statistics for one shader; allocated once the overlay asks for variance.
+struct ShaderConstantVariance {
     unsigned long long sampleCount = 0;
     double mean[kMaxConstantRegisters][4] = {};
     double m2[kMaxConstantRegisters][4] = {};
-    int stableViewBase = -1;
-    int stableViewCount = 0;
-    int stableProjBase = -1;
-    int stableProjCount = 0;
+};
+
+// Hot per-shader state. `constants` is a pooled block covering c0..c(capacity-1),
+// grown to the highest register the shader has written.
+struct ShaderConstantState {
+    float (*constants)[4] = nullptr;
+    int capacity = 0;
+    uint32_t validMask[kMaxConstantRegisters / 32] = {};
+    // g_constantChangeSerial of the last upload that changed each register, sized
+    // like `constants`.
+    std::vector<unsigned long long> changeSerials;
+    ShaderConstantOverrides* overrides = nullptr;
+    ShaderConstantVariance* variance = nullptr;
+    // Set by the first upload; reads of a shader that never uploaded fail.
+    bool hasUploaded = false;
     unsigned long long lastChangeSerial = 0;
 };
 
+static inline bool IsSnapshotReady(const ShaderConstantState& state) {
+    return state.hasUploaded;
+}
+
+static inline bool IsConstantValid(const ShaderConstantState& state, int reg) {
+    return static_cast<unsigned>(reg) < static_cast<unsigned>(kMaxConstantRegisters) &&
+           (state.validMask[reg >> 5] & (1u << (reg & 31))) != 0;
+}
+
+enum ScreenSpaceFlag : uint8_t {
+    // Listed in ScreenSpaceShaders or marked in the overlay.
+    ScreenSpace_Listed = 1 << 0,
+    // Uploaded a pixel-to-clip orthographic matrix (see ProbeScreenSpaceOrtho).
+    ScreenSpace_Ortho = 1 << 1
+};
+
+// Uploads per shader checked for a screen-space orthographic matrix.
+static constexpr uint8_t kScreenSpaceOrthoProbeUploads = 8;
+
+// Everything the proxy tracks for one vertex shader. Shaders created through the
+// wrapped device own their slot (see WrappedD3D9VertexShader) and the device keeps
+// the bound slot's pointer, so the hot path never looks a shader up by address.
+struct ShaderSlot {
+    uintptr_t key = 0;
+    bool inUse = false;
+    bool disabled = false;
+    // ScreenSpaceFlag bits; draws with this shader bound get no SetTransform.
+    uint8_t screenSpace = 0;
+    uint8_t orthoProbeUploads = kScreenSpaceOrthoProbeUploads;
+    // Set once the bytecode has been inspected, even if that failed.
+    bool hasRecord = false;
+    VertexShaderRecord record;
+    ShaderConstantState state;
+};
+
 static ShaderConstantState* GetShaderState(uintptr_t shaderKey, bool createIfMissing);
 
-static std::unordered_map<uintptr_t, ShaderConstantState> g_shaderConstants = {};
+// Slots live in a chunked pool so pointers stay stable; freed slots are reused
+// through g_freeShaderSlots. The index map serves the overlay and shaders that
+// were not created through the wrapped device.
+static std::deque<ShaderSlot> g_shaderSlots = {};
+static std::vector<uint32_t> g_freeShaderSlots = {};
+static std::unordered_map<uintptr_t, uint32_t> g_shaderSlotIndex = {};
 static std::vector<uintptr_t> g_shaderOrder = {};
-static std::unordered_map<uintptr_t, bool> g_disabledShaders = {};
+// Bumped whenever a shader leaves g_shaderOrder.
+static unsigned int g_shaderOrderGeneration = 0;
+
+static ShaderSlot* FindShaderSlot(uintptr_t shaderKey) {
+    auto it = g_shaderSlotIndex.find(shaderKey);
+    return it != g_shaderSlotIndex.end() ? &g_shaderSlots[it->second] : nullptr;
+}
+
+static ShaderSlot* AcquireShaderSlot(uintptr_t shaderKey) {
+    if (ShaderSlot* existing = FindShaderSlot(shaderKey)) {
+        return existing;
+    }
+    uint32_t index = 0;
+    if (!g_freeShaderSlots.empty()) {
+        index = g_freeShaderSlots.back();
+        g_freeShaderSlots.pop_back();
+    } else {
+        index = static_cast<uint32_t>(g_shaderSlots.size());
+        g_shaderSlots.emplace_back();
+    }
+    ShaderSlot& slot = g_shaderSlots[index];
+    slot.key = shaderKey;
+    slot.inUse = true;
+    g_shaderSlotIndex.emplace(shaderKey, index);
+    g_shaderOrder.push_back(shaderKey);
+    return &slot;
+}
+
+// Slot for draws and uploads with no vertex shader bound; never released.
+static ShaderSlot* NullShaderSlot() {
+    static ShaderSlot* slot = nullptr;
+    if (!slot) {
+        slot = AcquireShaderSlot(0);
+    }
+    return slot;
+}
+
+static const VertexShaderRecord* FindVertexShaderRecord(uintptr_t shaderKey) {
+    if (shaderKey == 0) {
+        return nullptr;
+    }
+    const ShaderSlot* slot = FindShaderSlot(shaderKey);
+    return slot && slot->hasRecord ? &slot->record : nullptr;
+}
+
+static bool TryGetShaderSlotBytecodeHash(const ShaderSlot* slot, uint32_t* outHash) {
+    if (!slot || !outHash || !slot->hasRecord || slot->record.bytecodeHash == 0) {
+        return false;
+    }
+    *outHash = slot->record.bytecodeHash;
+    return true;
+}
+
+static bool TryGetShaderBytecodeHash(uintptr_t shaderKey, uint32_t* outHash) {
+    return shaderKey != 0 && TryGetShaderSlotBytecodeHash(FindShaderSlot(shaderKey), outHash);
+}
 static unsigned long long g_constantChangeSerial = 0;
+// Registers that have ever produced a transform (detected, pinned, or profile layout).
+// Only grows; uploads that miss it and carry unchanged data skip all analysis.
+// Written by whichever thread classifies, read by the SetVertexShaderConstantF fast path.
+static std::atomic<uint32_t> g_knownTransformRegisterMask[kMaxConstantRegisters / 32] = {};
+static unsigned long long g_constantUploadCount = 0;
+static unsigned long long g_constantFastPathCount = 0;
+static unsigned long long g_transformEmitSent = 0;
+static unsigned long long g_transformEmitSkipped = 0;
+static unsigned long long g_transformGameSetsSuppressed = 0;
+static unsigned long long g_transformGetsAnsweredLocally = 0;
+// Render target / viewport passes of the device; policies decide which passes
+// feed the classifier and receive SetTransform.
+static RenderPassTracker g_renderPasses;
+// Present housekeeping that can run at a lower rate or slip a frame; registered
+// by the device, budgeted by PresentTaskBudgetUs.
+static PresentScheduler g_presentScheduler;
+static unsigned long long g_passUploadsSkipped = 0;
+static unsigned long long g_passDrawsSkipped = 0;
+static char g_passStatus[256] = "";
+// Bytecode hashes from ScreenSpaceShaders; matching shaders get ScreenSpace_Listed.
+static std::vector<uint32_t> g_screenSpaceShaderHashes = {};
+static unsigned long long g_screenSpaceDrawsSkipped = 0;
+
+static std::unordered_map<unsigned long long, LearnedUploadLayout> g_learnedLayouts = {};
+static unsigned long long g_layoutLockedUploads = 0;
+static unsigned long long g_layoutFullScans = 0;
+
+// Last structural scan per (shader bytecode, upload range), so the next upload of
+// the same range from the same shader only re-classifies windows whose registers
+// changed since (see ScanUploadForMatricesIncremental).
+struct UploadScanCache {
+    uintptr_t shaderKey = 0;
+    unsigned long long changeSerial = 0;
+    bool excludedPalette = false;
+    BonePaletteRange palette;
+    std::vector<UploadMatrixMatch> matches;
+};
+static std::unordered_map<unsigned long long, UploadScanCache> g_uploadScanCache = {};
+static unsigned long long g_layoutIncrementalScans = 0;
+static unsigned long long g_layoutIncrementalWindows = 0;
+static unsigned long long g_layoutValidationFailures = 0;
+
+// Skinning palettes per (shader bytecode, upload range), keyed like g_learnedLayouts.
+static constexpr int kBonePaletteConfirmUploads = 2;
+static std::unordered_map<unsigned long long, BonePaletteTracker> g_bonePalettes = {};
+static unsigned long long g_bonePaletteExcludedUploads = 0;
+static unsigned long long g_bonePaletteExcludedRegisters = 0;
+
+// On-disk layout cache state (see layout_cache.h).
+static constexpr DWORD kLayoutCacheAutosaveMs = 30000;
+static uint32_t g_layoutCacheModuleHash = 0;
+static uint32_t g_layoutCacheSettingsHash = 0;
+static uint32_t g_layoutCacheLoadedLayouts = 0;
+static uint32_t g_layoutCacheLoadedBindings = 0;
+static uint32_t g_layoutCacheRejectedLayouts = 0;
+static unsigned long long g_layoutCacheSeededUploads = 0;
+static bool g_layoutCacheDirty = false;
+static DWORD g_layoutCacheLastSaveTick = 0;
+static char g_layoutCacheStatus[192] = "";
+enum LayoutCacheWriteState {
+    LayoutCacheWrite_None = 0,
+    LayoutCacheWrite_Pending,
+    LayoutCacheWrite_Succeeded,
+    LayoutCacheWrite_Failed,
+};
+// Set by the thread that writes the file; shown next to g_layoutCacheStatus.
+static std::atomic<int> g_layoutCacheWriteState{LayoutCacheWrite_None};
+
+// Projection inverses and combined-MVP decompositions reused across uploads.
+static CameraDerivationCache g_cameraDerivationCache;
+
+// With AsyncClassification the worker owns the state above, the published matrix
+// sources and the profile status while it classifies a frame. The render thread
+// only touches them at a Present that finds the worker idle, and defers that work
+// to a later Present otherwise; it never waits on the worker.
+static AsyncClassifierPipeline g_asyncClassifier;
+
+static bool RenderThreadOwnsClassifierState() {
+    return !g_asyncClassifier.Running() || g_asyncClassifier.WorkerIdle();
+}
+
+static void ResetLearnedLayouts() {
+    g_learnedLayouts.clear();
+    g_layoutLockedUploads = 0;
+    g_layoutFullScans = 0;
+    g_uploadScanCache.clear();
+    g_layoutIncrementalScans = 0;
+    g_layoutIncrementalWindows = 0;
+    g_layoutValidationFailures = 0;
+    g_layoutCacheSeededUploads = 0;
+    g_layoutCacheDirty = true;
+}
+
+static void ResetBonePalettes() {
+    g_bonePalettes.clear();
+    g_bonePaletteExcludedUploads = 0;
+    g_bonePaletteExcludedRegisters = 0;
+}
+
+// Pushes the ini-backed classifier settings into camera_reconstruction.
+static void ApplyReconstructionConfig() {
+    ReconstructionConfig config = {};
+    config.minFOV = g_config.minFOV;
+    config.maxFOV = g_config.maxFOV;
+    config.probeTransposedLayouts = g_probeTransposedLayouts;
+    config.probeInverseView = g_probeInverseView;
+    config.combinedMVPForceDecomposition = g_config.combinedMVPForceDecomposition;
+    SetReconstructionConfig(config);
+    // Cached scan outcomes were classified under the previous settings.
+    g_uploadScanCache.clear();
+}
 static HANDLE g_memoryScannerThread = nullptr;
 static DWORD g_memoryScannerThreadId = 0;
 static DWORD g_memoryScannerLastTick = 0;
 
+// Memory scan work is split into ranges of at most kMemoryScanRangeBytes window
+// starts, collected in address order; workers pull the next range index
+// atomically and keep each range's hits separately. Results are the first
+// MaxResults hits by address whatever the thread timing: a range keeps at most
+// MaxResults hits, and ranges are only skipped once every range before them is
+// finished and those already hold MaxResults hits between them.
+static constexpr size_t kMemoryScanRangeBytes = 1024 * 1024;
+static constexpr size_t kMemoryScanChunkFloats = 16 * 1024;
+static constexpr int kMaxMemoryScanWorkers = 8;
+
+struct MemoryScanRange {
+    uintptr_t begin = 0;
+    uintptr_t end = 0;
+    uintptr_t regionEnd = 0;
+};
+
+static std::vector<MemoryScanRange> g_memoryScanRanges = {};
+static std::atomic<bool> g_memoryScanRunning{false};
+static std::atomic<bool> g_memoryScanCancel{false};
+static std::atomic<size_t> g_memoryScanNextRange{0};
+static std::atomic<uint64_t> g_memoryScanBytesDone{0};
+static std::atomic<uint64_t> g_memoryScanBytesTotal{0};
+// Hits recorded so far across all ranges; progress display only.
+static std::atomic<int> g_memoryScanHitCount{0};
+static std::atomic<uint32_t> g_memoryScanRegionCount{0};
+// Committed regions of the proxy's own heap, image, view and thread stacks left out.
+static std::atomic<uint32_t> g_memoryScanProxyRegions{0};
+static std::atomic<uint32_t> g_memoryScanUnreadableChunks{0};
+static std::atomic<int> g_memoryScanWorkerCount{0};
+static std::atomic<uint32_t> g_memoryScanLastDurationMs{0};
+
+// Pointer tracking: once a scan hit is confirmed as the live camera, its
+// address is re-read and re-validated every frame instead of rescanning.
+static constexpr int kMemoryTrackFailureLimit = 3;
+
+struct MemoryTrackedMatrix {
+    bool active = false;
+    bool valid = false;
+    bool reacquirePending = false;
+    uintptr_t address = 0;
+    D3DMATRIX matrix = {};
+    uint32_t hash = 0;
+    int consecutiveFailures = 0;
+    unsigned long long framesTracked = 0;
+};
+
+static MemoryTrackedMatrix g_memoryTracked[MatrixSlot_Count] = {};
+static unsigned long long g_memoryTrackRescans = 0;
+
 static constexpr int kFrameTimeHistory = 120;
 static float g_frameTimeHistory[kFrameTimeHistory] = {};
 static int g_frameTimeIndex = 0;
@@ -320,9 +663,28 @@ static LARGE_INTEGER g_perfFrequency = {};
 static LARGE_INTEGER g_prevCounter = {};
 static bool g_perfInitialized = false;
 
-static std::deque<std::string> g_logLines = {};
-static std::vector<std::string> g_logSnapshot = {};
-static std::vector<std::string> g_memoryScanResults = {};
+// Log ring: LogMsg formats straight into a fixed slot and publishes it with a
+// per-slot sequence (odd = being written, 2 * ticket + 2 = committed). As in a
+// Vyukov bounded queue, a producer claims a ticket only while its slot still
+// holds the previous lap's commit, so tickets and slot contents never disagree.
+// The file writer thread and the Logs tab both read slots by ticket and
+// re-check the sequence afterwards, so neither takes a lock or copies std::strings.
+static constexpr uint32_t kLogRingSlots = 1024;
+static constexpr size_t kLogSlotChars = 512;
+
+struct LogRingSlot {
+    std::atomic<uint64_t> sequence;
+    char text[kLogSlotChars];
+};
+
+static LogRingSlot g_logRing[kLogRingSlots] = {};
+static std::atomic<uint64_t> g_logWriteTicket{0};
+static std::atomic<uint64_t> g_logLinesTruncated{0};
+static std::atomic<uint64_t> g_logLinesDroppedFromFile{0};
+static std::atomic<uint64_t> g_logSlotWaits{0};
+static std::atomic<uint64_t> g_logFileBatches{0};
+static uint64_t g_logViewFirstTicket = 0;
+static uint64_t g_logViewEndTicket = 0;
 
 struct MemoryScanHit {
     std::string label;
@@ -332,11 +694,16 @@ struct MemoryScanHit {
     uint32_t hash = 0;
 };
 
+struct MemoryScanResultSet {
+    std::vector<MemoryScanHit> hits;
+};
+
+// The scanner thread publishes each finished scan here; Present takes it once per
+// frame into g_memoryScanHits, which only the render thread (tracking, overlay)
+// touches. Neither side waits on the other.
+static std::atomic<MemoryScanResultSet*> g_memoryScanPublished{nullptr};
 static std::vector<MemoryScanHit> g_memoryScanHits = {};
-static std::mutex g_uiDataMutex;
-static constexpr size_t kMaxUiLogLines = 600;
 static bool g_logsLiveUpdate = false;
-static bool g_logSnapshotDirty = true;
 
 
 static LRESULT CALLBACK ImGuiWndProcHook(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
@@ -361,6 +728,7 @@ static LRESULT CALLBACK ImGuiWndProcHook(HWND hwnd, UINT msg, WPARAM wParam, LPA
 
 static void StoreViewMatrix(const D3DMATRIX& view,
                             uintptr_t shaderKey = 0,
+                            uint32_t shaderHash = 0,
                             int baseRegister = -1,
                             int rows = 4,
                             bool transposed = false,
@@ -369,12 +737,13 @@ static void StoreViewMatrix(const D3DMATRIX& view,
                             int extractedFromRegister = -1) {
     g_cameraMatrices.view = view;
     g_cameraMatrices.hasView = true;
-    UpdateMatrixSource(MatrixSlot_View, shaderKey, baseRegister, rows, transposed, manual,
+    UpdateMatrixSource(MatrixSlot_View, shaderKey, shaderHash, baseRegister, rows, transposed, manual,
                        sourceLabel, extractedFromRegister);
 }
 
 static void StoreProjectionMatrix(const D3DMATRIX& projection,
                                   uintptr_t shaderKey = 0,
+                                  uint32_t shaderHash = 0,
                                   int baseRegister = -1,
                                   int rows = 4,
                                   bool transposed = false,
@@ -383,12 +752,13 @@ static void StoreProjectionMatrix(const D3DMATRIX& projection,
                                   int extractedFromRegister = -1) {
     g_cameraMatrices.projection = projection;
     g_cameraMatrices.hasProjection = true;
-    UpdateMatrixSource(MatrixSlot_Projection, shaderKey, baseRegister, rows, transposed, manual,
+    UpdateMatrixSource(MatrixSlot_Projection, shaderKey, shaderHash, baseRegister, rows, transposed, manual,
                        sourceLabel, extractedFromRegister);
 }
 
 static void StoreWorldMatrix(const D3DMATRIX& world,
                              uintptr_t shaderKey = 0,
+                             uint32_t shaderHash = 0,
                              int baseRegister = -1,
                              int rows = 4,
                              bool transposed = false,
@@ -397,12 +767,13 @@ static void StoreWorldMatrix(const D3DMATRIX& world,
                              int extractedFromRegister = -1) {
     g_cameraMatrices.world = world;
     g_cameraMatrices.hasWorld = true;
-    UpdateMatrixSource(MatrixSlot_World, shaderKey, baseRegister, rows, transposed, manual,
+    UpdateMatrixSource(MatrixSlot_World, shaderKey, shaderHash, baseRegister, rows, transposed, manual,
                        sourceLabel, extractedFromRegister);
 }
 
 static void StoreMVPMatrix(const D3DMATRIX& mvp,
                            uintptr_t shaderKey = 0,
+                           uint32_t shaderHash = 0,
                            int baseRegister = -1,
                            int rows = 4,
                            bool transposed = false,
@@ -411,7 +782,7 @@ static void StoreMVPMatrix(const D3DMATRIX& mvp,
                            int extractedFromRegister = -1) {
     g_cameraMatrices.mvp = mvp;
     g_cameraMatrices.hasMVP = true;
-    UpdateMatrixSource(MatrixSlot_MVP, shaderKey, baseRegister, rows, transposed, manual,
+    UpdateMatrixSource(MatrixSlot_MVP, shaderKey, shaderHash, baseRegister, rows, transposed, manual,
                        sourceLabel, extractedFromRegister);
 }
 
@@ -490,6 +861,9 @@ static void InitializeImGui(IDirect3DDevice9* device, HWND hwnd) {
     }
 
     IMGUI_CHECKVERSION();
+    // ImGui allocates with malloc by default; keep its buffers on the proxy heap too.
+    ImGui::SetAllocatorFunctions([](size_t bytes, void*) { return ProxyHeapAlloc(bytes); },
+                                 [](void* block, void*) { ProxyHeapFree(block); });
     ImGui::CreateContext();
     ImGui::StyleColorsDark();
     ImGuiStyle& style = ImGui::GetStyle();
@@ -582,6 +956,17 @@ static uint32_t HashMatrix(const D3DMATRIX& mat) {
     return HashBytesFNV1a(reinterpret_cast<const uint8_t*>(&mat), sizeof(D3DMATRIX));
 }
 
+static uint32_t GetShaderSlotHash(const ShaderSlot* slot) {
+    if (!slot || slot->key == 0) {
+        return 0;
+    }
+    uint32_t hash = 0;
+    if (TryGetShaderSlotBytecodeHash(slot, &hash)) {
+        return hash;
+    }
+    return HashBytesFNV1a(reinterpret_cast<const uint8_t*>(&slot->key), sizeof(slot->key));
+}
+
 static uint32_t GetShaderHashForKey(uintptr_t shaderKey) {
     if (shaderKey == 0) {
         return 0;
@@ -594,19 +979,17 @@ static uint32_t GetShaderHashForKey(uintptr_t shaderKey) {
 }
 
 static bool IsShaderDisabled(uintptr_t shaderKey) {
-    auto it = g_disabledShaders.find(shaderKey);
-    return it != g_disabledShaders.end() && it->second;
+    const ShaderSlot* slot = FindShaderSlot(shaderKey);
+    return slot && slot->disabled;
 }
 
 static void SetShaderDisabled(uintptr_t shaderKey, bool disabled) {
     if (shaderKey == 0) {
         return;
     }
-    g_disabledShaders[shaderKey] = disabled;
-}
-
-static bool IsCurrentShaderDrawDisabled(IDirect3DVertexShader9* shader) {
-    return IsShaderDisabled(reinterpret_cast<uintptr_t>(shader));
+    if (ShaderSlot* slot = FindShaderSlot(shaderKey)) {
+        slot->disabled = disabled;
+    }
 }
 
 static float GetShaderFlashStrength(const ShaderConstantState* state) {
@@ -636,14 +1019,69 @@ static void BuildShaderComboLabel(uintptr_t shaderKey, char* outLabel, size_t ou
              flash > 0.0f ? " [changed]" : "");
 }
 
-static void RefreshLogSnapshot() {
-    std::lock_guard<std::mutex> lock(g_uiDataMutex);
-    g_logSnapshot.assign(g_logLines.begin(), g_logLines.end());
-    g_logSnapshotDirty = false;
+// Copies one committed ring entry into out. Returns false when the ticket has
+// not been published yet or was overwritten while it was being read.
+static bool ReadLogRingEntry(uint64_t ticket, char* out, size_t outSize) {
+    const LogRingSlot& slot = g_logRing[ticket % kLogRingSlots];
+    const uint64_t expected = ticket * 2 + 2;
+    if (slot.sequence.load(std::memory_order_acquire) != expected) {
+        return false;
+    }
+    const size_t count = (std::min)(outSize, kLogSlotChars);
+    memcpy(out, slot.text, count);
+    out[count - 1] = '\0';
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == expected;
+}
+
+static uint64_t OldestLiveLogTicket(uint64_t endTicket) {
+    return endTicket > kLogRingSlots ? endTicket - kLogRingSlots : 0;
+}
+
+static void RefreshLogView() {
+    g_logViewEndTicket = g_logWriteTicket.load(std::memory_order_acquire);
+}
+
+static void MarkKnownTransformRegisters(int baseRegister, int rows) {
+    if (baseRegister < 0 || rows <= 0) {
+        return;
+    }
+    const int end = (std::min)(baseRegister + rows, kMaxConstantRegisters);
+    for (int reg = baseRegister; reg < end; reg++) {
+        std::atomic<uint32_t>& word = g_knownTransformRegisterMask[reg >> 5];
+        word.store(word.load(std::memory_order_relaxed) | (1u << (reg & 31)), std::memory_order_relaxed);
+    }
+}
+
+static bool RangeTouchesRegister(UINT startRegister, UINT vector4fCount, int baseRegister, int rows) {
+    if (baseRegister < 0) {
+        return false;
+    }
+    const UINT base = static_cast<UINT>(baseRegister);
+    return startRegister < base + static_cast<UINT>(rows) && base < startRegister + vector4fCount;
+}
+
+static bool RangeTouchesKnownTransform(UINT startRegister, UINT vector4fCount) {
+    if (RangeTouchesRegister(startRegister, vector4fCount, g_config.viewMatrixRegister, 4) ||
+        RangeTouchesRegister(startRegister, vector4fCount, g_config.projMatrixRegister, 4) ||
+        RangeTouchesRegister(startRegister, vector4fCount, g_config.worldMatrixRegister, 4)) {
+        return true;
+    }
+    const UINT end = startRegister + vector4fCount;
+    if (end > static_cast<UINT>(kMaxConstantRegisters) || end < startRegister) {
+        return true;
+    }
+    for (UINT reg = startRegister; reg < end; reg++) {
+        if (g_knownTransformRegisterMask[reg >> 5].load(std::memory_order_relaxed) & (1u << (reg & 31))) {
+            return true;
+        }
+    }
+    return false;
 }
 
 static void UpdateMatrixSource(MatrixSlot slot,
                                uintptr_t shaderKey,
+                               uint32_t shaderHash,
                                int baseRegister,
                                int rows,
                                bool transposed,
@@ -654,13 +1092,24 @@ static void UpdateMatrixSource(MatrixSlot slot,
     info.valid = true;
     info.manual = manual;
     info.shaderKey = shaderKey;
-    info.shaderHash = GetShaderHashForKey(shaderKey);
+    // Resolved by the caller: the async worker must never look up shader slots.
+    info.shaderHash = shaderHash;
     info.baseRegister = baseRegister;
     info.rows = rows;
     info.transposed = transposed;
     info.sourceLabel = sourceLabel ? sourceLabel : (manual ? "manual constants selection" : "auto/config detection");
     info.extractedFromRegister = extractedFromRegister >= 0 ? extractedFromRegister : baseRegister;
+    const MatrixSourceInfo& previous = g_matrixSources[slot];
+    if (g_proxyMarkers.enabled &&
+        (!previous.valid || previous.shaderHash != info.shaderHash || previous.baseRegister != info.baseRegister ||
+         previous.sourceLabel != info.sourceLabel)) {
+        ProxyMarkerSourceChanged(MatrixSlotLabel(slot), info.sourceLabel, info.baseRegister, info.shaderHash);
+    }
     g_matrixSources[slot] = info;
+    MarkKnownTransformRegisters(baseRegister, rows);
+    if (info.extractedFromRegister != baseRegister) {
+        MarkKnownTransformRegisters(info.extractedFromRegister, rows);
+    }
 }
 
 static void DrawMatrixSourceInfo(MatrixSlot slot, bool available) {
@@ -738,17 +1187,13 @@ static const char* MatrixSlotLabel(MatrixSlot slot) {
     }
 }
 
+// Overlay edits are queued and written to camera_proxy.ini in one batch by the
+// config watcher thread; the return value only reports that the key was queued.
 static bool SaveConfigRegisterValue(const char* key, int value) {
-    char path[MAX_PATH] = {};
-    GetModuleFileNameA(nullptr, path, MAX_PATH);
-    char* lastSlash = strrchr(path, '\\');
-    if (lastSlash) {
-        strcpy(lastSlash + 1, "camera_proxy.ini");
-    }
-
     char valueBuf[32] = {};
     snprintf(valueBuf, sizeof(valueBuf), "%d", value);
-    return WritePrivateProfileStringA("CameraProxy", key, valueBuf, path) != FALSE;
+    g_configWatcher.QueueWrite(key, valueBuf);
+    return true;
 }
 
 static bool SaveConfigBoolValue(const char* key, bool value) {
@@ -756,16 +1201,71 @@ static bool SaveConfigBoolValue(const char* key, bool value) {
 }
 
 static bool SaveConfigFloatValue(const char* key, float value) {
-    char path[MAX_PATH] = {};
-    GetModuleFileNameA(nullptr, path, MAX_PATH);
-    char* lastSlash = strrchr(path, '\\');
-    if (lastSlash) {
-        strcpy(lastSlash + 1, "camera_proxy.ini");
-    }
-
     char valueBuf[64] = {};
     snprintf(valueBuf, sizeof(valueBuf), "%.7g", value);
-    return WritePrivateProfileStringA("CameraProxy", key, valueBuf, path) != FALSE;
+    g_configWatcher.QueueWrite(key, valueBuf);
+    return true;
+}
+
+// Folds the overlay's per-pass overrides into PassPolicies by viewport size, so
+// the same passes are classified the same way after render targets are recreated.
+static void SaveRenderPassOverrides() {
+    std::vector<PassSizePolicy> policies = g_renderPasses.SizePolicies();
+    int overrides = 0;
+    for (const RenderPassInfo& pass : g_renderPasses.Passes()) {
+        if (pass.overridePolicy == PassPolicy_Auto) {
+            continue;
+        }
+        overrides++;
+        bool replaced = false;
+        for (PassSizePolicy& entry : policies) {
+            if (entry.width == pass.key.viewportWidth && entry.height == pass.key.viewportHeight) {
+                entry.policy = pass.overridePolicy;
+                replaced = true;
+            }
+        }
+        if (!replaced) {
+            policies.push_back({ pass.key.viewportWidth, pass.key.viewportHeight, pass.overridePolicy });
+        }
+    }
+    char text[sizeof(g_config.passPolicies)] = {};
+    size_t length = 0;
+    for (const PassSizePolicy& entry : policies) {
+        const int written = snprintf(text + length, sizeof(text) - length, "%s%ux%u:%s", length > 0 ? ";" : "",
+                                     entry.width, entry.height, PassPolicyLabel(entry.policy));
+        if (written < 0 || static_cast<size_t>(written) >= sizeof(text) - length) {
+            snprintf(g_passStatus, sizeof(g_passStatus), "Too many pass policies to save; PassPolicies unchanged.");
+            return;
+        }
+        length += static_cast<size_t>(written);
+    }
+    memcpy(g_config.passPolicies, text, sizeof(g_config.passPolicies));
+    g_renderPasses.SetSizePolicies(g_config.passPolicies);
+    g_configWatcher.QueueWrite("PassPolicies", g_config.passPolicies);
+    snprintf(g_passStatus, sizeof(g_passStatus), "Saved %d override(s); PassPolicies=%s", overrides,
+             g_config.passPolicies[0] ? g_config.passPolicies : "(empty)");
+}
+
+static void FormatSurfaceFormat(D3DFORMAT format, char* out, size_t outSize) {
+    const uint32_t value = static_cast<uint32_t>(format);
+    if (value > 0xFFu) {
+        // FOURCC formats (NULL, INTZ, ATI2, ...).
+        snprintf(out, outSize, "%c%c%c%c", static_cast<char>(value & 0xFF), static_cast<char>((value >> 8) & 0xFF),
+                 static_cast<char>((value >> 16) & 0xFF), static_cast<char>((value >> 24) & 0xFF));
+        return;
+    }
+    switch (format) {
+        case D3DFMT_UNKNOWN: snprintf(out, outSize, "unknown"); break;
+        case D3DFMT_A8R8G8B8: snprintf(out, outSize, "A8R8G8B8"); break;
+        case D3DFMT_X8R8G8B8: snprintf(out, outSize, "X8R8G8B8"); break;
+        case D3DFMT_A2R10G10B10: snprintf(out, outSize, "A2R10G10B10"); break;
+        case D3DFMT_A16B16G16R16F: snprintf(out, outSize, "A16B16G16R16F"); break;
+        case D3DFMT_A32B32G32R32F: snprintf(out, outSize, "A32B32G32R32F"); break;
+        case D3DFMT_G16R16F: snprintf(out, outSize, "G16R16F"); break;
+        case D3DFMT_R16F: snprintf(out, outSize, "R16F"); break;
+        case D3DFMT_R32F: snprintf(out, outSize, "R32F"); break;
+        default: snprintf(out, outSize, "%u", value); break;
+    }
 }
 
 static bool ConsumeSingleKeyHotkey(HotkeyAction action, int virtualKey) {
@@ -783,6 +1283,7 @@ static void ResetMatrixRegisterOverridesToAuto() {
     g_config.viewMatrixRegister = -1;
     g_config.projMatrixRegister = -1;
     memset(g_manualBindings, 0, sizeof(g_manualBindings));
+    g_layoutCacheDirty = true;
 
     bool savedWorld = SaveConfigRegisterValue("WorldMatrixRegister", -1);
     bool savedView = SaveConfigRegisterValue("ViewMatrixRegister", -1);
@@ -856,17 +1357,21 @@ static void TryAssignManualMatrixFromSelection(MatrixSlot slot,
 
     g_manualBindings[slot].enabled = true;
     g_manualBindings[slot].shaderKey = shaderKey;
+    g_manualBindings[slot].shaderHash = 0;
+    TryGetShaderBytecodeHash(shaderKey, &g_manualBindings[slot].shaderHash);
     g_manualBindings[slot].baseRegister = baseRegister;
     g_manualBindings[slot].rows = rows;
+    g_layoutCacheDirty = true;
 
+    const uint32_t shaderHash = GetShaderHashForKey(shaderKey);
     if (slot == MatrixSlot_World) {
-        StoreWorldMatrix(mat, shaderKey, baseRegister, rows, false, true);
+        StoreWorldMatrix(mat, shaderKey, shaderHash, baseRegister, rows, false, true);
     } else if (slot == MatrixSlot_View) {
-        StoreViewMatrix(mat, shaderKey, baseRegister, rows, false, true);
+        StoreViewMatrix(mat, shaderKey, shaderHash, baseRegister, rows, false, true);
     } else if (slot == MatrixSlot_Projection) {
-        StoreProjectionMatrix(mat, shaderKey, baseRegister, rows, false, true);
+        StoreProjectionMatrix(mat, shaderKey, shaderHash, baseRegister, rows, false, true);
     } else if (slot == MatrixSlot_MVP) {
-        StoreMVPMatrix(mat, shaderKey, baseRegister, rows, false, true);
+        StoreMVPMatrix(mat, shaderKey, shaderHash, baseRegister, rows, false, true);
     }
 
     snprintf(g_matrixAssignStatus, sizeof(g_matrixAssignStatus),
@@ -875,306 +1380,676 @@ static void TryAssignManualMatrixFromSelection(MatrixSlot slot,
              baseRegister + rows - 1, rows);
 }
 
-static D3DMATRIX TransposeMatrix(const D3DMATRIX& mat) {
-    D3DMATRIX out = {};
-    out._11 = mat._11; out._12 = mat._21; out._13 = mat._31; out._14 = mat._41;
-    out._21 = mat._12; out._22 = mat._22; out._23 = mat._32; out._24 = mat._42;
-    out._31 = mat._13; out._32 = mat._23; out._33 = mat._33; out._34 = mat._43;
-    out._41 = mat._14; out._42 = mat._24; out._43 = mat._34; out._44 = mat._44;
-    return out;
-}
-
-static void DrawMatrixWithTranspose(const char* label, const D3DMATRIX& mat, bool available,
-                                    bool transpose) {
-    if (!transpose) {
-        DrawMatrix(label, mat, available);
-        return;
+static void BuildGameDirectoryPath(const char* fileName, char* out, size_t outSize) {
+    char path[MAX_PATH] = {};
+    GetModuleFileNameA(nullptr, path, MAX_PATH);
+    char* lastSlash = strrchr(path, '\\');
+    if (lastSlash) {
+        lastSlash[1] = '\0';
+    } else {
+        path[0] = '\0';
     }
-    D3DMATRIX transposed = TransposeMatrix(mat);
-    DrawMatrix(label, transposed, available);
+    snprintf(out, outSize, "%s%s", path, fileName);
 }
 
-static ShaderConstantState* GetShaderState(uintptr_t shaderKey, bool createIfMissing) {
-    if (shaderKey == 0 && !createIfMissing) {
-        return nullptr;
-    }
-    auto it = g_shaderConstants.find(shaderKey);
-    if (it != g_shaderConstants.end()) {
-        return &it->second;
-    }
-    if (!createIfMissing) {
-        return nullptr;
-    }
-    g_shaderOrder.push_back(shaderKey);
-    auto inserted = g_shaderConstants.emplace(shaderKey, ShaderConstantState{});
-    return &inserted.first->second;
+// Cache files are per executable; the key is the lower-cased exe file name so a
+// game directory copied elsewhere keeps its cache.
+static uint32_t ComputeLayoutCacheModuleHash() {
+    char path[MAX_PATH] = {};
+    GetModuleFileNameA(nullptr, path, MAX_PATH);
+    const char* name = strrchr(path, '\\');
+    name = name ? name + 1 : path;
+    char lowered[MAX_PATH] = {};
+    size_t len = 0;
+    for (; name[len] && len + 1 < sizeof(lowered); len++) {
+        const char c = name[len];
+        lowered[len] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    return HashBytesFNV1a(reinterpret_cast<const uint8_t*>(lowered), len);
 }
 
-
-static uint32_t ComputeShaderBytecodeHash(IDirect3DVertexShader9* shader) {
-    if (!shader) {
-        return 0;
-    }
-    UINT size = 0;
-    if (FAILED(shader->GetFunction(nullptr, &size)) || size == 0) {
-        return 0;
-    }
-    std::vector<uint8_t> data(size);
-    if (FAILED(shader->GetFunction(data.data(), &size)) || size == 0) {
-        return 0;
-    }
-    return HashBytesFNV1a(data.data(), size);
+// Only settings that change which windows classify are part of the key.
+static uint32_t ComputeLayoutCacheSettingsHash() {
+    const ReconstructionConfig& config = GetReconstructionConfig();
+    const float fov[2] = { config.minFOV, config.maxFOV };
+    const uint8_t probes[2] = { static_cast<uint8_t>(config.probeTransposedLayouts ? 1 : 0),
+                                static_cast<uint8_t>(config.probeInverseView ? 1 : 0) };
+    uint8_t bytes[sizeof(fov) + sizeof(probes)] = {};
+    memcpy(bytes, fov, sizeof(fov));
+    memcpy(bytes + sizeof(fov), probes, sizeof(probes));
+    return HashBytesFNV1a(bytes, sizeof(bytes));
 }
 
-static bool TryBuildMatrix4x3FromSnapshot(const ShaderConstantState& state, int baseRegister,
-                                          bool transposed, D3DMATRIX* outMatrix) {
-    if (!outMatrix || !state.snapshotReady || baseRegister < 0 || baseRegister + 2 >= kMaxConstantRegisters) {
+// A seeded window must describe something ScanUploadForMatrices could have
+// produced for that upload range; anything else is a corrupt or foreign entry.
+static bool IsValidCachedLayoutEntry(const LayoutCacheLayoutEntry& entry) {
+    if (entry.windowCount == 0 || entry.windowCount > static_cast<uint32_t>(kMaxLearnedLayoutWindows) ||
+        entry.vector4fCount < 3 || entry.startRegister + entry.vector4fCount > kMaxConstantRegisters) {
         return false;
     }
-    for (int i = 0; i < 3; i++) {
-        if (!state.valid[baseRegister + i]) {
+    for (uint32_t w = 0; w < entry.windowCount; w++) {
+        const LayoutCacheWindow& window = entry.windows[w];
+        if ((window.rows != 3 && window.rows != 4) || window.baseRegister < entry.startRegister ||
+            window.baseRegister + window.rows > entry.startRegister + entry.vector4fCount ||
+            window.orientation > LayoutOrientation_InverseView ||
+            (window.orientation == LayoutOrientation_InverseView && window.rows != 4) ||
+            window.classification < MatrixClass_World || window.classification > MatrixClass_CombinedPerspective) {
             return false;
         }
     }
-
-    D3DMATRIX m = {};
-    if (!transposed) {
-        m._11 = state.constants[baseRegister + 0][0]; m._12 = state.constants[baseRegister + 0][1]; m._13 = state.constants[baseRegister + 0][2]; m._14 = state.constants[baseRegister + 0][3];
-        m._21 = state.constants[baseRegister + 1][0]; m._22 = state.constants[baseRegister + 1][1]; m._23 = state.constants[baseRegister + 1][2]; m._24 = state.constants[baseRegister + 1][3];
-        m._31 = state.constants[baseRegister + 2][0]; m._32 = state.constants[baseRegister + 2][1]; m._33 = state.constants[baseRegister + 2][2]; m._34 = state.constants[baseRegister + 2][3];
-        m._41 = 0.0f; m._42 = 0.0f; m._43 = 0.0f; m._44 = 1.0f;
-    } else {
-        m._11 = state.constants[baseRegister + 0][0]; m._21 = state.constants[baseRegister + 0][1]; m._31 = state.constants[baseRegister + 0][2]; m._41 = state.constants[baseRegister + 0][3];
-        m._12 = state.constants[baseRegister + 1][0]; m._22 = state.constants[baseRegister + 1][1]; m._32 = state.constants[baseRegister + 1][2]; m._42 = state.constants[baseRegister + 1][3];
-        m._13 = state.constants[baseRegister + 2][0]; m._23 = state.constants[baseRegister + 2][1]; m._33 = state.constants[baseRegister + 2][2]; m._43 = state.constants[baseRegister + 2][3];
-        m._14 = 0.0f; m._24 = 0.0f; m._34 = 0.0f; m._44 = 1.0f;
-    }
-    *outMatrix = m;
     return true;
 }
 
-static D3DMATRIX InvertSimpleRigidView(const D3DMATRIX& view) {
-    D3DMATRIX out = {};
-    out._11 = view._11; out._12 = view._21; out._13 = view._31;
-    out._21 = view._12; out._22 = view._22; out._23 = view._32;
-    out._31 = view._13; out._32 = view._23; out._33 = view._33;
-    out._44 = 1.0f;
-    out._41 = -(view._41 * out._11 + view._42 * out._21 + view._43 * out._31);
-    out._42 = -(view._41 * out._12 + view._42 * out._22 + view._43 * out._32);
-    out._43 = -(view._41 * out._13 + view._42 * out._23 + view._43 * out._33);
-    return out;
-}
-
-static const char* GameProfileLabel(GameProfileKind profile) {
-    switch (profile) {
-        case GameProfile_DevilMayCry4: return "DevilMayCry4";
-        case GameProfile_MetalGearRising: return "MetalGearRising";
-        case GameProfile_None:
-        default:
-            return "None";
+// Maps the cache file and pre-seeds locked layouts and pending manual bindings,
+// so the first upload of a known shader validates instead of relearning. Runs
+// once, at the first device creation rather than under the loader lock.
+static void LoadLayoutCache() {
+    static bool loaded = false;
+    if (loaded) {
+        return;
+    }
+    loaded = true;
+    g_layoutCacheModuleHash = ComputeLayoutCacheModuleHash();
+    g_layoutCacheSettingsHash = ComputeLayoutCacheSettingsHash();
+    g_layoutCacheLastSaveTick = GetTickCount();
+    if (!g_config.layoutCacheEnabled) {
+        snprintf(g_layoutCacheStatus, sizeof(g_layoutCacheStatus), "Layout cache disabled (LayoutCacheEnabled=0).");
+        return;
     }
-}
 
-static GameProfileKind ParseGameProfile(const char* profileName) {
-    if (!profileName || profileName[0] == '\0') {
-        return GameProfile_None;
+    char path[MAX_PATH] = {};
+    BuildGameDirectoryPath(g_config.layoutCacheFile, path, sizeof(path));
+    MappedLayoutCache cache;
+    if (!cache.Open(path, g_layoutCacheModuleHash, g_layoutCacheSettingsHash)) {
+        snprintf(g_layoutCacheStatus, sizeof(g_layoutCacheStatus),
+                 "No usable layout cache at %s (missing, other game or changed settings).", g_config.layoutCacheFile);
+        LogMsg("Layout cache: %s", g_layoutCacheStatus);
+        return;
     }
-    if (_stricmp(profileName, "MetalGearRising") == 0 ||
-        _stricmp(profileName, "MGR") == 0 ||
-        _stricmp(profileName, "MetalGearRisingRevengeance") == 0) {
-        return GameProfile_MetalGearRising;
+
+    if (g_layoutLockThreshold > 0) {
+        const LayoutCacheLayoutEntry* layouts = cache.Layouts();
+        for (uint32_t i = 0; i < cache.LayoutCount(); i++) {
+            const LayoutCacheLayoutEntry& entry = layouts[i];
+            if (!IsValidCachedLayoutEntry(entry)) {
+                g_layoutCacheRejectedLayouts++;
+                continue;
+            }
+            LearnedUploadLayout& layout =
+                g_learnedLayouts[LearnedLayoutKey(entry.shaderHash, entry.startRegister, entry.vector4fCount)];
+            layout = LearnedUploadLayout{};
+            layout.windowCount = static_cast<int>(entry.windowCount);
+            for (int w = 0; w < layout.windowCount; w++) {
+                layout.windows[w].baseRegister = entry.windows[w].baseRegister;
+                layout.windows[w].rows = entry.windows[w].rows;
+                layout.windows[w].orientation = static_cast<LayoutOrientation>(entry.windows[w].orientation);
+                layout.windows[w].classification = static_cast<MatrixClassification>(entry.windows[w].classification);
+            }
+            layout.consistentScans = g_layoutLockThreshold;
+            layout.locked = true;
+            layout.stableKey = true;
+            layout.seededFromCache = true;
+            g_layoutCacheLoadedLayouts++;
+        }
     }
-    if (_stricmp(profileName, "DevilMayCry4") == 0 ||
-        _stricmp(profileName, "DMC4") == 0 ||
-        _stricmp(profileName, "DevilMayCry4Original") == 0) {
-        return GameProfile_DevilMayCry4;
+
+    const LayoutCacheBindingEntry* bindings = cache.Bindings();
+    for (uint32_t i = 0; i < cache.BindingCount(); i++) {
+        const LayoutCacheBindingEntry& entry = bindings[i];
+        char reason[256] = {};
+        if (entry.slot >= MatrixSlot_Count || entry.shaderHash == 0 || entry.rows < 3 || entry.rows > 4 ||
+            entry.baseRegister < 0 || entry.baseRegister + entry.rows > kMaxConstantRegisters ||
+            !CanAssignManualMatrix(static_cast<MatrixSlot>(entry.slot), reason, sizeof(reason))) {
+            continue;
+        }
+        ManualMatrixBinding& binding = g_manualBindings[entry.slot];
+        binding.enabled = true;
+        binding.shaderKey = 0;
+        binding.shaderHash = entry.shaderHash;
+        binding.baseRegister = entry.baseRegister;
+        binding.rows = entry.rows;
+        g_layoutCacheLoadedBindings++;
+    }
+
+    snprintf(g_layoutCacheStatus, sizeof(g_layoutCacheStatus),
+             "Loaded %u layouts and %u manual bindings from %s (%u invalid layouts dropped).",
+             g_layoutCacheLoadedLayouts, g_layoutCacheLoadedBindings, g_config.layoutCacheFile,
+             g_layoutCacheRejectedLayouts);
+    LogMsg("Layout cache: %s", g_layoutCacheStatus);
+}
+
+// ConfigFileWatcher::FileJobFn: runs on the watcher thread, or on the caller's
+// thread when there is no watcher.
+static void WriteLayoutCacheJob(const char* path, const std::vector<uint8_t>& bytes) {
+    const bool saved = WriteLayoutCacheBytes(path, bytes);
+    g_layoutCacheWriteState.store(saved ? LayoutCacheWrite_Succeeded : LayoutCacheWrite_Failed,
+                                  std::memory_order_release);
+    if (!saved) {
+        LogMsg("Layout cache: failed to write %s", path);
     }
-    return GameProfile_None;
 }
 
-static void ConfigureActiveProfileLayout() {
-    g_profileLayout = {};
-    if (g_activeGameProfile == GameProfile_MetalGearRising) {
-        g_profileLayout.projectionBase = 4;
-        g_profileLayout.viewProjectionBase = 8;
-        g_profileLayout.viewInverseBase = 12;
-        g_profileLayout.worldBase = 16;
-        g_profileLayout.worldViewBase = 20;
-    } else if (g_activeGameProfile == GameProfile_DevilMayCry4) {
-        // Original DMC4 fixed layout.
-        g_profileLayout.combinedMvpBase = 0;
-        g_profileLayout.worldBase = 0;
-        g_profileLayout.viewInverseBase = 4;
-        g_profileLayout.projectionBase = 8;
-    }
-}
-
-static bool InvertMatrix4x4Deterministic(const D3DMATRIX& in, D3DMATRIX* out, float* outDeterminant = nullptr) {
-    if (!out) {
+// Serializes every locked layout with a bytecode-hash key plus the manual
+// bindings. With background set the file write goes to the config watcher
+// thread; otherwise (device teardown, where the process may exit next) it
+// happens on the calling thread.
+static bool SaveLayoutCache(bool background) {
+    g_layoutCacheLastSaveTick = GetTickCount();
+    g_layoutCacheDirty = false;
+    if (!g_config.layoutCacheEnabled) {
         return false;
     }
 
-    const float* m = reinterpret_cast<const float*>(&in);
-    float inv[16] = {};
-
-    inv[0] = m[5]  * m[10] * m[15] -
-             m[5]  * m[11] * m[14] -
-             m[9]  * m[6]  * m[15] +
-             m[9]  * m[7]  * m[14] +
-             m[13] * m[6]  * m[11] -
-             m[13] * m[7]  * m[10];
-
-    inv[4] = -m[4]  * m[10] * m[15] +
-              m[4]  * m[11] * m[14] +
-              m[8]  * m[6]  * m[15] -
-              m[8]  * m[7]  * m[14] -
-              m[12] * m[6]  * m[11] +
-              m[12] * m[7]  * m[10];
-
-    inv[8] = m[4]  * m[9] * m[15] -
-             m[4]  * m[11] * m[13] -
-             m[8]  * m[5] * m[15] +
-             m[8]  * m[7] * m[13] +
-             m[12] * m[5] * m[11] -
-             m[12] * m[7] * m[9];
-
-    inv[12] = -m[4]  * m[9] * m[14] +
-               m[4]  * m[10] * m[13] +
-               m[8]  * m[5] * m[14] -
-               m[8]  * m[6] * m[13] -
-               m[12] * m[5] * m[10] +
-               m[12] * m[6] * m[9];
-
-    inv[1] = -m[1]  * m[10] * m[15] +
-              m[1]  * m[11] * m[14] +
-              m[9]  * m[2] * m[15] -
-              m[9]  * m[3] * m[14] -
-              m[13] * m[2] * m[11] +
-              m[13] * m[3] * m[10];
-
-    inv[5] = m[0]  * m[10] * m[15] -
-             m[0]  * m[11] * m[14] -
-             m[8]  * m[2] * m[15] +
-             m[8]  * m[3] * m[14] +
-             m[12] * m[2] * m[11] -
-             m[12] * m[3] * m[10];
-
-    inv[9] = -m[0]  * m[9] * m[15] +
-              m[0]  * m[11] * m[13] +
-              m[8]  * m[1] * m[15] -
-              m[8]  * m[3] * m[13] -
-              m[12] * m[1] * m[11] +
-              m[12] * m[3] * m[9];
-
-    inv[13] = m[0]  * m[9] * m[14] -
-              m[0]  * m[10] * m[13] -
-              m[8]  * m[1] * m[14] +
-              m[8]  * m[2] * m[13] +
-              m[12] * m[1] * m[10] -
-              m[12] * m[2] * m[9];
-
-    inv[2] = m[1]  * m[6] * m[15] -
-             m[1]  * m[7] * m[14] -
-             m[5]  * m[2] * m[15] +
-             m[5]  * m[3] * m[14] +
-             m[13] * m[2] * m[7] -
-             m[13] * m[3] * m[6];
-
-    inv[6] = -m[0]  * m[6] * m[15] +
-              m[0]  * m[7] * m[14] +
-              m[4]  * m[2] * m[15] -
-              m[4]  * m[3] * m[14] -
-              m[12] * m[2] * m[7] +
-              m[12] * m[3] * m[6];
-
-    inv[10] = m[0]  * m[5] * m[15] -
-              m[0]  * m[7] * m[13] -
-              m[4]  * m[1] * m[15] +
-              m[4]  * m[3] * m[13] +
-              m[12] * m[1] * m[7] -
-              m[12] * m[3] * m[5];
-
-    inv[14] = -m[0]  * m[5] * m[14] +
-               m[0]  * m[6] * m[13] +
-               m[4]  * m[1] * m[14] -
-               m[4]  * m[2] * m[13] -
-               m[12] * m[1] * m[6] +
-               m[12] * m[2] * m[5];
-
-    inv[3] = -m[1] * m[6] * m[11] +
-              m[1] * m[7] * m[10] +
-              m[5] * m[2] * m[11] -
-              m[5] * m[3] * m[10] -
-              m[9] * m[2] * m[7] +
-              m[9] * m[3] * m[6];
-
-    inv[7] = m[0] * m[6] * m[11] -
-             m[0] * m[7] * m[10] -
-             m[4] * m[2] * m[11] +
-             m[4] * m[3] * m[10] +
-             m[8] * m[2] * m[7] -
-             m[8] * m[3] * m[6];
-
-    inv[11] = -m[0] * m[5] * m[11] +
-               m[0] * m[7] * m[9] +
-               m[4] * m[1] * m[11] -
-               m[4] * m[3] * m[9] -
-               m[8] * m[1] * m[7] +
-               m[8] * m[3] * m[5];
-
-    inv[15] = m[0] * m[5] * m[10] -
-              m[0] * m[6] * m[9] -
-              m[4] * m[1] * m[10] +
-              m[4] * m[2] * m[9] +
-              m[8] * m[1] * m[6] -
-              m[8] * m[2] * m[5];
-
-    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
-    if (outDeterminant) {
-        *outDeterminant = det;
-    }
-    if (fabsf(det) <= 1e-8f) {
-        return false;
+    std::vector<LayoutCacheLayoutEntry> layouts;
+    for (const auto& item : g_learnedLayouts) {
+        const LearnedUploadLayout& layout = item.second;
+        if (!layout.locked || !layout.stableKey || layout.windowCount <= 0) {
+            continue;
+        }
+        LayoutCacheLayoutEntry entry = {};
+        entry.shaderHash = static_cast<uint32_t>(item.first >> 32);
+        entry.startRegister = static_cast<uint16_t>((item.first >> 16) & 0xFFFFu);
+        entry.vector4fCount = static_cast<uint16_t>(item.first & 0xFFFFu);
+        entry.windowCount = static_cast<uint32_t>(layout.windowCount);
+        for (int w = 0; w < layout.windowCount; w++) {
+            entry.windows[w].baseRegister = static_cast<uint8_t>(layout.windows[w].baseRegister);
+            entry.windows[w].rows = static_cast<uint8_t>(layout.windows[w].rows);
+            entry.windows[w].orientation = static_cast<uint8_t>(layout.windows[w].orientation);
+            entry.windows[w].classification = static_cast<uint8_t>(layout.windows[w].classification);
+        }
+        layouts.push_back(entry);
     }
 
-    const float detInv = 1.0f / det;
-    float* dst = reinterpret_cast<float*>(out);
-    for (int i = 0; i < 16; i++) {
-        dst[i] = inv[i] * detInv;
+    std::vector<LayoutCacheBindingEntry> bindings;
+    for (int slot = 0; slot < MatrixSlot_Count; slot++) {
+        const ManualMatrixBinding& binding = g_manualBindings[slot];
+        if (!binding.enabled || binding.shaderHash == 0) {
+            continue;
+        }
+        LayoutCacheBindingEntry entry = {};
+        entry.slot = static_cast<uint32_t>(slot);
+        entry.shaderHash = binding.shaderHash;
+        entry.baseRegister = binding.baseRegister;
+        entry.rows = binding.rows;
+        bindings.push_back(entry);
     }
-    return true;
-}
 
-static void ClearAllShaderOverrides() {
-    for (auto& entry : g_shaderConstants) {
-        ShaderConstantState& state = entry.second;
-        memset(state.overrideConstants, 0, sizeof(state.overrideConstants));
-        memset(state.overrideValid, 0, sizeof(state.overrideValid));
-        memset(state.overrideFramesRemaining, 0, sizeof(state.overrideFramesRemaining));
+    char path[MAX_PATH] = {};
+    BuildGameDirectoryPath(g_config.layoutCacheFile, path, sizeof(path));
+    std::vector<uint8_t> bytes = SerializeLayoutCache(g_layoutCacheModuleHash, g_layoutCacheSettingsHash, layouts, bindings);
+    snprintf(g_layoutCacheStatus, sizeof(g_layoutCacheStatus), "Saving %d layouts and %d manual bindings to %s.",
+             static_cast<int>(layouts.size()), static_cast<int>(bindings.size()), g_config.layoutCacheFile);
+    g_layoutCacheWriteState.store(LayoutCacheWrite_Pending, std::memory_order_release);
+    if (!background || !g_configWatcher.QueueFileJob(path, bytes, WriteLayoutCacheJob)) {
+        WriteLayoutCacheJob(path, bytes);
+        return g_layoutCacheWriteState.load(std::memory_order_acquire) == LayoutCacheWrite_Succeeded;
     }
+    return true;
 }
 
-static void ClearShaderRegisterOverride(uintptr_t shaderKey, int reg) {
-    if (reg < 0 || reg >= kMaxConstantRegisters) {
+static void DrawMatrixWithTranspose(const char* label, const D3DMATRIX& mat, bool available,
+                                    bool transpose) {
+    if (!transpose) {
+        DrawMatrix(label, mat, available);
+        return;
+    }
+    D3DMATRIX transposed = TransposeMatrix(mat);
+    DrawMatrix(label, transposed, available);
+}
+
+static ShaderConstantState* GetShaderState(uintptr_t shaderKey, bool createIfMissing) {
+    if (shaderKey == 0 && !createIfMissing) {
+        return nullptr;
+    }
+    ShaderSlot* slot = createIfMissing ? AcquireShaderSlot(shaderKey) : FindShaderSlot(shaderKey);
+    return slot ? &slot->state : nullptr;
+}
+
+// Constant blocks come in power-of-two register counts (16..256) carved from
+// 64 KB slabs. Blocks released on growth are recycled through per-class free lists.
+static constexpr int kConstantBlockMinRegisters = 16;
+static constexpr int kConstantBlockClassCount = 5;
+static constexpr size_t kConstantSlabFloats = 16 * 1024;
+static std::vector<float*> g_constantBlockFreeLists[kConstantBlockClassCount] = {};
+static float* g_constantSlabCursor = nullptr;
+static size_t g_constantSlabRemaining = 0;
+static size_t g_constantPoolBytes = 0;
+
+static int ConstantBlockClass(int registers) {
+    int cls = 0;
+    int classRegisters = kConstantBlockMinRegisters;
+    while (classRegisters < registers && cls + 1 < kConstantBlockClassCount) {
+        classRegisters <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+static float* AllocateConstantBlock(int cls) {
+    std::vector<float*>& freeList = g_constantBlockFreeLists[cls];
+    if (!freeList.empty()) {
+        float* block = freeList.back();
+        freeList.pop_back();
+        return block;
+    }
+    const size_t floats = static_cast<size_t>(kConstantBlockMinRegisters << cls) * 4;
+    if (g_constantSlabRemaining < floats) {
+        g_constantSlabCursor = new float[kConstantSlabFloats];
+        g_constantSlabRemaining = kConstantSlabFloats;
+        g_constantPoolBytes += kConstantSlabFloats * sizeof(float);
+    }
+    float* block = g_constantSlabCursor;
+    g_constantSlabCursor += floats;
+    g_constantSlabRemaining -= floats;
+    return block;
+}
+
+static void EnsureConstantCapacity(ShaderConstantState& state, int registerEnd) {
+    if (registerEnd <= state.capacity) {
+        return;
+    }
+    const int cls = ConstantBlockClass(registerEnd);
+    const int newCapacity = kConstantBlockMinRegisters << cls;
+    float* block = AllocateConstantBlock(cls);
+    memset(block, 0, static_cast<size_t>(newCapacity) * 4 * sizeof(float));
+    if (state.constants) {
+        memcpy(block, state.constants, static_cast<size_t>(state.capacity) * 4 * sizeof(float));
+        g_constantBlockFreeLists[ConstantBlockClass(state.capacity)].push_back(&state.constants[0][0]);
+    }
+    state.constants = reinterpret_cast<float(*)[4]>(block);
+    state.capacity = newCapacity;
+    state.changeSerials.resize(static_cast<size_t>(newCapacity), 0);
+}
+
+static ShaderConstantOverrides* EnsureShaderOverrides(ShaderConstantState& state) {
+    if (!state.overrides) {
+        state.overrides = new ShaderConstantOverrides();
+    }
+    return state.overrides;
+}
+
+static ShaderConstantVariance* EnsureShaderVariance(ShaderConstantState& state) {
+    if (!state.variance) {
+        state.variance = new ShaderConstantVariance();
+    }
+    return state.variance;
+}
+
+// Called from the final Release of a wrapped shader. Returns the constant block to
+// its free list and forgets the address, so a shader later created at the same
+// address starts clean. Bindings restored by hash wait for the next matching shader.
+static void ReleaseShaderSlot(ShaderSlot* slot) {
+    if (!slot || !slot->inUse || slot == NullShaderSlot()) {
+        return;
+    }
+    const uintptr_t key = slot->key;
+    auto it = g_shaderSlotIndex.find(key);
+    if (it == g_shaderSlotIndex.end()) {
+        return;
+    }
+    const uint32_t index = it->second;
+    g_shaderSlotIndex.erase(it);
+    ShaderConstantState& state = slot->state;
+    if (state.constants) {
+        g_constantBlockFreeLists[ConstantBlockClass(state.capacity)].push_back(&state.constants[0][0]);
+    }
+    delete state.overrides;
+    delete state.variance;
+    *slot = ShaderSlot{};
+    g_freeShaderSlots.push_back(index);
+
+    g_shaderOrder.erase(std::remove(g_shaderOrder.begin(), g_shaderOrder.end(), key), g_shaderOrder.end());
+    g_shaderOrderGeneration++;
+    if (g_selectedShaderKey == key) {
+        g_selectedShaderKey = 0;
+        g_selectedRegister = -1;
+    }
+    if (g_activeShaderKey == key) {
+        g_activeShaderKey = 0;
+    }
+    for (ManualMatrixBinding& binding : g_manualBindings) {
+        if (binding.enabled && binding.shaderKey == key) {
+            binding.shaderKey = 0;
+            binding.enabled = binding.shaderHash != 0;
+        }
+    }
+    g_traceWriter.ForgetShader(key);
+}
+
+
+static constexpr size_t kMaxShaderBytecodeTokens = 1u << 18;
+
+// Returns the bytecode length in bytes, including the end token, or 0 if the
+// token stream is malformed. SM2+ instructions carry their length; SM1 operand
+// tokens always have bit 31 set, so the end token cannot be mistaken for one.
+static size_t MeasureShaderBytecodeSize(const DWORD* function) {
+    if (!function) {
+        return 0;
+    }
+    const bool hasInstructionLength = D3DSHADER_VERSION_MAJOR(function[0]) >= 2;
+    size_t i = 1;
+    while (i < kMaxShaderBytecodeTokens) {
+        const DWORD token = function[i];
+        if (token == D3DSIO_END) {
+            return (i + 1) * sizeof(DWORD);
+        }
+        if ((token & D3DSI_OPCODE_MASK) == D3DSIO_COMMENT && !(token & 0x80000000u)) {
+            i += 1 + ((token & D3DSI_COMMENTSIZE_MASK) >> D3DSI_COMMENTSIZE_SHIFT);
+        } else if (hasInstructionLength && !(token & 0x80000000u)) {
+            i += 1 + ((token & D3DSI_INSTLENGTH_MASK) >> D3DSI_INSTLENGTH_SHIFT);
+        } else {
+            i++;
+        }
+    }
+    return 0;
+}
+
+// Mirrors D3DXSHADER_CONSTANTTABLE / D3DXSHADER_CONSTANTINFO without pulling in d3dx9.
+struct ShaderCtabHeader {
+    DWORD size;
+    DWORD creator;
+    DWORD version;
+    DWORD constants;
+    DWORD constantInfo;
+    DWORD flags;
+    DWORD target;
+};
+
+struct ShaderCtabConstantInfo {
+    DWORD name;
+    WORD registerSet;
+    WORD registerIndex;
+    WORD registerCount;
+    WORD reserved;
+    DWORD typeInfo;
+    DWORD defaultValue;
+};
+
+static constexpr WORD kCtabRegisterSetFloat4 = 2;
+
+static void ParseShaderConstantTable(const uint8_t* blob, size_t blobSize, VertexShaderRecord* record) {
+    if (!blob || !record || blobSize < sizeof(ShaderCtabHeader)) {
+        return;
+    }
+    ShaderCtabHeader header = {};
+    memcpy(&header, blob, sizeof(header));
+    if (header.constantInfo > blobSize ||
+        header.constants > (blobSize - header.constantInfo) / sizeof(ShaderCtabConstantInfo)) {
+        return;
+    }
+    for (DWORD c = 0; c < header.constants; c++) {
+        ShaderCtabConstantInfo info = {};
+        memcpy(&info, blob + header.constantInfo + c * sizeof(ShaderCtabConstantInfo), sizeof(info));
+        if (info.registerSet != kCtabRegisterSetFloat4 || info.registerCount == 0) {
+            continue;
+        }
+        ShaderConstantTableEntry entry = {};
+        entry.registerIndex = info.registerIndex;
+        entry.registerCount = info.registerCount;
+        if (info.name < blobSize) {
+            const char* name = reinterpret_cast<const char*>(blob + info.name);
+            size_t maxLen = (std::min)(blobSize - info.name, sizeof(entry.name) - 1);
+            size_t len = 0;
+            while (len < maxLen && name[len] != '\0') {
+                len++;
+            }
+            memcpy(entry.name, name, len);
+        }
+        record->maxConstantRegister = (std::max)(record->maxConstantRegister,
+                                                 entry.registerIndex + entry.registerCount - 1);
+        record->constantTable.push_back(entry);
+    }
+}
+
+static bool BuildVertexShaderRecord(const DWORD* function, size_t sizeBytes, VertexShaderRecord* out) {
+    if (!function || !out || sizeBytes < 2 * sizeof(DWORD)) {
+        return false;
+    }
+    VertexShaderRecord record = {};
+    record.bytecodeSize = static_cast<uint32_t>(sizeBytes);
+    record.bytecodeHash = HashBytesFNV1a(reinterpret_cast<const uint8_t*>(function), sizeBytes);
+    record.shaderVersion = function[0];
+
+    const size_t tokenCount = sizeBytes / sizeof(DWORD);
+    for (size_t i = 1; i < tokenCount; i++) {
+        const DWORD token = function[i];
+        if ((token & D3DSI_OPCODE_MASK) != D3DSIO_COMMENT || (token & 0x80000000u)) {
+            continue;
+        }
+        const size_t commentTokens = (token & D3DSI_COMMENTSIZE_MASK) >> D3DSI_COMMENTSIZE_SHIFT;
+        if (commentTokens >= 1 && i + commentTokens < tokenCount &&
+            function[i + 1] == MAKEFOURCC('C', 'T', 'A', 'B')) {
+            ParseShaderConstantTable(reinterpret_cast<const uint8_t*>(function + i + 2),
+                                     (commentTokens - 1) * sizeof(DWORD), &record);
+            break;
+        }
+        i += commentTokens;
+    }
+
+    *out = std::move(record);
+    return true;
+}
+
+static void ApplyScreenSpaceListFlag(ShaderSlot* slot) {
+    uint32_t hash = 0;
+    if (!TryGetShaderSlotBytecodeHash(slot, &hash)) {
+        return;
+    }
+    const bool listed = std::find(g_screenSpaceShaderHashes.begin(), g_screenSpaceShaderHashes.end(), hash) !=
+                        g_screenSpaceShaderHashes.end();
+    slot->screenSpace = static_cast<uint8_t>(listed ? (slot->screenSpace | ScreenSpace_Listed)
+                                                    : (slot->screenSpace & ~ScreenSpace_Listed));
+}
+
+// Parses ScreenSpaceShaders ("0x1234ABCD,0x..." bytecode hashes) and re-flags
+// every live shader.
+static void ApplyScreenSpaceShaderList() {
+    g_screenSpaceShaderHashes.clear();
+    char buffer[sizeof(g_config.screenSpaceShaders)];
+    snprintf(buffer, sizeof(buffer), "%s", g_config.screenSpaceShaders);
+    char* context = nullptr;
+    for (char* entry = strtok_s(buffer, ",; ", &context); entry; entry = strtok_s(nullptr, ",; ", &context)) {
+        char* end = nullptr;
+        const unsigned long hash = strtoul(entry, &end, 16);
+        if (end != entry && hash != 0) {
+            g_screenSpaceShaderHashes.push_back(static_cast<uint32_t>(hash));
+        }
+    }
+    for (ShaderSlot& slot : g_shaderSlots) {
+        if (slot.inUse) {
+            ApplyScreenSpaceListFlag(&slot);
+        }
+    }
+}
+
+// Overlay toggle; shaders with a bytecode hash are also written to ScreenSpaceShaders.
+static void SetShaderScreenSpaceListed(uintptr_t shaderKey, bool listed) {
+    ShaderSlot* slot = shaderKey != 0 ? FindShaderSlot(shaderKey) : nullptr;
+    if (!slot) {
+        return;
+    }
+    slot->screenSpace = static_cast<uint8_t>(listed ? (slot->screenSpace | ScreenSpace_Listed)
+                                                    : (slot->screenSpace & ~ScreenSpace_Listed));
+    uint32_t hash = 0;
+    if (!TryGetShaderSlotBytecodeHash(slot, &hash)) {
+        return;
+    }
+    g_screenSpaceShaderHashes.erase(std::remove(g_screenSpaceShaderHashes.begin(), g_screenSpaceShaderHashes.end(), hash),
+                                    g_screenSpaceShaderHashes.end());
+    if (listed) {
+        g_screenSpaceShaderHashes.push_back(hash);
+    }
+    char text[sizeof(g_config.screenSpaceShaders)] = {};
+    size_t length = 0;
+    for (uint32_t listedHash : g_screenSpaceShaderHashes) {
+        if (length + 12 >= sizeof(text)) {
+            break;
+        }
+        length += static_cast<size_t>(snprintf(text + length, sizeof(text) - length, "%s0x%08X",
+                                                length > 0 ? "," : "", listedHash));
+    }
+    memcpy(g_config.screenSpaceShaders, text, sizeof(g_config.screenSpaceShaders));
+    g_configWatcher.QueueWrite("ScreenSpaceShaders", g_config.screenSpaceShaders);
+}
+
+// A 2D projection mapping pixel coordinates to clip space: x/y scales of at most
+// 2/64 with no shear, x/y translation of about -1/+1, and no perspective term.
+// Four registers, in either the row or the transposed layout. World matrices
+// this small that also sit at the clip-space corner are not expected.
+static bool LooksLikePixelOrthographic(const float* m) {
+    const bool rowLayout = m[3] == 0.0f && m[7] == 0.0f && m[11] == 0.0f && m[15] == 1.0f;
+    const bool columnLayout = m[12] == 0.0f && m[13] == 0.0f && m[14] == 0.0f && m[15] == 1.0f;
+    if (!rowLayout && !columnLayout) {
+        return false;
+    }
+    const float sx = std::fabs(m[0]);
+    const float sy = std::fabs(m[5]);
+    const float kMaxScale = 2.0f / 64.0f;
+    if (sx <= 1e-6f || sy <= 1e-6f || sx > kMaxScale || sy > kMaxScale) {
+        return false;
+    }
+    if (std::fabs(m[1]) > 1e-6f || std::fabs(m[4]) > 1e-6f) {
+        return false;
+    }
+    const float tx = std::fabs(rowLayout ? m[12] : m[3]);
+    const float ty = std::fabs(rowLayout ? m[13] : m[7]);
+    return tx > 0.9f && tx < 1.1f && ty > 0.9f && ty < 1.1f;
+}
+
+// Checks the first few uploads of a shader for a pixel-space orthographic matrix
+// and flags the shader as screen-space when one is found.
+static void ProbeScreenSpaceOrtho(ShaderSlot* slot, UINT startRegister, UINT vector4fCount, const float* data) {
+    slot->orthoProbeUploads--;
+    if (!data || vector4fCount < 4) {
+        return;
+    }
+    for (UINT base = 0; base + 4 <= vector4fCount; base++) {
+        if (LooksLikePixelOrthographic(data + base * 4)) {
+            slot->screenSpace |= ScreenSpace_Ortho;
+            slot->orthoProbeUploads = 0;
+            LogMsg("Shader 0x%p: pixel-space orthographic matrix at c%u; treating its draws as screen-space.",
+                   reinterpret_cast<void*>(slot->key), startRegister + base);
+            return;
+        }
+    }
+}
+
+static bool IsPretransformedDeclaration(const D3DVERTEXELEMENT9* elements) {
+    for (const D3DVERTEXELEMENT9* element = elements; element && element->Stream != 0xFF; ++element) {
+        if (element->Usage == D3DDECLUSAGE_POSITIONT) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Only for declarations not created through the wrapped device, which carry no
+// cached flag (see WrappedD3D9VertexDeclaration).
+static bool ReadPretransformedDeclaration(IDirect3DVertexDeclaration9* decl) {
+    if (!decl) {
+        return false;
+    }
+    UINT count = 0;
+    if (SUCCEEDED(decl->GetDeclaration(nullptr, &count)) && count > 0) {
+        std::vector<D3DVERTEXELEMENT9> elements(count);
+        if (SUCCEEDED(decl->GetDeclaration(elements.data(), &count))) {
+            return IsPretransformedDeclaration(elements.data());
+        }
+    }
+    return false;
+}
+
+static void RegisterVertexShader(ShaderSlot* slot, const DWORD* function) {
+    if (!slot) {
+        return;
+    }
+    VertexShaderRecord record = {};
+    if (!BuildVertexShaderRecord(function, MeasureShaderBytecodeSize(function), &record)) {
+        return;
+    }
+    slot->record = std::move(record);
+    slot->hasRecord = true;
+    ApplyScreenSpaceListFlag(slot);
+}
+
+// Slow path for shaders whose bytecode was not seen at creation (e.g. created
+// before the device was wrapped, or replayed). Runs once per shader.
+static void RegisterVertexShaderFromRuntime(ShaderSlot* slot, IDirect3DVertexShader9* shader) {
+    if (!slot || !shader) {
+        return;
+    }
+    slot->hasRecord = true;
+    UINT size = 0;
+    if (FAILED(shader->GetFunction(nullptr, &size)) || size == 0) {
+        return;
+    }
+    std::vector<DWORD> data((size + sizeof(DWORD) - 1) / sizeof(DWORD));
+    if (FAILED(shader->GetFunction(data.data(), &size)) || size == 0) {
+        return;
+    }
+    BuildVertexShaderRecord(data.data(), size, &slot->record);
+    ApplyScreenSpaceListFlag(slot);
+}
+
+static bool TryBuildMatrix4x3FromSnapshot(const ShaderConstantState& state, int baseRegister,
+                                          bool transposed, D3DMATRIX* outMatrix) {
+    if (!outMatrix || !IsSnapshotReady(state) || baseRegister < 0 || baseRegister + 2 >= kMaxConstantRegisters) {
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (!IsConstantValid(state, baseRegister + i)) {
+            return false;
+        }
+    }
+
+    D3DMATRIX m = {};
+    if (!transposed) {
+        m._11 = state.constants[baseRegister + 0][0]; m._12 = state.constants[baseRegister + 0][1]; m._13 = state.constants[baseRegister + 0][2]; m._14 = state.constants[baseRegister + 0][3];
+        m._21 = state.constants[baseRegister + 1][0]; m._22 = state.constants[baseRegister + 1][1]; m._23 = state.constants[baseRegister + 1][2]; m._24 = state.constants[baseRegister + 1][3];
+        m._31 = state.constants[baseRegister + 2][0]; m._32 = state.constants[baseRegister + 2][1]; m._33 = state.constants[baseRegister + 2][2]; m._34 = state.constants[baseRegister + 2][3];
+        m._41 = 0.0f; m._42 = 0.0f; m._43 = 0.0f; m._44 = 1.0f;
+    } else {
+        m._11 = state.constants[baseRegister + 0][0]; m._21 = state.constants[baseRegister + 0][1]; m._31 = state.constants[baseRegister + 0][2]; m._41 = state.constants[baseRegister + 0][3];
+        m._12 = state.constants[baseRegister + 1][0]; m._22 = state.constants[baseRegister + 1][1]; m._32 = state.constants[baseRegister + 1][2]; m._42 = state.constants[baseRegister + 1][3];
+        m._13 = state.constants[baseRegister + 2][0]; m._23 = state.constants[baseRegister + 2][1]; m._33 = state.constants[baseRegister + 2][2]; m._43 = state.constants[baseRegister + 2][3];
+        m._14 = 0.0f; m._24 = 0.0f; m._34 = 0.0f; m._44 = 1.0f;
+    }
+    *outMatrix = m;
+    return true;
+}
+
+static void ClearAllShaderOverrides() {
+    for (ShaderSlot& slot : g_shaderSlots) {
+        delete slot.state.overrides;
+        slot.state.overrides = nullptr;
+    }
+}
+
+static void ClearShaderRegisterOverride(uintptr_t shaderKey, int reg) {
+    if (reg < 0 || reg >= kMaxConstantRegisters) {
         return;
     }
     ShaderConstantState* state = GetShaderState(shaderKey, false);
-    if (!state) {
+    if (!state || !state->overrides) {
         return;
     }
-    memset(state->overrideConstants[reg], 0, sizeof(state->overrideConstants[reg]));
-    state->overrideValid[reg] = false;
-    state->overrideFramesRemaining[reg] = 0;
+    ShaderConstantOverrides& overrides = *state->overrides;
+    memset(overrides.constants[reg], 0, sizeof(overrides.constants[reg]));
+    overrides.valid[reg] = false;
+    overrides.framesRemaining[reg] = 0;
 }
 
 static bool BuildOverriddenConstants(ShaderConstantState& state,
                                      UINT startRegister,
                                      UINT vector4fCount,
                                      const float* sourceData,
-                                     std::vector<float>& scratch) {
-    if (!g_enableShaderEditing || !sourceData || vector4fCount == 0) {
+                                     float* scratch,
+                                     size_t scratchFloats) {
+    if (!g_enableShaderEditing || !state.overrides || !sourceData || !scratch || vector4fCount == 0 ||
+        static_cast<size_t>(vector4fCount) * 4 > scratchFloats) {
         return false;
     }
+    ShaderConstantOverrides& overrides = *state.overrides;
 
     bool hasOverride = false;
     for (UINT i = 0; i < vector4fCount; i++) {
@@ -1182,7 +2057,7 @@ static bool BuildOverriddenConstants(ShaderConstantState& state,
         if (reg >= kMaxConstantRegisters) {
             break;
         }
-        if (state.overrideValid[reg]) {
+        if (overrides.valid[reg]) {
             hasOverride = true;
             break;
         }
@@ -1191,109 +2066,107 @@ static bool BuildOverriddenConstants(ShaderConstantState& state,
         return false;
     }
 
-    scratch.assign(sourceData, sourceData + vector4fCount * 4);
+    memcpy(scratch, sourceData, static_cast<size_t>(vector4fCount) * 4 * sizeof(float));
     for (UINT i = 0; i < vector4fCount; i++) {
         UINT reg = startRegister + i;
         if (reg >= kMaxConstantRegisters) {
             break;
         }
-        if (!state.overrideValid[reg]) {
+        if (!overrides.valid[reg]) {
             continue;
         }
 
-        memcpy(&scratch[i * 4], state.overrideConstants[reg], sizeof(state.overrideConstants[reg]));
+        memcpy(&scratch[i * 4], overrides.constants[reg], sizeof(overrides.constants[reg]));
 
-        if (state.overrideFramesRemaining[reg] > 0) {
-            state.overrideFramesRemaining[reg]--;
-            if (state.overrideFramesRemaining[reg] == 0) {
-                state.overrideValid[reg] = false;
+        if (overrides.framesRemaining[reg] > 0) {
+            overrides.framesRemaining[reg]--;
+            if (overrides.framesRemaining[reg] == 0) {
+                overrides.valid[reg] = false;
             }
         }
     }
     return true;
 }
 
-static void UpdateVariance(ShaderConstantState& state, int reg, const float* values) {
-    state.sampleCount++;
+// True when every register in the upload is already cached with identical contents.
+static bool ConstantRangeMatchesCache(const ShaderConstantState& state,
+                                      UINT startRegister,
+                                      UINT vector4fCount,
+                                      const float* data) {
+    if (!data || vector4fCount == 0 ||
+        startRegister + vector4fCount > static_cast<UINT>(kMaxConstantRegisters)) {
+        return false;
+    }
+    for (UINT i = 0; i < vector4fCount; i++) {
+        if (!IsConstantValid(state, static_cast<int>(startRegister + i))) {
+            return false;
+        }
+    }
+    return memcmp(state.constants[startRegister], data, vector4fCount * sizeof(state.constants[0])) == 0;
+}
+
+// Stores registers [startRegister, uploadEnd) of an upload, comparing each one
+// bitwise against the cached value first (one SSE2 compare per register).
+// Registers never written before or holding different bits get their change
+// serial set to serial; the classifier turns serials newer than its last scan of
+// the range into a changed-register mask. Returns true when any register changed.
+static bool MergeConstantRegisters(ShaderConstantState& state,
+                                   UINT startRegister,
+                                   UINT uploadEnd,
+                                   const float* data,
+                                   unsigned long long serial) {
+    uint32_t anyChanged = 0;
+    for (UINT reg = startRegister; reg < uploadEnd; reg++) {
+        const __m128i incoming = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + (reg - startRegister) * 4));
+        const __m128i cached = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state.constants[reg]));
+        const uint32_t bit = 1u << (reg & 31);
+        uint32_t& validWord = state.validMask[reg >> 5];
+        if ((validWord & bit) && _mm_movemask_epi8(_mm_cmpeq_epi32(incoming, cached)) == 0xFFFF) {
+            continue;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state.constants[reg]), incoming);
+        validWord |= bit;
+        state.changeSerials[reg] = serial;
+        anyChanged = 1;
+    }
+    return anyChanged != 0;
+}
+
+static void UpdateVariance(ShaderConstantVariance& variance, int reg, const float* values) {
+    variance.sampleCount++;
     for (int i = 0; i < 4; i++) {
         double value = static_cast<double>(values[i]);
-        double delta = value - state.mean[reg][i];
-        state.mean[reg][i] += delta / static_cast<double>(state.sampleCount);
-        double delta2 = value - state.mean[reg][i];
-        state.m2[reg][i] += delta * delta2;
+        double delta = value - variance.mean[reg][i];
+        variance.mean[reg][i] += delta / static_cast<double>(variance.sampleCount);
+        double delta2 = value - variance.mean[reg][i];
+        variance.m2[reg][i] += delta * delta2;
     }
 }
 
-static float GetVarianceMagnitude(const ShaderConstantState& state, int reg) {
-    if (state.sampleCount < 2) {
+static float GetVarianceMagnitude(const ShaderConstantVariance& variance, int reg) {
+    if (variance.sampleCount < 2) {
         return 0.0f;
     }
     double sum = 0.0;
     for (int i = 0; i < 4; i++) {
-        sum += state.m2[reg][i] / static_cast<double>(state.sampleCount - 1);
+        sum += variance.m2[reg][i] / static_cast<double>(variance.sampleCount - 1);
     }
     return static_cast<float>(sum / 4.0);
 }
 
 
-static bool TryBuildMatrixFromConstantUpdate(const float* constantData,
-                                             UINT startRegister,
-                                             UINT vector4fCount,
-                                             int baseRegister,
-                                             int rows,
-                                             bool transposed,
-                                             D3DMATRIX* outMatrix) {
-    if (!constantData || !outMatrix || rows < 3 || rows > 4) {
-        return false;
-    }
-    if (baseRegister < 0) {
-        return false;
-    }
-    if (startRegister > static_cast<UINT>(baseRegister) ||
-        startRegister + vector4fCount < static_cast<UINT>(baseRegister + rows)) {
-        return false;
-    }
-
-    int offset = (baseRegister - static_cast<int>(startRegister)) * 4;
-    const float* m = constantData + offset;
-    D3DMATRIX out = {};
-
-    if (!transposed) {
-        out._11 = m[0]; out._12 = m[1]; out._13 = m[2]; out._14 = m[3];
-        out._21 = m[4]; out._22 = m[5]; out._23 = m[6]; out._24 = m[7];
-        out._31 = m[8]; out._32 = m[9]; out._33 = m[10]; out._34 = m[11];
-        if (rows == 4) {
-            out._41 = m[12]; out._42 = m[13]; out._43 = m[14]; out._44 = m[15];
-        } else {
-            out._41 = 0.0f; out._42 = 0.0f; out._43 = 0.0f; out._44 = 1.0f;
-        }
-    } else {
-        out._11 = m[0]; out._21 = m[1]; out._31 = m[2]; out._41 = m[3];
-        out._12 = m[4]; out._22 = m[5]; out._32 = m[6]; out._42 = m[7];
-        out._13 = m[8]; out._23 = m[9]; out._33 = m[10]; out._43 = m[11];
-        if (rows == 4) {
-            out._14 = m[12]; out._24 = m[13]; out._34 = m[14]; out._44 = m[15];
-        } else {
-            out._14 = 0.0f; out._24 = 0.0f; out._34 = 0.0f; out._44 = 1.0f;
-        }
-    }
-
-    *outMatrix = out;
-    return true;
-}
-
 static bool TryBuildMatrixSnapshot(const ShaderConstantState& state,
                                   int baseRegister,
                                   int rows,
                                   bool transposed,
                                   D3DMATRIX* outMatrix) {
-    if (!outMatrix || !state.snapshotReady || baseRegister < 0 || rows < 3 || rows > 4 ||
+    if (!outMatrix || !IsSnapshotReady(state) || baseRegister < 0 || rows < 3 || rows > 4 ||
         baseRegister + rows - 1 >= kMaxConstantRegisters) {
         return false;
     }
 
     for (int i = 0; i < rows; i++) {
-        if (!state.valid[baseRegister + i]) {
+        if (!IsConstantValid(state, baseRegister + i)) {
             return false;
         }
     }
@@ -1344,126 +2217,501 @@ static bool TryBuildMatrixSnapshotInfo(const ShaderConstantState& state, int bas
     return true;
 }
 
-static void ScanBuffer(const void* base, size_t size, int& resultsFound) {
-    if (!base || size < sizeof(D3DMATRIX)) {
-        return;
+#if defined(_MSC_VER)
+// Copies size bytes from memory another thread may decommit at any time.
+static bool SafeReadMemory(const void* src, void* dst, size_t size) {
+    __try {
+        memcpy(dst, src, size);
+        return true;
+    } __except (EXCEPTION_EXECUTE_HANDLER) {
+        return false;
     }
-    const float* data = reinterpret_cast<const float*>(base);
-    size_t count = size / sizeof(float);
-    for (size_t i = 0; i + 16 <= count; i++) {
-        const float* window = data + i;
-        if (!LooksLikeMatrix(window)) {
-            continue;
+}
+#else
+static bool SafeReadMemory(const void* src, void* dst, size_t size) {
+    SIZE_T bytesRead = 0;
+    return ReadProcessMemory(GetCurrentProcess(), src, dst, size, &bytesRead) && bytesRead == size;
+}
+#endif
+
+static bool IsScannableProtection(DWORD protect) {
+    if (protect & (PAGE_GUARD | PAGE_NOACCESS)) {
+        return false;
+    }
+    return (protect & (PAGE_READWRITE | PAGE_EXECUTE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_WRITECOPY)) != 0;
+}
+
+struct MemoryScanWorkerHit {
+    uintptr_t address = 0;
+    D3DMATRIX matrix = {};
+    MatrixSlot slot = MatrixSlot_View;
+    uint32_t hash = 0;
+};
+
+// The scanner's config, copied on the render thread by StartMemoryScanner so the
+// scan threads never read g_config while a reload replaces it.
+struct MemoryScanSettings {
+    std::string moduleName;
+    int maxResults = 0;
+    bool allRegions = false;
+    int threads = 0;
+};
+
+struct MemoryScanWorker {
+    HANDLE thread = nullptr;
+    const MemoryScanSettings* settings = nullptr;
+};
+
+// Per range, indexed like g_memoryScanRanges. Hits are written only by the worker
+// that took the range and read after every worker has been joined.
+static std::vector<std::vector<MemoryScanWorkerHit>> g_memoryScanRangeHits = {};
+// Hit count of each finished range; -1 while pending or when it was abandoned.
+static std::vector<std::atomic<int>> g_memoryScanRangeDone = {};
+// Ranges [0, prefix) are finished and hold g_memoryScanPrefixHits hits between them.
+static std::atomic<size_t> g_memoryScanPrefixRanges{0};
+static std::atomic<int> g_memoryScanPrefixHits{0};
+// Ranges past this index cannot contribute to the result.
+static std::atomic<size_t> g_memoryScanLastNeededRange{SIZE_MAX};
+
+struct MemoryScanChunkContext {
+    uintptr_t baseAddress;
+    int maxResults;
+    std::vector<MemoryScanWorkerHit>* hits;
+};
+
+// Moves the finished prefix forward over every range that has completed. Two
+// workers may add their counts out of order, so the range that crosses
+// maxResults can be one past the true cutoff; that only scans a little more.
+static void AdvanceMemoryScanPrefix(int maxResults) {
+    for (;;) {
+        size_t prefix = g_memoryScanPrefixRanges.load(std::memory_order_acquire);
+        if (prefix >= g_memoryScanRangeDone.size()) {
+            return;
         }
-        D3DMATRIX mat = {};
-        memcpy(&mat, window, sizeof(D3DMATRIX));
-        bool looksView = LooksLikeViewStrict(mat);
-        bool looksProj = LooksLikeProjectionStrict(mat);
-        if (!looksView && !looksProj) {
+        const int count = g_memoryScanRangeDone[prefix].load(std::memory_order_acquire);
+        if (count < 0) {
+            return;
+        }
+        if (!g_memoryScanPrefixRanges.compare_exchange_strong(prefix, prefix + 1, std::memory_order_acq_rel)) {
             continue;
         }
-        uint32_t hash = HashMatrix(mat);
-        char resultLine[256];
-        snprintf(resultLine, sizeof(resultLine), "Memory scan: %s matrix at %p hash 0x%08X",
-                 looksView ? "VIEW" : "PROJ", reinterpret_cast<const void*>(window), hash);
-        LogMsg("%s", resultLine);
-        {
-            std::lock_guard<std::mutex> lock(g_uiDataMutex);
-            g_memoryScanResults.emplace_back(resultLine);
-            MemoryScanHit hit = {};
-            hit.label = resultLine;
-            hit.matrix = mat;
-            hit.slot = looksView ? MatrixSlot_View : MatrixSlot_Projection;
-            hit.address = reinterpret_cast<uintptr_t>(window);
-            hit.hash = hash;
-            g_memoryScanHits.emplace_back(hit);
-        }
-        resultsFound++;
-        if (resultsFound >= g_config.memoryScannerMaxResults) {
+        if (g_memoryScanPrefixHits.fetch_add(count, std::memory_order_acq_rel) + count >= maxResults) {
+            size_t lastNeeded = g_memoryScanLastNeededRange.load(std::memory_order_relaxed);
+            while (prefix < lastNeeded &&
+                   !g_memoryScanLastNeededRange.compare_exchange_weak(lastNeeded, prefix, std::memory_order_relaxed)) {
+            }
             return;
         }
     }
 }
 
-static DWORD WINAPI MemoryScannerThread(LPVOID lpParam) {
-    std::string moduleName = lpParam ? static_cast<const char*>(lpParam) : "";
-    if (lpParam) {
-        free(lpParam);
-    }
-    HMODULE hmod = moduleName.empty() ? GetModuleHandleA(nullptr)
-                                      : GetModuleHandleA(moduleName.c_str());
-    if (!hmod) {
-        LogMsg("Memory scan failed: module not found (%s)", moduleName.c_str());
-        g_memoryScannerThread = nullptr;
-        return 0;
+// ScanFloatsForCameraMatrices callback: records a hit until the range holds
+// maxResults, since no later hit of the range could make the result.
+static bool RecordMemoryScanHit(void* context, size_t floatIndex, const D3DMATRIX& mat, bool looksView) {
+    MemoryScanChunkContext* chunk = static_cast<MemoryScanChunkContext*>(context);
+    if (chunk->hits->size() >= static_cast<size_t>((std::max)(chunk->maxResults, 0))) {
+        return false;
     }
+    g_memoryScanHitCount.fetch_add(1, std::memory_order_relaxed);
+    MemoryScanWorkerHit hit = {};
+    hit.address = chunk->baseAddress + floatIndex * sizeof(float);
+    hit.matrix = mat;
+    hit.slot = looksView ? MatrixSlot_View : MatrixSlot_Projection;
+    hit.hash = HashMatrix(mat);
+    chunk->hits->push_back(hit);
+    return true;
+}
 
-    MEMORY_BASIC_INFORMATION info = {};
-    SIZE_T len = VirtualQuery(hmod, &info, sizeof(info));
-    if (len == 0) {
-        LogMsg("Memory scan failed: VirtualQuery base.");
-        g_memoryScannerThread = nullptr;
-        return 0;
+static DWORD WINAPI MemoryScanWorkerThread(LPVOID lpParam) {
+    ScopedProxyThreadStack ownStack;
+    MemoryScanWorker* worker = static_cast<MemoryScanWorker*>(lpParam);
+    std::vector<float> buffer(kMemoryScanChunkFloats + 15);
+    std::vector<uint8_t> flags(buffer.size());
+    std::vector<uint8_t> okRun(buffer.size());
+    std::vector<uint8_t> nextSignificant(buffer.size());
+
+    const int maxResults = worker->settings->maxResults;
+    while (!g_memoryScanCancel.load(std::memory_order_relaxed)) {
+        const size_t index = g_memoryScanNextRange.fetch_add(1, std::memory_order_relaxed);
+        if (index >= g_memoryScanRanges.size() ||
+            index > g_memoryScanLastNeededRange.load(std::memory_order_relaxed)) {
+            break;
+        }
+        const MemoryScanRange& range = g_memoryScanRanges[index];
+        std::vector<MemoryScanWorkerHit>& hits = g_memoryScanRangeHits[index];
+        bool finished = true;
+        for (uintptr_t chunk = range.begin; chunk < range.end; chunk += kMemoryScanChunkFloats * sizeof(float)) {
+            if (g_memoryScanCancel.load(std::memory_order_relaxed) ||
+                index > g_memoryScanLastNeededRange.load(std::memory_order_relaxed)) {
+                finished = false;
+                break;
+            }
+            const uintptr_t windowsEnd = (std::min)(range.end, chunk + kMemoryScanChunkFloats * sizeof(float));
+            const uintptr_t readEnd = (std::min)(range.regionEnd, windowsEnd + 15 * sizeof(float));
+            const size_t floatCount = (readEnd - chunk) / sizeof(float);
+            const size_t windowCount = (windowsEnd - chunk) / sizeof(float);
+            if (SafeReadMemory(reinterpret_cast<const void*>(chunk), buffer.data(), floatCount * sizeof(float))) {
+                MemoryScanChunkContext context = { chunk, maxResults, &hits };
+                const bool full = !ScanFloatsForCameraMatrices(buffer.data(), floatCount, windowCount,
+                                                               flags.data(), okRun.data(), nextSignificant.data(),
+                                                               RecordMemoryScanHit, &context);
+                if (full) {
+                    g_memoryScanBytesDone.fetch_add(range.end - chunk, std::memory_order_relaxed);
+                    break;
+                }
+            } else {
+                g_memoryScanUnreadableChunks.fetch_add(1, std::memory_order_relaxed);
+            }
+            g_memoryScanBytesDone.fetch_add(windowsEnd - chunk, std::memory_order_relaxed);
+        }
+        if (finished) {
+            g_memoryScanRangeDone[index].store(static_cast<int>(hits.size()), std::memory_order_release);
+            AdvanceMemoryScanPrefix(maxResults);
+        }
     }
+    return 0;
+}
 
-    BYTE* dllBase = static_cast<BYTE*>(info.AllocationBase);
-    BYTE* address = dllBase;
-    int resultsFound = 0;
-    while (true) {
-        len = VirtualQuery(address, &info, sizeof(info));
-        if (len == 0) {
+// Collects scannable committed regions: the allocation of one module, or
+// every committed read/write region in the process when allRegions is set.
+// Regions the proxy owns (proxy_heap.h) are left out either way.
+static void CollectMemoryScanRanges(BYTE* allocationBase, bool allRegions) {
+    g_memoryScanRanges.clear();
+    SYSTEM_INFO systemInfo = {};
+    GetSystemInfo(&systemInfo);
+    BYTE* address = allRegions ? static_cast<BYTE*>(systemInfo.lpMinimumApplicationAddress) : allocationBase;
+    BYTE* maxAddress = static_cast<BYTE*>(systemInfo.lpMaximumApplicationAddress);
+    uint64_t totalBytes = 0;
+    uint32_t regionCount = 0;
+    uint32_t proxyRegions = 0;
+    MEMORY_BASIC_INFORMATION info = {};
+    while (address < maxAddress && VirtualQuery(address, &info, sizeof(info)) != 0) {
+        if (!allRegions && info.AllocationBase != allocationBase) {
             break;
         }
-        if (info.AllocationBase != dllBase) {
+        const uintptr_t regionBegin = reinterpret_cast<uintptr_t>(info.BaseAddress);
+        const uintptr_t regionEnd = regionBegin + info.RegionSize;
+        const bool scannable = info.State == MEM_COMMIT && IsScannableProtection(info.Protect) &&
+                               info.RegionSize >= sizeof(D3DMATRIX);
+        if (scannable && ProxyOwnsRange(regionBegin, regionEnd)) {
+            proxyRegions++;
+        } else if (scannable) {
+            const uintptr_t windowEnd = regionEnd - sizeof(D3DMATRIX) + sizeof(float);
+            for (uintptr_t begin = regionBegin; begin < windowEnd; begin += kMemoryScanRangeBytes) {
+                MemoryScanRange range = {};
+                range.begin = begin;
+                range.end = (std::min)(windowEnd, begin + kMemoryScanRangeBytes);
+                range.regionEnd = regionEnd;
+                g_memoryScanRanges.push_back(range);
+                totalBytes += range.end - range.begin;
+            }
+            regionCount++;
+        }
+        if (regionEnd <= reinterpret_cast<uintptr_t>(address)) {
             break;
         }
-        if (((info.Protect & PAGE_EXECUTE_READWRITE) || (info.Protect & PAGE_READWRITE)) &&
-            !(info.Protect & PAGE_GUARD)) {
-            ScanBuffer(info.BaseAddress, info.RegionSize, resultsFound);
-            if (resultsFound >= g_config.memoryScannerMaxResults) {
-                break;
-            }
+        address = reinterpret_cast<BYTE*>(regionEnd);
+    }
+    g_memoryScanRangeHits.assign(g_memoryScanRanges.size(), std::vector<MemoryScanWorkerHit>());
+    g_memoryScanRangeDone = std::vector<std::atomic<int>>(g_memoryScanRanges.size());
+    for (std::atomic<int>& done : g_memoryScanRangeDone) {
+        done.store(-1, std::memory_order_relaxed);
+    }
+    g_memoryScanPrefixRanges.store(0, std::memory_order_relaxed);
+    g_memoryScanPrefixHits.store(0, std::memory_order_relaxed);
+    g_memoryScanLastNeededRange.store(SIZE_MAX, std::memory_order_relaxed);
+    g_memoryScanBytesTotal.store(totalBytes, std::memory_order_relaxed);
+    g_memoryScanRegionCount.store(regionCount, std::memory_order_relaxed);
+    g_memoryScanProxyRegions.store(proxyRegions, std::memory_order_relaxed);
+}
+
+static int ResolveMemoryScanWorkerCount(int requested) {
+    if (requested > 0) {
+        return (std::min)(requested, kMaxMemoryScanWorkers);
+    }
+    SYSTEM_INFO systemInfo = {};
+    GetSystemInfo(&systemInfo);
+    const int cores = static_cast<int>(systemInfo.dwNumberOfProcessors);
+    // Leave one core for the game's render thread.
+    return (std::max)(1, (std::min)(cores - 1, kMaxMemoryScanWorkers));
+}
+
+static DWORD WINAPI MemoryScannerThread(LPVOID lpParam) {
+    ScopedProxyThreadStack ownStack;
+    // Owned by this thread; deleted on every exit path.
+    MemoryScanSettings* settings = static_cast<MemoryScanSettings*>(lpParam);
+    const std::string moduleName = settings->moduleName;
+    LARGE_INTEGER startCounter = {};
+    LARGE_INTEGER frequency = {};
+    QueryPerformanceCounter(&startCounter);
+    QueryPerformanceFrequency(&frequency);
+
+    BYTE* allocationBase = nullptr;
+    if (!settings->allRegions) {
+        HMODULE hmod = moduleName.empty() ? GetModuleHandleA(nullptr)
+                                          : GetModuleHandleA(moduleName.c_str());
+        if (!hmod) {
+            LogMsg("Memory scan failed: module not found (%s)", moduleName.c_str());
+            g_memoryScanRunning.store(false, std::memory_order_release);
+            delete settings;
+            return 0;
+        }
+        MEMORY_BASIC_INFORMATION info = {};
+        if (VirtualQuery(hmod, &info, sizeof(info)) == 0) {
+            LogMsg("Memory scan failed: VirtualQuery base.");
+            g_memoryScanRunning.store(false, std::memory_order_release);
+            delete settings;
+            return 0;
+        }
+        allocationBase = static_cast<BYTE*>(info.AllocationBase);
+    }
+    CollectMemoryScanRanges(allocationBase, settings->allRegions);
+
+    const int workerCount = ResolveMemoryScanWorkerCount(settings->threads);
+    g_memoryScanWorkerCount.store(workerCount, std::memory_order_relaxed);
+    MemoryScanWorker workers[kMaxMemoryScanWorkers];
+    HANDLE handles[kMaxMemoryScanWorkers] = {};
+    int started = 0;
+    for (int i = 0; i < kMaxMemoryScanWorkers; ++i) {
+        workers[i].settings = settings;
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        workers[i].thread = CreateThread(nullptr, 0, MemoryScanWorkerThread, &workers[i], 0, nullptr);
+        if (workers[i].thread) {
+            handles[started++] = workers[i].thread;
+        }
+    }
+    if (started == 0) {
+        // No worker threads available; scan on this thread instead.
+        MemoryScanWorkerThread(&workers[0]);
+    } else {
+        WaitForMultipleObjects(static_cast<DWORD>(started), handles, TRUE, INFINITE);
+        for (int i = 0; i < started; ++i) {
+            CloseHandle(handles[i]);
+        }
+    }
+
+    // Ranges are in address order and each range's hits are too, so taking them in
+    // range order yields the lowest-addressed hits. An abandoned range lies past
+    // the cutoff and is only reached once the result is already full.
+    const size_t maxResults = static_cast<size_t>((std::max)(settings->maxResults, 0));
+    std::vector<MemoryScanWorkerHit> merged;
+    for (const std::vector<MemoryScanWorkerHit>& rangeHits : g_memoryScanRangeHits) {
+        if (merged.size() >= maxResults) {
+            break;
         }
-        address = static_cast<BYTE*>(info.BaseAddress) + info.RegionSize;
+        const size_t take = (std::min)(rangeHits.size(), maxResults - merged.size());
+        merged.insert(merged.end(), rangeHits.begin(), rangeHits.begin() + take);
     }
+    const bool limitReached = merged.size() >= maxResults && maxResults > 0;
+    g_memoryScanRangeHits.clear();
+    g_memoryScanRangeDone.clear();
 
-    LogMsg("Memory scan complete: %d results", resultsFound);
-    g_memoryScannerThread = nullptr;
+    MemoryScanResultSet* published = new MemoryScanResultSet();
+    published->hits.reserve(merged.size());
+    for (const MemoryScanWorkerHit& workerHit : merged) {
+        char resultLine[256];
+        snprintf(resultLine, sizeof(resultLine), "Memory scan: %s matrix at %p hash 0x%08X",
+                 workerHit.slot == MatrixSlot_View ? "VIEW" : "PROJ",
+                 reinterpret_cast<const void*>(workerHit.address), workerHit.hash);
+        LogMsg("%s", resultLine);
+        MemoryScanHit hit = {};
+        hit.label = resultLine;
+        hit.matrix = workerHit.matrix;
+        hit.slot = workerHit.slot;
+        hit.address = workerHit.address;
+        hit.hash = workerHit.hash;
+        published->hits.push_back(std::move(hit));
+    }
+    // Published before g_memoryScanRunning drops, so a render-thread reader that
+    // sees the scan finished also finds its results.
+    delete g_memoryScanPublished.exchange(published, std::memory_order_acq_rel);
+
+    LARGE_INTEGER endCounter = {};
+    QueryPerformanceCounter(&endCounter);
+    const double elapsedMs = frequency.QuadPart > 0
+        ? static_cast<double>(endCounter.QuadPart - startCounter.QuadPart) * 1000.0 / static_cast<double>(frequency.QuadPart)
+        : 0.0;
+    g_memoryScanLastDurationMs.store(static_cast<uint32_t>(elapsedMs), std::memory_order_relaxed);
+    LogMsg("Memory scan complete: %d results, %u regions, %.1f MB, %d workers, %.1f ms%s",
+           static_cast<int>(merged.size()),
+           g_memoryScanRegionCount.load(std::memory_order_relaxed),
+           static_cast<double>(g_memoryScanBytesTotal.load(std::memory_order_relaxed)) / (1024.0 * 1024.0),
+           started > 0 ? started : 1,
+           elapsedMs,
+           limitReached
+               ? " (result limit reached)"
+               : (g_memoryScanCancel.load(std::memory_order_relaxed) ? " (cancelled)" : ""));
+    delete settings;
+    g_memoryScanRunning.store(false, std::memory_order_release);
     return 0;
 }
 
+// Render thread. Returns true when a newer scan replaced g_memoryScanHits.
+static bool TakePublishedMemoryScan() {
+    MemoryScanResultSet* published = g_memoryScanPublished.exchange(nullptr, std::memory_order_acq_rel);
+    if (!published) {
+        return false;
+    }
+    g_memoryScanHits.swap(published->hits);
+    delete published;
+    return true;
+}
+
+static void ClearMemoryScanResults() {
+    delete g_memoryScanPublished.exchange(nullptr, std::memory_order_acq_rel);
+    g_memoryScanHits.clear();
+}
+
 static void StartMemoryScanner() {
-    if (g_memoryScannerThread) {
+    if (g_memoryScanRunning.load(std::memory_order_acquire)) {
         return;
     }
-    const char* moduleName = g_config.memoryScannerModule[0] ? g_config.memoryScannerModule : nullptr;
-    {
-        std::lock_guard<std::mutex> lock(g_uiDataMutex);
-        g_memoryScanResults.clear();
-        g_memoryScanHits.clear();
-    }
-    char* moduleCopy = nullptr;
-    if (moduleName) {
-        moduleCopy = _strdup(moduleName);
+    if (g_memoryScannerThread) {
+        CloseHandle(g_memoryScannerThread);
+        g_memoryScannerThread = nullptr;
     }
+    PROXY_MARKER_SCOPE(ProxyMarker_MemoryScannerHandoff);
+    ClearMemoryScanResults();
+    g_memoryScanCancel.store(false, std::memory_order_relaxed);
+    g_memoryScanNextRange.store(0, std::memory_order_relaxed);
+    g_memoryScanBytesDone.store(0, std::memory_order_relaxed);
+    g_memoryScanBytesTotal.store(0, std::memory_order_relaxed);
+    g_memoryScanHitCount.store(0, std::memory_order_relaxed);
+    g_memoryScanUnreadableChunks.store(0, std::memory_order_relaxed);
+    g_memoryScanRunning.store(true, std::memory_order_release);
+    MemoryScanSettings* settings = new MemoryScanSettings();
+    settings->moduleName = g_config.memoryScannerModule;
+    settings->maxResults = g_config.memoryScannerMaxResults;
+    settings->allRegions = g_config.memoryScannerAllRegions;
+    settings->threads = g_config.memoryScannerThreads;
     g_memoryScannerThread = CreateThread(
         nullptr,
         0,
         MemoryScannerThread,
-        moduleCopy,
+        settings,
         0,
         &g_memoryScannerThreadId);
     if (!g_memoryScannerThread) {
         LogMsg("WARNING: Failed to create memory scan thread.");
-        if (moduleCopy) {
-            free(moduleCopy);
+        g_memoryScanRunning.store(false, std::memory_order_release);
+        delete settings;
+    }
+}
+
+static void CancelMemoryScanner() {
+    g_memoryScanCancel.store(true, std::memory_order_relaxed);
+}
+
+static const char* MemoryTrackedSlotLabel(MatrixSlot slot) {
+    return slot == MatrixSlot_View ? "VIEW" : "PROJ";
+}
+
+// Refuses addresses inside the proxy's own memory (proxy_heap.h): those hold the
+// proxy's copies of the camera, and tracking one would feed the camera back into itself.
+static bool StartTrackingMemoryMatrix(MatrixSlot slot, uintptr_t address) {
+    if (ProxyOwnsRange(address, address + sizeof(D3DMATRIX))) {
+        LogMsg("Memory tracker: %s hit at %p is the proxy's own memory; not tracking it",
+               MemoryTrackedSlotLabel(slot), reinterpret_cast<const void*>(address));
+        return false;
+    }
+    MemoryTrackedMatrix& tracked = g_memoryTracked[slot];
+    tracked = MemoryTrackedMatrix{};
+    tracked.active = true;
+    tracked.address = address;
+    LogMsg("Memory tracker: watching %s matrix at %p", MemoryTrackedSlotLabel(slot),
+           reinterpret_cast<const void*>(address));
+    return true;
+}
+
+static void StopTrackingMemoryMatrix(MatrixSlot slot) {
+    g_memoryTracked[slot] = MemoryTrackedMatrix{};
+}
+
+static bool IsMemoryTrackingActive() {
+    return g_memoryTracked[MatrixSlot_View].active || g_memoryTracked[MatrixSlot_Projection].active;
+}
+
+static bool ValidateTrackedMatrix(MatrixSlot slot, const D3DMATRIX& mat) {
+    if (!LooksLikeMatrix(reinterpret_cast<const float*>(&mat))) {
+        return false;
+    }
+    return slot == MatrixSlot_View ? LooksLikeViewStrict(mat) : LooksLikeProjectionStrict(mat);
+}
+
+// After a rescan triggered by lost validation, re-attach to the hit of the
+// same type nearest the old address (camera objects tend to be reallocated
+// close to where they were).
+static void TryReacquireMemoryMatrix(MatrixSlot slot) {
+    MemoryTrackedMatrix& tracked = g_memoryTracked[slot];
+    uintptr_t bestAddress = 0;
+    uintptr_t bestDistance = (std::numeric_limits<uintptr_t>::max)();
+    // The rescan may have finished after this frame's hand-off.
+    TakePublishedMemoryScan();
+    for (const MemoryScanHit& hit : g_memoryScanHits) {
+        if (hit.slot != slot || ProxyOwnsRange(hit.address, hit.address + sizeof(D3DMATRIX))) {
+            continue;
+        }
+        const uintptr_t distance = hit.address > tracked.address ? hit.address - tracked.address
+                                                                 : tracked.address - hit.address;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            bestAddress = hit.address;
         }
     }
+    if (bestAddress == 0) {
+        LogMsg("Memory tracker: %s matrix lost; rescan found no replacement", MemoryTrackedSlotLabel(slot));
+        tracked.reacquirePending = false;
+        return;
+    }
+    if (!StartTrackingMemoryMatrix(slot, bestAddress)) {
+        tracked.reacquirePending = false;
+    }
 }
 
-static void UpdateConstantSnapshot() {
-    for (auto& entry : g_shaderConstants) {
-        entry.second.snapshotReady = true;
+// Called once per frame from Present. Each watched address is read under a
+// fault guard and must still pass the strict classifier for its slot; only
+// kMemoryTrackFailureLimit consecutive failures trigger a full rescan.
+static void UpdateMemoryTracking() {
+    const MatrixSlot slots[] = { MatrixSlot_View, MatrixSlot_Projection };
+    for (MatrixSlot slot : slots) {
+        MemoryTrackedMatrix& tracked = g_memoryTracked[slot];
+        if (tracked.reacquirePending && !g_memoryScanRunning.load(std::memory_order_acquire)) {
+            TryReacquireMemoryMatrix(slot);
+        }
+        if (!tracked.active) {
+            continue;
+        }
+        // The game may have freed the block and the proxy heap grown over it.
+        const bool proxyOwned = ProxyOwnsRange(tracked.address, tracked.address + sizeof(D3DMATRIX));
+        D3DMATRIX mat = {};
+        if (!proxyOwned && SafeReadMemory(reinterpret_cast<const void*>(tracked.address), &mat, sizeof(mat)) &&
+            ValidateTrackedMatrix(slot, mat)) {
+            tracked.valid = true;
+            tracked.consecutiveFailures = 0;
+            tracked.matrix = mat;
+            tracked.hash = HashMatrix(mat);
+            tracked.framesTracked++;
+            if (slot == MatrixSlot_View) {
+                StoreViewMatrix(mat, 0, 0, -1, 4, false, false, "memory tracker");
+            } else {
+                StoreProjectionMatrix(mat, 0, 0, -1, 4, false, false, "memory tracker");
+            }
+            continue;
+        }
+        tracked.valid = false;
+        if (!proxyOwned && ++tracked.consecutiveFailures < kMemoryTrackFailureLimit) {
+            continue;
+        }
+        LogMsg("Memory tracker: %s matrix at %p %s; rescanning", MemoryTrackedSlotLabel(slot),
+               reinterpret_cast<const void*>(tracked.address),
+               proxyOwned ? "is now the proxy's own memory" : "failed validation");
+        tracked.active = false;
+        tracked.reacquirePending = true;
+        if (!g_memoryScanRunning.load(std::memory_order_acquire)) {
+            StartMemoryScanner();
+            g_memoryTrackRescans++;
+        }
     }
 }
 
@@ -1500,34 +2748,433 @@ static void UpdateFrameTimeStats() {
         return;
     }
 
-    LARGE_INTEGER now = {};
-    QueryPerformanceCounter(&now);
-    double delta = static_cast<double>(now.QuadPart - g_prevCounter.QuadPart) /
-                   static_cast<double>(g_perfFrequency.QuadPart);
-    g_prevCounter = now;
+    LARGE_INTEGER now = {};
+    QueryPerformanceCounter(&now);
+    double delta = static_cast<double>(now.QuadPart - g_prevCounter.QuadPart) /
+                   static_cast<double>(g_perfFrequency.QuadPart);
+    g_prevCounter = now;
+
+    float ms = static_cast<float>(delta * 1000.0);
+    g_frameTimeHistory[g_frameTimeIndex] = ms;
+    g_frameTimeIndex = (g_frameTimeIndex + 1) % kFrameTimeHistory;
+    if (g_frameTimeCount < kFrameTimeHistory) {
+        g_frameTimeCount++;
+    }
+
+    if (g_frameTimeSamples == 0) {
+        g_frameTimeMin = ms;
+        g_frameTimeMax = ms;
+    } else {
+        if (ms < g_frameTimeMin) g_frameTimeMin = ms;
+        if (ms > g_frameTimeMax) g_frameTimeMax = ms;
+    }
+    g_frameTimeSum += ms;
+    g_frameTimeSamples++;
+}
+
+// Shared-memory camera export (camera_proxy_shared.h). The mapping is created at
+// the first Present that wants it and every field is written straight into the
+// view, so publishing a frame is a few hundred bytes of stores between two
+// sequence bumps.
+static HANDLE g_sharedCameraMapping = nullptr;
+static CameraProxySharedHeader* g_sharedCamera = nullptr;
+static bool g_sharedCameraOpenFailed = false;
+static char g_sharedCameraName[MAX_PATH] = "";
+// Label pointers last copied per slot; labels are only rewritten when they change.
+static const char* g_sharedCameraLabels[MatrixSlot_Count] = {};
+
+static bool OpenSharedCameraExport() {
+    const DWORD size = static_cast<DWORD>(sizeof(CameraProxySharedHeader));
+    snprintf(g_sharedCameraName, sizeof(g_sharedCameraName), "Local\\%s", g_config.sharedCameraExportName);
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, size, g_sharedCameraName);
+    if (mapping && GetLastError() == ERROR_ALREADY_EXISTS) {
+        // Another game (or a stale reader holding the name) owns it: keep ours apart.
+        CloseHandle(mapping);
+        snprintf(g_sharedCameraName, sizeof(g_sharedCameraName), "Local\\%s_%lu",
+                 g_config.sharedCameraExportName, static_cast<unsigned long>(GetCurrentProcessId()));
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, size, g_sharedCameraName);
+    }
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size) : nullptr;
+    if (!view) {
+        LogMsg("Shared camera export: cannot create %s (error %lu)", g_sharedCameraName,
+               static_cast<unsigned long>(GetLastError()));
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        g_sharedCameraOpenFailed = true;
+        return false;
+    }
+    g_sharedCameraMapping = mapping;
+    g_sharedCamera = static_cast<CameraProxySharedHeader*>(view);
+    ProxyRegisterAllocationOf(view);
+    memset(g_sharedCamera, 0, sizeof(*g_sharedCamera));
+    g_sharedCamera->size = sizeof(CameraProxySharedHeader);
+    g_sharedCamera->version = CAMERA_PROXY_SHARED_VERSION;
+    g_sharedCamera->processId = GetCurrentProcessId();
+    std::atomic_thread_fence(std::memory_order_release);
+    g_sharedCamera->magic = CAMERA_PROXY_SHARED_MAGIC;
+    for (const char*& label : g_sharedCameraLabels) {
+        label = nullptr;
+    }
+    LogMsg("Shared camera export: %s (%u bytes)", g_sharedCameraName, static_cast<unsigned>(size));
+    return true;
+}
+
+static void CloseSharedCameraExport() {
+    if (g_sharedCamera) {
+        g_sharedCamera->magic = 0;
+        ProxyUnregisterOwnedRange(reinterpret_cast<uintptr_t>(g_sharedCamera));
+        UnmapViewOfFile(g_sharedCamera);
+        g_sharedCamera = nullptr;
+    }
+    if (g_sharedCameraMapping) {
+        CloseHandle(g_sharedCameraMapping);
+        g_sharedCameraMapping = nullptr;
+    }
+}
+
+static void PublishSharedSource(MatrixSlot slot, CameraProxySharedSource* out) {
+    const MatrixSourceInfo& source = g_matrixSources[slot];
+    out->valid = source.valid ? 1 : 0;
+    out->manual = source.manual ? 1 : 0;
+    out->transposed = source.transposed ? 1 : 0;
+    out->rows = static_cast<uint8_t>(source.rows);
+    out->baseRegister = source.baseRegister;
+    out->extractedFromRegister = source.extractedFromRegister;
+    out->shaderHash = source.shaderHash;
+    out->shaderKey = static_cast<uint64_t>(source.shaderKey);
+    if (g_sharedCameraLabels[slot] != source.sourceLabel) {
+        g_sharedCameraLabels[slot] = source.sourceLabel;
+        const char* label = source.sourceLabel ? source.sourceLabel : "";
+        const size_t length = (std::min)(strlen(label), sizeof(out->sourceLabel) - 1);
+        memcpy(out->sourceLabel, label, length);
+        out->sourceLabel[length] = '\0';
+    }
+}
+
+// Called at Present on the render thread, only while it owns the classifier state;
+// a Present that finds the worker busy leaves the previous frame in the mapping.
+static void PublishSharedCamera() {
+    if (!g_config.sharedCameraExport || g_traceReplayActive) {
+        return;
+    }
+    if (!g_sharedCamera && (g_sharedCameraOpenFailed || !OpenSharedCameraExport())) {
+        return;
+    }
+    CameraProxySharedHeader* shared = g_sharedCamera;
+    volatile LONG* sequencePtr = reinterpret_cast<volatile LONG*>(&shared->sequence);
+    // This thread is the only writer, so a plain read of its own last value is fine.
+    const uint32_t sequence = shared->sequence;
+    // Full barrier: readers see the odd value before any of the frame writes below.
+    InterlockedExchange(sequencePtr, static_cast<LONG>(sequence + 1u));
+
+    CameraProxySharedFrame& frame = shared->frame;
+    memcpy(frame.matrices[CameraProxySharedSlot_World], &g_cameraMatrices.world, sizeof(D3DMATRIX));
+    memcpy(frame.matrices[CameraProxySharedSlot_View], &g_cameraMatrices.view, sizeof(D3DMATRIX));
+    memcpy(frame.matrices[CameraProxySharedSlot_Projection], &g_cameraMatrices.projection, sizeof(D3DMATRIX));
+    memcpy(frame.matrices[CameraProxySharedSlot_MVP], &g_cameraMatrices.mvp, sizeof(D3DMATRIX));
+    frame.validMask = (g_cameraMatrices.hasWorld ? 1u << CameraProxySharedSlot_World : 0u) |
+                      (g_cameraMatrices.hasView ? 1u << CameraProxySharedSlot_View : 0u) |
+                      (g_cameraMatrices.hasProjection ? 1u << CameraProxySharedSlot_Projection : 0u) |
+                      (g_cameraMatrices.hasMVP ? 1u << CameraProxySharedSlot_MVP : 0u);
+    if (g_projectionDetectedByNumericStructure) {
+        frame.fovRadians = g_projectionDetectedFovRadians;
+        frame.handedness = g_projectionDetectedHandedness;
+    } else if (g_combinedMvpDebug.succeeded) {
+        frame.fovRadians = g_combinedMvpDebug.fovRadians;
+        frame.handedness = g_combinedMvpDebug.handedness;
+    } else {
+        frame.fovRadians = 0.0f;
+        frame.handedness = ProjectionHandedness_Unknown;
+    }
+    frame.frameTimeMs = g_frameTimeCount > 0
+        ? g_frameTimeHistory[(g_frameTimeIndex + kFrameTimeHistory - 1) % kFrameTimeHistory] : 0.0f;
+    PublishSharedSource(MatrixSlot_World, &frame.sources[CameraProxySharedSlot_World]);
+    PublishSharedSource(MatrixSlot_View, &frame.sources[CameraProxySharedSlot_View]);
+    PublishSharedSource(MatrixSlot_Projection, &frame.sources[CameraProxySharedSlot_Projection]);
+    PublishSharedSource(MatrixSlot_MVP, &frame.sources[CameraProxySharedSlot_MVP]);
+    LARGE_INTEGER counter = {};
+    QueryPerformanceCounter(&counter);
+    frame.frame = static_cast<uint64_t>(g_frameCount);
+    frame.presentCounter = counter.QuadPart;
+    frame.constantUploads = g_constantUploadCount;
+    frame.constantFastPathUploads = g_constantFastPathCount;
+    frame.transformsSent = g_transformEmitSent;
+    frame.transformsSkipped = g_transformEmitSkipped;
+    frame.passDrawsSkipped = g_passDrawsSkipped;
+    frame.screenSpaceDrawsSkipped = g_screenSpaceDrawsSkipped;
+    frame.presentTaskMicros = g_presentScheduler.LastFrameMicros();
+
+    // Full barrier: the frame is complete before readers see the even value.
+    InterlockedExchange(sequencePtr, static_cast<LONG>(sequence + 2u));
+}
+
+// The Constants tab renders from this cache. It is rebuilt only when the selected
+// shader's constants change (lastChangeSerial) or a display option does, and the
+// rows go through ImGuiListClipper, so an open overlay formats only visible rows.
+enum ConstantsViewLineKind {
+    ConstantsViewLine_Block = 0,
+    ConstantsViewLine_Register,
+    ConstantsViewLine_AssignButtons
+};
+
+struct ConstantsViewLine {
+    ConstantsViewLineKind kind = ConstantsViewLine_Register;
+    // Register for Register lines, block base for Block and AssignButtons lines.
+    int reg = 0;
+    int assignRows = 4;
+    char label[96] = {};
+};
+
+struct ConstantsViewModel {
+    bool valid = false;
+    uintptr_t shaderKey = 0;
+    unsigned int shaderOrderGeneration = 0;
+    unsigned long long changeSerial = 0;
+    bool grouped = false;
+    bool detectedOnly = false;
+    bool transposed = false;
+    int assignRows = 4;
+    // Bit n set = block c(4n)-c(4n+3) is expanded.
+    uint64_t expandedBlocks = 0;
+    std::vector<ConstantsViewLine> lines;
+};
+
+static ConstantsViewModel g_constantsView;
+static unsigned long long g_constantsViewRebuilds = 0;
+
+static void AppendConstantsRegisterLine(const ShaderConstantState& state, int reg, const float* displayRow,
+                                        int displayRowIndex, std::vector<ConstantsViewLine>* lines) {
+    ConstantsViewLine line;
+    line.kind = ConstantsViewLine_Register;
+    line.reg = reg;
+    if (!IsConstantValid(state, reg)) {
+        snprintf(line.label, sizeof(line.label), "c%d: <unset>###reg_%d", reg, reg);
+    } else if (displayRow) {
+        snprintf(line.label, sizeof(line.label), "r%d: [%.3f %.3f %.3f %.3f]###reg_%d",
+                 displayRowIndex, displayRow[0], displayRow[1], displayRow[2], displayRow[3], reg);
+    } else {
+        const float* data = state.constants[reg];
+        snprintf(line.label, sizeof(line.label), "c%d: [%.3f %.3f %.3f %.3f]###reg_%d",
+                 reg, data[0], data[1], data[2], data[3], reg);
+    }
+    lines->push_back(line);
+}
+
+static void AppendConstantsBlockLines(const ShaderConstantState& state, int base, ConstantsViewModel* view) {
+    D3DMATRIX mat = {};
+    bool looksLike = false;
+    const bool hasMatrix = TryBuildMatrixSnapshotInfo(state, base, &mat, &looksLike);
+    if (view->detectedOnly) {
+        if (!hasMatrix || !looksLike) {
+            return;
+        }
+    } else if (!IsConstantValid(state, base) && !IsConstantValid(state, base + 1) &&
+               !IsConstantValid(state, base + 2) && !IsConstantValid(state, base + 3)) {
+        return;
+    }
+
+    ConstantsViewLine header;
+    header.kind = ConstantsViewLine_Block;
+    header.reg = base;
+    snprintf(header.label, sizeof(header.label), "c%d-c%d%s###blk_%d", base, base + 3,
+             looksLike ? " (matrix)" : "", base);
+    view->lines.push_back(header);
+    if ((view->expandedBlocks & (1ull << (base / 4))) == 0) {
+        return;
+    }
+
+    const bool showTransposed = view->transposed && hasMatrix;
+    const D3DMATRIX displayMat = showTransposed ? TransposeMatrix(mat) : mat;
+    for (int reg = base; reg < base + 4; reg++) {
+        const int row = reg - base;
+        const float* displayRow = showTransposed ? reinterpret_cast<const float*>(&displayMat) + row * 4 : nullptr;
+        AppendConstantsRegisterLine(state, reg, displayRow, row, &view->lines);
+    }
+
+    int selectedRows = view->assignRows;
+    if (selectedRows == 3 && !IsConstantValid(state, base + 2)) {
+        selectedRows = 4;
+    }
+    D3DMATRIX assignedMat = {};
+    const bool canAssign = IsConstantValid(state, base) && IsConstantValid(state, base + 1) && IsConstantValid(state, base + 2) &&
+                           (selectedRows == 3 || IsConstantValid(state, base + 3)) &&
+                           TryBuildMatrixSnapshot(state, base, selectedRows, false, &assignedMat);
+    if (canAssign) {
+        ConstantsViewLine buttons;
+        buttons.kind = ConstantsViewLine_AssignButtons;
+        buttons.reg = base;
+        buttons.assignRows = selectedRows;
+        view->lines.push_back(buttons);
+    }
+}
+
+static const ConstantsViewModel& UpdateConstantsViewModel(uintptr_t shaderKey, const ShaderConstantState& state) {
+    ConstantsViewModel& view = g_constantsView;
+    if (view.valid && view.shaderKey == shaderKey && view.shaderOrderGeneration == g_shaderOrderGeneration &&
+        view.changeSerial == state.lastChangeSerial &&
+        view.grouped == g_showConstantsAsMatrices && view.detectedOnly == g_filterDetectedMatrices &&
+        view.transposed == g_showTransposedMatrices && view.assignRows == g_manualAssignRows) {
+        return view;
+    }
+    view.valid = true;
+    view.shaderKey = shaderKey;
+    view.shaderOrderGeneration = g_shaderOrderGeneration;
+    view.changeSerial = state.lastChangeSerial;
+    view.grouped = g_showConstantsAsMatrices;
+    view.detectedOnly = g_filterDetectedMatrices;
+    view.transposed = g_showTransposedMatrices;
+    view.assignRows = g_manualAssignRows;
+    view.lines.clear();
+    g_constantsViewRebuilds++;
+
+    if (view.grouped) {
+        for (int base = 0; base < kMaxConstantRegisters; base += 4) {
+            AppendConstantsBlockLines(state, base, &view);
+        }
+    } else {
+        for (int reg = 0; reg < kMaxConstantRegisters; reg++) {
+            if (IsConstantValid(state, reg)) {
+                AppendConstantsRegisterLine(state, reg, nullptr, 0, &view.lines);
+            }
+        }
+    }
+    return view;
+}
+
+static void DrawConstantsViewLine(const ConstantsViewLine& line, const ShaderConstantState& state) {
+    if (line.kind == ConstantsViewLine_Block) {
+        const uint64_t bit = 1ull << (line.reg / 4);
+        const bool expanded = (g_constantsView.expandedBlocks & bit) != 0;
+        ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth |
+                                   ImGuiTreeNodeFlags_NoTreePushOnOpen;
+        if (g_selectedRegister == line.reg) {
+            flags |= ImGuiTreeNodeFlags_Selected;
+        }
+        ImGui::SetNextItemOpen(expanded);
+        const bool open = ImGui::TreeNodeEx(line.label, flags);
+        if (ImGui::IsItemClicked()) {
+            g_selectedRegister = line.reg;
+        }
+        if (open != expanded) {
+            // Takes effect on the next frame's rebuild; this frame keeps iterating the old lines.
+            g_constantsView.expandedBlocks ^= bit;
+            g_constantsView.valid = false;
+        }
+        return;
+    }
+
+    const bool nested = g_constantsView.grouped;
+    if (nested) {
+        ImGui::Indent();
+    }
+    if (line.kind == ConstantsViewLine_Register) {
+        ImGui::PushID(line.reg);
+        if (ImGui::Selectable(line.label, g_selectedRegister == line.reg)) {
+            g_selectedRegister = line.reg;
+        }
+        ImGui::PopID();
+    } else {
+        // Small buttons keep the line as tall as the others, which the clipper relies on.
+        static const struct { const char* label; MatrixSlot slot; } kAssignButtons[] = {
+            { "Use as World", MatrixSlot_World },
+            { "Use as View", MatrixSlot_View },
+            { "Use as Projection", MatrixSlot_Projection },
+            { "Use as MVP", MatrixSlot_MVP },
+        };
+        ImGui::PushID(line.reg);
+        for (int i = 0; i < IM_ARRAYSIZE(kAssignButtons); i++) {
+            if (i > 0) {
+                ImGui::SameLine();
+            }
+            if (ImGui::SmallButton(kAssignButtons[i].label)) {
+                D3DMATRIX assignedMat = {};
+                if (TryBuildMatrixSnapshot(state, line.reg, line.assignRows, false, &assignedMat)) {
+                    TryAssignManualMatrixFromSelection(kAssignButtons[i].slot, g_selectedShaderKey,
+                                                       line.reg, line.assignRows, assignedMat);
+                }
+            }
+        }
+        ImGui::PopID();
+    }
+    if (nested) {
+        ImGui::Unindent();
+    }
+}
+
+// Shader combo items: the static part of each label is formatted once per shader,
+// and the filtered index list is rebuilt only when the filter text or shader list changes.
+struct ShaderComboEntry {
+    uintptr_t key = 0;
+    // False while the hash is the pointer fallback; relabelled once bytecode is known.
+    bool bytecodeHash = false;
+    char label[64] = {};
+};
 
-    float ms = static_cast<float>(delta * 1000.0);
-    g_frameTimeHistory[g_frameTimeIndex] = ms;
-    g_frameTimeIndex = (g_frameTimeIndex + 1) % kFrameTimeHistory;
-    if (g_frameTimeCount < kFrameTimeHistory) {
-        g_frameTimeCount++;
+static std::vector<ShaderComboEntry> g_shaderComboEntries;
+static std::vector<int> g_shaderComboFiltered;
+static ImGuiTextFilter g_shaderComboFilter;
+static char g_shaderComboFilterApplied[IM_ARRAYSIZE(g_shaderComboFilter.InputBuf)] = {};
+static bool g_shaderComboFilterDirty = true;
+static unsigned int g_shaderComboGeneration = 0;
+
+static void FormatShaderComboEntry(ShaderComboEntry* entry) {
+    uint32_t hash = 0;
+    entry->bytecodeHash = TryGetShaderBytecodeHash(entry->key, &hash);
+    if (!entry->bytecodeHash) {
+        hash = GetShaderHashForKey(entry->key);
     }
+    snprintf(entry->label, sizeof(entry->label), "0x%p (hash 0x%08X)", reinterpret_cast<void*>(entry->key), hash);
+}
 
-    if (g_frameTimeSamples == 0) {
-        g_frameTimeMin = ms;
-        g_frameTimeMax = ms;
-    } else {
-        if (ms < g_frameTimeMin) g_frameTimeMin = ms;
-        if (ms > g_frameTimeMax) g_frameTimeMax = ms;
+static void SyncShaderComboEntries() {
+    // Between removals g_shaderOrder only grows, so new shaders are appended.
+    if (g_shaderComboGeneration != g_shaderOrderGeneration) {
+        g_shaderComboGeneration = g_shaderOrderGeneration;
+        g_shaderComboEntries.clear();
+        g_shaderComboFilterDirty = true;
+    }
+    for (size_t i = g_shaderComboEntries.size(); i < g_shaderOrder.size(); i++) {
+        ShaderComboEntry entry;
+        entry.key = g_shaderOrder[i];
+        FormatShaderComboEntry(&entry);
+        g_shaderComboEntries.push_back(entry);
+        g_shaderComboFilterDirty = true;
+    }
+    for (ShaderComboEntry& entry : g_shaderComboEntries) {
+        uint32_t hash = 0;
+        if (!entry.bytecodeHash && TryGetShaderBytecodeHash(entry.key, &hash)) {
+            FormatShaderComboEntry(&entry);
+            g_shaderComboFilterDirty = true;
+        }
+    }
+    if (!g_shaderComboFilterDirty && strcmp(g_shaderComboFilterApplied, g_shaderComboFilter.InputBuf) == 0) {
+        return;
+    }
+    g_shaderComboFilterDirty = false;
+    memcpy(g_shaderComboFilterApplied, g_shaderComboFilter.InputBuf, sizeof(g_shaderComboFilterApplied));
+    g_shaderComboFiltered.clear();
+    for (size_t i = 0; i < g_shaderComboEntries.size(); i++) {
+        if (g_shaderComboFilter.PassFilter(g_shaderComboEntries[i].label)) {
+            g_shaderComboFiltered.push_back(static_cast<int>(i));
+        }
     }
-    g_frameTimeSum += ms;
-    g_frameTimeSamples++;
 }
 
-static void RenderImGuiOverlay() {
+// rebuild == false: the async worker owns the state the tabs read, so the draw
+// data built at the last owning Present is submitted again unchanged.
+static void RenderImGuiOverlay(bool rebuild) {
     if (!g_imguiInitialized || !g_showImGui) {
         return;
     }
+    if (!rebuild) {
+        if (ImDrawData* drawData = ImGui::GetDrawData()) {
+            g_isRenderingImGui = true;
+            ImGui_ImplDX9_RenderDrawData(drawData);
+            g_isRenderingImGui = false;
+        }
+        return;
+    }
 
     ApplyImGuiScale(g_imguiHwnd);
     ImGui_ImplDX9_NewFrame();
@@ -1567,6 +3214,18 @@ static void RenderImGuiOverlay() {
     if (g_manualEmitStatus[0] != '\0') {
         ImGui::TextWrapped("%s", g_manualEmitStatus);
     }
+    if (ImGui::Checkbox("Emit transforms on change only", &g_config.emitTransformsOnChangeOnly)) {
+        SaveConfigBoolValue("EmitTransformsOnChangeOnly", g_config.emitTransformsOnChangeOnly);
+    }
+    ImGui::SameLine();
+    ImGui::Text("SetTransform sent: %llu, skipped: %llu", g_transformEmitSent, g_transformEmitSkipped);
+    ImGui::Text("Game SetTransform suppressed: %llu, GetTransform answered locally: %llu",
+                g_transformGameSetsSuppressed, g_transformGetsAnsweredLocally);
+    if (ImGui::Checkbox("Skip screen-space draws", &g_config.skipScreenSpaceDraws)) {
+        SaveConfigBoolValue("SkipScreenSpaceDraws", g_config.skipScreenSpaceDraws);
+    }
+    ImGui::SameLine();
+    ImGui::Text("Screen-space draws skipped: %llu", g_screenSpaceDrawsSkipped);
 
     ImGui::Checkbox("Show FPS stats", &g_showFpsStats);
     ImGui::Checkbox("Show transposed matrices", &g_showTransposedMatrices);
@@ -1587,6 +3246,8 @@ static void RenderImGuiOverlay() {
                          nullptr, 0.0f, graphMaxMs,
                          ImVec2(0, 80));
         ImGui::PopStyleColor(2);
+        ImGui::Text("Matrix kernels: %s%s", ActiveMatrixKernels().name,
+                    DetectedCpuFeatures().avx ? " (AVX available, not used)" : "");
     }
 
     ImGui::Separator();
@@ -1628,6 +3289,9 @@ static void RenderImGuiOverlay() {
                 if (g_profileStatusMessage[0] != '\0') {
                     ImGui::TextWrapped("%s", g_profileStatusMessage);
                 }
+                if (g_profileDrawStatusMessage[0] != '\0') {
+                    ImGui::TextWrapped("%s", g_profileDrawStatusMessage);
+                }
             }
             else if (g_activeGameProfile == GameProfile_DevilMayCry4) {
                 ImGui::Text("DMC4 layout: MVP=c0-c3, World=c0-c3, View=c4-c7, Projection=c8-c11");
@@ -1638,6 +3302,9 @@ static void RenderImGuiOverlay() {
                 if (g_profileStatusMessage[0] != '\0') {
                     ImGui::TextWrapped("%s", g_profileStatusMessage);
                 }
+                if (g_profileDrawStatusMessage[0] != '\0') {
+                    ImGui::TextWrapped("%s", g_profileDrawStatusMessage);
+                }
             }
             ImGui::Separator();
             DrawMatrixWithTranspose("World", g_cameraMatrices.world, g_cameraMatrices.hasWorld,
@@ -1674,11 +3341,13 @@ static void RenderImGuiOverlay() {
                     if (ImGui::RadioButton("Manual matrix", g_config.experimentalCustomProjectionMode == 1)) {
                         g_config.experimentalCustomProjectionMode = 1;
                         SaveConfigRegisterValue("ExperimentalCustomProjectionMode", g_config.experimentalCustomProjectionMode);
+                        InvalidateCustomProjectionCache();
                     }
                     ImGui::SameLine();
                     if (ImGui::RadioButton("Auto-generate", g_config.experimentalCustomProjectionMode == 2)) {
                         g_config.experimentalCustomProjectionMode = 2;
                         SaveConfigRegisterValue("ExperimentalCustomProjectionMode", g_config.experimentalCustomProjectionMode);
+                        InvalidateCustomProjectionCache();
                     }
 
                     if (ImGui::Checkbox("Override detected projection", &g_config.experimentalCustomProjectionOverrideDetectedProjection)) {
@@ -1715,34 +3384,48 @@ static void RenderImGuiOverlay() {
                                 snprintf(key, sizeof(key), "ExperimentalCustomProjectionM%d%d", row, col);
                                 SaveConfigFloatValue(key, values[i]);
                             }
+                            InvalidateCustomProjectionCache();
                         }
                     } else {
                         if (ImGui::SliderFloat("Auto FOV (deg)", &g_config.experimentalCustomProjectionAutoFovDeg, 1.0f, 179.0f, "%.2f")) {
                             SaveConfigFloatValue("ExperimentalCustomProjectionAutoFovDeg", g_config.experimentalCustomProjectionAutoFovDeg);
+                            InvalidateCustomProjectionCache();
                         }
                         if (ImGui::InputFloat("Auto Near Z", &g_config.experimentalCustomProjectionAutoNearZ, 0.01f, 0.1f, "%.6f")) {
                             SaveConfigFloatValue("ExperimentalCustomProjectionAutoNearZ", g_config.experimentalCustomProjectionAutoNearZ);
+                            InvalidateCustomProjectionCache();
                         }
                         if (ImGui::InputFloat("Auto Far Z", &g_config.experimentalCustomProjectionAutoFarZ, 1.0f, 10.0f, "%.3f")) {
                             SaveConfigFloatValue("ExperimentalCustomProjectionAutoFarZ", g_config.experimentalCustomProjectionAutoFarZ);
+                            InvalidateCustomProjectionCache();
                         }
                         if (ImGui::InputFloat("Aspect fallback", &g_config.experimentalCustomProjectionAutoAspectFallback, 0.01f, 0.1f, "%.6f")) {
                             SaveConfigFloatValue("ExperimentalCustomProjectionAutoAspectFallback", g_config.experimentalCustomProjectionAutoAspectFallback);
+                            InvalidateCustomProjectionCache();
                         }
                         int handednessIndex = g_config.experimentalCustomProjectionAutoHandedness == ProjectionHandedness_Right ? 1 : 0;
                         if (ImGui::RadioButton("Left-handed", handednessIndex == 0)) {
                             g_config.experimentalCustomProjectionAutoHandedness = ProjectionHandedness_Left;
                             SaveConfigRegisterValue("ExperimentalCustomProjectionAutoHandedness", g_config.experimentalCustomProjectionAutoHandedness);
+                            InvalidateCustomProjectionCache();
                         }
                         ImGui::SameLine();
                         if (ImGui::RadioButton("Right-handed", handednessIndex == 1)) {
                             g_config.experimentalCustomProjectionAutoHandedness = ProjectionHandedness_Right;
                             SaveConfigRegisterValue("ExperimentalCustomProjectionAutoHandedness", g_config.experimentalCustomProjectionAutoHandedness);
+                            InvalidateCustomProjectionCache();
                         }
                     }
 
-                    if (g_customProjectionStatus[0] != '\0') {
-                        ImGui::TextWrapped("%s", g_customProjectionStatus);
+                    const CustomProjectionStatusInfo& status = g_customProjectionStatusInfo;
+                    if (status.active && status.usedAuto) {
+                        ImGui::TextWrapped("Experimental projection active (auto): %ux%u aspect=%.4f fov=%.2f near=%.4f far=%.2f.",
+                                           status.width, status.height, status.aspect,
+                                           g_config.experimentalCustomProjectionAutoFovDeg,
+                                           g_config.experimentalCustomProjectionAutoNearZ,
+                                           g_config.experimentalCustomProjectionAutoFarZ);
+                    } else if (status.active) {
+                        ImGui::TextWrapped("Experimental projection active (manual matrix mode).");
                     }
                 }
             }
@@ -1764,6 +3447,7 @@ static void RenderImGuiOverlay() {
                 }
                 if (ImGui::Checkbox("Force Decomposition", &g_config.combinedMVPForceDecomposition)) {
                     SaveConfigBoolValue("CombinedMVPForceDecomposition", g_config.combinedMVPForceDecomposition);
+                    ApplyReconstructionConfig();
                 }
                 if (ImGui::Checkbox("Log Decomposition", &g_config.combinedMVPLogDecomposition)) {
                     SaveConfigBoolValue("CombinedMVPLogDecomposition", g_config.combinedMVPLogDecomposition);
@@ -1779,6 +3463,10 @@ static void RenderImGuiOverlay() {
                 ImGui::Text("Decomposition succeeded: %s", g_combinedMvpDebug.succeeded ? "yes" : "no");
                 ImGui::Text("Extracted FOV: %.2f deg", g_combinedMvpDebug.fovRadians * 180.0f / 3.14159265f);
                 ImGui::Text("Handedness: %s", ProjectionHandednessLabel(g_combinedMvpDebug.handedness));
+                ImGui::Text("Decomposition cache: %llu hits, %llu misses",
+                            g_cameraDerivationCache.decompositionHits, g_cameraDerivationCache.decompositionMisses);
+                ImGui::Text("Inverse projection cache: %llu hits, %llu misses",
+                            g_cameraDerivationCache.projectionHits, g_cameraDerivationCache.projectionMisses);
             }
 
             ImGui::Separator();
@@ -1810,6 +3498,76 @@ static void RenderImGuiOverlay() {
 
         if (ImGui::BeginTabItem("Constants")) {
             ImGui::Text("Per-shader snapshots update every frame.");
+            ImGui::Text("Constant uploads: %llu (%llu unchanged, skipped analysis)",
+                        g_constantUploadCount, g_constantFastPathCount);
+            if (g_asyncClassifier.Running()) {
+                ImGui::Text("Async classification: %llu frame(s) behind, worker %.2f ms (max %.2f), %llu batches, %llu late, %llu dropped",
+                            static_cast<unsigned long long>(g_asyncClassifier.LatencyFrames(static_cast<uint64_t>(g_frameCount))),
+                            g_asyncClassifier.LastProcessMs(), g_asyncClassifier.MaxProcessMs(),
+                            static_cast<unsigned long long>(g_asyncClassifier.ProcessedFrames()),
+                            static_cast<unsigned long long>(g_asyncClassifier.LateFrames()),
+                            static_cast<unsigned long long>(g_asyncClassifier.DroppedFrames()));
+            }
+            ImGui::Text("Tracked shaders: %d, constant pool: %.1f KB",
+                        static_cast<int>(g_shaderSlotIndex.size()),
+                        static_cast<double>(g_constantPoolBytes) / 1024.0);
+            int lockedLayouts = 0;
+            for (const auto& entry : g_learnedLayouts) {
+                if (entry.second.locked) {
+                    lockedLayouts++;
+                }
+            }
+            ImGui::Text("Learned layouts: %d/%d locked, %llu locked uploads, %llu full scans, %llu validation failures",
+                        lockedLayouts, static_cast<int>(g_learnedLayouts.size()),
+                        g_layoutLockedUploads, g_layoutFullScans, g_layoutValidationFailures);
+            ImGui::Text("Incremental scans: %llu of the full scans, %.1f windows re-classified per scan",
+                        g_layoutIncrementalScans,
+                        g_layoutIncrementalScans > 0 ? static_cast<double>(g_layoutIncrementalWindows) /
+                                                           static_cast<double>(g_layoutIncrementalScans)
+                                                     : 0.0);
+            ImGui::SameLine();
+            if (ImGui::Button("Reset learned layouts")) {
+                ResetLearnedLayouts();
+            }
+            if (g_config.layoutCacheEnabled) {
+                ImGui::Text("Layout cache: %llu uploads resolved from cached layouts", g_layoutCacheSeededUploads);
+                ImGui::SameLine();
+                if (ImGui::Button("Save layout cache")) {
+                    SaveLayoutCache(true);
+                }
+            }
+            if (g_layoutCacheStatus[0] != '\0') {
+                static const char* const kWriteStateText[] = { "", " (writing)", " (written)", " (write failed)" };
+                ImGui::TextWrapped("%s%s", g_layoutCacheStatus,
+                                   kWriteStateText[g_layoutCacheWriteState.load(std::memory_order_acquire)]);
+            }
+            int confirmedPalettes = 0;
+            for (const auto& entry : g_bonePalettes) {
+                if (entry.second.confirmed) {
+                    confirmedPalettes++;
+                }
+            }
+            ImGui::Text("Bone palettes: %d confirmed, %llu uploads excluded (%llu registers skipped)",
+                        confirmedPalettes, g_bonePaletteExcludedUploads, g_bonePaletteExcludedRegisters);
+            ImGui::SameLine();
+            if (ImGui::Button("Reset bone palettes")) {
+                ResetBonePalettes();
+            }
+            if (confirmedPalettes > 0 && ImGui::TreeNode("Excluded bone palette ranges")) {
+                for (const auto& entry : g_bonePalettes) {
+                    const BonePaletteTracker& tracker = entry.second;
+                    if (!tracker.confirmed) {
+                        continue;
+                    }
+                    const UINT uploadStart = static_cast<UINT>((entry.first >> 16) & 0xFFFFu);
+                    const UINT uploadCount = static_cast<UINT>(entry.first & 0xFFFFu);
+                    ImGui::Text("hash 0x%08X  upload c%u-c%u  palette c%u-c%u (%u bones, %u invalidations)",
+                                static_cast<uint32_t>(entry.first >> 32), uploadStart, uploadStart + uploadCount - 1,
+                                tracker.range.startRegister, tracker.range.startRegister + tracker.range.registerCount - 1,
+                                tracker.range.registerCount / tracker.range.boneStride, tracker.invalidations);
+                }
+                ImGui::TreePop();
+            }
             if (g_selectedShaderKey == 0) {
                 if (g_activeShaderKey != 0) {
                     g_selectedShaderKey = g_activeShaderKey;
@@ -1820,29 +3578,45 @@ static void RenderImGuiOverlay() {
             if (!g_shaderOrder.empty()) {
                 char preview[128];
                 BuildShaderComboLabel(g_selectedShaderKey, preview, sizeof(preview));
-                if (ImGui::BeginCombo("Shader", preview)) {
-                    for (uintptr_t key : g_shaderOrder) {
-                        char itemLabel[128];
-                        BuildShaderComboLabel(key, itemLabel, sizeof(itemLabel));
-                        ShaderConstantState* itemState = GetShaderState(key, false);
-                        float flashStrength = GetShaderFlashStrength(itemState);
-                        if (flashStrength > 0.0f) {
-                            ImGui::PushStyleColor(ImGuiCol_Text,
-                                                  ImVec4(1.00f,
-                                                         0.35f + 0.45f * flashStrength,
-                                                         0.35f + 0.45f * flashStrength,
-                                                         1.00f));
-                        }
-                        bool selected = (key == g_selectedShaderKey);
-                        if (ImGui::Selectable(itemLabel, selected)) {
-                            g_selectedShaderKey = key;
-                            g_selectedRegister = -1;
-                        }
-                        if (flashStrength > 0.0f) {
-                            ImGui::PopStyleColor();
-                        }
-                        if (selected) {
-                            ImGui::SetItemDefaultFocus();
+                if (ImGui::BeginCombo("Shader", preview, ImGuiComboFlags_HeightLarge)) {
+                    if (ImGui::IsWindowAppearing()) {
+                        ImGui::SetKeyboardFocusHere();
+                    }
+                    g_shaderComboFilter.Draw("Filter");
+                    SyncShaderComboEntries();
+                    ImGuiListClipper clipper;
+                    clipper.Begin(static_cast<int>(g_shaderComboFiltered.size()));
+                    while (clipper.Step()) {
+                        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                            const ShaderComboEntry& entry = g_shaderComboEntries[g_shaderComboFiltered[i]];
+                            ShaderConstantState* itemState = GetShaderState(entry.key, false);
+                            float flashStrength = GetShaderFlashStrength(itemState);
+                            if (flashStrength > 0.0f) {
+                                ImGui::PushStyleColor(ImGuiCol_Text,
+                                                      ImVec4(1.00f,
+                                                             0.35f + 0.45f * flashStrength,
+                                                             0.35f + 0.45f * flashStrength,
+                                                             1.00f));
+                            }
+                            bool selected = (entry.key == g_selectedShaderKey);
+                            if (ImGui::Selectable(entry.label, selected)) {
+                                g_selectedShaderKey = entry.key;
+                                g_selectedRegister = -1;
+                            }
+                            const bool disabled = IsShaderDisabled(entry.key);
+                            if (entry.key == g_activeShaderKey || disabled || flashStrength > 0.0f) {
+                                ImGui::SameLine();
+                                ImGui::TextDisabled("%s%s%s",
+                                                    entry.key == g_activeShaderKey ? "(active)" : "",
+                                                    disabled ? " [DISABLED]" : "",
+                                                    flashStrength > 0.0f ? " [changed]" : "");
+                            }
+                            if (flashStrength > 0.0f) {
+                                ImGui::PopStyleColor();
+                            }
+                            if (selected) {
+                                ImGui::SetItemDefaultFocus();
+                            }
                         }
                     }
                     ImGui::EndCombo();
@@ -1852,6 +3626,33 @@ static void RenderImGuiOverlay() {
                 if (ImGui::Checkbox("Disable shader draws", &disableSelected)) {
                     SetShaderDisabled(g_selectedShaderKey, disableSelected);
                 }
+                if (const ShaderSlot* selectedSlot = g_selectedShaderKey != 0 ? FindShaderSlot(g_selectedShaderKey) : nullptr) {
+                    ImGui::SameLine();
+                    bool screenSpace = (selectedSlot->screenSpace & ScreenSpace_Listed) != 0;
+                    if (ImGui::Checkbox("Screen-space (no SetTransform)", &screenSpace)) {
+                        SetShaderScreenSpaceListed(g_selectedShaderKey, screenSpace);
+                    }
+                    if (selectedSlot->screenSpace & ScreenSpace_Ortho) {
+                        ImGui::SameLine();
+                        ImGui::TextDisabled("(orthographic upload detected)");
+                    }
+                }
+                const VertexShaderRecord* record = FindVertexShaderRecord(g_selectedShaderKey);
+                if (record && record->bytecodeSize != 0) {
+                    ImGui::Text("Bytecode: vs_%u_%u, %u bytes, %d CTAB float4 constants",
+                                static_cast<unsigned>(D3DSHADER_VERSION_MAJOR(record->shaderVersion)),
+                                static_cast<unsigned>(D3DSHADER_VERSION_MINOR(record->shaderVersion)),
+                                record->bytecodeSize,
+                                static_cast<int>(record->constantTable.size()));
+                    if (!record->constantTable.empty() && ImGui::TreeNode("Constant table")) {
+                        for (const ShaderConstantTableEntry& entry : record->constantTable) {
+                            ImGui::Text("c%d-c%d  %s", entry.registerIndex,
+                                        entry.registerIndex + entry.registerCount - 1,
+                                        entry.name[0] ? entry.name : "<unnamed>");
+                        }
+                        ImGui::TreePop();
+                    }
+                }
             } else {
                 ImGui::Text("<no shader constants captured yet>");
             }
@@ -1886,22 +3687,23 @@ static void RenderImGuiOverlay() {
                 ImGui::Text("Selected register: c%d", g_selectedRegister);
                 if (editState && g_selectedRegister < kMaxConstantRegisters) {
                     float editValues[4] = {};
-                    if (editState->overrideValid[g_selectedRegister]) {
-                        memcpy(editValues, editState->overrideConstants[g_selectedRegister], sizeof(editValues));
-                    } else if (editState->valid[g_selectedRegister]) {
+                    if (editState->overrides && editState->overrides->valid[g_selectedRegister]) {
+                        memcpy(editValues, editState->overrides->constants[g_selectedRegister], sizeof(editValues));
+                    } else if (IsConstantValid(*editState, g_selectedRegister)) {
                         memcpy(editValues, editState->constants[g_selectedRegister], sizeof(editValues));
                     }
 
                     if (ImGui::InputFloat4("Override values", editValues, "%.6f")) {
-                        memcpy(editState->overrideConstants[g_selectedRegister], editValues,
-                               sizeof(editState->overrideConstants[g_selectedRegister]));
-                        editState->overrideValid[g_selectedRegister] = true;
+                        ShaderConstantOverrides* overrides = EnsureShaderOverrides(*editState);
+                        memcpy(overrides->constants[g_selectedRegister], editValues,
+                               sizeof(overrides->constants[g_selectedRegister]));
+                        overrides->valid[g_selectedRegister] = true;
                         if (g_overrideScopeMode == Override_OneFrame) {
-                            editState->overrideFramesRemaining[g_selectedRegister] = 1;
+                            overrides->framesRemaining[g_selectedRegister] = 1;
                         } else if (g_overrideScopeMode == Override_NFrames) {
-                            editState->overrideFramesRemaining[g_selectedRegister] = g_overrideNFrames;
+                            overrides->framesRemaining[g_selectedRegister] = g_overrideNFrames;
                         } else {
-                            editState->overrideFramesRemaining[g_selectedRegister] = -1;
+                            overrides->framesRemaining[g_selectedRegister] = -1;
                         }
                     }
                     ImGui::SameLine();
@@ -1911,134 +3713,30 @@ static void RenderImGuiOverlay() {
                     if (!g_enableShaderEditing) {
                         ImGui::TextDisabled("Editing is armed but inactive until enabled.");
                     }
+                    // Variance tracking starts the first time a register of this shader is inspected.
+                    const ShaderConstantVariance* variance = EnsureShaderVariance(*editState);
+                    ImGui::Text("Variance (since first inspected): %.6f",
+                                GetVarianceMagnitude(*variance, g_selectedRegister));
                 }
             }
 
             ImGui::BeginChild("ConstantsScroll", ImVec2(0, 270), true);
             ShaderConstantState* state = GetShaderState(g_selectedShaderKey, false);
-            if (state && state->snapshotReady) {
-                if (g_showConstantsAsMatrices) {
-                    for (int base = 0; base < kMaxConstantRegisters; base += 4) {
-                        D3DMATRIX mat = {};
-                        bool looksLike = false;
-                        bool hasMatrix = TryBuildMatrixSnapshotInfo(*state, base, &mat, &looksLike);
-
-                        if (g_filterDetectedMatrices) {
-                            if (!hasMatrix || !looksLike) {
-                                continue;
-                            }
-                        } else {
-                            bool anyValid = false;
-                            for (int reg = base; reg < base + 4; reg++) {
-                                if (state->valid[reg]) {
-                                    anyValid = true;
-                                    break;
-                                }
-                            }
-                            if (!anyValid) {
-                                continue;
-                            }
-                        }
-
-                        char label[64];
-                        snprintf(label, sizeof(label), "c%d-c%d%s", base, base + 3,
-                                 looksLike ? " (matrix)" : "");
-                        ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow |
-                                                   ImGuiTreeNodeFlags_SpanAvailWidth;
-                        if (g_selectedRegister == base) {
-                            flags |= ImGuiTreeNodeFlags_Selected;
-                        }
-                        bool open = ImGui::TreeNodeEx(label, flags);
-                        if (ImGui::IsItemClicked()) {
-                            g_selectedRegister = base;
-                        }
-                        if (open) {
-                            D3DMATRIX displayMat = mat;
-                            if (g_showTransposedMatrices && hasMatrix) {
-                                displayMat = TransposeMatrix(mat);
-                            }
-                            for (int reg = base; reg < base + 4; reg++) {
-                                char rowLabel[128];
-                                if (state->valid[reg]) {
-                                    if (g_showTransposedMatrices && hasMatrix) {
-                                        int row = reg - base;
-                                        const float* data = reinterpret_cast<const float*>(&displayMat) + row * 4;
-                                        snprintf(rowLabel, sizeof(rowLabel), "r%d: [%.3f %.3f %.3f %.3f]###reg_%d",
-                                                 row, data[0], data[1], data[2], data[3], reg);
-                                    } else {
-                                        const float* data = state->constants[reg];
-                                        snprintf(rowLabel, sizeof(rowLabel), "c%d: [%.3f %.3f %.3f %.3f]###reg_%d",
-                                                 reg, data[0], data[1], data[2], data[3], reg);
-                                    }
-                                } else {
-                                    snprintf(rowLabel, sizeof(rowLabel), "c%d: <unset>###reg_%d", reg, reg);
-                                }
-                                bool selected = (g_selectedRegister == reg);
-                                ImGui::PushID(reg);
-                                if (ImGui::Selectable(rowLabel, selected)) {
-                                    g_selectedRegister = reg;
-                                }
-                                ImGui::PopID();
-                            }
-
-                            int selectedRows = g_manualAssignRows;
-                            if (selectedRows == 3 && !state->valid[base + 2]) {
-                                selectedRows = 4;
-                            }
-                            bool canAssign = state->valid[base] && state->valid[base + 1] && state->valid[base + 2] &&
-                                             (selectedRows == 3 || state->valid[base + 3]);
-                            if (canAssign) {
-                                D3DMATRIX assignedMat = {};
-                                if (!TryBuildMatrixSnapshot(*state, base, selectedRows, false, &assignedMat)) {
-                                    canAssign = false;
-                                }
-                                if (canAssign) {
-                                    ImGui::PushID(base);
-                                    if (ImGui::Button("Use as World")) {
-                                        TryAssignManualMatrixFromSelection(MatrixSlot_World, g_selectedShaderKey,
-                                                                           base, selectedRows, assignedMat);
-                                    }
-                                    ImGui::SameLine();
-                                    if (ImGui::Button("Use as View")) {
-                                        TryAssignManualMatrixFromSelection(MatrixSlot_View, g_selectedShaderKey,
-                                                                           base, selectedRows, assignedMat);
-                                    }
-                                    ImGui::SameLine();
-                                    if (ImGui::Button("Use as Projection")) {
-                                        TryAssignManualMatrixFromSelection(MatrixSlot_Projection, g_selectedShaderKey,
-                                                                           base, selectedRows, assignedMat);
-                                    }
-                                    ImGui::SameLine();
-                                    if (ImGui::Button("Use as MVP")) {
-                                        TryAssignManualMatrixFromSelection(MatrixSlot_MVP, g_selectedShaderKey,
-                                                                           base, selectedRows, assignedMat);
-                                    }
-                                    ImGui::PopID();
-                                }
-                            }
-                            ImGui::TreePop();
-                        }
-                    }
-                } else {
-                    for (int reg = 0; reg < kMaxConstantRegisters; reg++) {
-                        if (!state->valid[reg]) {
-                            continue;
-                        }
-                        const float* data = state->constants[reg];
-                        char rowLabel[128];
-                        snprintf(rowLabel, sizeof(rowLabel), "c%d: [%.3f %.3f %.3f %.3f]###reg_%d",
-                                 reg, data[0], data[1], data[2], data[3], reg);
-                        ImGui::PushID(reg);
-                        if (ImGui::Selectable(rowLabel, g_selectedRegister == reg)) {
-                            g_selectedRegister = reg;
-                        }
-                        ImGui::PopID();
+            if (state && IsSnapshotReady(*state)) {
+                const ConstantsViewModel& view = UpdateConstantsViewModel(g_selectedShaderKey, *state);
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(view.lines.size()));
+                while (clipper.Step()) {
+                    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                        DrawConstantsViewLine(view.lines[i], *state);
                     }
                 }
             } else {
                 ImGui::Text("<no constants captured yet>");
             }
             ImGui::EndChild();
+            ImGui::TextDisabled("%d rows, view rebuilt %llu times", static_cast<int>(g_constantsView.lines.size()),
+                                g_constantsViewRebuilds);
             ImGui::EndTabItem();
         }
 
@@ -2047,73 +3745,330 @@ static void RenderImGuiOverlay() {
                 StartMemoryScanner();
             }
             ImGui::SameLine();
-            ImGui::Text("Status: %s", g_memoryScannerThread ? "running" : "idle");
+            const bool scanRunning = g_memoryScanRunning.load(std::memory_order_acquire);
+            ImGui::Text("Status: %s", scanRunning ? "running" : "idle");
             ImGui::SameLine();
+            if (scanRunning) {
+                if (ImGui::Button("Cancel scan")) {
+                    CancelMemoryScanner();
+                }
+                ImGui::SameLine();
+            }
             if (ImGui::Button("Clear results")) {
-                std::lock_guard<std::mutex> lock(g_uiDataMutex);
-                g_memoryScanResults.clear();
-                g_memoryScanHits.clear();
+                ClearMemoryScanResults();
+            }
+            if (ImGui::Checkbox("Scan all committed RW regions", &g_config.memoryScannerAllRegions)) {
+                SaveConfigBoolValue("MemoryScannerAllRegions", g_config.memoryScannerAllRegions);
+            }
+            const uint64_t scanTotal = g_memoryScanBytesTotal.load(std::memory_order_relaxed);
+            const uint64_t scanDone = g_memoryScanBytesDone.load(std::memory_order_relaxed);
+            const float scanFraction = scanTotal > 0
+                ? static_cast<float>(static_cast<double>(scanDone) / static_cast<double>(scanTotal))
+                : 0.0f;
+            char scanProgressLabel[96];
+            snprintf(scanProgressLabel, sizeof(scanProgressLabel), "%.1f / %.1f MB",
+                     static_cast<double>(scanDone) / (1024.0 * 1024.0),
+                     static_cast<double>(scanTotal) / (1024.0 * 1024.0));
+            ImGui::ProgressBar(scanFraction, ImVec2(-1.0f, 0.0f), scanProgressLabel);
+            ImGui::Text("Regions: %u (%u proxy-owned skipped) | Workers: %d | Hits: %d | Unreadable chunks: %u | Last scan: %u ms",
+                        g_memoryScanRegionCount.load(std::memory_order_relaxed),
+                        g_memoryScanProxyRegions.load(std::memory_order_relaxed),
+                        g_memoryScanWorkerCount.load(std::memory_order_relaxed),
+                        (std::min)(g_memoryScanHitCount.load(std::memory_order_relaxed), g_config.memoryScannerMaxResults),
+                        g_memoryScanUnreadableChunks.load(std::memory_order_relaxed),
+                        g_memoryScanLastDurationMs.load(std::memory_order_relaxed));
+            ImGui::Separator();
+            ImGui::Text("Pointer tracking (rescans triggered: %llu)", g_memoryTrackRescans);
+            const MatrixSlot trackedSlots[] = { MatrixSlot_View, MatrixSlot_Projection };
+            for (MatrixSlot slot : trackedSlots) {
+                const MemoryTrackedMatrix& tracked = g_memoryTracked[slot];
+                ImGui::PushID(static_cast<int>(slot));
+                if (tracked.active) {
+                    ImGui::Text("%s @ 0x%p: %s, hash 0x%08X, %llu frames",
+                                MemoryTrackedSlotLabel(slot), reinterpret_cast<void*>(tracked.address),
+                                tracked.valid ? "valid" : "validation failing",
+                                tracked.hash, tracked.framesTracked);
+                    ImGui::SameLine();
+                    if (ImGui::SmallButton("Stop")) {
+                        StopTrackingMemoryMatrix(slot);
+                    }
+                } else if (tracked.reacquirePending) {
+                    ImGui::Text("%s: lost, waiting for rescan", MemoryTrackedSlotLabel(slot));
+                } else {
+                    ImGui::Text("%s: not tracked", MemoryTrackedSlotLabel(slot));
+                }
+                ImGui::PopID();
             }
             ImGui::Separator();
             ImGui::Text("Memory scan output");
             ImGui::BeginChild("MemoryScanResults", ImVec2(0, 360), true);
-            {
-                std::lock_guard<std::mutex> lock(g_uiDataMutex);
-                if (g_memoryScanHits.empty()) {
-                    ImGui::Text("<no scan results>");
-                } else {
-                    for (size_t i = 0; i < g_memoryScanHits.size(); ++i) {
-                        const MemoryScanHit& hit = g_memoryScanHits[i];
-                        ImGui::PushID(static_cast<int>(i));
-                        ImGui::TextWrapped("%s", hit.label.c_str());
-                        if (ImGui::Button("Use as View")) {
-                            StoreViewMatrix(hit.matrix, 0, -1, 4, false, true, "memory scanner");
+            if (g_memoryScanHits.empty()) {
+                ImGui::Text("<no scan results>");
+            } else {
+                for (size_t i = 0; i < g_memoryScanHits.size(); ++i) {
+                    const MemoryScanHit& hit = g_memoryScanHits[i];
+                    ImGui::PushID(static_cast<int>(i));
+                    ImGui::TextWrapped("%s", hit.label.c_str());
+                    if (ImGui::Button("Use as View")) {
+                        StoreViewMatrix(hit.matrix, 0, 0, -1, 4, false, true, "memory scanner");
+                        snprintf(g_matrixAssignStatus, sizeof(g_matrixAssignStatus),
+                                 "Assigned VIEW from memory scan @ 0x%p (hash 0x%08X).",
+                                 reinterpret_cast<void*>(hit.address), hit.hash);
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Use as Projection")) {
+                        StoreProjectionMatrix(hit.matrix, 0, 0, -1, 4, false, true, "memory scanner");
+                        snprintf(g_matrixAssignStatus, sizeof(g_matrixAssignStatus),
+                                 "Assigned PROJECTION from memory scan @ 0x%p (hash 0x%08X).",
+                                 reinterpret_cast<void*>(hit.address), hit.hash);
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Track")) {
+                        if (StartTrackingMemoryMatrix(hit.slot, hit.address)) {
                             snprintf(g_matrixAssignStatus, sizeof(g_matrixAssignStatus),
-                                     "Assigned VIEW from memory scan @ 0x%p (hash 0x%08X).",
-                                     reinterpret_cast<void*>(hit.address), hit.hash);
-                        }
-                        ImGui::SameLine();
-                        if (ImGui::Button("Use as Projection")) {
-                            StoreProjectionMatrix(hit.matrix, 0, -1, 4, false, true, "memory scanner");
+                                     "Tracking %s from memory @ 0x%p every frame.",
+                                     MemoryTrackedSlotLabel(hit.slot), reinterpret_cast<void*>(hit.address));
+                        } else {
                             snprintf(g_matrixAssignStatus, sizeof(g_matrixAssignStatus),
-                                     "Assigned PROJECTION from memory scan @ 0x%p (hash 0x%08X).",
-                                     reinterpret_cast<void*>(hit.address), hit.hash);
+                                     "Not tracking 0x%p: it is the proxy's own copy of a matrix.",
+                                     reinterpret_cast<void*>(hit.address));
                         }
-                        ImGui::PopID();
-                        ImGui::Separator();
                     }
+                    ImGui::PopID();
+                    ImGui::Separator();
                 }
             }
             ImGui::EndChild();
             ImGui::EndTabItem();
         }
 
+        if (ImGui::BeginTabItem("Passes")) {
+            if (ImGui::Checkbox("Filter by render pass", &g_config.passFiltering)) {
+                SaveConfigBoolValue("PassFiltering", g_config.passFiltering);
+            }
+            ImGui::SameLine();
+            ImGui::Text("Back buffer %ux%u, uploads skipped: %llu, draws skipped: %llu",
+                        g_renderPasses.BackBufferWidth(), g_renderPasses.BackBufferHeight(),
+                        g_passUploadsSkipped, g_passDrawsSkipped);
+            ImGui::TextDisabled("A pass is one render target 0 / depth-stencil / viewport size. Ignored passes are neither\n"
+                                "classified nor sent SetTransform; emit-only passes get the camera without feeding it.");
+            static const char* kPassPolicyChoices[] = {"auto", "classify", "ignore", "emitonly"};
+            const std::vector<RenderPassInfo>& passes = g_renderPasses.Passes();
+            if (ImGui::BeginTable("RenderPasses", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Render target");
+                ImGui::TableSetupColumn("Format");
+                ImGui::TableSetupColumn("Viewport");
+                ImGui::TableSetupColumn("Draws");
+                ImGui::TableSetupColumn("Uploads");
+                ImGui::TableSetupColumn("Auto policy");
+                ImGui::TableSetupColumn("Override");
+                ImGui::TableHeadersRow();
+                for (size_t i = 0; i < passes.size(); ++i) {
+                    const RenderPassInfo& pass = passes[i];
+                    char formatLabel[32] = {};
+                    FormatSurfaceFormat(pass.targetFormat, formatLabel, sizeof(formatLabel));
+                    ImGui::PushID(static_cast<int>(i));
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%p %ux%u", reinterpret_cast<void*>(pass.key.renderTarget),
+                                pass.targetWidth, pass.targetHeight);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::TextUnformatted(formatLabel);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%ux%u", pass.key.viewportWidth, pass.key.viewportHeight);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%u", pass.drawsLastFrame);
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::Text("%u", pass.uploadsLastFrame);
+                    ImGui::TableSetColumnIndex(5);
+                    if (pass.configuredPolicy != PassPolicy_Auto) {
+                        ImGui::Text("%s (ini)", PassPolicyLabel(pass.configuredPolicy));
+                    } else {
+                        ImGui::Text("%s (learned)", PassPolicyLabel(pass.learnedPolicy));
+                    }
+                    ImGui::TableSetColumnIndex(6);
+                    int choice = pass.overridePolicy;
+                    ImGui::SetNextItemWidth(-1.0f);
+                    if (ImGui::Combo("##policy", &choice, kPassPolicyChoices, IM_ARRAYSIZE(kPassPolicyChoices))) {
+                        g_renderPasses.SetOverride(i, static_cast<PassPolicy>(choice));
+                    }
+                    ImGui::PopID();
+                }
+                ImGui::EndTable();
+            }
+            if (ImGui::Button("Save overrides by viewport size")) {
+                SaveRenderPassOverrides();
+            }
+            if (g_passStatus[0] != '\0') {
+                ImGui::SameLine();
+                ImGui::TextUnformatted(g_passStatus);
+            }
+            ImGui::EndTabItem();
+        }
+
+        if (ImGui::BeginTabItem("Profiler")) {
+#if CAMERA_PROXY_PROFILER
+            ImGui::Text("Rolling window: %d frames (%llu recorded). Times are proxy CPU cost per frame.",
+                        g_profiler.historyCount, g_profiler.framesRecorded);
+            if (ImGui::Button("Reset profiler")) {
+                ProfilerReset();
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Export CSV")) {
+                const bool exported = ProfilerExportCsv("camera_proxy_profile.csv");
+                snprintf(g_profilerStatus, sizeof(g_profilerStatus), "%s",
+                         exported ? "Wrote camera_proxy_profile.csv." : "Failed to write camera_proxy_profile.csv.");
+            }
+            if (g_profilerStatus[0] != '\0') {
+                ImGui::SameLine();
+                ImGui::TextUnformatted(g_profilerStatus);
+            }
+            if (ImGui::BeginTable("ProfilerZones", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Zone");
+                ImGui::TableSetupColumn("Calls (last)");
+                ImGui::TableSetupColumn("Calls (avg)");
+                ImGui::TableSetupColumn("us (avg)");
+                ImGui::TableSetupColumn("us p50");
+                ImGui::TableSetupColumn("us p99");
+                ImGui::TableSetupColumn("Max call us");
+                ImGui::TableHeadersRow();
+                for (int zone = 0; zone < ProfilerZone_Count; ++zone) {
+                    const ProfilerZoneSummary summary = ProfilerSummarize(static_cast<ProfilerZone>(zone));
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%s%s", kProfilerZoneInfo[zone].name,
+                                kProfilerZoneInfo[zone].includesRuntimeCall ? " *" : "");
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%u", summary.lastCalls);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.1f", summary.avgCalls);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.1f", summary.avgMicros);
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::Text("%.0f", summary.p50Micros);
+                    ImGui::TableSetColumnIndex(5);
+                    ImGui::Text("%.0f", summary.p99Micros);
+                    ImGui::TableSetColumnIndex(6);
+                    ImGui::Text("%.0f", summary.maxCallMicros);
+                }
+                ImGui::EndTable();
+            }
+            ImGui::TextDisabled("* includes the call forwarded to the real device. Classifier and\n"
+                                "EmitFixedFunctionTransforms are nested inside the hook zones.");
+#else
+            ImGui::TextWrapped("Profiler is compiled out. Rebuild with /DCAMERA_PROXY_PROFILER=1 "
+                               "(build.bat profile) to record per-hook CPU cost.");
+#endif
+            ImGui::Separator();
+            if (ImGui::Checkbox("PIX/Nsight markers (D3DPERF)", &g_config.perfMarkers)) {
+                ProxyMarkersEnable(g_config.perfMarkers);
+                SaveConfigBoolValue("PerfMarkers", g_config.perfMarkers);
+            }
+            ImGui::SameLine();
+            ImGui::TextDisabled(CAMERA_PROXY_ETW ? "ETW provider: *CameraProxy" : "ETW compiled out (build.bat etw)");
+            ImGui::Text("Present housekeeping: %u us last frame, %u us max",
+                        g_presentScheduler.LastFrameMicros(), g_presentScheduler.MaxFrameMicros());
+            if (ImGui::SliderInt("Budget (us, 0 = unlimited)", &g_config.presentTaskBudgetUs, 0, 2000)) {
+                g_presentScheduler.SetBudgetMicros(static_cast<uint32_t>(g_config.presentTaskBudgetUs));
+                SaveConfigRegisterValue("PresentTaskBudgetUs", g_config.presentTaskBudgetUs);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Reset task stats")) {
+                g_presentScheduler.ResetStats();
+            }
+            if (ImGui::BeginTable("PresentTasks", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Task");
+                ImGui::TableSetupColumn("Every N frames");
+                ImGui::TableSetupColumn("Runs");
+                ImGui::TableSetupColumn("Deferred");
+                ImGui::TableSetupColumn("us (avg)");
+                ImGui::TableSetupColumn("Max us");
+                ImGui::TableHeadersRow();
+                for (int task = 0; task < g_presentScheduler.TaskCount(); ++task) {
+                    const PresentScheduler::TaskStats& stats = g_presentScheduler.Stats(task);
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(stats.name);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%u", stats.intervalFrames);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%llu", static_cast<unsigned long long>(stats.runs));
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%llu", static_cast<unsigned long long>(stats.deferrals));
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::Text("%.1f", stats.runs ? static_cast<double>(stats.totalMicros) / stats.runs : 0.0);
+                    ImGui::TableSetColumnIndex(5);
+                    ImGui::Text("%u", stats.maxMicros);
+                }
+                ImGui::EndTable();
+            }
+            if (g_sharedCamera) {
+                ImGui::Text("Shared camera export: %s (frame %llu)", g_sharedCameraName,
+                            static_cast<unsigned long long>(g_sharedCamera->frame.frame));
+            } else {
+                ImGui::TextDisabled("Shared camera export: %s", g_sharedCameraOpenFailed ? "failed (see log)" : "off");
+            }
+            ImGui::Separator();
+            ImGui::Text("Trace capture: %s", g_config.traceCapturePath);
+            if (!g_traceWriter.IsOpen()) {
+                if (ImGui::Button("Start capture")) {
+                    g_traceCaptureRequested = true;
+                }
+            } else {
+                if (ImGui::Button("Stop capture")) {
+                    g_traceStopRequested = true;
+                }
+                ImGui::SameLine();
+                ImGui::Text("%llu records, %.1f MB", g_traceWriter.RecordCount(),
+                            static_cast<double>(g_traceWriter.ByteCount()) / (1024.0 * 1024.0));
+            }
+            if (g_traceStatus[0] != '\0') {
+                ImGui::TextWrapped("%s", g_traceStatus);
+            }
+            ImGui::TextDisabled("Replay offline: rundll32 <path>\\d3d9.dll,ReplayCameraTrace <trace file>");
+            ImGui::EndTabItem();
+        }
+
         if (ImGui::BeginTabItem("Logs")) {
             ImGui::Checkbox("Live update", &g_logsLiveUpdate);
             ImGui::SameLine();
-            if (ImGui::Button("Refresh")) {
-                RefreshLogSnapshot();
+            if (ImGui::Button("Refresh") || g_logsLiveUpdate || g_logViewEndTicket == 0) {
+                RefreshLogView();
             }
             ImGui::SameLine();
             if (ImGui::Button("Clear logs")) {
-                std::lock_guard<std::mutex> lock(g_uiDataMutex);
-                g_logLines.clear();
-                g_logSnapshot.clear();
-                g_logSnapshotDirty = false;
-            }
-            if (g_logsLiveUpdate && g_logSnapshotDirty) {
-                RefreshLogSnapshot();
-            } else if (!g_logsLiveUpdate && g_logSnapshot.empty() && g_logSnapshotDirty) {
-                RefreshLogSnapshot();
+                RefreshLogView();
+                g_logViewFirstTicket = g_logViewEndTicket;
             }
+            ImGui::Text("Ring: %u slots, %llu written, %llu truncated, %llu dropped from file, %llu slot waits, %llu file batches",
+                        kLogRingSlots,
+                        static_cast<unsigned long long>(g_logWriteTicket.load(std::memory_order_relaxed)),
+                        static_cast<unsigned long long>(g_logLinesTruncated.load(std::memory_order_relaxed)),
+                        static_cast<unsigned long long>(g_logLinesDroppedFromFile.load(std::memory_order_relaxed)),
+                        static_cast<unsigned long long>(g_logSlotWaits.load(std::memory_order_relaxed)),
+                        static_cast<unsigned long long>(g_logFileBatches.load(std::memory_order_relaxed)));
             ImGui::Separator();
-            ImGui::BeginChild("FormattedLogs", ImVec2(0, 380), true);
-            if (g_logSnapshot.empty()) {
+            ImGui::BeginChild("FormattedLogs", ImVec2(0, 380), true, ImGuiWindowFlags_HorizontalScrollbar);
+            const uint64_t firstTicket = (std::max)(g_logViewFirstTicket, OldestLiveLogTicket(g_logViewEndTicket));
+            const int lineCount = g_logViewEndTicket > firstTicket
+                ? static_cast<int>(g_logViewEndTicket - firstTicket)
+                : 0;
+            if (lineCount == 0) {
                 ImGui::Text("<no logs>");
             } else {
-                for (const std::string& line : g_logSnapshot) {
-                    ImGui::TextWrapped("%s", line.c_str());
+                char line[kLogSlotChars];
+                ImGuiListClipper clipper;
+                clipper.Begin(lineCount);
+                while (clipper.Step()) {
+                    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                        if (ReadLogRingEntry(firstTicket + static_cast<uint64_t>(i), line, sizeof(line))) {
+                            ImGui::TextUnformatted(line);
+                        } else {
+                            ImGui::TextDisabled("<overwritten>");
+                        }
+                    }
                 }
+                clipper.End();
                 if (g_logsLiveUpdate) {
                     ImGui::SetScrollHereY(1.0f);
                 }
@@ -2155,352 +4110,211 @@ static D3DPERF_SetMarker_t g_origD3DPERF_SetMarker = nullptr;
 static D3DPERF_SetOptions_t g_origD3DPERF_SetOptions = nullptr;
 static D3DPERF_SetRegion_t g_origD3DPERF_SetRegion = nullptr;
 
-static void AppendUiLogLine(const char* text) {
-    if (!text || !text[0]) {
-        return;
-    }
-    std::lock_guard<std::mutex> lock(g_uiDataMutex);
-    g_logLines.emplace_back(text);
-    g_logSnapshotDirty = true;
-    while (g_logLines.size() > kMaxUiLogLines) {
-        g_logLines.pop_front();
-    }
-}
-
-// Logging helper
-void LogMsg(const char* fmt, ...) {
-    char line[2048] = {};
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(line, sizeof(line), fmt, args);
-    va_end(args);
-
-    AppendUiLogLine(line);
-
-    if (!g_config.enableLogging || !g_logFile) return;
-
-    fprintf(g_logFile, "%s\n", line);
-    fflush(g_logFile);
-}
-
-// Check if matrix values are valid
-bool LooksLikeMatrix(const float* data) {
-    float sum = 0;
-    for (int i = 0; i < 16; i++) {
-        if (!std::isfinite(data[i])) return false;
-        sum += fabsf(data[i]);
-    }
-    if (sum < 0.001f || sum > 10000.0f) return false;
-    return true;
-}
-
-static float Dot3(float ax, float ay, float az, float bx, float by, float bz) {
-    return ax * bx + ay * by + az * bz;
-}
-
-static float Determinant3x3(const D3DMATRIX& m) {
-    return m._11 * (m._22 * m._33 - m._23 * m._32) -
-           m._12 * (m._21 * m._33 - m._23 * m._31) +
-           m._13 * (m._21 * m._32 - m._22 * m._31);
-}
-
-static bool LooksLikeViewStrict(const D3DMATRIX& m) {
-    float row0len = sqrtf(Dot3(m._11, m._12, m._13, m._11, m._12, m._13));
-    float row1len = sqrtf(Dot3(m._21, m._22, m._23, m._21, m._22, m._23));
-    float row2len = sqrtf(Dot3(m._31, m._32, m._33, m._31, m._32, m._33));
-
-    if (fabsf(row0len - 1.0f) > 0.05f) return false;
-    if (fabsf(row1len - 1.0f) > 0.05f) return false;
-    if (fabsf(row2len - 1.0f) > 0.05f) return false;
-
-    if (fabsf(Dot3(m._11, m._12, m._13, m._21, m._22, m._23)) > 0.05f) return false;
-    if (fabsf(Dot3(m._11, m._12, m._13, m._31, m._32, m._33)) > 0.05f) return false;
-    if (fabsf(Dot3(m._21, m._22, m._23, m._31, m._32, m._33)) > 0.05f) return false;
-
-    if (fabsf(m._14) > 0.01f || fabsf(m._24) > 0.01f || fabsf(m._34) > 0.01f) return false;
-    if (fabsf(m._44 - 1.0f) > 0.01f) return false;
-
-    float det = Determinant3x3(m);
-    if (fabsf(det - 1.0f) > 0.1f) return false;
-
-    return true;
-}
-
-static bool LooksLikeProjectionStrict(const D3DMATRIX& m) {
-    return AnalyzeProjectionMatrixNumeric(m, nullptr);
-}
-
-static bool IsTypicalProjectionMatrix(const D3DMATRIX& m) {
-    ProjectionAnalysis analysis = {};
-    if (!AnalyzeProjectionMatrixNumeric(m, &analysis) || !analysis.valid) {
-        return false;
-    }
-
-    const bool perspectiveTermsLookValid =
-        fabsf(m._14) <= 0.05f &&
-        fabsf(m._24) <= 0.05f &&
-        fabsf(m._44) <= 0.05f &&
-        fabsf(fabsf(m._34) - 1.0f) <= 0.05f;
-
-    return perspectiveTermsLookValid;
-}
-
-static bool AnalyzeProjectionMatrixNumeric(const D3DMATRIX& m, ProjectionAnalysis* out) {
-    constexpr float kZeroEpsilon = 0.02f;
-    constexpr float kPerspectiveEpsilon = 0.05f;
-
-    if (!std::isfinite(m._11) || !std::isfinite(m._22) || !std::isfinite(m._33) ||
-        !std::isfinite(m._34) || !std::isfinite(m._43) || !std::isfinite(m._44)) {
-        return false;
-    }
-
-    if (fabsf(m._12) > kZeroEpsilon || fabsf(m._13) > kZeroEpsilon ||
-        fabsf(m._21) > kZeroEpsilon || fabsf(m._23) > kZeroEpsilon ||
-        fabsf(m._31) > kZeroEpsilon || fabsf(m._32) > kZeroEpsilon) {
-        return false;
-    }
-
-    if (fabsf(m._14) > kZeroEpsilon || fabsf(m._24) > kZeroEpsilon) {
-        return false;
-    }
-
-    if (fabsf(fabsf(m._34) - 1.0f) > kPerspectiveEpsilon) {
-        return false;
-    }
-
-    if (fabsf(m._44) > kPerspectiveEpsilon) {
-        return false;
-    }
-
-    if (fabsf(m._11) < 0.001f || fabsf(m._22) < 0.001f) {
-        return false;
-    }
-
-    if (fabsf(m._33) < 0.0001f || fabsf(m._43) < 0.0001f) {
-        return false;
-    }
+enum LogWriterStartState : int {
+    LogWriter_Off = 0,
+    // Log file open; the first LogMsg after DllMain starts the writer.
+    LogWriter_Pending = 1,
+    LogWriter_Started = 2
+};
 
-    const float fov = 2.0f * atanf(1.0f / fabsf(m._22));
-    if (!std::isfinite(fov) || fov < g_config.minFOV || fov > g_config.maxFOV) {
-        return false;
+static std::atomic<int> g_logWriterStart{LogWriter_Off};
+static HANDLE g_logWriterThread = nullptr;
+static HANDLE g_logWriterEvent = nullptr;
+static HMODULE g_logWriterModule = nullptr;
+static std::atomic<bool> g_logWriterStop{false};
+static std::atomic<bool> g_logWriterIdle{false};
+static std::atomic<bool> g_logDrainBusy{false};
+static uint64_t g_logFileTicket = 0;
+
+// Writes every committed entry from g_logFileTicket onward in one buffered
+// batch and flushes once. If producers lapped the writer, the lost entries are
+// counted and the cursor jumps to the oldest live slot. Caller owns g_logDrainBusy.
+static void DrainLogRingToFile() {
+    if (!g_logFile) {
+        return;
     }
-
-    if (out) {
-        out->valid = true;
-        out->fovRadians = fov;
-        out->handedness = (m._34 >= 0.0f) ? ProjectionHandedness_Left : ProjectionHandedness_Right;
+    static char batch[64 * 1024];
+    size_t batchUsed = 0;
+    bool wroteAny = false;
+    for (;;) {
+        const uint64_t endTicket = g_logWriteTicket.load(std::memory_order_acquire);
+        const uint64_t oldest = OldestLiveLogTicket(endTicket);
+        if (g_logFileTicket < oldest) {
+            g_logLinesDroppedFromFile.fetch_add(oldest - g_logFileTicket, std::memory_order_relaxed);
+            g_logFileTicket = oldest;
+        }
+        if (g_logFileTicket >= endTicket) {
+            break;
+        }
+        if (batchUsed + kLogSlotChars + 1 > sizeof(batch)) {
+            fwrite(batch, 1, batchUsed, g_logFile);
+            batchUsed = 0;
+            wroteAny = true;
+        }
+        char* dst = batch + batchUsed;
+        if (ReadLogRingEntry(g_logFileTicket, dst, kLogSlotChars)) {
+            const size_t len = strlen(dst);
+            dst[len] = '\n';
+            batchUsed += len + 1;
+            ++g_logFileTicket;
+            continue;
+        }
+        const LogRingSlot& slot = g_logRing[g_logFileTicket % kLogRingSlots];
+        if (slot.sequence.load(std::memory_order_acquire) > g_logFileTicket * 2 + 2) {
+            // Overwritten before we got to it; the lap check above resyncs.
+            g_logLinesDroppedFromFile.fetch_add(1, std::memory_order_relaxed);
+            ++g_logFileTicket;
+            continue;
+        }
+        // Claimed but not committed yet; pick it up on the next wake.
+        break;
     }
-    return true;
-}
-
-static const char* ProjectionHandednessLabel(ProjectionHandedness handedness) {
-    switch (handedness) {
-        case ProjectionHandedness_Left: return "LH";
-        case ProjectionHandedness_Right: return "RH";
-        default: return "Unknown";
+    if (batchUsed > 0) {
+        fwrite(batch, 1, batchUsed, g_logFile);
+        wroteAny = true;
     }
-}
-
-static const char* CombinedMVPStrategyLabel(CombinedMVPStrategy strategy) {
-    switch (strategy) {
-        case CombinedMVPStrategy_WorldAndMVP: return "Strategy 1 (World + MVP)";
-        case CombinedMVPStrategy_MVPOnly: return "Strategy 2 (MVP only)";
-        case CombinedMVPStrategy_WorldRequiredNoWorld: return "Strategy 3 (world required, missing)";
-        case CombinedMVPStrategy_Disabled: return "Disabled";
-        case CombinedMVPStrategy_SkippedFullWVP: return "Skipped (full W/V/P already present)";
-        case CombinedMVPStrategy_Failed: return "Failed";
-        case CombinedMVPStrategy_None:
-        default:
-            return "None";
+    if (wroteAny) {
+        fflush(g_logFile);
+        g_logFileBatches.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
-static bool HasPerspectiveComponent(const D3DMATRIX& m) {
-    return fabsf(m._34) > 0.5f && fabsf(m._44) < 0.5f;
+static bool TryAcquireLogDrain() {
+    bool expected = false;
+    return g_logDrainBusy.compare_exchange_strong(expected, true, std::memory_order_acquire);
 }
 
-static bool IsAffineMatrixNoPerspective(const D3DMATRIX& m) {
-    return fabsf(m._14) < 0.02f && fabsf(m._24) < 0.02f && fabsf(m._34) < 0.02f && fabsf(m._44 - 1.0f) < 0.02f;
+static void ReleaseLogDrain() {
+    g_logDrainBusy.store(false, std::memory_order_release);
 }
 
-static bool IsLikelyBoneTransform(const D3DMATRIX& m,
-                                  int rows,
-                                  UINT vectorCountInUpload,
-                                  UINT uploadStartReg,
-                                  UINT candidateBaseReg) {
-    if (!IsAffineMatrixNoPerspective(m)) {
-        return false;
+static DWORD WINAPI LogWriterThread(LPVOID) {
+    while (!g_logWriterStop.load(std::memory_order_acquire)) {
+        g_logWriterIdle.store(true, std::memory_order_release);
+        WaitForSingleObject(g_logWriterEvent, 100);
+        g_logWriterIdle.store(false, std::memory_order_release);
+        if (!TryAcquireLogDrain()) {
+            continue;
+        }
+        if (!g_logWriterStop.load(std::memory_order_acquire)) {
+            DrainLogRingToFile();
+        }
+        ReleaseLogDrain();
     }
-
-    const float tx = m._41;
-    const float ty = m._42;
-    const float tz = m._43;
-    const float translationLen = sqrtf(tx * tx + ty * ty + tz * tz);
-
-    const float r0 = sqrtf(Dot3(m._11, m._12, m._13, m._11, m._12, m._13));
-    const float r1 = sqrtf(Dot3(m._21, m._22, m._23, m._21, m._22, m._23));
-    const float r2 = sqrtf(Dot3(m._31, m._32, m._33, m._31, m._32, m._33));
-    const bool nearUnitRows = fabsf(r0 - 1.0f) < 0.25f && fabsf(r1 - 1.0f) < 0.25f && fabsf(r2 - 1.0f) < 0.25f;
-
-    const bool appearsInLargePaletteUpload =
-        rows == 3 && vectorCountInUpload >= 12 && candidateBaseReg >= uploadStartReg &&
-        candidateBaseReg + 2 < uploadStartReg + vectorCountInUpload;
-
-    return nearUnitRows && translationLen < 50.0f && appearsInLargePaletteUpload;
-}
-
-static bool LooksLikeWorldStrict(const D3DMATRIX& m,
-                                 int rows,
-                                 UINT vectorCountInUpload,
-                                 UINT uploadStartReg,
-                                 UINT candidateBaseReg) {
-    if (!IsAffineMatrixNoPerspective(m)) return false;
-    if (LooksLikeViewStrict(m)) return false;
-
-    const float det = Determinant3x3(m);
-    if (!std::isfinite(det) || fabsf(det) < 0.0001f) return false;
-
-    if (IsLikelyBoneTransform(m, rows, vectorCountInUpload, uploadStartReg, candidateBaseReg)) {
-        return false;
+    // Like the async classifier's worker, the writer holds a reference on the
+    // proxy until it exits, so its code is never unmapped under it.
+    if (g_logWriterModule) {
+        FreeLibraryAndExitThread(g_logWriterModule, 0);
     }
-    return true;
+    return 0;
 }
 
-enum MatrixClassification {
-    MatrixClass_None = 0,
-    MatrixClass_World,
-    MatrixClass_View,
-    MatrixClass_Projection,
-    MatrixClass_CombinedPerspective
-};
-
-static MatrixClassification ClassifyMatrixDeterministic(const D3DMATRIX& m,
-                                                        int rows,
-                                                        UINT vectorCountInUpload,
-                                                        UINT uploadStartReg,
-                                                        UINT candidateBaseReg) {
-    if (LooksLikeProjectionStrict(m)) {
-        return MatrixClass_Projection;
+// Called once, from the first LogMsg after DllMain returned.
+static void StartLogWriter() {
+    g_logWriterModule = nullptr;
+    GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                       reinterpret_cast<LPCSTR>(&LogWriterThread), &g_logWriterModule);
+    g_logWriterEvent = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+    if (g_logWriterEvent) {
+        g_logWriterThread = CreateThread(nullptr, 0, LogWriterThread, nullptr, 0, nullptr);
+    }
+    if (!g_logWriterThread) {
+        if (g_logWriterModule) {
+            FreeLibrary(g_logWriterModule);
+            g_logWriterModule = nullptr;
+        }
+        LogMsg("WARNING: Failed to create log writer thread; log file is written on unload only.");
     }
-    if (HasPerspectiveComponent(m)) {
-        return MatrixClass_CombinedPerspective;
+}
+
+// Never waits. The writer pins the module, so at detach it is either gone or was
+// killed by process exit, possibly mid-batch while owning the drain; in that
+// case the file is left alone rather than touched under a dead thread's locks.
+// Returns true when the ring was flushed and the caller may close the file.
+static bool StopLogWriter() {
+    g_logWriterStop.store(true, std::memory_order_release);
+    if (g_logWriterEvent) {
+        SetEvent(g_logWriterEvent);
     }
-    if (LooksLikeViewStrict(m)) {
-        return MatrixClass_View;
+    const bool drained = TryAcquireLogDrain();
+    if (drained) {
+        DrainLogRingToFile();
     }
-    if (LooksLikeWorldStrict(m, rows, vectorCountInUpload, uploadStartReg, candidateBaseReg)) {
-        return MatrixClass_World;
+    if (g_logWriterThread) {
+        CloseHandle(g_logWriterThread);
+        g_logWriterThread = nullptr;
     }
-    return MatrixClass_None;
-}
-
-static D3DMATRIX MultiplyMatrix(const D3DMATRIX& a, const D3DMATRIX& b) {
-    D3DMATRIX out = {};
-    out._11 = a._11*b._11 + a._12*b._21 + a._13*b._31 + a._14*b._41;
-    out._12 = a._11*b._12 + a._12*b._22 + a._13*b._32 + a._14*b._42;
-    out._13 = a._11*b._13 + a._12*b._23 + a._13*b._33 + a._14*b._43;
-    out._14 = a._11*b._14 + a._12*b._24 + a._13*b._34 + a._14*b._44;
-
-    out._21 = a._21*b._11 + a._22*b._21 + a._23*b._31 + a._24*b._41;
-    out._22 = a._21*b._12 + a._22*b._22 + a._23*b._32 + a._24*b._42;
-    out._23 = a._21*b._13 + a._22*b._23 + a._23*b._33 + a._24*b._43;
-    out._24 = a._21*b._14 + a._22*b._24 + a._23*b._34 + a._24*b._44;
-
-    out._31 = a._31*b._11 + a._32*b._21 + a._33*b._31 + a._34*b._41;
-    out._32 = a._31*b._12 + a._32*b._22 + a._33*b._32 + a._34*b._42;
-    out._33 = a._31*b._13 + a._32*b._23 + a._33*b._33 + a._34*b._43;
-    out._34 = a._31*b._14 + a._32*b._24 + a._33*b._34 + a._34*b._44;
-
-    out._41 = a._41*b._11 + a._42*b._21 + a._43*b._31 + a._44*b._41;
-    out._42 = a._41*b._12 + a._42*b._22 + a._43*b._32 + a._44*b._42;
-    out._43 = a._41*b._13 + a._42*b._23 + a._43*b._33 + a._44*b._43;
-    out._44 = a._41*b._14 + a._42*b._24 + a._43*b._34 + a._44*b._44;
-    return out;
-}
-
-static bool IsIdentityMatrix(const D3DMATRIX& m, float tolerance) {
-    return fabsf(m._11 - 1.0f) < tolerance &&
-           fabsf(m._22 - 1.0f) < tolerance &&
-           fabsf(m._33 - 1.0f) < tolerance &&
-           fabsf(m._44 - 1.0f) < tolerance &&
-           fabsf(m._12) < tolerance &&
-           fabsf(m._13) < tolerance &&
-           fabsf(m._14) < tolerance &&
-           fabsf(m._21) < tolerance &&
-           fabsf(m._23) < tolerance &&
-           fabsf(m._24) < tolerance &&
-           fabsf(m._31) < tolerance &&
-           fabsf(m._32) < tolerance &&
-           fabsf(m._34) < tolerance &&
-           fabsf(m._41) < tolerance &&
-           fabsf(m._42) < tolerance &&
-           fabsf(m._43) < tolerance;
-}
-static float MatrixIdentityMaxError(const D3DMATRIX& m) {
-    const D3DMATRIX identity = {
-        1.0f, 0.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, 1.0f
-    };
-    const float* a = reinterpret_cast<const float*>(&m);
-    const float* b = reinterpret_cast<const float*>(&identity);
-    float maxErr = 0.0f;
-    for (int i = 0; i < 16; ++i) {
-        maxErr = (std::max)(maxErr, fabsf(a[i] - b[i]));
+    if (g_logWriterEvent) {
+        CloseHandle(g_logWriterEvent);
+        g_logWriterEvent = nullptr;
     }
-    return maxErr;
+    return drained;
 }
 
-
-static bool MatrixClose(const D3DMATRIX& a, const D3DMATRIX& b, float tolerance) {
-    const float* pa = reinterpret_cast<const float*>(&a);
-    const float* pb = reinterpret_cast<const float*>(&b);
-    for (int i = 0; i < 16; i++) {
-        if (fabsf(pa[i] - pb[i]) > tolerance) {
-            return false;
+// Logging helper
+void LogMsg(const char* fmt, ...) {
+    uint64_t ticket = g_logWriteTicket.load(std::memory_order_relaxed);
+    for (;;) {
+        const LogRingSlot& candidate = g_logRing[ticket % kLogRingSlots];
+        const uint64_t previousLap = ticket >= kLogRingSlots ? (ticket - kLogRingSlots) * 2 + 2 : 0;
+        const uint64_t sequence = candidate.sequence.load(std::memory_order_acquire);
+        if (sequence == previousLap) {
+            if (g_logWriteTicket.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (sequence < previousLap) {
+            // The producer a full lap behind is still formatting into this slot.
+            // This needs kLogRingSlots lines emitted during one format call, so
+            // it is effectively never hit.
+            g_logSlotWaits.fetch_add(1, std::memory_order_relaxed);
+            YieldProcessor();
+            ticket = g_logWriteTicket.load(std::memory_order_relaxed);
+        } else {
+            // Another producer claimed this ticket first.
+            ticket = g_logWriteTicket.load(std::memory_order_relaxed);
         }
     }
-    return true;
-}
-
-// Extract FOV from projection matrix
-float ExtractFOV(const D3DMATRIX& proj) {
-    if (fabsf(proj._22) < 0.001f) return 0;
-    return 2.0f * atanf(1.0f / fabsf(proj._22));
-}
+    LogRingSlot& slot = g_logRing[ticket % kLogRingSlots];
+    slot.sequence.store(ticket * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
 
-// Check if matrix looks like projection
-bool LooksLikeProjection(const D3DMATRIX& m) {
-    return AnalyzeProjectionMatrixNumeric(m, nullptr);
-}
+    va_list args;
+    va_start(args, fmt);
+    const int written = vsnprintf(slot.text, sizeof(slot.text), fmt, args);
+    va_end(args);
+    if (written < 0) {
+        slot.text[0] = '\0';
+    } else if (static_cast<size_t>(written) >= sizeof(slot.text)) {
+        g_logLinesTruncated.fetch_add(1, std::memory_order_relaxed);
+    }
+    slot.sequence.store(ticket * 2 + 2, std::memory_order_release);
 
-// Create a standard perspective projection matrix
-void CreateProjectionMatrix(D3DMATRIX* out, float fovY, float aspect, float zNear, float zFar) {
-    float yScale = 1.0f / tanf(fovY / 2.0f);
-    float xScale = yScale / aspect;
-    memset(out, 0, sizeof(D3DMATRIX));
-    out->_11 = xScale;
-    out->_22 = yScale;
-    out->_33 = zFar / (zFar - zNear);
-    out->_34 = 1.0f;
-    out->_43 = -zNear * zFar / (zFar - zNear);
+    int pending = LogWriter_Pending;
+    if (g_logWriterStart.load(std::memory_order_relaxed) == pending &&
+        g_logWriterStart.compare_exchange_strong(pending, LogWriter_Started, std::memory_order_acq_rel)) {
+        StartLogWriter();
+    }
+    // Idle is only ever set by a running writer, so the event exists once it reads true.
+    if (g_logWriterIdle.exchange(false, std::memory_order_acq_rel)) {
+        SetEvent(g_logWriterEvent);
+    }
 }
 
-static void CreateProjectionMatrixWithHandedness(D3DMATRIX* out,
-                                                 float fovY,
-                                                 float aspect,
-                                                 float zNear,
-                                                 float zFar,
-                                                 ProjectionHandedness handedness) {
-    CreateProjectionMatrix(out, fovY, aspect, zNear, zFar);
-    if (handedness == ProjectionHandedness_Right) {
-        out->_33 = zFar / (zNear - zFar);
-        out->_34 = -1.0f;
-        out->_43 = zNear * zFar / (zNear - zFar);
+static const char* CombinedMVPStrategyLabel(CombinedMVPStrategy strategy) {
+    switch (strategy) {
+        case CombinedMVPStrategy_WorldAndMVP: return "Strategy 1 (World + MVP)";
+        case CombinedMVPStrategy_MVPOnly: return "Strategy 2 (MVP only)";
+        case CombinedMVPStrategy_WorldRequiredNoWorld: return "Strategy 3 (world required, missing)";
+        case CombinedMVPStrategy_Disabled: return "Disabled";
+        case CombinedMVPStrategy_SkippedFullWVP: return "Skipped (full W/V/P already present)";
+        case CombinedMVPStrategy_Failed: return "Failed";
+        case CombinedMVPStrategy_None:
+        default:
+            return "None";
     }
 }
 
+
 static bool TryGetCurrentDisplayAspect(IDirect3DDevice9* device,
                                        HWND hwnd,
                                        float* outAspect,
@@ -2603,205 +4417,1109 @@ static bool BuildExperimentalCustomProjectionMatrix(IDirect3DDevice9* device,
     return true;
 }
 
-static void OrthonormalizeViewMatrix(D3DMATRIX* view) {
-    if (!view) {
-        return;
+// Forward declarations
+class WrappedD3D9Device;
+class WrappedD3D9;
+
+// Known WORLD/VIEW/PROJECTION values, indexed by ShadowTransformIndex. A slot that
+// is not valid is unknown and is always forwarded to the real device.
+struct TransformStateShadow {
+    D3DMATRIX matrix[3] = {};
+    bool valid[3] = {};
+};
+
+static int ShadowTransformIndex(D3DTRANSFORMSTATETYPE state) {
+    if (state == D3DTS_WORLD) return 0;
+    if (state == D3DTS_VIEW) return 1;
+    if (state == D3DTS_PROJECTION) return 2;
+    return -1;
+}
+
+/**
+ * Wrapped IDirect3DStateBlock9 - Apply() can rewrite device transforms behind our back,
+ * so the block carries which shadowed transforms it contains and their values when known.
+ */
+class WrappedD3D9StateBlock : public IDirect3DStateBlock9 {
+private:
+    IDirect3DStateBlock9* m_real;
+    WrappedD3D9Device* m_device;
+    // Bit i set = the block contains shadow transform i; m_transforms holds its value.
+    uint8_t m_transformMask;
+    TransformStateShadow m_transforms;
+
+public:
+    WrappedD3D9StateBlock(IDirect3DStateBlock9* real, WrappedD3D9Device* device,
+                          uint8_t transformMask, const TransformStateShadow& transforms)
+        : m_real(real), m_device(device), m_transformMask(transformMask), m_transforms(transforms) {}
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObj) override {
+        if (!ppvObj) {
+            return E_POINTER;
+        }
+        if (riid == IID_IUnknown || riid == IID_IDirect3DStateBlock9) {
+            *ppvObj = this;
+            AddRef();
+            return S_OK;
+        }
+        return m_real->QueryInterface(riid, ppvObj);
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return m_real->AddRef(); }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = m_real->Release();
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override;
+    HRESULT STDMETHODCALLTYPE Capture() override;
+    HRESULT STDMETHODCALLTYPE Apply() override;
+};
+
+class WrappedD3D9VertexShader;
+
+// Every wrapper shares one vtable; it is recorded by the first constructor.
+static const void* g_wrappedVertexShaderVtable = nullptr;
+// Real shader -> wrapper, only for re-resolving a binding changed by a state block.
+static std::unordered_map<IDirect3DVertexShader9*, WrappedD3D9VertexShader*> g_wrappedVertexShadersByReal = {};
+
+/**
+ * Wrapped IDirect3DVertexShader9 - owns the shader's ShaderSlot, so SetVertexShader
+ * resolves per-shader state with a pointer copy and the slot is freed on the
+ * final Release instead of lingering under a reusable address.
+ */
+class WrappedD3D9VertexShader : public IDirect3DVertexShader9 {
+private:
+    IDirect3DVertexShader9* m_real;
+    WrappedD3D9Device* m_device;
+    ShaderSlot* m_slot;
+    ULONG m_refCount = 1;
+
+public:
+    // Takes over the caller's reference on real.
+    WrappedD3D9VertexShader(IDirect3DVertexShader9* real, WrappedD3D9Device* device)
+        : m_real(real), m_device(device), m_slot(AcquireShaderSlot(reinterpret_cast<uintptr_t>(this))) {
+        g_wrappedVertexShaderVtable = *reinterpret_cast<void* const*>(this);
+        g_wrappedVertexShadersByReal[real] = this;
+    }
+
+    IDirect3DVertexShader9* Real() const { return m_real; }
+    ShaderSlot* Slot() const { return m_slot; }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObj) override {
+        if (!ppvObj) {
+            return E_POINTER;
+        }
+        if (riid == IID_IUnknown || riid == IID_IDirect3DVertexShader9) {
+            *ppvObj = this;
+            AddRef();
+            return S_OK;
+        }
+        return m_real->QueryInterface(riid, ppvObj);
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = --m_refCount;
+        if (count == 0) {
+            ReleaseShaderSlot(m_slot);
+            g_wrappedVertexShadersByReal.erase(m_real);
+            m_real->Release();
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override;
+    HRESULT STDMETHODCALLTYPE GetFunction(void* pData, UINT* pSizeOfData) override {
+        return m_real->GetFunction(pData, pSizeOfData);
+    }
+};
+
+// A COM object's first word is its vtable pointer, so this never touches foreign state.
+static WrappedD3D9VertexShader* AsWrappedVertexShader(IDirect3DVertexShader9* shader) {
+    if (!shader || !g_wrappedVertexShaderVtable ||
+        *reinterpret_cast<void* const*>(shader) != g_wrappedVertexShaderVtable) {
+        return nullptr;
     }
+    return static_cast<WrappedD3D9VertexShader*>(shader);
+}
+
+class WrappedD3D9VertexDeclaration;
 
-    float r0x = view->_11, r0y = view->_12, r0z = view->_13;
-    float r1x = view->_21, r1y = view->_22, r1z = view->_23;
+static const void* g_wrappedVertexDeclarationVtable = nullptr;
+// Real declaration -> wrapper, only for re-resolving a binding changed by a state block.
+static std::unordered_map<IDirect3DVertexDeclaration9*, WrappedD3D9VertexDeclaration*> g_wrappedVertexDeclarationsByReal = {};
+
+/**
+ * Wrapped IDirect3DVertexDeclaration9 - carries whether the declaration has
+ * POSITIONT input, read once from the elements passed to CreateVertexDeclaration,
+ * so the flag dies with the declaration instead of outliving it under its address.
+ */
+class WrappedD3D9VertexDeclaration : public IDirect3DVertexDeclaration9 {
+private:
+    IDirect3DVertexDeclaration9* m_real;
+    WrappedD3D9Device* m_device;
+    bool m_pretransformed;
+    ULONG m_refCount = 1;
 
-    const float len0 = sqrtf(Dot3(r0x, r0y, r0z, r0x, r0y, r0z));
-    if (len0 > 1e-6f) {
-        r0x /= len0; r0y /= len0; r0z /= len0;
+public:
+    // Takes over the caller's reference on real.
+    WrappedD3D9VertexDeclaration(IDirect3DVertexDeclaration9* real, WrappedD3D9Device* device, bool pretransformed)
+        : m_real(real), m_device(device), m_pretransformed(pretransformed) {
+        g_wrappedVertexDeclarationVtable = *reinterpret_cast<void* const*>(this);
+        g_wrappedVertexDeclarationsByReal[real] = this;
     }
 
-    float dot01 = Dot3(r1x, r1y, r1z, r0x, r0y, r0z);
-    r1x -= dot01 * r0x;
-    r1y -= dot01 * r0y;
-    r1z -= dot01 * r0z;
+    IDirect3DVertexDeclaration9* Real() const { return m_real; }
+    bool Pretransformed() const { return m_pretransformed; }
 
-    const float len1 = sqrtf(Dot3(r1x, r1y, r1z, r1x, r1y, r1z));
-    if (len1 > 1e-6f) {
-        r1x /= len1; r1y /= len1; r1z /= len1;
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObj) override {
+        if (!ppvObj) {
+            return E_POINTER;
+        }
+        if (riid == IID_IUnknown || riid == IID_IDirect3DVertexDeclaration9) {
+            *ppvObj = this;
+            AddRef();
+            return S_OK;
+        }
+        return m_real->QueryInterface(riid, ppvObj);
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = --m_refCount;
+        if (count == 0) {
+            g_wrappedVertexDeclarationsByReal.erase(m_real);
+            g_traceWriter.ForgetDeclaration(reinterpret_cast<uintptr_t>(this));
+            m_real->Release();
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override;
+    HRESULT STDMETHODCALLTYPE GetDeclaration(D3DVERTEXELEMENT9* pElement, UINT* pNumElements) override {
+        return m_real->GetDeclaration(pElement, pNumElements);
     }
+};
 
-    const float r2x = r0y * r1z - r0z * r1y;
-    const float r2y = r0z * r1x - r0x * r1z;
-    const float r2z = r0x * r1y - r0y * r1x;
+static WrappedD3D9VertexDeclaration* AsWrappedVertexDeclaration(IDirect3DVertexDeclaration9* decl) {
+    if (!decl || !g_wrappedVertexDeclarationVtable ||
+        *reinterpret_cast<void* const*>(decl) != g_wrappedVertexDeclarationVtable) {
+        return nullptr;
+    }
+    return static_cast<WrappedD3D9VertexDeclaration*>(decl);
+}
 
-    view->_11 = r0x; view->_12 = r0y; view->_13 = r0z; view->_14 = 0.0f;
-    view->_21 = r1x; view->_22 = r1y; view->_23 = r1z; view->_24 = 0.0f;
-    view->_31 = r2x; view->_32 = r2y; view->_33 = r2z; view->_34 = 0.0f;
-    view->_44 = 1.0f;
+static IDirect3DVertexDeclaration9* UnwrapVertexDeclaration(IDirect3DVertexDeclaration9* decl) {
+    WrappedD3D9VertexDeclaration* wrapped = AsWrappedVertexDeclaration(decl);
+    return wrapped ? wrapped->Real() : decl;
 }
 
-static bool TryExtractProjectionFromCombined(const D3DMATRIX& combined,
-                                             ProjectionAnalysis* outAnalysis,
-                                             D3DMATRIX* outProjection,
-                                             bool forceDecomposition) {
-    if (!outProjection) {
-        return false;
+// One SetVertexShaderConstantF as seen by the classifier.
+struct ConstantUpload {
+    uintptr_t shaderKey = 0;
+    // Bytecode hash when stableKey, otherwise a hash of shaderKey. Resolved on the
+    // render thread when the upload is recorded: the classifier may run on the async
+    // worker, which must not touch the shader slot pool or its index.
+    uint32_t shaderHash = 0;
+    bool stableKey = false;
+    UINT startRegister = 0;
+    UINT vector4fCount = 0;
+    // Constants after overlay overrides.
+    const float* constantData = nullptr;
+    uint8_t manualMask = 0;
+    const CapturedManualMatrix* manual = nullptr;
+    // Per-register change serials of the uploading shader, indexed by register, and
+    // g_constantChangeSerial after this upload. Only set on the render thread; null
+    // means every window is scanned.
+    const unsigned long long* changeSerials = nullptr;
+    unsigned long long changeSerial = 0;
+};
+
+enum ProfileDrawAction {
+    ProfileDraw_Skip = 0,
+    ProfileDraw_Emit,
+    // Fill missing matrices from tracked memory, the custom projection and identity first.
+    ProfileDraw_EmitWithFallbacks
+};
+
+// Per-profile hot path. Each GameProfileKind (and the generic structural mode)
+// is a set of template specializations; ConfigureActiveProfileLayout picks the
+// table once, so uploads and draws never re-test which profile is active.
+struct ProfilePipeline {
+    // Overlay constant overrides and manual matrix bindings reach this profile.
+    bool usesOverlayInputs;
+    void (*classifyUpload)(ResolvedTransforms& resolved,
+                           const ConstantUpload& upload,
+                           bool mgrrUseAutoProjection,
+                           std::vector<UploadMatrixMatch>& structuralMatches);
+    ProfileDrawAction (*prepareDraw)(const ResolvedTransforms& resolved);
+    void (*resetScene)(ResolvedTransforms& resolved);
+};
+
+static void SetProfileStatusText(const char* text) {
+    if (g_profileStatusText != text) {
+        snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage), "%s", text);
+        g_profileStatusText = text;
     }
+}
 
-    const float sx = sqrtf(Dot3(combined._11, combined._12, combined._13,
-                                combined._11, combined._12, combined._13));
-    const float sy = sqrtf(Dot3(combined._21, combined._22, combined._23,
-                                combined._21, combined._22, combined._23));
-    if (!std::isfinite(sx) || !std::isfinite(sy) || sx < 1e-5f || sy < 1e-5f) {
-        return false;
+// Reads every enabled manual binding of this shader out of its accumulated
+// constants. Returns one bit per bound slot; captures are written in slot order.
+static uint8_t CaptureManualBindings(ShaderSlot* shaderSlot, CapturedManualMatrix* captures, int* outCount) {
+    uint8_t mask = 0;
+    int count = 0;
+    const uintptr_t shaderKey = shaderSlot->key;
+    if (shaderKey != 0) {
+        for (int slot = 0; slot < MatrixSlot_Count; slot++) {
+            ManualMatrixBinding& binding = g_manualBindings[slot];
+            if (binding.enabled && binding.shaderKey == 0 && binding.shaderHash != 0) {
+                // Binding restored from the layout cache: bind it to this run's shader.
+                uint32_t currentHash = 0;
+                if (TryGetShaderSlotBytecodeHash(shaderSlot, &currentHash) && currentHash == binding.shaderHash) {
+                    binding.shaderKey = shaderKey;
+                }
+            }
+            if (!binding.enabled || binding.shaderKey != shaderKey) {
+                continue;
+            }
+            CapturedManualMatrix& capture = captures[count];
+            if (!TryBuildMatrixSnapshot(shaderSlot->state, binding.baseRegister, binding.rows, false, &capture.matrix)) {
+                continue;
+            }
+            capture.baseRegister = binding.baseRegister;
+            capture.rows = binding.rows;
+            mask |= static_cast<uint8_t>(1u << slot);
+            count++;
+        }
     }
+    *outCount = count;
+    return mask;
+}
 
-    const float fov = 2.0f * atanf(1.0f / sy);
-    const float aspect = sy / sx;
-    if (!forceDecomposition) {
-        if (!std::isfinite(fov) || fov < g_config.minFOV || fov > g_config.maxFOV) {
-            return false;
+// Applies the manual bindings captured for this upload and marks their slots.
+static void ApplyManualBindings(ResolvedTransforms& resolved,
+                                const ConstantUpload& upload,
+                                bool* slotResolvedByOverride) {
+    const uintptr_t shaderKey = upload.shaderKey;
+    const uint32_t shaderHash = upload.shaderHash;
+    int captured = 0;
+    for (int slot = 0; slot < MatrixSlot_Count; slot++) {
+        if (!(upload.manualMask & (1u << slot))) {
+            continue;
+        }
+        const CapturedManualMatrix& capture = upload.manual[captured++];
+        const D3DMATRIX& manualMat = capture.matrix;
+        slotResolvedByOverride[slot] = true;
+        if (slot == MatrixSlot_World) {
+            resolved.world = manualMat;
+            resolved.hasWorld = true;
+            StoreWorldMatrix(resolved.world, shaderKey, shaderHash, capture.baseRegister, capture.rows, false, true);
+        } else if (slot == MatrixSlot_View) {
+            resolved.view = manualMat;
+            resolved.hasView = true;
+            StoreViewMatrix(resolved.view, shaderKey, shaderHash, capture.baseRegister, capture.rows, false, true);
+        } else if (slot == MatrixSlot_Projection) {
+            resolved.proj = manualMat;
+            resolved.hasProj = true;
+            g_projectionDetectedByNumericStructure = false;
+            g_projectionDetectedRegister = capture.baseRegister;
+            g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
+            g_projectionDetectedFovRadians = 0.0f;
+            StoreProjectionMatrix(resolved.proj, shaderKey, shaderHash, capture.baseRegister, capture.rows, false, true);
+        } else if (slot == MatrixSlot_MVP) {
+            StoreMVPMatrix(manualMat, shaderKey, shaderHash, capture.baseRegister, capture.rows, false, true);
         }
     }
+}
 
-    const float det = Determinant3x3(combined);
-    ProjectionHandedness handedness = ProjectionHandedness_Unknown;
-    if (std::isfinite(det)) {
-        handedness = (det < 0.0f) ? ProjectionHandedness_Right : ProjectionHandedness_Left;
+// Fixed-register profiles: copies cBase..cBase+3 when the upload carries all four rows.
+template <int Base>
+static inline bool TryCopyProfileMatrix(const ConstantUpload& upload, D3DMATRIX* outMat) {
+    if (upload.startRegister > static_cast<UINT>(Base) ||
+        upload.startRegister + upload.vector4fCount < static_cast<UINT>(Base + 4)) {
+        return false;
     }
+    memcpy(outMat, upload.constantData + (Base - static_cast<int>(upload.startRegister)) * 4, sizeof(D3DMATRIX));
+    return true;
+}
 
-    CreateProjectionMatrixWithHandedness(outProjection,
-                                         fov,
-                                         (std::max)(0.1f, aspect),
-                                         0.1f,
-                                         1000.0f,
-                                         handedness);
+// True when the upload overlaps registers [First, End).
+template <int First, int End>
+static inline bool UploadTouchesRegisters(const ConstantUpload& upload) {
+    return upload.constantData && upload.vector4fCount > 0 &&
+           upload.startRegister < static_cast<UINT>(End) &&
+           upload.startRegister + upload.vector4fCount > static_cast<UINT>(First);
+}
+
+// Start-of-scene reset of per-frame classifier state.
+template <GameProfileKind Profile>
+static void ResetProfileScene(ResolvedTransforms&) {
+    g_combinedMvpDebug = {};
+}
+
+template <>
+void ResetProfileScene<GameProfile_MetalGearRising>(ResolvedTransforms& resolved) {
+    g_combinedMvpDebug = {};
+    // MGR frame lifecycle: keep projection/view persistent across draws and frames,
+    // but require a fresh world upload for each frame.
+    CreateIdentityMatrix(&resolved.world);
+    resolved.hasWorld = false;
+    g_mgrWorldCapturedForDraw = false;
+    g_mgrProjCapturedThisFrame = false;
+    g_mgrViewCapturedThisFrame = false;
+    g_mgrProjectionRegisterValid = false;
+}
+
+// One upload folded into resolved. The primary template is the generic mode:
+// manual bindings, register overrides, combined MVP and the structural scan.
+// Runs on the render thread, or on the async classifier worker while it owns the
+// classifier state.
+template <GameProfileKind Profile>
+static void ClassifyProfileUpload(ResolvedTransforms& resolved,
+                                  const ConstantUpload& upload,
+                                  bool,
+                                  std::vector<UploadMatrixMatch>& structuralMatches) {
+    const uintptr_t shaderKey = upload.shaderKey;
+    const uint32_t shaderHash = upload.shaderHash;
+    const UINT startRegister = upload.startRegister;
+    const UINT vector4fCount = upload.vector4fCount;
+    const float* constantData = upload.constantData;
+
+    bool slotResolvedByOverride[MatrixSlot_Count] = {};
+    bool slotResolvedStructurally[MatrixSlot_Count] = {};
+
+    ApplyManualBindings(resolved, upload, slotResolvedByOverride);
+
+    auto tryExplicitRegisterOverride = [&](MatrixSlot slot, int configuredRegister) {
+        if (configuredRegister < 0 || !constantData) {
+            return;
+        }
+        if (slotResolvedByOverride[slot]) {
+            return;
+        }
+        for (UINT rows : {4u, 3u}) {
+            D3DMATRIX mat = {};
+            if (!TryBuildMatrixFromConstantUpdate(constantData, startRegister, vector4fCount,
+                                                  configuredRegister, static_cast<int>(rows), false, &mat)) {
+                continue;
+            }
+            slotResolvedByOverride[slot] = true;
+            if (slot == MatrixSlot_World) {
+                resolved.world = mat;
+                resolved.hasWorld = true;
+                StoreWorldMatrix(resolved.world, shaderKey, shaderHash, configuredRegister, static_cast<int>(rows), false, true,
+                                 "explicit register override");
+            } else if (slot == MatrixSlot_View) {
+                resolved.view = mat;
+                resolved.hasView = true;
+                StoreViewMatrix(resolved.view, shaderKey, shaderHash, configuredRegister, static_cast<int>(rows), false, true,
+                                "explicit register override");
+            } else if (slot == MatrixSlot_Projection) {
+                resolved.proj = mat;
+                resolved.hasProj = true;
+                g_projectionDetectedByNumericStructure = false;
+                g_projectionDetectedRegister = configuredRegister;
+                g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
+                g_projectionDetectedFovRadians = 0.0f;
+                StoreProjectionMatrix(resolved.proj, shaderKey, shaderHash, configuredRegister, static_cast<int>(rows), false, true,
+                                      "explicit register override");
+            }
+            return;
+        }
+    };
+
+    tryExplicitRegisterOverride(MatrixSlot_World, g_config.worldMatrixRegister);
+    tryExplicitRegisterOverride(MatrixSlot_View, g_config.viewMatrixRegister);
+    tryExplicitRegisterOverride(MatrixSlot_Projection, g_config.projMatrixRegister);
+
+    auto tryHandleCombinedMVP = [&](const D3DMATRIX& combinedMvp, UINT baseReg, int rows, bool transposed) {
+        StoreMVPMatrix(combinedMvp, shaderKey, shaderHash, static_cast<int>(baseReg), rows, transposed, false,
+                       "deterministic structural combined MVP", static_cast<int>(baseReg));
+        g_combinedMvpDebug.registerBase = static_cast<int>(baseReg);
+        g_combinedMvpDebug.succeeded = false;
+        g_combinedMvpDebug.fovRadians = 0.0f;
+        g_combinedMvpDebug.handedness = ProjectionHandedness_Unknown;
+
+        if (!g_config.enableCombinedMVP) {
+            g_combinedMvpDebug.strategy = CombinedMVPStrategy_Disabled;
+            return;
+        }
+        if (resolved.hasWorld && resolved.hasView && resolved.hasProj) {
+            g_combinedMvpDebug.strategy = CombinedMVPStrategy_SkippedFullWVP;
+            return;
+        }
+
+        const bool worldAvailable = resolved.hasWorld;
+        CombinedMVPStrategy strategy = CombinedMVPStrategy_None;
+        if (worldAvailable) {
+            strategy = CombinedMVPStrategy_WorldAndMVP;
+        } else if (g_config.combinedMVPRequireWorld) {
+            strategy = CombinedMVPStrategy_WorldRequiredNoWorld;
+        } else if (g_config.combinedMVPAssumeIdentityWorld) {
+            strategy = CombinedMVPStrategy_MVPOnly;
+        } else {
+            strategy = CombinedMVPStrategy_Failed;
+        }
+        g_combinedMvpDebug.strategy = strategy;
+
+        if (strategy == CombinedMVPStrategy_WorldRequiredNoWorld) {
+            if (g_config.combinedMVPLogDecomposition) {
+                LogMsg("Combined MVP ignored at c%d-c%d: world required but missing.",
+                       static_cast<int>(baseReg), static_cast<int>(baseReg) + rows - 1);
+            }
+            return;
+        }
+
+        D3DMATRIX decompWorld = {};
+        D3DMATRIX decompView = {};
+        D3DMATRIX decompProj = {};
+        ProjectionAnalysis projectionInfo = {};
+        if (!TryDecomposeCombinedMVP(combinedMvp,
+                                     worldAvailable ? &resolved.world : nullptr,
+                                     worldAvailable,
+                                     &decompWorld,
+                                     &decompView,
+                                     &decompProj,
+                                     &projectionInfo,
+                                     &g_cameraDerivationCache)) {
+            g_combinedMvpDebug.strategy = CombinedMVPStrategy_Failed;
+            if (g_config.combinedMVPLogDecomposition) {
+                LogMsg("Combined MVP decomposition failed at c%d-c%d.",
+                       static_cast<int>(baseReg), static_cast<int>(baseReg) + rows - 1);
+            }
+            return;
+        }
+
+        resolved.world = decompWorld;
+        resolved.view = decompView;
+        resolved.proj = decompProj;
+        resolved.hasWorld = true;
+        resolved.hasView = true;
+        resolved.hasProj = true;
+        slotResolvedStructurally[MatrixSlot_World] = true;
+        slotResolvedStructurally[MatrixSlot_View] = true;
+        slotResolvedStructurally[MatrixSlot_Projection] = true;
+        g_projectionDetectedByNumericStructure = true;
+        g_projectionDetectedFovRadians = projectionInfo.fovRadians;
+        g_projectionDetectedRegister = static_cast<int>(baseReg);
+        g_projectionDetectedHandedness = projectionInfo.handedness;
+
+        StoreWorldMatrix(resolved.world, shaderKey, shaderHash, static_cast<int>(baseReg), rows, transposed, false,
+                         "combined MVP decomposition world", static_cast<int>(baseReg));
+        StoreViewMatrix(resolved.view, shaderKey, shaderHash, static_cast<int>(baseReg), rows, transposed, false,
+                        "combined MVP decomposition view", static_cast<int>(baseReg));
+        StoreProjectionMatrix(resolved.proj, shaderKey, shaderHash, static_cast<int>(baseReg), rows, transposed, false,
+                              "combined MVP decomposition projection", static_cast<int>(baseReg));
+
+        g_combinedMvpDebug.succeeded = true;
+        g_combinedMvpDebug.fovRadians = projectionInfo.fovRadians;
+        g_combinedMvpDebug.handedness = projectionInfo.handedness;
+        if (g_config.combinedMVPLogDecomposition) {
+            LogMsg("Combined MVP decomposition success at c%d-c%d using %s, FOV=%.2f deg, handedness=%s.",
+                   static_cast<int>(baseReg), static_cast<int>(baseReg) + rows - 1,
+                   CombinedMVPStrategyLabel(strategy),
+                   projectionInfo.fovRadians * 180.0f / 3.14159265f,
+                   ProjectionHandednessLabel(projectionInfo.handedness));
+        }
+    };
+
+    auto updateFromClassification = [&](D3DMATRIX mat, UINT baseReg, int rows, bool transposed) {
+        MatrixClassification cls = ClassifyMatrixDeterministic(mat, rows, vector4fCount, startRegister, baseReg);
+
+        if (cls == MatrixClass_Projection && g_config.projMatrixRegister < 0 && !slotResolvedByOverride[MatrixSlot_Projection]) {
+            ProjectionAnalysis projectionInfo = {};
+            if (!AnalyzeProjectionMatrixNumeric(mat, &projectionInfo)) {
+                return;
+            }
+            resolved.proj = mat;
+            resolved.hasProj = true;
+            slotResolvedStructurally[MatrixSlot_Projection] = true;
+            g_projectionDetectedByNumericStructure = true;
+            g_projectionDetectedFovRadians = projectionInfo.fovRadians;
+            g_projectionDetectedRegister = static_cast<int>(baseReg);
+            g_projectionDetectedHandedness = projectionInfo.handedness;
+            StoreProjectionMatrix(resolved.proj, shaderKey, shaderHash, static_cast<int>(baseReg), rows, transposed, false, "deterministic structural projection");
+            LogMsg("Projection accepted via numeric structure: c%d-c%d rows=%d transpose=%d fov=%.2f deg (%s)",
+                   static_cast<int>(baseReg), static_cast<int>(baseReg) + rows - 1,
+                   rows, transposed ? 1 : 0,
+                   projectionInfo.fovRadians * 180.0f / 3.14159265f,
+                   ProjectionHandednessLabel(projectionInfo.handedness));
+        } else if (cls == MatrixClass_View && g_config.viewMatrixRegister < 0 && !slotResolvedByOverride[MatrixSlot_View]) {
+            resolved.view = mat;
+            resolved.hasView = true;
+            slotResolvedStructurally[MatrixSlot_View] = true;
+            StoreViewMatrix(resolved.view, shaderKey, shaderHash, static_cast<int>(baseReg), rows, transposed, false, "deterministic structural view");
+        } else if (cls == MatrixClass_World && g_config.worldMatrixRegister < 0 && !slotResolvedByOverride[MatrixSlot_World]) {
+            resolved.world = mat;
+            resolved.hasWorld = true;
+            slotResolvedStructurally[MatrixSlot_World] = true;
+            StoreWorldMatrix(resolved.world, shaderKey, shaderHash, static_cast<int>(baseReg), rows, transposed, false, "deterministic structural world");
+        } else if (cls == MatrixClass_CombinedPerspective &&
+                   g_config.worldMatrixRegister < 0 && g_config.viewMatrixRegister < 0 && g_config.projMatrixRegister < 0 &&
+                   !slotResolvedByOverride[MatrixSlot_World] && !slotResolvedByOverride[MatrixSlot_View] && !slotResolvedByOverride[MatrixSlot_Projection] &&
+                   rows == 4) {
+            tryHandleCombinedMVP(mat, baseReg, rows, transposed);
+        }
+    };
+
+    bool anyStructuralMatch = false;
+    if (constantData && vector4fCount >= 3) {
+        PROXY_PROFILE_SCOPE(ProfilerZone_Classifier);
+        const bool stableKey = upload.stableKey;
+        const unsigned long long uploadKey = LearnedLayoutKey(upload.shaderHash, startRegister, vector4fCount);
+        LearnedUploadLayout* learned = nullptr;
+        if (g_layoutLockThreshold > 0) {
+            learned = &g_learnedLayouts[uploadKey];
+            learned->stableKey = stableKey;
+        }
+
+        bool resolvedFromLearnedLayout = false;
+        if (learned && learned->locked) {
+            // Validate every known window before applying any, so a layout change
+            // falls back to the full scan without half-applied results.
+            D3DMATRIX validated[kMaxLearnedLayoutWindows] = {};
+            if (ValidateLearnedLayout(*learned, constantData, startRegister, vector4fCount, validated)) {
+                for (int i = 0; i < learned->windowCount; i++) {
+                    const LearnedLayoutWindow& window = learned->windows[i];
+                    anyStructuralMatch = true;
+                    updateFromClassification(validated[i], static_cast<UINT>(window.baseRegister), window.rows,
+                                             window.orientation == LayoutOrientation_Transposed);
+                }
+                resolvedFromLearnedLayout = true;
+                g_layoutLockedUploads++;
+                if (learned->seededFromCache) {
+                    g_layoutCacheSeededUploads++;
+                }
+            } else {
+                learned->locked = false;
+                learned->seededFromCache = false;
+                learned->consistentScans = 0;
+                learned->validationFailures++;
+                g_layoutValidationFailures++;
+            }
+        }
 
-    if (outAnalysis) {
-        outAnalysis->valid = true;
-        outAnalysis->fovRadians = fov;
-        outAnalysis->handedness = handedness;
+        if (!resolvedFromLearnedLayout) {
+            LearnedLayoutWindow found[kMaxLearnedLayoutWindows + 1] = {};
+            int foundCount = 0;
+            g_layoutFullScans++;
+            // Bone palettes are excluded up front instead of being classified and
+            // then rejected window by window.
+            BonePaletteRange palette;
+            bool excludePalette = false;
+            if (g_bonePaletteMinBones > 0 && vector4fCount >= static_cast<UINT>(g_bonePaletteMinBones) * 3u) {
+                excludePalette = UpdateBonePaletteTracker(g_bonePalettes[uploadKey], constantData,
+                                                          startRegister, vector4fCount, g_bonePaletteMinBones,
+                                                          kBonePaletteConfirmUploads, &palette);
+                if (excludePalette) {
+                    g_bonePaletteExcludedUploads++;
+                    g_bonePaletteExcludedRegisters += palette.registerCount;
+                }
+            }
+            structuralMatches.clear();
+            UploadScanCache* scanCache = upload.changeSerials && shaderKey != 0 ? &g_uploadScanCache[uploadKey] : nullptr;
+            if (scanCache && scanCache->shaderKey == shaderKey && scanCache->excludedPalette == excludePalette &&
+                (!excludePalette || (scanCache->palette.startRegister == palette.startRegister &&
+                                     scanCache->palette.registerCount == palette.registerCount &&
+                                     scanCache->palette.boneStride == palette.boneStride))) {
+                uint32_t changed[kMaxConstantRegisters / 32] = {};
+                for (UINT i = 0; i < vector4fCount; i++) {
+                    if (upload.changeSerials[startRegister + i] > scanCache->changeSerial) {
+                        changed[i >> 5] |= 1u << (i & 31);
+                    }
+                }
+                UINT windowsScanned = 0;
+                ScanUploadForMatricesIncremental(constantData, startRegister, vector4fCount, changed,
+                                                 scanCache->matches, &structuralMatches,
+                                                 excludePalette ? &palette : nullptr, &windowsScanned);
+                g_layoutIncrementalScans++;
+                g_layoutIncrementalWindows += windowsScanned;
+            } else {
+                ScanUploadForMatrices(constantData, startRegister, vector4fCount, &structuralMatches,
+                                      excludePalette ? &palette : nullptr);
+            }
+            if (scanCache) {
+                scanCache->shaderKey = shaderKey;
+                scanCache->changeSerial = upload.changeSerial;
+                scanCache->excludedPalette = excludePalette;
+                scanCache->palette = palette;
+                scanCache->matches.assign(structuralMatches.begin(), structuralMatches.end());
+            }
+            for (const UploadMatrixMatch& match : structuralMatches) {
+                anyStructuralMatch = true;
+                if (foundCount <= kMaxLearnedLayoutWindows) {
+                    found[foundCount++] = match.window;
+                }
+                updateFromClassification(match.matrix, static_cast<UINT>(match.window.baseRegister), match.window.rows,
+                                         match.window.orientation == LayoutOrientation_Transposed);
+            }
+            if (learned) {
+                const bool wasLocked = learned->locked;
+                LearnUploadLayout(*learned, found, foundCount, g_layoutLockThreshold);
+                if (learned->locked && !wasLocked && learned->stableKey) {
+                    g_layoutCacheDirty = true;
+                }
+            }
+        }
     }
-    return true;
 }
 
-static bool TryDecomposeCombinedMVP(const D3DMATRIX& mvp,
-                                    const D3DMATRIX* worldOptional,
-                                    bool worldAvailable,
-                                    D3DMATRIX* outWorld,
-                                    D3DMATRIX* outView,
-                                    D3DMATRIX* outProjection,
-                                    ProjectionAnalysis* outProjectionAnalysis) {
-    if (!outWorld || !outView || !outProjection) {
-        return false;
+// MGR strict known-layout mode:
+// - capture c4-c7 projection, c8-c11 viewProjection, c16-c19 world
+// - derive View as inverse(Projection) * ViewProjection
+// - do not run structural detection fallback or candidate scanning
+// - persist projection/view across draws until overwritten by the same known registers
+// Overlay overrides and manual bindings never reach this profile.
+template <>
+void ClassifyProfileUpload<GameProfile_MetalGearRising>(ResolvedTransforms& resolved,
+                                                        const ConstantUpload& upload,
+                                                        bool mgrrUseAutoProjection,
+                                                        std::vector<UploadMatrixMatch>&) {
+    typedef MgrProfileRegisters Regs;
+    if (!UploadTouchesRegisters<Regs::kProjection, Regs::kWorld + 4>(upload)) {
+        return;
+    }
+    const uintptr_t shaderKey = upload.shaderKey;
+    const uint32_t shaderHash = upload.shaderHash;
+
+    D3DMATRIX mat;
+    if (TryCopyProfileMatrix<Regs::kProjection>(upload, &mat)) {
+        g_profileCoreRegistersSeen[0] = true;
+        g_mgrProjectionRegisterValid = IsTypicalProjectionMatrix(mat);
+        resolved.proj = mat;
+        resolved.hasProj = true;
+        g_mgrProjCapturedThisFrame = true;
+        g_projectionDetectedByNumericStructure = false;
+        g_projectionDetectedRegister = Regs::kProjection;
+        g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
+        if (g_mgrProjectionRegisterValid) {
+            g_projectionDetectedFovRadians = ExtractFOV(mat);
+            StoreProjectionMatrix(resolved.proj, shaderKey, shaderHash, Regs::kProjection, 4, false, true,
+                                  "MetalGearRising profile projection (c4-c7)");
+        } else {
+            g_projectionDetectedFovRadians = 0.0f;
+            StoreProjectionMatrix(resolved.proj, shaderKey, shaderHash, Regs::kProjection, 4, false, true,
+                                  "MetalGearRising profile projection (c4-c7, non-typical)");
+            SetProfileStatusText("MGR projection at c4-c7 is non-typical; using it by default.");
+        }
     }
 
-    D3DMATRIX world = {};
-    D3DMATRIX viewProjection = {};
+    if (TryCopyProfileMatrix<Regs::kViewProjection>(upload, &mat)) {
+        g_profileCoreRegistersSeen[1] = true;
+        g_profileOptionalRegistersSeen[0] = true;
 
-    if (worldAvailable && worldOptional) {
-        world = *worldOptional;
-        D3DMATRIX worldInv = {};
-        if (!InvertMatrix4x4Deterministic(world, &worldInv, nullptr)) {
-            return false;
+        D3DMATRIX resolvedProjection = {};
+        bool haveProjectionForViewDerivation = false;
+
+        if (resolved.hasProj) {
+            resolvedProjection = resolved.proj;
+            haveProjectionForViewDerivation = true;
+        }
+
+        if (!g_mgrProjectionRegisterValid && mgrrUseAutoProjection) {
+            ProjectionAnalysis generatedProjectionInfo = {};
+            D3DMATRIX generatedProjection = {};
+            if (TryExtractProjectionFromCombined(mat,
+                                                 &generatedProjectionInfo,
+                                                 &generatedProjection,
+                                                 g_config.combinedMVPForceDecomposition)) {
+                resolvedProjection = generatedProjection;
+                resolved.proj = generatedProjection;
+                resolved.hasProj = true;
+                g_mgrProjCapturedThisFrame = true;
+                g_projectionDetectedByNumericStructure = true;
+                g_projectionDetectedRegister = Regs::kViewProjection;
+                g_projectionDetectedHandedness = generatedProjectionInfo.handedness;
+                g_projectionDetectedFovRadians = generatedProjectionInfo.fovRadians;
+                StoreProjectionMatrix(resolved.proj, shaderKey, shaderHash, Regs::kViewProjection, 4, false, true,
+                                      "MetalGearRising auto projection from VP (c8-c11)");
+                haveProjectionForViewDerivation = true;
+            }
+        }
+
+        if (haveProjectionForViewDerivation) {
+            D3DMATRIX derivedView = {};
+            if (DeriveViewFromViewProjection(resolvedProjection, mat, &derivedView, &g_cameraDerivationCache)) {
+                resolved.view = derivedView;
+                resolved.hasView = true;
+                g_mgrViewCapturedThisFrame = true;
+                g_profileViewDerivedFromInverse = true;
+                SetProfileStatusText("MGR view updated from VP (c8-c11) using inverse projection.");
+                StoreViewMatrix(resolved.view, shaderKey, shaderHash, Regs::kViewProjection, 4, false, true,
+                                "MetalGearRising profile view from VP", Regs::kViewProjection);
+            } else {
+                g_profileViewDerivedFromInverse = false;
+                SetProfileStatusText("MGR VP derivation failed: projection inversion failed.");
+            }
+        } else {
+            g_profileViewDerivedFromInverse = false;
+            SetProfileStatusText("MGR VP detected but projection inversion failed. Enable auto projection to prefer generated projection.");
         }
-        viewProjection = MultiplyMatrix(mvp, worldInv);
-    } else {
-        CreateIdentityMatrix(&world);
-        viewProjection = mvp;
     }
 
-    ProjectionAnalysis analysis = {};
-    D3DMATRIX projection = {};
-    if (!TryExtractProjectionFromCombined(viewProjection, &analysis, &projection, g_config.combinedMVPForceDecomposition)) {
-        return false;
+    if (TryCopyProfileMatrix<Regs::kWorld>(upload, &mat)) {
+        resolved.world = mat;
+        resolved.hasWorld = true;
+        g_mgrWorldCapturedForDraw = true;
+        g_profileCoreRegistersSeen[2] = true;
+        StoreWorldMatrix(resolved.world, shaderKey, shaderHash, Regs::kWorld, 4, false, true,
+                         "MetalGearRising profile world (c16-c19)");
     }
+}
 
-    D3DMATRIX projectionInv = {};
-    if (!InvertMatrix4x4Deterministic(projection, &projectionInv, nullptr)) {
-        return false;
+// DMC4 strict mapping with no fallback: MVP/World c0-c3, View c4-c7, Projection c8-c11.
+template <>
+void ClassifyProfileUpload<GameProfile_DevilMayCry4>(ResolvedTransforms& resolved,
+                                                     const ConstantUpload& upload,
+                                                     bool,
+                                                     std::vector<UploadMatrixMatch>&) {
+    typedef Dmc4ProfileRegisters Regs;
+    bool slotResolvedByOverride[MatrixSlot_Count] = {};
+    ApplyManualBindings(resolved, upload, slotResolvedByOverride);
+    if (!UploadTouchesRegisters<Regs::kCombinedMvp, Regs::kProjection + 4>(upload)) {
+        SetProfileStatusText("DMC4 profile active but upload did not hit c0-c11 transform registers.");
+        return;
     }
+    const uintptr_t shaderKey = upload.shaderKey;
+    const uint32_t shaderHash = upload.shaderHash;
+
+    D3DMATRIX mat;
+    bool anyCaptured = false;
+
+    if (TryCopyProfileMatrix<Regs::kCombinedMvp>(upload, &mat)) {
+        anyCaptured = true;
+        g_cameraMatrices.mvp = mat;
+        g_cameraMatrices.hasMVP = true;
+        UpdateMatrixSource(MatrixSlot_MVP, shaderKey, shaderHash, Regs::kCombinedMvp, 4, false, true,
+                           "DevilMayCry4 profile combined MVP (c0-c3)");
+        resolved.world = mat;
+        resolved.hasWorld = true;
+        g_profileCoreRegistersSeen[0] = true;
+        StoreWorldMatrix(resolved.world, shaderKey, shaderHash, Regs::kCombinedMvp, 4, false, true,
+                         "DevilMayCry4 profile world (c0-c3)");
+    }
+
+    if (TryCopyProfileMatrix<Regs::kView>(upload, &mat)) {
+        anyCaptured = true;
+        resolved.view = mat;
+        resolved.hasView = true;
+        g_profileCoreRegistersSeen[1] = true;
+        g_profileViewDerivedFromInverse = false;
+        StoreViewMatrix(resolved.view, shaderKey, shaderHash, Regs::kView, 4, false, true,
+                        "DevilMayCry4 profile view (c4-c7)");
+    }
+
+    if (TryCopyProfileMatrix<Regs::kProjection>(upload, &mat)) {
+        anyCaptured = true;
+        resolved.proj = mat;
+        resolved.hasProj = true;
+        g_projectionDetectedByNumericStructure = false;
+        g_projectionDetectedRegister = Regs::kProjection;
+        g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
+        g_projectionDetectedFovRadians = ExtractFOV(mat);
+        g_profileCoreRegistersSeen[2] = true;
+        StoreProjectionMatrix(resolved.proj, shaderKey, shaderHash, Regs::kProjection, 4, false, true,
+                              "DevilMayCry4 profile projection (c8-c11)");
+    }
+
+    SetProfileStatusText(anyCaptured
+        ? "DMC4 profile active: strict mapping MVP/World=c0-c3 View=c4-c7 Projection=c8-c11."
+        : "DMC4 profile active but upload did not hit c0-c11 transform registers.");
+}
+
+// Draw gating. The generic mode fills whatever is missing before emitting.
+template <GameProfileKind Profile>
+static ProfileDrawAction PrepareProfileDraw(const ResolvedTransforms&) {
+    return ProfileDraw_EmitWithFallbacks;
+}
+
+// MGR profile is strict: only emit transforms when all three known registers
+// have been captured. Never emit identity/fallback transforms in this mode.
+template <>
+ProfileDrawAction PrepareProfileDraw<GameProfile_MetalGearRising>(const ResolvedTransforms& resolved) {
+    if (resolved.hasWorld && resolved.hasView && resolved.hasProj) {
+        g_profileDrawStatusMessage[0] = '\0';
+        return ProfileDraw_Emit;
+    }
+    snprintf(g_profileDrawStatusMessage, sizeof(g_profileDrawStatusMessage),
+             "MGR draw skipped: missing matrix/matrices (Proj=%s View=%s World=%s).",
+             resolved.hasProj ? "ready" : "missing",
+             resolved.hasView ? "ready" : "missing",
+             resolved.hasWorld ? "ready" : "missing");
+    return ProfileDraw_Skip;
+}
+
+template <>
+ProfileDrawAction PrepareProfileDraw<GameProfile_DevilMayCry4>(const ResolvedTransforms& resolved) {
+    if (resolved.hasWorld && resolved.hasView && resolved.hasProj) {
+        g_profileDrawStatusMessage[0] = '\0';
+        return ProfileDraw_Emit;
+    }
+    snprintf(g_profileDrawStatusMessage, sizeof(g_profileDrawStatusMessage),
+             "DMC4 draw skipped: missing matrix/matrices (World=%s View=%s Proj=%s).",
+             resolved.hasWorld ? "ready" : "missing",
+             resolved.hasView ? "ready" : "missing",
+             resolved.hasProj ? "ready" : "missing");
+    return ProfileDraw_Skip;
+}
+
+template <GameProfileKind Profile>
+static constexpr ProfilePipeline MakeProfilePipeline(bool usesOverlayInputs) {
+    return ProfilePipeline{ usesOverlayInputs, ClassifyProfileUpload<Profile>, PrepareProfileDraw<Profile>,
+                            ResetProfileScene<Profile> };
+}
+
+static const ProfilePipeline kGenericProfilePipeline = MakeProfilePipeline<GameProfile_None>(true);
+static const ProfilePipeline kMgrProfilePipeline = MakeProfilePipeline<GameProfile_MetalGearRising>(false);
+static const ProfilePipeline kDmc4ProfilePipeline = MakeProfilePipeline<GameProfile_DevilMayCry4>(true);
 
-    D3DMATRIX view = MultiplyMatrix(projectionInv, viewProjection);
-    OrthonormalizeViewMatrix(&view);
+// The active profile's handlers. Replaced only by ConfigureActiveProfileLayout.
+static const ProfilePipeline* g_profilePipeline = &kGenericProfilePipeline;
 
-    *outWorld = world;
-    *outView = view;
-    *outProjection = projection;
-    if (outProjectionAnalysis) {
-        *outProjectionAnalysis = analysis;
+// A new profile adds its specializations above and a case here; the upload and
+// draw paths only ever call through g_profilePipeline.
+static const ProfilePipeline* SelectProfilePipeline(GameProfileKind profile) {
+    switch (profile) {
+    case GameProfile_MetalGearRising:
+        return &kMgrProfilePipeline;
+    case GameProfile_DevilMayCry4:
+        return &kDmc4ProfilePipeline;
+    default:
+        return &kGenericProfilePipeline;
     }
-    return true;
 }
 
-// Create an identity matrix
-void CreateIdentityMatrix(D3DMATRIX* out) {
-    memset(out, 0, sizeof(D3DMATRIX));
-    out->_11 = out->_22 = out->_33 = out->_44 = 1.0f;
+static void ConfigureActiveProfileLayout() {
+    g_profileLayout = BuildProfileLayout(g_activeGameProfile);
+    g_profilePipeline = SelectProfilePipeline(g_activeGameProfile);
+    g_profileDisableStructuralDetection = g_activeGameProfile != GameProfile_None;
+    MarkKnownTransformRegisters(g_profileLayout.combinedMvpBase, 4);
+    MarkKnownTransformRegisters(g_profileLayout.projectionBase, 4);
+    MarkKnownTransformRegisters(g_profileLayout.viewInverseBase, 4);
+    MarkKnownTransformRegisters(g_profileLayout.worldBase, 4);
+    MarkKnownTransformRegisters(g_profileLayout.viewProjectionBase, 4);
+    MarkKnownTransformRegisters(g_profileLayout.worldViewBase, 4);
 }
 
-// Try to extract camera position from MVP-like matrix
-void ExtractCameraFromMVP(const D3DMATRIX& mvp, D3DMATRIX* viewOut) {
-    // The MVP matrix has rotation in the upper 3x3 and translation in column 4
-    // We can try to extract a view matrix by normalizing the rotation part
-    CreateIdentityMatrix(viewOut);
-
-    // Extract rotation vectors (may be scaled by projection)
-    float r0len = sqrtf(mvp._11*mvp._11 + mvp._12*mvp._12 + mvp._13*mvp._13);
-    float r1len = sqrtf(mvp._21*mvp._21 + mvp._22*mvp._22 + mvp._23*mvp._23);
-    float r2len = sqrtf(mvp._31*mvp._31 + mvp._32*mvp._32 + mvp._33*mvp._33);
+static void ResetResolvedTransformsForScene(ResolvedTransforms& resolved) {
+    g_profilePipeline->resetScene(resolved);
+}
 
-    if (r0len > 0.001f && r1len > 0.001f && r2len > 0.001f) {
-        // Normalize to get rotation
-        viewOut->_11 = mvp._11 / r0len; viewOut->_12 = mvp._12 / r0len; viewOut->_13 = mvp._13 / r0len;
-        viewOut->_21 = mvp._21 / r1len; viewOut->_22 = mvp._22 / r1len; viewOut->_23 = mvp._23 / r1len;
-        viewOut->_31 = mvp._31 / r2len; viewOut->_32 = mvp._32 / r2len; viewOut->_33 = mvp._33 / r2len;
+static void ClassifyConstantUpload(ResolvedTransforms& resolved,
+                                   const ConstantUpload& upload,
+                                   bool mgrrUseAutoProjection,
+                                   std::vector<UploadMatrixMatch>& structuralMatches) {
+    g_profilePipeline->classifyUpload(resolved, upload, mgrrUseAutoProjection, structuralMatches);
+}
 
-        // Translation (approximate - this is complex with combined matrices)
-        viewOut->_41 = mvp._14 / r0len;
-        viewOut->_42 = mvp._24 / r1len;
-        viewOut->_43 = mvp._34 / r2len;
+// Worker-side classifier state; carries over from frame to frame like m_resolved.
+static ResolvedTransforms g_asyncResolved = {};
+static std::vector<UploadMatrixMatch> g_asyncStructuralMatches;
+static void ClassifyAsyncFrame(const AsyncClassifierFrame& frame, AsyncClassifierResult* result) {
+    for (const AsyncClassifierRecord& record : frame.records) {
+        if (record.kind == AsyncRecord_Draw) {
+            result->draws.push_back(g_asyncResolved);
+        } else if (record.kind == AsyncRecord_BeginScene) {
+            ResetResolvedTransformsForScene(g_asyncResolved);
+        } else {
+            ConstantUpload upload;
+            upload.shaderKey = record.shaderKey;
+            upload.shaderHash = record.shaderHash;
+            upload.stableKey = record.stableKey;
+            upload.startRegister = record.startRegister;
+            upload.vector4fCount = record.vector4fCount;
+            upload.constantData = record.vector4fCount > 0 ? frame.constants.data() + record.dataOffset : nullptr;
+            upload.manualMask = record.manualMask;
+            upload.manual = frame.manual.data() + record.manualOffset;
+            ClassifyConstantUpload(g_asyncResolved, upload, frame.mgrrUseAutoProjection, g_asyncStructuralMatches);
+        }
     }
+    result->final = g_asyncResolved;
 }
 
-// Check if matrix looks like view matrix (orthonormal rotation + translation)
-bool LooksLikeView(const D3DMATRIX& m) {
-    float row0len = sqrtf(m._11*m._11 + m._12*m._12 + m._13*m._13);
-    float row1len = sqrtf(m._21*m._21 + m._22*m._22 + m._23*m._23);
-    float row2len = sqrtf(m._31*m._31 + m._32*m._32 + m._33*m._33);
-
-    if (fabsf(row0len - 1.0f) > 0.1f) return false;
-    if (fabsf(row1len - 1.0f) > 0.1f) return false;
-    if (fabsf(row2len - 1.0f) > 0.1f) return false;
+static void StartAsyncClassifier() {
+    CreateIdentityMatrix(&g_asyncResolved.world);
+    CreateIdentityMatrix(&g_asyncResolved.view);
+    CreateIdentityMatrix(&g_asyncResolved.proj);
+    if (g_asyncClassifier.Start(ClassifyAsyncFrame)) {
+        LogMsg("Async classification enabled: camera transforms run one frame behind (first draw waits up to %u ms).",
+               static_cast<unsigned>(kAsyncClassifierMaxWaitMs));
+    } else {
+        LogMsg("WARNING: Failed to create async classifier thread; classifying on the render thread.");
+        g_config.asyncClassification = false;
+    }
+}
 
-    if (fabsf(m._14) > 0.01f || fabsf(m._24) > 0.01f || fabsf(m._34) > 0.01f) return false;
-    if (fabsf(m._44 - 1.0f) > 0.01f) return false;
+// Settings parsed into g_config that the rest of the proxy reads from globals.
+static void ApplyConfigGlobals() {
+    g_iniViewMatrixRegister = g_config.viewMatrixRegister;
+    g_iniProjMatrixRegister = g_config.projMatrixRegister;
+    g_iniWorldMatrixRegister = g_config.worldMatrixRegister;
+    g_probeTransposedLayouts = g_config.probeTransposedLayouts;
+    g_probeInverseView = g_config.probeInverseView;
+    g_layoutLockThreshold = g_config.layoutLockThreshold;
+    g_bonePaletteMinBones = g_config.bonePaletteMinBones;
+    g_overrideScopeMode = g_config.overrideScopeMode;
+    g_overrideNFrames = g_config.overrideNFrames;
+    g_renderPasses.SetSizePolicies(g_config.passPolicies);
+    ApplyScreenSpaceShaderList();
+    g_presentScheduler.SetBudgetMicros(static_cast<uint32_t>(g_config.presentTaskBudgetUs));
+    ProxyMarkersEnable(g_config.perfMarkers);
+}
 
-    return true;
+static void ApplyGameProfileConfig() {
+    g_activeGameProfile = ParseGameProfile(g_config.gameProfile);
+    ConfigureActiveProfileLayout();
+    g_profileCoreRegistersSeen[0] = g_profileCoreRegistersSeen[1] = g_profileCoreRegistersSeen[2] = false;
+    g_profileOptionalRegistersSeen[0] = g_profileOptionalRegistersSeen[1] = false;
+    g_profileViewDerivedFromInverse = false;
+    g_profileStatusMessage[0] = '\0';
+    g_profileStatusText = nullptr;
+    g_profileDrawStatusMessage[0] = '\0';
+    if (g_config.gameProfile[0] != '\0' && g_activeGameProfile == GameProfile_None) {
+        snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
+                 "Unknown GameProfile='%s'. Falling back to structural detection.", g_config.gameProfile);
+    }
 }
 
-// Forward declarations
-class WrappedD3D9Device;
-class WrappedD3D9;
+// Switches to a camera_proxy.ini re-read by the watcher. Keys that pick the
+// runtime, the log, the layout cache file or the classifier thread only take
+// effect at startup and keep their current values. Runs at Present while the
+// render thread owns the classifier state.
+static void ApplyReloadedConfig(ProxyConfig next) {
+    next.useRemixRuntime = g_config.useRemixRuntime;
+    memcpy(next.remixDllName, g_config.remixDllName, sizeof(next.remixDllName));
+    next.enableLogging = g_config.enableLogging;
+    next.layoutCacheEnabled = g_config.layoutCacheEnabled;
+    memcpy(next.layoutCacheFile, g_config.layoutCacheFile, sizeof(next.layoutCacheFile));
+    next.asyncClassification = g_config.asyncClassification;
+    next.traceCaptureOnStart = g_config.traceCaptureOnStart;
+    next.configHotReload = g_config.configHotReload;
+
+    const bool kernelsChanged = next.useSimdMatrixKernels != g_config.useSimdMatrixKernels;
+    const bool profileChanged = _stricmp(next.gameProfile, g_config.gameProfile) != 0;
+    const bool scaleChanged = next.imguiScale != g_config.imguiScale;
+    g_config = next;
+    ApplyConfigGlobals();
+    ApplyReconstructionConfig();
+    if (kernelsChanged) {
+        SelectMatrixKernels(g_config.useSimdMatrixKernels);
+    }
+    if (profileChanged) {
+        ApplyGameProfileConfig();
+    }
+    const uint32_t settingsHash = ComputeLayoutCacheSettingsHash();
+    if (settingsHash != g_layoutCacheSettingsHash) {
+        // Locked layouts were learned under the old FOV limits and probes.
+        ResetLearnedLayouts();
+        g_layoutCacheSettingsHash = settingsHash;
+    }
+    if (scaleChanged && g_imguiInitialized) {
+        g_imguiScaleRuntime = g_config.imguiScale;
+        ApplyImGuiScale(g_imguiHwnd);
+    }
+    InvalidateCustomProjectionCache();
+    g_configReloadCount++;
+    LogMsg("Reloaded camera_proxy.ini (reload %u)%s.", g_configReloadCount,
+           profileChanged ? ", game profile changed" : "");
+}
 
 /**
  * Wrapped IDirect3DDevice9 - intercepts SetVertexShaderConstantF
  */
-class WrappedD3D9Device : public IDirect3DDevice9 {
+// Implements the IDirect3DDevice9Ex vtable so WrappedD3D9DeviceEx can share every
+// hook; a plain device is never handed out as IDirect3DDevice9Ex and its Ex
+// entry points refuse the call.
+class WrappedD3D9Device : public IDirect3DDevice9Ex {
 private:
     IDirect3DDevice9* m_real;
-    D3DMATRIX m_currentView;
-    D3DMATRIX m_currentProj;
-    D3DMATRIX m_currentWorld;
+    // What the next draw sends as WORLD/VIEW/PROJECTION. In async mode it is reloaded
+    // per draw from the worker's result for the previous frame.
+    ResolvedTransforms m_resolved;
+    uint32_t m_asyncDrawIndex = 0;
     HWND m_hwnd = nullptr;
+    // The shader the game bound (a wrapper unless it came from elsewhere) and its slot.
     IDirect3DVertexShader9* m_currentVertexShader = nullptr;
-    bool m_hasView = false;
-    bool m_hasProj = false;
-    bool m_hasWorld = false;
+    ShaderSlot* m_currentShaderSlot = NullShaderSlot();
+    // Reference held on a bound wrapper, as the runtime holds one on the real shader.
+    WrappedD3D9VertexShader* m_boundWrappedShader = nullptr;
+    // Referenced while bound, like m_boundWrappedShader; null under an FVF.
+    WrappedD3D9VertexDeclaration* m_boundDeclaration = nullptr;
     bool m_mgrrUseAutoProjection = false;
     int m_constantLogThrottle = 0;
+    // Override scratch for SetVertexShaderConstantF; uploads larger than this skip overrides.
+    float m_constantScratch[kMaxConstantRegisters * 4] = {};
+    // Reused output of ScanUploadForMatrices so full scans do not allocate per upload.
+    std::vector<UploadMatrixMatch> m_structuralMatches;
+    // Current WORLD/VIEW/PROJECTION of the real device, whoever set them. Answers
+    // GetTransform and drops redundant SetTransform calls.
+    TransformStateShadow m_transformShadow;
+    bool m_recordingStateBlock = false;
+    // Transforms set while recording; handed to the block returned by EndStateBlock.
+    uint8_t m_recordedTransformMask = 0;
+    TransformStateShadow m_recordedTransforms;
+    D3DMATRIX m_customProjection = {};
+    uint32_t m_customProjectionGeneration = 0;
+    bool m_customProjectionValid = false;
+    bool m_customProjectionStored = false;
+    bool m_customProjectionPublishPending = false;
+    const char* m_customProjectionLabel = nullptr;
+    float m_customProjectionFov = 0.0f;
+    // g_cameraMatrices.hasMVP as of the last Present that owned the classifier
+    // state; draws read this copy while the async worker may be writing it.
+    bool m_cameraHasMVP = false;
+    DWORD m_viewportWidth = 0;
+    DWORD m_viewportHeight = 0;
+    // Bound FVF or vertex declaration carries pretransformed (XYZRHW/POSITIONT) positions.
+    bool m_pretransformedInput = false;
+
+    bool ShadowMatches(int index, const D3DMATRIX& matrix) const {
+        return index >= 0 && !m_recordingStateBlock && m_transformShadow.valid[index] &&
+               memcmp(&m_transformShadow.matrix[index], &matrix, sizeof(D3DMATRIX)) == 0;
+    }
+
+    // Records a successful SetTransform. While recording it lands in the block
+    // instead of the device; matrix == nullptr means the resulting value is unknown.
+    void NoteTransformSet(int index, const D3DMATRIX* matrix) {
+        if (index < 0) {
+            return;
+        }
+        TransformStateShadow& target = m_recordingStateBlock ? m_recordedTransforms : m_transformShadow;
+        if (m_recordingStateBlock) {
+            m_recordedTransformMask |= static_cast<uint8_t>(1u << index);
+        }
+        target.valid[index] = matrix != nullptr;
+        if (matrix) {
+            target.matrix[index] = *matrix;
+        }
+    }
+
+    // Returns false when the device already holds the matrix and nothing was sent.
+    bool EmitTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX& matrix) {
+        const int index = ShadowTransformIndex(state);
+        if (g_config.emitTransformsOnChangeOnly && ShadowMatches(index, matrix)) {
+            g_transformEmitSkipped++;
+            return false;
+        }
+        HRESULT hr = m_real->SetTransform(state, &matrix);
+        g_transformEmitSent++;
+        NoteTransformSet(index, SUCCEEDED(hr) ? &matrix : nullptr);
+        return true;
+    }
+
+    void EmitWorldViewProjection() {
+        PROXY_MARKER_SCOPE(ProxyMarker_TransformEmission);
+        unsigned sentMask = 0;
+        sentMask |= EmitTransform(D3DTS_WORLD, m_resolved.world) ? 1u : 0u;
+        sentMask |= EmitTransform(D3DTS_VIEW, m_resolved.view) ? 2u : 0u;
+        sentMask |= EmitTransform(D3DTS_PROJECTION, m_resolved.proj) ? 4u : 0u;
+        ProxyMarkerEmittedSlots(sentMask);
+    }
 
 public:
     WrappedD3D9Device(IDirect3DDevice9* real) : m_real(real) {
-        CreateIdentityMatrix(&m_currentView);
-        CreateIdentityMatrix(&m_currentProj);
-        CreateIdentityMatrix(&m_currentWorld);
+        CreateIdentityMatrix(&m_resolved.view);
+        CreateIdentityMatrix(&m_resolved.proj);
+        CreateIdentityMatrix(&m_resolved.world);
         m_mgrrUseAutoProjection = g_config.mgrrUseAutoProjectionWhenC4Invalid;
         D3DDEVICE_CREATION_PARAMETERS params = {};
         if (SUCCEEDED(m_real->GetCreationParameters(&params))) {
@@ -2810,603 +5528,587 @@ public:
         if (!m_hwnd) {
             m_hwnd = GetForegroundWindow();
         }
+        ResetRenderPasses();
+        RegisterPresentTasks();
+        LoadLayoutCache();
+        ProxyMarkersSetRenderThread(GetCurrentThreadId());
         LogMsg("WrappedD3D9Device created, wrapping device at %p", real);
     }
 
-    ~WrappedD3D9Device() {
+    virtual ~WrappedD3D9Device() {
         LogMsg("WrappedD3D9Device destroyed");
     }
 
-    void EmitFixedFunctionTransforms() {
-        if (!g_config.emitFixedFunctionTransforms) {
+    // Intervals are in frames. RunFrame is only called while the render thread owns
+    // the classifier state, so tasks may read and write it; the context is the
+    // device that is presenting.
+    static void RegisterPresentTasks() {
+        if (g_presentScheduler.TaskCount() > 0) {
             return;
         }
-        if (g_activeGameProfile == GameProfile_MetalGearRising) {
-            // MGR profile is strict: only emit transforms when all three known registers
-            // have been captured. Never emit identity/fallback transforms in this mode.
-            if (!(m_hasWorld && m_hasView && m_hasProj)) {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "MGR draw skipped: missing matrix/matrices (Proj=%s View=%s World=%s).",
-                         m_hasProj ? "ready" : "missing",
-                         m_hasView ? "ready" : "missing",
-                         m_hasWorld ? "ready" : "missing");
-                return;
+        // A tracked scanner hit is re-validated every frame unless the budget is spent.
+        g_presentScheduler.Register("Memory tracking", 1, 2, [](void*) {
+            UpdateMemoryTracking();
+        });
+        g_presentScheduler.Register("Memory scanner timer", 30, 30, [](void*) {
+            if (g_config.enableMemoryScanner && g_config.memoryScannerIntervalSec > 0 && !IsMemoryTrackingActive()) {
+                DWORD nowTick = GetTickCount();
+                if (g_memoryScannerLastTick == 0 ||
+                    nowTick - g_memoryScannerLastTick >= static_cast<DWORD>(g_config.memoryScannerIntervalSec) * 1000u) {
+                    StartMemoryScanner();
+                    g_memoryScannerLastTick = nowTick;
+                }
+            }
+        });
+        g_presentScheduler.Register("Layout cache autosave", 60, 120, [](void*) {
+            if (g_layoutCacheDirty && g_config.layoutCacheEnabled &&
+                GetTickCount() - g_layoutCacheLastSaveTick >= kLayoutCacheAutosaveMs) {
+                SaveLayoutCache(true);
             }
+        });
+        g_presentScheduler.Register("Status log", 300, 300, [](void* context) {
+            const WrappedD3D9Device* device = static_cast<const WrappedD3D9Device*>(context);
+            LogMsg("Frame %d - hasView: %d, hasProj: %d", g_frameCount,
+                   device->m_resolved.hasView, device->m_resolved.hasProj);
+        });
+    }
 
-            m_real->SetTransform(D3DTS_WORLD, &m_currentWorld);
-            m_real->SetTransform(D3DTS_VIEW, &m_currentView);
-            m_real->SetTransform(D3DTS_PROJECTION, &m_currentProj);
+    void EmitFixedFunctionTransforms() {
+        PROXY_PROFILE_SCOPE(ProfilerZone_EmitTransforms);
+        if (!g_config.emitFixedFunctionTransforms) {
             return;
         }
-
-        if (g_activeGameProfile == GameProfile_DevilMayCry4) {
-            if (!(m_hasWorld && m_hasView && m_hasProj)) {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "DMC4 draw skipped: missing matrix/matrices (World=%s View=%s Proj=%s).",
-                         m_hasWorld ? "ready" : "missing",
-                         m_hasView ? "ready" : "missing",
-                         m_hasProj ? "ready" : "missing");
-                return;
-            }
-
-            m_real->SetTransform(D3DTS_WORLD, &m_currentWorld);
-            m_real->SetTransform(D3DTS_VIEW, &m_currentView);
-            m_real->SetTransform(D3DTS_PROJECTION, &m_currentProj);
+        const ProfileDrawAction action = g_profilePipeline->prepareDraw(m_resolved);
+        if (action == ProfileDraw_Skip) {
             return;
         }
+        if (action == ProfileDraw_EmitWithFallbacks) {
+            ApplyDrawFallbacks();
+        }
+        EmitWorldViewProjection();
+    }
+
+    // Generic mode: complete m_resolved from tracked memory, the experimental
+    // custom projection and identity.
+    // Publishes the custom projection as the detected one. With the async worker
+    // mid-frame this waits for the next Present that owns the classifier state.
+    void PublishCustomProjection() {
+        m_customProjectionPublishPending = false;
+        g_projectionDetectedByNumericStructure = false;
+        g_projectionDetectedRegister = -1;
+        g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
+        g_projectionDetectedFovRadians = m_customProjectionFov;
+        // Another source may have replaced the published projection since the
+        // last draw; republish only then.
+        if (!m_customProjectionStored || g_matrixSources[MatrixSlot_Projection].sourceLabel != m_customProjectionLabel) {
+            StoreProjectionMatrix(m_customProjection, 0, 0, -1, 4, false, true, m_customProjectionLabel);
+            m_customProjectionStored = true;
+        }
+    }
+
+    void ApplyDrawFallbacks() {
+        // Tracked memory matrices are the most direct camera source available,
+        // so they take precedence over whatever the constant uploads produced.
+        if (g_memoryTracked[MatrixSlot_View].valid) {
+            m_resolved.view = g_memoryTracked[MatrixSlot_View].matrix;
+            m_resolved.hasView = true;
+        }
+        if (g_memoryTracked[MatrixSlot_Projection].valid) {
+            m_resolved.proj = g_memoryTracked[MatrixSlot_Projection].matrix;
+            m_resolved.hasProj = true;
+        }
 
         bool shouldApplyCustomProjection = false;
         if (g_config.experimentalCustomProjectionEnabled) {
-            const bool projectionMissing = !m_hasProj;
+            const bool projectionMissing = !m_resolved.hasProj;
             const bool projectionOverrideAllowed = g_config.experimentalCustomProjectionOverrideDetectedProjection;
-            const bool mvpBlocksProjection = g_cameraMatrices.hasMVP && !g_config.experimentalCustomProjectionOverrideCombinedMVP;
+            const bool cameraHasMVP = g_asyncClassifier.Running() ? m_cameraHasMVP : g_cameraMatrices.hasMVP;
+            const bool mvpBlocksProjection = cameraHasMVP && !g_config.experimentalCustomProjectionOverrideCombinedMVP;
             shouldApplyCustomProjection = (projectionMissing || projectionOverrideAllowed) && !mvpBlocksProjection;
         }
 
         if (shouldApplyCustomProjection) {
-            D3DMATRIX customProjection = {};
-            bool usedAuto = false;
-            float resolvedAspect = 0.0f;
-            UINT width = 0;
-            UINT height = 0;
-            if (BuildExperimentalCustomProjectionMatrix(m_real, m_hwnd, &customProjection,
-                                                        &usedAuto, &resolvedAspect,
-                                                        &width, &height)) {
-                m_currentProj = customProjection;
-                m_hasProj = true;
-                g_projectionDetectedByNumericStructure = false;
-                g_projectionDetectedRegister = -1;
-                g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                g_projectionDetectedFovRadians = ExtractFOV(customProjection);
-                StoreProjectionMatrix(m_currentProj, 0, -1, 4, false, true,
-                                      usedAuto
-                                          ? "experimental custom projection auto"
-                                          : "experimental custom projection manual");
-                if (usedAuto) {
-                    snprintf(g_customProjectionStatus, sizeof(g_customProjectionStatus),
-                             "Experimental projection active (auto): %ux%u aspect=%.4f fov=%.2f near=%.4f far=%.2f.",
-                             width, height, resolvedAspect,
-                             g_config.experimentalCustomProjectionAutoFovDeg,
-                             g_config.experimentalCustomProjectionAutoNearZ,
-                             g_config.experimentalCustomProjectionAutoFarZ);
+            if (m_customProjectionGeneration != g_customProjectionGeneration) {
+                CustomProjectionStatusInfo& status = g_customProjectionStatusInfo;
+                status = CustomProjectionStatusInfo{};
+                m_customProjectionValid = BuildExperimentalCustomProjectionMatrix(m_real, m_hwnd, &m_customProjection,
+                                                                                  &status.usedAuto, &status.aspect,
+                                                                                  &status.width, &status.height);
+                status.active = m_customProjectionValid;
+                m_customProjectionFov = m_customProjectionValid ? ExtractFOV(m_customProjection) : 0.0f;
+                m_customProjectionGeneration = g_customProjectionGeneration;
+                m_customProjectionStored = false;
+            }
+            if (m_customProjectionValid) {
+                const char* label = g_customProjectionStatusInfo.usedAuto ? kCustomProjectionAutoLabel
+                                                                          : kCustomProjectionManualLabel;
+                m_resolved.proj = m_customProjection;
+                m_resolved.hasProj = true;
+                m_customProjectionLabel = label;
+                if (RenderThreadOwnsClassifierState()) {
+                    PublishCustomProjection();
                 } else {
-                    snprintf(g_customProjectionStatus, sizeof(g_customProjectionStatus),
-                             "Experimental projection active (manual matrix mode).");
+                    m_customProjectionPublishPending = true;
                 }
             }
         }
 
         D3DMATRIX identity = {};
         CreateIdentityMatrix(&identity);
-        if (!m_hasWorld) m_currentWorld = identity;
-        if (!m_hasView) m_currentView = identity;
-        if (!m_hasProj) m_currentProj = identity;
-        m_real->SetTransform(D3DTS_WORLD, &m_currentWorld);
-        m_real->SetTransform(D3DTS_VIEW, &m_currentView);
-        m_real->SetTransform(D3DTS_PROJECTION, &m_currentProj);
+        if (!m_resolved.hasWorld) m_resolved.world = identity;
+        if (!m_resolved.hasView) m_resolved.view = identity;
+        if (!m_resolved.hasProj) m_resolved.proj = identity;
     }
 
-
-    // IUnknown
-    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObj) override {
-        HRESULT hr = m_real->QueryInterface(riid, ppvObj);
-        // Don't wrap QueryInterface results - could cause issues
-        return hr;
+    // HUD, fullscreen-quad and post-process draws have no camera; whatever the
+    // proxy sent would be taken as their transforms.
+    bool IsScreenSpaceDraw() const {
+        const uint8_t flags = m_currentShaderSlot->screenSpace;
+        if (flags & ScreenSpace_Listed) {
+            return true;
+        }
+        return g_config.skipScreenSpaceDraws && (m_pretransformedInput || flags != 0);
     }
 
-    ULONG STDMETHODCALLTYPE AddRef() override {
-        return m_real->AddRef();
+    // Per-draw entry point. Draws in ignored passes and screen-space draws are left
+    // alone entirely; in async mode the draw is also recorded for the worker, and
+    // the transforms it resolved for the same draw last frame are loaded first.
+    void EmitDrawTransforms() {
+        if (NoteDrawPass() == PassPolicy_Ignore) {
+            g_passDrawsSkipped++;
+            return;
+        }
+        if (IsScreenSpaceDraw()) {
+            g_screenSpaceDrawsSkipped++;
+            return;
+        }
+        if (g_asyncClassifier.Running()) {
+            g_asyncClassifier.RecordEvent(AsyncRecord_Draw);
+            if (m_asyncDrawIndex == 0) {
+                g_asyncClassifier.BeginFrameDraws();
+            }
+            if (const ResolvedTransforms* resolved = g_asyncClassifier.ResolvedForDraw(m_asyncDrawIndex)) {
+                m_resolved = *resolved;
+            }
+            m_asyncDrawIndex++;
+        }
+        EmitFixedFunctionTransforms();
     }
 
-    ULONG STDMETHODCALLTYPE Release() override {
-        ULONG count = m_real->Release();
-        if (count == 0) {
-            ShutdownImGui();
-            delete this;
+    void BindVertexShaderSlot(IDirect3DVertexShader9* shader, WrappedD3D9VertexShader* wrapped) {
+        if (wrapped) {
+            wrapped->AddRef();
+        }
+        WrappedD3D9VertexShader* previous = m_boundWrappedShader;
+        m_boundWrappedShader = wrapped;
+        m_currentVertexShader = shader;
+        if (wrapped) {
+            m_currentShaderSlot = wrapped->Slot();
+        } else {
+            m_currentShaderSlot = shader ? AcquireShaderSlot(reinterpret_cast<uintptr_t>(shader)) : NullShaderSlot();
+        }
+        g_activeShaderKey = m_currentShaderSlot->key;
+        if (previous) {
+            previous->Release();
         }
-        return count;
     }
 
-    // The key interception point
-    HRESULT STDMETHODCALLTYPE SetVertexShaderConstantF(
-        UINT StartRegister,
-        const float* pConstantData,
-        UINT Vector4fCount) override
-    {
-        uintptr_t shaderKey = reinterpret_cast<uintptr_t>(m_currentVertexShader);
-        ShaderConstantState* state = GetShaderState(shaderKey, true);
-        const bool profileIsMgr = g_activeGameProfile == GameProfile_MetalGearRising;
-
-        std::vector<float> overrideScratch;
-        const float* effectiveConstantData = pConstantData;
-        // Keep MGR profile extraction isolated from manual/override paths.
-        if (!profileIsMgr && BuildOverriddenConstants(*state, StartRegister, Vector4fCount, pConstantData, overrideScratch)) {
-            effectiveConstantData = overrideScratch.data();
+    // A state block may have rebound the vertex shader; pick up whatever the device has now.
+    void ResyncVertexShaderBinding() {
+        IDirect3DVertexShader9* real = nullptr;
+        if (FAILED(m_real->GetVertexShader(&real))) {
+            return;
         }
-
-        bool constantsChanged = false;
-        for (UINT i = 0; i < Vector4fCount; i++) {
-            UINT reg = StartRegister + i;
-            if (reg >= kMaxConstantRegisters) {
-                break;
-            }
-            if (!constantsChanged) {
-                if (!state->valid[reg] ||
-                    memcmp(state->constants[reg], effectiveConstantData + i * 4,
-                           sizeof(state->constants[reg])) != 0) {
-                    constantsChanged = true;
-                }
+        IDirect3DVertexShader9* current = m_boundWrappedShader ? m_boundWrappedShader->Real() : m_currentVertexShader;
+        if (real != current) {
+            auto it = g_wrappedVertexShadersByReal.find(real);
+            WrappedD3D9VertexShader* wrapped = it != g_wrappedVertexShadersByReal.end() ? it->second : nullptr;
+            BindVertexShaderSlot(wrapped ? static_cast<IDirect3DVertexShader9*>(wrapped) : real, wrapped);
+            if (g_traceWriter.IsOpen()) {
+                TraceShaderBinding(wrapped ? static_cast<IDirect3DVertexShader9*>(wrapped) : real);
             }
-            memcpy(state->constants[reg], effectiveConstantData + i * 4, sizeof(state->constants[reg]));
-            state->valid[reg] = true;
-            UpdateVariance(*state, static_cast<int>(reg), effectiveConstantData + i * 4);
         }
-        if (constantsChanged) {
-            state->lastChangeSerial = ++g_constantChangeSerial;
+        if (real) {
+            real->Release();
         }
-        state->snapshotReady = true;
+    }
 
-        bool slotResolvedByOverride[MatrixSlot_Count] = {};
-        bool slotResolvedStructurally[MatrixSlot_Count] = {};
+    void BindVertexDeclaration(WrappedD3D9VertexDeclaration* wrapped) {
+        if (wrapped) {
+            wrapped->AddRef();
+        }
+        WrappedD3D9VertexDeclaration* previous = m_boundDeclaration;
+        m_boundDeclaration = wrapped;
+        if (previous) {
+            previous->Release();
+        }
+    }
 
-        if (!profileIsMgr && shaderKey != 0) {
-            for (int slot = 0; slot < MatrixSlot_Count; slot++) {
-                const ManualMatrixBinding& binding = g_manualBindings[slot];
-                if (!binding.enabled || binding.shaderKey != shaderKey) {
-                    continue;
-                }
-                D3DMATRIX manualMat = {};
-                if (!TryBuildMatrixSnapshot(*state, binding.baseRegister, binding.rows, false, &manualMat)) {
-                    continue;
-                }
-                slotResolvedByOverride[slot] = true;
-                if (slot == MatrixSlot_World) {
-                    m_currentWorld = manualMat;
-                    m_hasWorld = true;
-                    StoreWorldMatrix(m_currentWorld, shaderKey, binding.baseRegister, binding.rows, false, true);
-                } else if (slot == MatrixSlot_View) {
-                    m_currentView = manualMat;
-                    m_hasView = true;
-                    StoreViewMatrix(m_currentView, shaderKey, binding.baseRegister, binding.rows, false, true);
-                } else if (slot == MatrixSlot_Projection) {
-                    m_currentProj = manualMat;
-                    m_hasProj = true;
-                    g_projectionDetectedByNumericStructure = false;
-                    g_projectionDetectedRegister = binding.baseRegister;
-                    g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                    g_projectionDetectedFovRadians = 0.0f;
-                    StoreProjectionMatrix(m_currentProj, shaderKey, binding.baseRegister, binding.rows, false, true);
-                } else if (slot == MatrixSlot_MVP) {
-                    StoreMVPMatrix(manualMat, shaderKey, binding.baseRegister, binding.rows, false, true);
-                }
+    // After a state-block Apply, which may have restored the FVF or declaration.
+    void ResyncVertexInput() {
+        DWORD fvf = 0;
+        if (SUCCEEDED(m_real->GetFVF(&fvf)) && fvf != 0) {
+            BindVertexDeclaration(nullptr);
+            m_pretransformedInput = (fvf & D3DFVF_POSITION_MASK) == D3DFVF_XYZRHW;
+            if (g_traceWriter.IsOpen()) {
+                TraceFVF(fvf);
             }
+            return;
         }
+        IDirect3DVertexDeclaration9* real = nullptr;
+        if (FAILED(m_real->GetVertexDeclaration(&real))) {
+            return;
+        }
+        auto it = g_wrappedVertexDeclarationsByReal.find(real);
+        WrappedD3D9VertexDeclaration* wrapped = it != g_wrappedVertexDeclarationsByReal.end() ? it->second : nullptr;
+        BindVertexDeclaration(wrapped);
+        m_pretransformedInput = wrapped ? wrapped->Pretransformed() : ReadPretransformedDeclaration(real);
+        if (g_traceWriter.IsOpen()) {
+            TraceDeclarationBinding(wrapped ? static_cast<IDirect3DVertexDeclaration9*>(wrapped) : real);
+        }
+        if (real) {
+            real->Release();
+        }
+    }
 
-        if (profileIsMgr) {
-            g_profileDisableStructuralDetection = true;
-            // MGR strict known-layout mode:
-            // - capture c4-c7 projection, c8-c11 viewProjection, c16-c19 world
-            // - derive View as inverse(Projection) * ViewProjection
-            // - do not run structural detection fallback or candidate scanning
-            // - persist projection/view across draws until overwritten by the same known registers
-            auto tryExtractMgrMatrix = [&](int baseRegister, D3DMATRIX* outMat) -> bool {
-                if (!outMat || !effectiveConstantData || baseRegister < 0) {
-                    return false;
-                }
-                const UINT uploadStart = StartRegister;
-                const UINT uploadEnd = (Vector4fCount == 0) ? StartRegister : (StartRegister + Vector4fCount - 1);
-                const UINT matrixEnd = static_cast<UINT>(baseRegister + 3);
-                if (uploadStart > static_cast<UINT>(baseRegister) || uploadEnd < matrixEnd) {
-                    return false;
-                }
-                return TryBuildMatrixFromConstantUpdate(effectiveConstantData,
-                                                        StartRegister,
-                                                        Vector4fCount,
-                                                        baseRegister,
-                                                        4,
-                                                        false,
-                                                        outMat);
-            };
+    void InvalidateTransformShadow() {
+        memset(m_transformShadow.valid, 0, sizeof(m_transformShadow.valid));
+    }
 
-            D3DMATRIX mat = {};
-            if (tryExtractMgrMatrix(4, &mat)) {
-                g_profileCoreRegistersSeen[0] = true;
-                g_mgrProjectionRegisterValid = IsTypicalProjectionMatrix(mat);
-                m_currentProj = mat;
-                m_hasProj = true;
-                g_mgrProjCapturedThisFrame = true;
-                if (g_mgrProjectionRegisterValid) {
-                    g_projectionDetectedByNumericStructure = false;
-                    g_projectionDetectedRegister = 4;
-                    g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                    g_projectionDetectedFovRadians = ExtractFOV(mat);
-                    StoreProjectionMatrix(m_currentProj, shaderKey, 4, 4, false, true,
-                                          "MetalGearRising profile projection (c4-c7)");
-                } else {
-                    g_projectionDetectedByNumericStructure = false;
-                    g_projectionDetectedRegister = 4;
-                    g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                    g_projectionDetectedFovRadians = 0.0f;
-                    StoreProjectionMatrix(m_currentProj, shaderKey, 4, 4, false, true,
-                                          "MetalGearRising profile projection (c4-c7, non-typical)");
-                    snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                             "MGR projection at c4-c7 is non-typical; using it by default.");
-                }
+    // Called by WrappedD3D9StateBlock: Apply() writes the block's transforms to the
+    // device, Capture() reads the device's into the block.
+    void ApplyStateBlockTransforms(uint8_t mask, const TransformStateShadow& transforms) {
+        for (int i = 0; i < 3; i++) {
+            if (mask & (1u << i)) {
+                m_transformShadow.valid[i] = transforms.valid[i];
+                m_transformShadow.matrix[i] = transforms.matrix[i];
             }
+        }
+    }
 
-            if (tryExtractMgrMatrix(8, &mat)) {
-                g_profileCoreRegistersSeen[1] = true;
-                g_profileOptionalRegistersSeen[0] = true;
-
-                D3DMATRIX resolvedProjection = {};
-                bool haveProjectionForViewDerivation = false;
+    void CaptureStateBlockTransforms(uint8_t mask, TransformStateShadow* transforms) const {
+        for (int i = 0; i < 3; i++) {
+            if (mask & (1u << i)) {
+                transforms->valid[i] = m_transformShadow.valid[i];
+                transforms->matrix[i] = m_transformShadow.matrix[i];
+            }
+        }
+    }
 
-                if (m_hasProj) {
-                    resolvedProjection = m_currentProj;
-                    haveProjectionForViewDerivation = true;
+    void TraceShaderBinding(IDirect3DVertexShader9* pShader) {
+        const uint64_t key = reinterpret_cast<uintptr_t>(pShader);
+        if (pShader && g_traceWriter.MarkShaderEmitted(key)) {
+            UINT size = 0;
+            if (SUCCEEDED(pShader->GetFunction(nullptr, &size)) && size > 0 && size <= kTraceMaxShaderBytes) {
+                std::vector<uint8_t> bytecode(size);
+                if (SUCCEEDED(pShader->GetFunction(bytecode.data(), &size))) {
+                    g_traceWriter.Write(TraceRecord_Shader, &key, sizeof(key), bytecode.data(), size);
                 }
+            }
+        }
+        g_traceWriter.Write(TraceRecord_SetVertexShader, &key, sizeof(key));
+    }
+
+    // Render target 0 or the depth-stencil surface, with the description the
+    // render pass tracker keys on.
+    void TraceSurfaceBinding(TraceRecordType type, IDirect3DSurface9* pSurface) {
+        TraceSurfacePayload payload = {};
+        payload.key = reinterpret_cast<uintptr_t>(pSurface);
+        D3DSURFACE_DESC desc = {};
+        if (pSurface && SUCCEEDED(pSurface->GetDesc(&desc))) {
+            payload.width = desc.Width;
+            payload.height = desc.Height;
+            payload.format = static_cast<uint32_t>(desc.Format);
+            payload.usage = desc.Usage;
+        }
+        g_traceWriter.Write(type, &payload, sizeof(payload));
+    }
 
-                if (!g_mgrProjectionRegisterValid && m_mgrrUseAutoProjection) {
-                    ProjectionAnalysis generatedProjectionInfo = {};
-                    D3DMATRIX generatedProjection = {};
-                    if (TryExtractProjectionFromCombined(mat,
-                                                         &generatedProjectionInfo,
-                                                         &generatedProjection,
-                                                         g_config.combinedMVPForceDecomposition)) {
-                        resolvedProjection = generatedProjection;
-                        m_currentProj = generatedProjection;
-                        m_hasProj = true;
-                        g_mgrProjCapturedThisFrame = true;
-                        g_projectionDetectedByNumericStructure = true;
-                        g_projectionDetectedRegister = 8;
-                        g_projectionDetectedHandedness = generatedProjectionInfo.handedness;
-                        g_projectionDetectedFovRadians = generatedProjectionInfo.fovRadians;
-                        StoreProjectionMatrix(m_currentProj, shaderKey, 8, 4, false, true,
-                                              "MetalGearRising auto projection from VP (c8-c11)");
-                        haveProjectionForViewDerivation = true;
-                    }
-                }
+    void TraceFVF(DWORD fvf) {
+        const uint32_t value = fvf;
+        g_traceWriter.Write(TraceRecord_SetFVF, &value, sizeof(value));
+    }
 
-                if (haveProjectionForViewDerivation) {
-                    D3DMATRIX projectionInv = {};
-                    if (InvertMatrix4x4Deterministic(resolvedProjection, &projectionInv, nullptr)) {
-                        D3DMATRIX derivedView = MultiplyMatrix(projectionInv, mat);
-                        OrthonormalizeViewMatrix(&derivedView);
-                        m_currentView = derivedView;
-                        m_hasView = true;
-                        g_mgrViewCapturedThisFrame = true;
-                        g_profileViewDerivedFromInverse = true;
-                        snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                                 "MGR view updated from VP (c8-c11) using inverse projection.");
-                        StoreViewMatrix(m_currentView, shaderKey, 8, 4, false, true,
-                                        "MetalGearRising profile view from VP", 8);
-                    } else {
-                        g_profileViewDerivedFromInverse = false;
-                        snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                                 "MGR VP derivation failed: projection inversion failed.");
-                    }
-                } else {
-                    g_profileViewDerivedFromInverse = false;
-                    snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                             "MGR VP detected but projection inversion failed. Enable auto projection to prefer generated projection.");
+    void TraceDeclarationBinding(IDirect3DVertexDeclaration9* pDecl) {
+        const uint64_t key = reinterpret_cast<uintptr_t>(pDecl);
+        if (pDecl && g_traceWriter.MarkDeclarationEmitted(key)) {
+            UINT count = 0;
+            if (SUCCEEDED(pDecl->GetDeclaration(nullptr, &count)) && count > 0 && count <= kTraceMaxDeclarationElements) {
+                std::vector<D3DVERTEXELEMENT9> elements(count);
+                if (SUCCEEDED(pDecl->GetDeclaration(elements.data(), &count))) {
+                    g_traceWriter.Write(TraceRecord_VertexDeclaration, &key, sizeof(key),
+                                        elements.data(), count * sizeof(D3DVERTEXELEMENT9));
                 }
             }
-
-            if (tryExtractMgrMatrix(16, &mat)) {
-                m_currentWorld = mat;
-                m_hasWorld = true;
-                g_mgrWorldCapturedForDraw = true;
-                g_profileCoreRegistersSeen[2] = true;
-                StoreWorldMatrix(m_currentWorld, shaderKey, 16, 4, false, true,
-                                 "MetalGearRising profile world (c16-c19)");
-            }
-
-            return m_real->SetVertexShaderConstantF(StartRegister, effectiveConstantData, Vector4fCount);
         }
+        g_traceWriter.Write(TraceRecord_SetVertexDeclaration, &key, sizeof(key));
+    }
 
-        const bool profileIsDmc4 = g_activeGameProfile == GameProfile_DevilMayCry4;
-        const bool profileActive = profileIsMgr || profileIsDmc4;
-
-        auto tryExtractProfileMatrix = [&](int baseRegister, D3DMATRIX* outMat) -> bool {
-            if (!outMat || !effectiveConstantData || baseRegister < 0) {
-                return false;
+    // Whichever of the FVF or declaration is live on the device.
+    void TraceVertexInput() {
+        if (m_boundDeclaration) {
+            TraceDeclarationBinding(m_boundDeclaration);
+            return;
+        }
+        DWORD fvf = 0;
+        if (SUCCEEDED(m_real->GetFVF(&fvf)) && fvf != 0) {
+            TraceFVF(fvf);
+            return;
+        }
+        IDirect3DVertexDeclaration9* decl = nullptr;
+        if (SUCCEEDED(m_real->GetVertexDeclaration(&decl))) {
+            TraceDeclarationBinding(decl);
+            if (decl) {
+                decl->Release();
             }
-            return TryBuildMatrixFromConstantUpdate(effectiveConstantData, StartRegister, Vector4fCount,
-                                                    baseRegister, 4, false, outMat);
-        };
+        }
+    }
 
-        if (profileIsDmc4) {
-            D3DMATRIX mat = {};
-            bool anyCaptured = false;
-
-            if (tryExtractProfileMatrix(g_profileLayout.combinedMvpBase, &mat)) {
-                anyCaptured = true;
-                g_cameraMatrices.mvp = mat;
-                g_cameraMatrices.hasMVP = true;
-                UpdateMatrixSource(MatrixSlot_MVP, shaderKey, g_profileLayout.combinedMvpBase, 4, false, true,
-                                   "DevilMayCry4 profile combined MVP (c0-c3)");
-                m_currentWorld = mat;
-                m_hasWorld = true;
-                slotResolvedByOverride[MatrixSlot_World] = true;
-                g_profileCoreRegistersSeen[0] = true;
-                StoreWorldMatrix(m_currentWorld, shaderKey, g_profileLayout.worldBase, 4, false, true,
-                                 "DevilMayCry4 profile world (c0-c3)");
-            }
-
-            if (tryExtractProfileMatrix(g_profileLayout.viewInverseBase, &mat)) {
-                anyCaptured = true;
-                m_currentView = mat;
-                m_hasView = true;
-                slotResolvedByOverride[MatrixSlot_View] = true;
-                g_profileCoreRegistersSeen[1] = true;
-                g_profileViewDerivedFromInverse = false;
-                StoreViewMatrix(m_currentView, shaderKey, g_profileLayout.viewInverseBase, 4, false, true,
-                                "DevilMayCry4 profile view (c4-c7)");
+    void TraceDraw(TraceDrawKind kind, D3DPRIMITIVETYPE primitiveType, UINT primitiveCount) {
+        TraceDrawPayload payload = {};
+        payload.kind = kind;
+        payload.primitiveType = static_cast<uint32_t>(primitiveType);
+        payload.primitiveCount = primitiveCount;
+        g_traceWriter.Write(TraceRecord_Draw, &payload, sizeof(payload));
+    }
+
+    // Seeds a new trace with the state replay cannot infer: the current viewport,
+    // render target 0, depth-stencil surface, vertex input and vertex shader.
+    void UpdateTraceCapture() {
+        if (g_traceStopRequested || (g_traceCaptureRequested && g_traceWriter.IsOpen())) {
+            g_traceStopRequested = false;
+            if (g_traceWriter.IsOpen()) {
+                snprintf(g_traceStatus, sizeof(g_traceStatus), "Wrote %llu records (%.1f MB) to %s.",
+                         g_traceWriter.RecordCount(),
+                         static_cast<double>(g_traceWriter.ByteCount()) / (1024.0 * 1024.0),
+                         g_config.traceCapturePath);
+                LogMsg("Trace capture stopped: %s", g_traceStatus);
+                g_traceWriter.Close();
             }
-
-            if (tryExtractProfileMatrix(g_profileLayout.projectionBase, &mat)) {
-                anyCaptured = true;
-                m_currentProj = mat;
-                m_hasProj = true;
-                slotResolvedByOverride[MatrixSlot_Projection] = true;
-                g_projectionDetectedByNumericStructure = false;
-                g_projectionDetectedRegister = g_profileLayout.projectionBase;
-                g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                g_projectionDetectedFovRadians = ExtractFOV(mat);
-                g_profileCoreRegistersSeen[2] = true;
-                StoreProjectionMatrix(m_currentProj, shaderKey, g_profileLayout.projectionBase, 4, false, true,
-                                      "DevilMayCry4 profile projection (c8-c11)");
+        }
+        if (!g_traceCaptureRequested) {
+            return;
+        }
+        g_traceCaptureRequested = false;
+        if (!g_traceWriter.Open(g_config.traceCapturePath)) {
+            snprintf(g_traceStatus, sizeof(g_traceStatus), "Failed to open %s for writing.", g_config.traceCapturePath);
+            LogMsg("Trace capture: %s", g_traceStatus);
+            return;
+        }
+        D3DVIEWPORT9 viewport = {};
+        if (SUCCEEDED(m_real->GetViewport(&viewport))) {
+            g_traceWriter.Write(TraceRecord_SetViewport, &viewport, sizeof(viewport));
+        }
+        IDirect3DSurface9* surface = nullptr;
+        if (SUCCEEDED(m_real->GetRenderTarget(0, &surface))) {
+            TraceSurfaceBinding(TraceRecord_SetRenderTarget, surface);
+            if (surface) {
+                surface->Release();
             }
-
-            if (anyCaptured) {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "DMC4 profile active: strict mapping MVP/World=c0-c3 View=c4-c7 Projection=c8-c11.");
-            } else {
-                snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                         "DMC4 profile active but upload did not hit c0-c11 transform registers.");
+        }
+        surface = nullptr;
+        // Fails with D3DERR_NOTFOUND when no depth-stencil surface is bound.
+        if (FAILED(m_real->GetDepthStencilSurface(&surface))) {
+            surface = nullptr;
+        }
+        TraceSurfaceBinding(TraceRecord_SetDepthStencilSurface, surface);
+        if (surface) {
+            surface->Release();
+        }
+        TraceVertexInput();
+        TraceShaderBinding(m_currentVertexShader);
+        snprintf(g_traceStatus, sizeof(g_traceStatus), "Capturing to %s.", g_config.traceCapturePath);
+        LogMsg("Trace capture started: %s", g_config.traceCapturePath);
+    }
+
+    // Viewport may have changed behind our back (Reset, render target switch,
+    // state-block Apply); rebuild the custom projection on its next use.
+    void InvalidateViewportDependentState() {
+        m_customProjectionGeneration = 0;
+        m_viewportWidth = 0;
+        m_viewportHeight = 0;
+    }
+
+    // Counts an upload or draw against the current render pass and returns the
+    // policy it follows (always Classify with PassFiltering=0).
+    PassPolicy NoteUploadPass() {
+        RenderPassInfo& pass = g_renderPasses.Current();
+        pass.uploadsThisFrame++;
+        return g_config.passFiltering ? pass.policy : PassPolicy_Classify;
+    }
+
+    PassPolicy NoteDrawPass() {
+        RenderPassInfo& pass = g_renderPasses.Current();
+        pass.drawsThisFrame++;
+        return g_config.passFiltering ? pass.policy : PassPolicy_Classify;
+    }
+
+    // Device created or Reset: every surface the tracker knew is gone, so re-read
+    // the back buffer size and the bound render target, depth-stencil and viewport.
+    void ResetRenderPasses() {
+        uint32_t backBufferWidth = 0;
+        uint32_t backBufferHeight = 0;
+        IDirect3DSurface9* surface = nullptr;
+        if (SUCCEEDED(m_real->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &surface)) && surface) {
+            D3DSURFACE_DESC desc = {};
+            if (SUCCEEDED(surface->GetDesc(&desc))) {
+                backBufferWidth = desc.Width;
+                backBufferHeight = desc.Height;
             }
-
-            g_profileDisableStructuralDetection = true;
-            return m_real->SetVertexShaderConstantF(StartRegister, effectiveConstantData, Vector4fCount);
+            surface->Release();
+        }
+        g_renderPasses.Reset(backBufferWidth, backBufferHeight);
+        // Only the pointers are kept, as pass identity; the tracker holds no references.
+        surface = nullptr;
+        if (SUCCEEDED(m_real->GetRenderTarget(0, &surface)) && surface) {
+            g_renderPasses.SetRenderTarget(surface);
+            surface->Release();
+        }
+        surface = nullptr;
+        if (SUCCEEDED(m_real->GetDepthStencilSurface(&surface)) && surface) {
+            g_renderPasses.SetDepthStencil(surface);
+            surface->Release();
         }
+        SyncRenderPassViewport();
+    }
 
-        auto tryExplicitRegisterOverride = [&](MatrixSlot slot, int configuredRegister) {
-            if (profileActive) {
-                return;
-            }
-            if (configuredRegister < 0 || !effectiveConstantData) {
-                return;
-            }
-            if (slotResolvedByOverride[slot]) {
-                return;
-            }
-            for (UINT rows : {4u, 3u}) {
-                D3DMATRIX mat = {};
-                if (!TryBuildMatrixFromConstantUpdate(effectiveConstantData, StartRegister, Vector4fCount,
-                                                      configuredRegister, static_cast<int>(rows), false, &mat)) {
-                    continue;
-                }
-                slotResolvedByOverride[slot] = true;
-                if (slot == MatrixSlot_World) {
-                    m_currentWorld = mat;
-                    m_hasWorld = true;
-                    StoreWorldMatrix(m_currentWorld, shaderKey, configuredRegister, static_cast<int>(rows), false, true,
-                                     "explicit register override");
-                } else if (slot == MatrixSlot_View) {
-                    m_currentView = mat;
-                    m_hasView = true;
-                    StoreViewMatrix(m_currentView, shaderKey, configuredRegister, static_cast<int>(rows), false, true,
-                                    "explicit register override");
-                } else if (slot == MatrixSlot_Projection) {
-                    m_currentProj = mat;
-                    m_hasProj = true;
-                    g_projectionDetectedByNumericStructure = false;
-                    g_projectionDetectedRegister = configuredRegister;
-                    g_projectionDetectedHandedness = ProjectionHandedness_Unknown;
-                    g_projectionDetectedFovRadians = 0.0f;
-                    StoreProjectionMatrix(m_currentProj, shaderKey, configuredRegister, static_cast<int>(rows), false, true,
-                                          "explicit register override");
-                }
-                return;
-            }
-        };
+    void SyncRenderPassViewport() {
+        D3DVIEWPORT9 viewport = {};
+        if (SUCCEEDED(m_real->GetViewport(&viewport))) {
+            g_renderPasses.SetViewport(viewport.Width, viewport.Height);
+        }
+    }
 
-        tryExplicitRegisterOverride(MatrixSlot_World, g_config.worldMatrixRegister);
-        tryExplicitRegisterOverride(MatrixSlot_View, g_config.viewMatrixRegister);
-        tryExplicitRegisterOverride(MatrixSlot_Projection, g_config.projMatrixRegister);
 
-        auto tryHandleCombinedMVP = [&](const D3DMATRIX& combinedMvp, UINT baseReg, int rows, bool transposed) {
-            StoreMVPMatrix(combinedMvp, shaderKey, static_cast<int>(baseReg), rows, transposed, false,
-                           "deterministic structural combined MVP", static_cast<int>(baseReg));
-            g_combinedMvpDebug.registerBase = static_cast<int>(baseReg);
-            g_combinedMvpDebug.succeeded = false;
-            g_combinedMvpDebug.fovRadians = 0.0f;
-            g_combinedMvpDebug.handedness = ProjectionHandedness_Unknown;
+    // IUnknown. The device interfaces resolve to the wrapper so the game never
+    // reaches the real device; IDirect3DDevice9Ex is only exposed by
+    // WrappedD3D9DeviceEx, whose hooks cover the Ex methods.
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObj) override {
+        if (!ppvObj) {
+            return E_POINTER;
+        }
+        if (riid == IID_IUnknown || riid == IID_IDirect3DDevice9) {
+            *ppvObj = static_cast<IDirect3DDevice9*>(this);
+            AddRef();
+            return S_OK;
+        }
+        if (riid == IID_IDirect3DDevice9Ex) {
+            *ppvObj = nullptr;
+            return E_NOINTERFACE;
+        }
+        // Don't wrap other QueryInterface results - could cause issues
+        return m_real->QueryInterface(riid, ppvObj);
+    }
 
-            if (!g_config.enableCombinedMVP) {
-                g_combinedMvpDebug.strategy = CombinedMVPStrategy_Disabled;
-                return;
-            }
-            if (m_hasWorld && m_hasView && m_hasProj) {
-                g_combinedMvpDebug.strategy = CombinedMVPStrategy_SkippedFullWVP;
-                return;
-            }
+    ULONG STDMETHODCALLTYPE AddRef() override {
+        return m_real->AddRef();
+    }
 
-            const bool worldAvailable = m_hasWorld;
-            CombinedMVPStrategy strategy = CombinedMVPStrategy_None;
-            if (worldAvailable) {
-                strategy = CombinedMVPStrategy_WorldAndMVP;
-            } else if (g_config.combinedMVPRequireWorld) {
-                strategy = CombinedMVPStrategy_WorldRequiredNoWorld;
-            } else if (g_config.combinedMVPAssumeIdentityWorld) {
-                strategy = CombinedMVPStrategy_MVPOnly;
-            } else {
-                strategy = CombinedMVPStrategy_Failed;
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = m_real->Release();
+        if (count == 0) {
+            ShutdownImGui();
+            if (m_boundWrappedShader) {
+                m_boundWrappedShader->Release();
+                m_boundWrappedShader = nullptr;
             }
-            g_combinedMvpDebug.strategy = strategy;
-
-            if (strategy == CombinedMVPStrategy_WorldRequiredNoWorld) {
-                if (g_config.combinedMVPLogDecomposition) {
-                    LogMsg("Combined MVP ignored at c%d-c%d: world required but missing.",
-                           static_cast<int>(baseReg), static_cast<int>(baseReg) + rows - 1);
-                }
-                return;
+            BindVertexDeclaration(nullptr);
+            // The last save point outside the loader lock; DllMain never writes the cache.
+            if (g_layoutCacheDirty && RenderThreadOwnsClassifierState()) {
+                SaveLayoutCache(false);
             }
+            delete this;
+        }
+        return count;
+    }
 
-            D3DMATRIX decompWorld = {};
-            D3DMATRIX decompView = {};
-            D3DMATRIX decompProj = {};
-            ProjectionAnalysis projectionInfo = {};
-            if (!TryDecomposeCombinedMVP(combinedMvp,
-                                         worldAvailable ? &m_currentWorld : nullptr,
-                                         worldAvailable,
-                                         &decompWorld,
-                                         &decompView,
-                                         &decompProj,
-                                         &projectionInfo)) {
-                g_combinedMvpDebug.strategy = CombinedMVPStrategy_Failed;
-                if (g_config.combinedMVPLogDecomposition) {
-                    LogMsg("Combined MVP decomposition failed at c%d-c%d.",
-                           static_cast<int>(baseReg), static_cast<int>(baseReg) + rows - 1);
-                }
-                return;
-            }
+    // The key interception point
+    HRESULT STDMETHODCALLTYPE SetVertexShaderConstantF(
+        UINT StartRegister,
+        const float* pConstantData,
+        UINT Vector4fCount) override
+    {
+        PROXY_PROFILE_SCOPE(ProfilerZone_SetVertexShaderConstantF);
+        // The runtime rejects larger uploads; the trace reader would too.
+        if (g_traceWriter.IsOpen() && pConstantData && Vector4fCount <= kTraceMaxConstantRegisters) {
+            const uint32_t range[2] = { StartRegister, Vector4fCount };
+            g_traceWriter.Write(TraceRecord_SetVertexShaderConstantF, range, sizeof(range),
+                                pConstantData, static_cast<size_t>(Vector4fCount) * 4 * sizeof(float));
+        }
+        ShaderSlot* shaderSlot = m_currentShaderSlot;
+        const uintptr_t shaderKey = shaderSlot->key;
+        ShaderConstantState* state = &shaderSlot->state;
+        const ProfilePipeline& profile = *g_profilePipeline;
 
-            m_currentWorld = decompWorld;
-            m_currentView = decompView;
-            m_currentProj = decompProj;
-            m_hasWorld = true;
-            m_hasView = true;
-            m_hasProj = true;
-            slotResolvedStructurally[MatrixSlot_World] = true;
-            slotResolvedStructurally[MatrixSlot_View] = true;
-            slotResolvedStructurally[MatrixSlot_Projection] = true;
-            g_projectionDetectedByNumericStructure = true;
-            g_projectionDetectedFovRadians = projectionInfo.fovRadians;
-            g_projectionDetectedRegister = static_cast<int>(baseReg);
-            g_projectionDetectedHandedness = projectionInfo.handedness;
+        g_constantUploadCount++;
+        const PassPolicy passPolicy = NoteUploadPass();
+        const float* effectiveConstantData = pConstantData;
+        if (profile.usesOverlayInputs && BuildOverriddenConstants(*state, StartRegister, Vector4fCount, pConstantData,
+                                                                  m_constantScratch, IM_ARRAYSIZE(m_constantScratch))) {
+            effectiveConstantData = m_constantScratch;
+        }
 
-            StoreWorldMatrix(m_currentWorld, shaderKey, static_cast<int>(baseReg), rows, transposed, false,
-                             "combined MVP decomposition world", static_cast<int>(baseReg));
-            StoreViewMatrix(m_currentView, shaderKey, static_cast<int>(baseReg), rows, transposed, false,
-                            "combined MVP decomposition view", static_cast<int>(baseReg));
-            StoreProjectionMatrix(m_currentProj, shaderKey, static_cast<int>(baseReg), rows, transposed, false,
-                                  "combined MVP decomposition projection", static_cast<int>(baseReg));
+        // Fast path: nothing overridden, nothing new, and no register that has ever carried
+        // a transform. Re-running detection on identical data cannot produce a new result.
+        if (effectiveConstantData == pConstantData &&
+            !(g_config.logAllConstants && m_constantLogThrottle == 0) &&
+            !RangeTouchesKnownTransform(StartRegister, Vector4fCount) &&
+            ConstantRangeMatchesCache(*state, StartRegister, Vector4fCount, pConstantData)) {
+            g_constantFastPathCount++;
+            return m_real->SetVertexShaderConstantF(StartRegister, pConstantData, Vector4fCount);
+        }
 
-            g_combinedMvpDebug.succeeded = true;
-            g_combinedMvpDebug.fovRadians = projectionInfo.fovRadians;
-            g_combinedMvpDebug.handedness = projectionInfo.handedness;
-            if (g_config.combinedMVPLogDecomposition) {
-                LogMsg("Combined MVP decomposition success at c%d-c%d using %s, FOV=%.2f deg, handedness=%s.",
-                       static_cast<int>(baseReg), static_cast<int>(baseReg) + rows - 1,
-                       CombinedMVPStrategyLabel(strategy),
-                       projectionInfo.fovRadians * 180.0f / 3.14159265f,
-                       ProjectionHandednessLabel(projectionInfo.handedness));
+        // Ended before the upload is forwarded, so the region covers only proxy work.
+        ScopedProxyMarker constantsMarker(ProxyMarker_ConstantProcessing);
+
+        // Per-register change serials let large uploads that rewrite a few matrices
+        // re-classify only those windows. Clipped uploads are always scanned in full.
+        bool changeSerialsValid = false;
+        if (StartRegister < static_cast<UINT>(kMaxConstantRegisters) && effectiveConstantData) {
+            const UINT uploadEnd = (std::min)(StartRegister + Vector4fCount, static_cast<UINT>(kMaxConstantRegisters));
+            EnsureConstantCapacity(*state, static_cast<int>(uploadEnd));
+            const unsigned long long serial = g_constantChangeSerial + 1;
+            if (MergeConstantRegisters(*state, StartRegister, uploadEnd, effectiveConstantData, serial)) {
+                g_constantChangeSerial = serial;
+                state->lastChangeSerial = serial;
             }
-        };
-
-        auto updateFromClassification = [&](D3DMATRIX mat, UINT baseReg, int rows, bool transposed) {
-            MatrixClassification cls = ClassifyMatrixDeterministic(mat, rows, Vector4fCount, StartRegister, baseReg);
-
-            if (cls == MatrixClass_Projection && g_config.projMatrixRegister < 0 && !slotResolvedByOverride[MatrixSlot_Projection]) {
-                ProjectionAnalysis projectionInfo = {};
-                if (!AnalyzeProjectionMatrixNumeric(mat, &projectionInfo)) {
-                    return;
+            if (state->variance) {
+                for (UINT reg = StartRegister; reg < uploadEnd; reg++) {
+                    UpdateVariance(*state->variance, static_cast<int>(reg), effectiveConstantData + (reg - StartRegister) * 4);
                 }
-                m_currentProj = mat;
-                m_hasProj = true;
-                slotResolvedStructurally[MatrixSlot_Projection] = true;
-                g_projectionDetectedByNumericStructure = true;
-                g_projectionDetectedFovRadians = projectionInfo.fovRadians;
-                g_projectionDetectedRegister = static_cast<int>(baseReg);
-                g_projectionDetectedHandedness = projectionInfo.handedness;
-                StoreProjectionMatrix(m_currentProj, shaderKey, static_cast<int>(baseReg), rows, transposed, false, "deterministic structural projection");
-                LogMsg("Projection accepted via numeric structure: c%d-c%d rows=%d transpose=%d fov=%.2f deg (%s)",
-                       static_cast<int>(baseReg), static_cast<int>(baseReg) + rows - 1,
-                       rows, transposed ? 1 : 0,
-                       projectionInfo.fovRadians * 180.0f / 3.14159265f,
-                       ProjectionHandednessLabel(projectionInfo.handedness));
-            } else if (cls == MatrixClass_View && g_config.viewMatrixRegister < 0 && !slotResolvedByOverride[MatrixSlot_View]) {
-                m_currentView = mat;
-                m_hasView = true;
-                slotResolvedStructurally[MatrixSlot_View] = true;
-                StoreViewMatrix(m_currentView, shaderKey, static_cast<int>(baseReg), rows, transposed, false, "deterministic structural view");
-            } else if (cls == MatrixClass_World && g_config.worldMatrixRegister < 0 && !slotResolvedByOverride[MatrixSlot_World]) {
-                m_currentWorld = mat;
-                m_hasWorld = true;
-                slotResolvedStructurally[MatrixSlot_World] = true;
-                StoreWorldMatrix(m_currentWorld, shaderKey, static_cast<int>(baseReg), rows, transposed, false, "deterministic structural world");
-            } else if (cls == MatrixClass_CombinedPerspective &&
-                       g_config.worldMatrixRegister < 0 && g_config.viewMatrixRegister < 0 && g_config.projMatrixRegister < 0 &&
-                       !slotResolvedByOverride[MatrixSlot_World] && !slotResolvedByOverride[MatrixSlot_View] && !slotResolvedByOverride[MatrixSlot_Projection] &&
-                       rows == 4) {
-                tryHandleCombinedMVP(mat, baseReg, rows, transposed);
             }
-        };
-
-        g_profileDisableStructuralDetection = false;
-        const bool allowStructuralDetection = !profileActive;
-
-        bool anyStructuralMatch = false;
-        if (allowStructuralDetection && effectiveConstantData && Vector4fCount >= 3) {
-            for (UINT rows : {4u, 3u}) {
-                if (Vector4fCount < rows) {
-                    continue;
-                }
-                for (UINT offset = 0; offset + rows <= Vector4fCount; ++offset) {
-                    UINT baseReg = StartRegister + offset;
-                    D3DMATRIX mat = {};
-                    if (!TryBuildMatrixFromConstantUpdate(effectiveConstantData + offset * 4, baseReg, rows,
-                                                          static_cast<int>(baseReg), static_cast<int>(rows),
-                                                          false, &mat)) {
-                        continue;
-                    }
-
-                    MatrixClassification directClass = ClassifyMatrixDeterministic(mat, static_cast<int>(rows), Vector4fCount, StartRegister, baseReg);
-                    bool transposed = false;
-                    if (directClass == MatrixClass_None && g_probeTransposedLayouts) {
-                        D3DMATRIX t = TransposeMatrix(mat);
-                        MatrixClassification transposedClass = ClassifyMatrixDeterministic(t, static_cast<int>(rows), Vector4fCount, StartRegister, baseReg);
-                        if (transposedClass != MatrixClass_None) {
-                            mat = t;
-                            transposed = true;
-                        }
-                    }
+            changeSerialsValid = uploadEnd == StartRegister + Vector4fCount;
+        }
+        state->hasUploaded = true;
+        if (shaderSlot->orthoProbeUploads > 0 && shaderKey != 0 && g_config.skipScreenSpaceDraws) {
+            ProbeScreenSpaceOrtho(shaderSlot, StartRegister, Vector4fCount, effectiveConstantData);
+        }
 
-                    MatrixClassification finalClass = ClassifyMatrixDeterministic(mat, static_cast<int>(rows), Vector4fCount, StartRegister, baseReg);
-                    if (finalClass == MatrixClass_None && g_probeInverseView && rows == 4u) {
-                        D3DMATRIX inverseView = InvertSimpleRigidView(mat);
-                        MatrixClassification inverseClass = ClassifyMatrixDeterministic(inverseView, static_cast<int>(rows), Vector4fCount, StartRegister, baseReg);
-                        if (inverseClass == MatrixClass_View) {
-                            mat = inverseView;
-                            finalClass = inverseClass;
-                        }
-                    }
-                    if (finalClass != MatrixClass_None) {
-                        anyStructuralMatch = true;
-                        updateFromClassification(mat, baseReg, static_cast<int>(rows), transposed);
-                    }
-                }
+        if (passPolicy != PassPolicy_Classify) {
+            // Shadow, reflection and post-process passes keep the constant cache
+            // current for the overlay but never feed the camera.
+            g_passUploadsSkipped++;
+        } else {
+            CapturedManualMatrix manualCaptures[MatrixSlot_Count];
+            int manualCount = 0;
+            ConstantUpload upload;
+            upload.shaderKey = shaderKey;
+            upload.startRegister = StartRegister;
+            upload.vector4fCount = Vector4fCount;
+            upload.constantData = effectiveConstantData;
+            upload.manualMask = profile.usesOverlayInputs ? CaptureManualBindings(shaderSlot, manualCaptures, &manualCount) : 0;
+            upload.manual = manualCaptures;
+            uint32_t bytecodeHash = 0;
+            upload.stableKey = shaderKey != 0 && TryGetShaderSlotBytecodeHash(shaderSlot, &bytecodeHash);
+            upload.shaderHash = upload.stableKey ? bytecodeHash : GetShaderSlotHash(shaderSlot);
+            upload.changeSerials = changeSerialsValid ? state->changeSerials.data() : nullptr;
+            upload.changeSerial = g_constantChangeSerial;
+            if (g_asyncClassifier.Running()) {
+                g_asyncClassifier.RecordUpload(upload.shaderKey, upload.shaderHash, upload.stableKey, StartRegister,
+                                               Vector4fCount, effectiveConstantData, upload.manualMask,
+                                               manualCaptures, manualCount);
+            } else {
+                ClassifyConstantUpload(m_resolved, upload, m_mgrrUseAutoProjection, m_structuralMatches);
             }
         }
 
@@ -3421,51 +6123,88 @@ public:
             }
         }
 
+        constantsMarker.End();
         return m_real->SetVertexShaderConstantF(StartRegister, effectiveConstantData, Vector4fCount);
     }
 
     // Present - good place to do per-frame logging throttle
     HRESULT STDMETHODCALLTYPE Present(const RECT* pSourceRect, const RECT* pDestRect,
                                        HWND hDestWindowOverride, const RGNDATA* pDirtyRegion) override {
+        BeginPresent();
+        return m_real->Present(pSourceRect, pDestRect, hDestWindowOverride, pDirtyRegion);
+    }
+
+    // Per-frame work shared by Present and PresentEx, run before the frame is handed on.
+    void BeginPresent() {
+        if (g_traceWriter.IsOpen()) {
+            g_traceWriter.Write(TraceRecord_Present, nullptr, 0);
+        }
+        UpdateTraceCapture();
         g_frameCount++;
+        g_renderPasses.EndFrame(static_cast<uint64_t>(g_frameCount));
         UpdateFrameTimeStats();
+        PROXY_PROFILE_END_FRAME();
         // Throttle constant logging to every 60 frames
         if (g_config.logAllConstants) {
             m_constantLogThrottle = (m_constantLogThrottle + 1) % 60;
         }
-        UpdateConstantSnapshot();
-        if (g_config.enableMemoryScanner && g_config.memoryScannerIntervalSec > 0) {
-            DWORD nowTick = GetTickCount();
-            if (g_memoryScannerLastTick == 0 ||
-                nowTick - g_memoryScannerLastTick >= static_cast<DWORD>(g_config.memoryScannerIntervalSec) * 1000u) {
-                StartMemoryScanner();
-                g_memoryScannerLastTick = nowTick;
-            }
-        }
-
-        // Log periodic status
-        if (g_frameCount % 300 == 0) {
-            LogMsg("Frame %d - hasView: %d, hasProj: %d", g_frameCount, m_hasView, m_hasProj);
+        if (g_config.asyncClassification && !g_traceReplayActive && !g_asyncClassifier.Running()) {
+            StartAsyncClassifier();
         }
-
-        if (!g_imguiInitialized) {
-            InitializeImGui(m_real, m_hwnd);
+        TakePublishedMemoryScan();
+
+        // Everything below that reads or writes classifier state runs only while the
+        // async worker is idle. When it is still inside the previous frame (that
+        // frame is then dropped), the work waits for the next Present and the
+        // overlay shows its last built frame, so Present never waits on the worker.
+        const bool ownsClassifierState = RenderThreadOwnsClassifierState();
+        if (ownsClassifierState) {
+            if (!g_traceReplayActive) {
+                if (ProxyConfig* reloaded = g_reloadedConfig.exchange(nullptr, std::memory_order_acq_rel)) {
+                    ApplyReloadedConfig(*reloaded);
+                    delete reloaded;
+                    m_mgrrUseAutoProjection = g_config.mgrrUseAutoProjectionWhenC4Invalid;
+                }
+            }
+            if (m_customProjectionPublishPending) {
+                PublishCustomProjection();
+            }
+            g_presentScheduler.RunFrame(static_cast<uint64_t>(g_frameCount), this);
+            PublishSharedCamera();
+            if (!g_traceReplayActive) {
+                UpdateHotkeys();
+                // The ImGui context, backends and WndProc hook are only created once the
+                // menu is first opened; until then the overlay costs one branch per frame.
+                if (!g_imguiInitialized && g_showImGui) {
+                    InitializeImGui(m_real, m_hwnd);
+                }
+            }
         }
-        UpdateHotkeys();
         if (g_imguiInitialized) {
             ImGui::GetIO().MouseDrawCursor = g_showImGui;
         }
         g_imguiMgrrUseAutoProjection = m_mgrrUseAutoProjection;
-        RenderImGuiOverlay();
+        {
+            PROXY_PROFILE_SCOPE(ProfilerZone_ImGuiOverlay);
+            PROXY_MARKER_SCOPE(ProxyMarker_Overlay);
+            RenderImGuiOverlay(ownsClassifierState);
+        }
         m_mgrrUseAutoProjection = g_imguiMgrrUseAutoProjection;
-        if (g_requestManualEmit) {
+        if (ownsClassifierState && g_requestManualEmit) {
+            InvalidateTransformShadow();
             EmitFixedFunctionTransforms();
             g_requestManualEmit = false;
             snprintf(g_manualEmitStatus, sizeof(g_manualEmitStatus),
                      "Sent cached World/View/Projection matrices to RTX Remix via SetTransform().");
         }
-
-        return m_real->Present(pSourceRect, pDestRect, hDestWindowOverride, pDirtyRegion);
+        // Last, so the worker only gets the state back once this Present is done with it.
+        if (g_asyncClassifier.Running()) {
+            if (ownsClassifierState) {
+                m_cameraHasMVP = g_cameraMatrices.hasMVP;
+            }
+            g_asyncClassifier.EndFrame(static_cast<uint64_t>(g_frameCount), m_mgrrUseAutoProjection);
+            m_asyncDrawIndex = 0;
+        }
     }
 
     // All other methods pass through
@@ -3483,14 +6222,34 @@ public:
     HRESULT STDMETHODCALLTYPE GetSwapChain(UINT iSwapChain, IDirect3DSwapChain9** pSwapChain) override { return m_real->GetSwapChain(iSwapChain, pSwapChain); }
     UINT STDMETHODCALLTYPE GetNumberOfSwapChains() override { return m_real->GetNumberOfSwapChains(); }
     HRESULT STDMETHODCALLTYPE Reset(D3DPRESENT_PARAMETERS* pPresentationParameters) override {
+        BeginReset();
+        HRESULT hr = m_real->Reset(pPresentationParameters);
+        EndReset(hr);
+        return hr;
+    }
+
+    // Shared by Reset and ResetEx.
+    void BeginReset() {
         if (g_imguiInitialized) {
             ImGui_ImplDX9_InvalidateDeviceObjects();
         }
-        HRESULT hr = m_real->Reset(pPresentationParameters);
+    }
+
+    void EndReset(HRESULT hr) {
+        // Reset returns device transforms to defaults; resend everything on the next draw.
+        InvalidateTransformShadow();
+        m_recordingStateBlock = false;
+        if (SUCCEEDED(hr)) {
+            // Reset returns the device to default state, which has no vertex shader bound.
+            BindVertexShaderSlot(nullptr, nullptr);
+            BindVertexDeclaration(nullptr);
+            m_pretransformedInput = false;
+        }
+        InvalidateViewportDependentState();
+        ResetRenderPasses();
         if (SUCCEEDED(hr) && g_imguiInitialized) {
             ImGui_ImplDX9_CreateDeviceObjects();
         }
-        return hr;
     }
     HRESULT STDMETHODCALLTYPE GetBackBuffer(UINT iSwapChain, UINT iBackBuffer, D3DBACKBUFFER_TYPE Type, IDirect3DSurface9** ppBackBuffer) override { return m_real->GetBackBuffer(iSwapChain, iBackBuffer, Type, ppBackBuffer); }
     HRESULT STDMETHODCALLTYPE GetRasterStatus(UINT iSwapChain, D3DRASTER_STATUS* pRasterStatus) override { return m_real->GetRasterStatus(iSwapChain, pRasterStatus); }
@@ -3511,30 +6270,92 @@ public:
     HRESULT STDMETHODCALLTYPE StretchRect(IDirect3DSurface9* pSourceSurface, const RECT* pSourceRect, IDirect3DSurface9* pDestSurface, const RECT* pDestRect, D3DTEXTUREFILTERTYPE Filter) override { return m_real->StretchRect(pSourceSurface, pSourceRect, pDestSurface, pDestRect, Filter); }
     HRESULT STDMETHODCALLTYPE ColorFill(IDirect3DSurface9* pSurface, const RECT* pRect, D3DCOLOR color) override { return m_real->ColorFill(pSurface, pRect, color); }
     HRESULT STDMETHODCALLTYPE CreateOffscreenPlainSurface(UINT Width, UINT Height, D3DFORMAT Format, D3DPOOL Pool, IDirect3DSurface9** ppSurface, HANDLE* pSharedHandle) override { return m_real->CreateOffscreenPlainSurface(Width, Height, Format, Pool, ppSurface, pSharedHandle); }
-    HRESULT STDMETHODCALLTYPE SetRenderTarget(DWORD RenderTargetIndex, IDirect3DSurface9* pRenderTarget) override { return m_real->SetRenderTarget(RenderTargetIndex, pRenderTarget); }
+    HRESULT STDMETHODCALLTYPE SetRenderTarget(DWORD RenderTargetIndex, IDirect3DSurface9* pRenderTarget) override {
+        HRESULT hr = m_real->SetRenderTarget(RenderTargetIndex, pRenderTarget);
+        // Setting render target 0 resets the viewport to the surface size.
+        if (SUCCEEDED(hr) && RenderTargetIndex == 0) {
+            InvalidateViewportDependentState();
+            g_renderPasses.SetRenderTarget(pRenderTarget);
+            if (g_traceWriter.IsOpen()) {
+                TraceSurfaceBinding(TraceRecord_SetRenderTarget, pRenderTarget);
+            }
+        }
+        return hr;
+    }
     HRESULT STDMETHODCALLTYPE GetRenderTarget(DWORD RenderTargetIndex, IDirect3DSurface9** ppRenderTarget) override { return m_real->GetRenderTarget(RenderTargetIndex, ppRenderTarget); }
-    HRESULT STDMETHODCALLTYPE SetDepthStencilSurface(IDirect3DSurface9* pNewZStencil) override { return m_real->SetDepthStencilSurface(pNewZStencil); }
+    HRESULT STDMETHODCALLTYPE SetDepthStencilSurface(IDirect3DSurface9* pNewZStencil) override {
+        HRESULT hr = m_real->SetDepthStencilSurface(pNewZStencil);
+        if (SUCCEEDED(hr)) {
+            g_renderPasses.SetDepthStencil(pNewZStencil);
+            if (g_traceWriter.IsOpen()) {
+                TraceSurfaceBinding(TraceRecord_SetDepthStencilSurface, pNewZStencil);
+            }
+        }
+        return hr;
+    }
     HRESULT STDMETHODCALLTYPE GetDepthStencilSurface(IDirect3DSurface9** ppZStencilSurface) override { return m_real->GetDepthStencilSurface(ppZStencilSurface); }
     HRESULT STDMETHODCALLTYPE BeginScene() override {
-        g_combinedMvpDebug = {};
-        if (g_activeGameProfile == GameProfile_MetalGearRising) {
-            // MGR frame lifecycle: keep projection/view persistent across draws and frames,
-            // but require a fresh world upload for each frame.
-            CreateIdentityMatrix(&m_currentWorld);
-            m_hasWorld = false;
-            g_mgrWorldCapturedForDraw = false;
-            g_mgrProjCapturedThisFrame = false;
-            g_mgrViewCapturedThisFrame = false;
-            g_mgrProjectionRegisterValid = false;
+        if (g_traceWriter.IsOpen()) {
+            g_traceWriter.Write(TraceRecord_BeginScene, nullptr, 0);
+        }
+        if (g_asyncClassifier.Running()) {
+            g_asyncClassifier.RecordEvent(AsyncRecord_BeginScene);
+        } else {
+            ResetResolvedTransformsForScene(m_resolved);
         }
         return m_real->BeginScene();
     }
     HRESULT STDMETHODCALLTYPE EndScene() override { return m_real->EndScene(); }
     HRESULT STDMETHODCALLTYPE Clear(DWORD Count, const D3DRECT* pRects, DWORD Flags, D3DCOLOR Color, float Z, DWORD Stencil) override { return m_real->Clear(Count, pRects, Flags, Color, Z, Stencil); }
-    HRESULT STDMETHODCALLTYPE SetTransform(D3DTRANSFORMSTATETYPE State, const D3DMATRIX* pMatrix) override { return m_real->SetTransform(State, pMatrix); }
-    HRESULT STDMETHODCALLTYPE GetTransform(D3DTRANSFORMSTATETYPE State, D3DMATRIX* pMatrix) override { return m_real->GetTransform(State, pMatrix); }
-    HRESULT STDMETHODCALLTYPE MultiplyTransform(D3DTRANSFORMSTATETYPE State, const D3DMATRIX* pMatrix) override { return m_real->MultiplyTransform(State, pMatrix); }
-    HRESULT STDMETHODCALLTYPE SetViewport(const D3DVIEWPORT9* pViewport) override { return m_real->SetViewport(pViewport); }
+    HRESULT STDMETHODCALLTYPE SetTransform(D3DTRANSFORMSTATETYPE State, const D3DMATRIX* pMatrix) override {
+        const int index = ShadowTransformIndex(State);
+        if (pMatrix && ShadowMatches(index, *pMatrix)) {
+            g_transformGameSetsSuppressed++;
+            return D3D_OK;
+        }
+        HRESULT hr = m_real->SetTransform(State, pMatrix);
+        NoteTransformSet(index, SUCCEEDED(hr) ? pMatrix : nullptr);
+        return hr;
+    }
+    HRESULT STDMETHODCALLTYPE GetTransform(D3DTRANSFORMSTATETYPE State, D3DMATRIX* pMatrix) override {
+        const int index = ShadowTransformIndex(State);
+        if (index >= 0 && pMatrix && m_transformShadow.valid[index]) {
+            *pMatrix = m_transformShadow.matrix[index];
+            g_transformGetsAnsweredLocally++;
+            return D3D_OK;
+        }
+        HRESULT hr = m_real->GetTransform(State, pMatrix);
+        if (SUCCEEDED(hr) && index >= 0 && pMatrix) {
+            m_transformShadow.matrix[index] = *pMatrix;
+            m_transformShadow.valid[index] = true;
+        }
+        return hr;
+    }
+    HRESULT STDMETHODCALLTYPE MultiplyTransform(D3DTRANSFORMSTATETYPE State, const D3DMATRIX* pMatrix) override {
+        // The runtime's product may round differently from ours, so the result is
+        // re-read on the next GetTransform rather than computed here.
+        HRESULT hr = m_real->MultiplyTransform(State, pMatrix);
+        NoteTransformSet(ShadowTransformIndex(State), nullptr);
+        return hr;
+    }
+    HRESULT STDMETHODCALLTYPE SetViewport(const D3DVIEWPORT9* pViewport) override {
+        if (g_traceWriter.IsOpen() && pViewport) {
+            g_traceWriter.Write(TraceRecord_SetViewport, pViewport, sizeof(*pViewport));
+        }
+        HRESULT hr = m_real->SetViewport(pViewport);
+        // Only the aspect ratio feeds the custom projection, so depth-range or
+        // offset-only changes keep the cached matrix.
+        if (SUCCEEDED(hr) && pViewport &&
+            (pViewport->Width != m_viewportWidth || pViewport->Height != m_viewportHeight)) {
+            m_customProjectionGeneration = 0;
+            m_viewportWidth = pViewport->Width;
+            m_viewportHeight = pViewport->Height;
+        }
+        if (SUCCEEDED(hr) && pViewport) {
+            g_renderPasses.SetViewport(pViewport->Width, pViewport->Height);
+        }
+        return hr;
+    }
     HRESULT STDMETHODCALLTYPE GetViewport(D3DVIEWPORT9* pViewport) override { return m_real->GetViewport(pViewport); }
     HRESULT STDMETHODCALLTYPE SetMaterial(const D3DMATERIAL9* pMaterial) override { return m_real->SetMaterial(pMaterial); }
     HRESULT STDMETHODCALLTYPE GetMaterial(D3DMATERIAL9* pMaterial) override { return m_real->GetMaterial(pMaterial); }
@@ -3546,9 +6367,34 @@ public:
     HRESULT STDMETHODCALLTYPE GetClipPlane(DWORD Index, float* pPlane) override { return m_real->GetClipPlane(Index, pPlane); }
     HRESULT STDMETHODCALLTYPE SetRenderState(D3DRENDERSTATETYPE State, DWORD Value) override { return m_real->SetRenderState(State, Value); }
     HRESULT STDMETHODCALLTYPE GetRenderState(D3DRENDERSTATETYPE State, DWORD* pValue) override { return m_real->GetRenderState(State, pValue); }
-    HRESULT STDMETHODCALLTYPE CreateStateBlock(D3DSTATEBLOCKTYPE Type, IDirect3DStateBlock9** ppSB) override { return m_real->CreateStateBlock(Type, ppSB); }
-    HRESULT STDMETHODCALLTYPE BeginStateBlock() override { return m_real->BeginStateBlock(); }
-    HRESULT STDMETHODCALLTYPE EndStateBlock(IDirect3DStateBlock9** ppSB) override { return m_real->EndStateBlock(ppSB); }
+    HRESULT STDMETHODCALLTYPE CreateStateBlock(D3DSTATEBLOCKTYPE Type, IDirect3DStateBlock9** ppSB) override {
+        HRESULT hr = m_real->CreateStateBlock(Type, ppSB);
+        if (SUCCEEDED(hr) && ppSB && *ppSB) {
+            // Only D3DSBT_ALL captures transforms; pixel- and vertex-state blocks
+            // leave WORLD/VIEW/PROJECTION alone on Apply. Recorded blocks carry
+            // exactly what was set while recording (see EndStateBlock).
+            const uint8_t mask = (Type == D3DSBT_ALL) ? 0x7 : 0;
+            *ppSB = new WrappedD3D9StateBlock(*ppSB, this, mask, m_transformShadow);
+        }
+        return hr;
+    }
+    HRESULT STDMETHODCALLTYPE BeginStateBlock() override {
+        HRESULT hr = m_real->BeginStateBlock();
+        if (SUCCEEDED(hr)) {
+            m_recordingStateBlock = true;
+            m_recordedTransformMask = 0;
+            m_recordedTransforms = TransformStateShadow{};
+        }
+        return hr;
+    }
+    HRESULT STDMETHODCALLTYPE EndStateBlock(IDirect3DStateBlock9** ppSB) override {
+        HRESULT hr = m_real->EndStateBlock(ppSB);
+        m_recordingStateBlock = false;
+        if (SUCCEEDED(hr) && ppSB && *ppSB) {
+            *ppSB = new WrappedD3D9StateBlock(*ppSB, this, m_recordedTransformMask, m_recordedTransforms);
+        }
+        return hr;
+    }
     HRESULT STDMETHODCALLTYPE SetClipStatus(const D3DCLIPSTATUS9* pClipStatus) override { return m_real->SetClipStatus(pClipStatus); }
     HRESULT STDMETHODCALLTYPE GetClipStatus(D3DCLIPSTATUS9* pClipStatus) override { return m_real->GetClipStatus(pClipStatus); }
     HRESULT STDMETHODCALLTYPE GetTexture(DWORD Stage, IDirect3DBaseTexture9** ppTexture) override { return m_real->GetTexture(Stage, ppTexture); }
@@ -3569,55 +6415,129 @@ public:
     HRESULT STDMETHODCALLTYPE SetNPatchMode(float nSegments) override { return m_real->SetNPatchMode(nSegments); }
     float STDMETHODCALLTYPE GetNPatchMode() override { return m_real->GetNPatchMode(); }
     HRESULT STDMETHODCALLTYPE DrawPrimitive(D3DPRIMITIVETYPE PrimitiveType, UINT StartVertex, UINT PrimitiveCount) override {
-        if ((g_pauseRendering || IsCurrentShaderDrawDisabled(m_currentVertexShader)) && !g_isRenderingImGui) {
-            return D3D_OK;
+        {
+            PROXY_PROFILE_SCOPE(ProfilerZone_DrawPrimitive);
+            if (g_traceWriter.IsOpen()) {
+                TraceDraw(TraceDraw_Primitive, PrimitiveType, PrimitiveCount);
+            }
+            if ((g_pauseRendering || m_currentShaderSlot->disabled) && !g_isRenderingImGui) {
+                return D3D_OK;
+            }
+            EmitDrawTransforms();
         }
-        EmitFixedFunctionTransforms();
         return m_real->DrawPrimitive(PrimitiveType, StartVertex, PrimitiveCount);
     }
     HRESULT STDMETHODCALLTYPE DrawIndexedPrimitive(D3DPRIMITIVETYPE PrimitiveType, INT BaseVertexIndex, UINT MinVertexIndex, UINT NumVertices, UINT startIndex, UINT primCount) override {
-        if ((g_pauseRendering || IsCurrentShaderDrawDisabled(m_currentVertexShader)) && !g_isRenderingImGui) {
-            return D3D_OK;
+        {
+            PROXY_PROFILE_SCOPE(ProfilerZone_DrawIndexedPrimitive);
+            if (g_traceWriter.IsOpen()) {
+                TraceDraw(TraceDraw_IndexedPrimitive, PrimitiveType, primCount);
+            }
+            if ((g_pauseRendering || m_currentShaderSlot->disabled) && !g_isRenderingImGui) {
+                return D3D_OK;
+            }
+            EmitDrawTransforms();
         }
-        EmitFixedFunctionTransforms();
         return m_real->DrawIndexedPrimitive(PrimitiveType, BaseVertexIndex, MinVertexIndex, NumVertices, startIndex, primCount);
     }
     HRESULT STDMETHODCALLTYPE DrawPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType, UINT PrimitiveCount, const void* pVertexStreamZeroData, UINT VertexStreamZeroStride) override {
-        if ((g_pauseRendering || IsCurrentShaderDrawDisabled(m_currentVertexShader)) && !g_isRenderingImGui) {
-            return D3D_OK;
+        {
+            PROXY_PROFILE_SCOPE(ProfilerZone_DrawPrimitiveUP);
+            if (g_traceWriter.IsOpen()) {
+                TraceDraw(TraceDraw_PrimitiveUP, PrimitiveType, PrimitiveCount);
+            }
+            if ((g_pauseRendering || m_currentShaderSlot->disabled) && !g_isRenderingImGui) {
+                return D3D_OK;
+            }
+            EmitDrawTransforms();
         }
-        EmitFixedFunctionTransforms();
         return m_real->DrawPrimitiveUP(PrimitiveType, PrimitiveCount, pVertexStreamZeroData, VertexStreamZeroStride);
     }
     HRESULT STDMETHODCALLTYPE DrawIndexedPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType, UINT MinVertexIndex, UINT NumVertices, UINT PrimitiveCount, const void* pIndexData, D3DFORMAT IndexDataFormat, const void* pVertexStreamZeroData, UINT VertexStreamZeroStride) override {
-        if ((g_pauseRendering || IsCurrentShaderDrawDisabled(m_currentVertexShader)) && !g_isRenderingImGui) {
-            return D3D_OK;
+        {
+            PROXY_PROFILE_SCOPE(ProfilerZone_DrawIndexedPrimitiveUP);
+            if (g_traceWriter.IsOpen()) {
+                TraceDraw(TraceDraw_IndexedPrimitiveUP, PrimitiveType, PrimitiveCount);
+            }
+            if ((g_pauseRendering || m_currentShaderSlot->disabled) && !g_isRenderingImGui) {
+                return D3D_OK;
+            }
+            EmitDrawTransforms();
         }
-        EmitFixedFunctionTransforms();
         return m_real->DrawIndexedPrimitiveUP(PrimitiveType, MinVertexIndex, NumVertices, PrimitiveCount, pIndexData, IndexDataFormat, pVertexStreamZeroData, VertexStreamZeroStride);
     }
-    HRESULT STDMETHODCALLTYPE ProcessVertices(UINT SrcStartIndex, UINT DestIndex, UINT VertexCount, IDirect3DVertexBuffer9* pDestBuffer, IDirect3DVertexDeclaration9* pVertexDecl, DWORD Flags) override { return m_real->ProcessVertices(SrcStartIndex, DestIndex, VertexCount, pDestBuffer, pVertexDecl, Flags); }
-    HRESULT STDMETHODCALLTYPE CreateVertexDeclaration(const D3DVERTEXELEMENT9* pVertexElements, IDirect3DVertexDeclaration9** ppDecl) override { return m_real->CreateVertexDeclaration(pVertexElements, ppDecl); }
-    HRESULT STDMETHODCALLTYPE SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl) override { return m_real->SetVertexDeclaration(pDecl); }
-    HRESULT STDMETHODCALLTYPE GetVertexDeclaration(IDirect3DVertexDeclaration9** ppDecl) override { return m_real->GetVertexDeclaration(ppDecl); }
-    HRESULT STDMETHODCALLTYPE SetFVF(DWORD FVF) override { return m_real->SetFVF(FVF); }
+    HRESULT STDMETHODCALLTYPE ProcessVertices(UINT SrcStartIndex, UINT DestIndex, UINT VertexCount, IDirect3DVertexBuffer9* pDestBuffer, IDirect3DVertexDeclaration9* pVertexDecl, DWORD Flags) override { return m_real->ProcessVertices(SrcStartIndex, DestIndex, VertexCount, pDestBuffer, UnwrapVertexDeclaration(pVertexDecl), Flags); }
+    HRESULT STDMETHODCALLTYPE CreateVertexDeclaration(const D3DVERTEXELEMENT9* pVertexElements, IDirect3DVertexDeclaration9** ppDecl) override {
+        HRESULT hr = m_real->CreateVertexDeclaration(pVertexElements, ppDecl);
+        if (SUCCEEDED(hr) && ppDecl && *ppDecl) {
+            *ppDecl = new WrappedD3D9VertexDeclaration(*ppDecl, this, IsPretransformedDeclaration(pVertexElements));
+        }
+        return hr;
+    }
+    HRESULT STDMETHODCALLTYPE SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl) override {
+        WrappedD3D9VertexDeclaration* wrapped = AsWrappedVertexDeclaration(pDecl);
+        HRESULT hr = m_real->SetVertexDeclaration(wrapped ? wrapped->Real() : pDecl);
+        if (SUCCEEDED(hr)) {
+            BindVertexDeclaration(wrapped);
+            m_pretransformedInput = wrapped ? wrapped->Pretransformed() : ReadPretransformedDeclaration(pDecl);
+            if (g_traceWriter.IsOpen()) {
+                TraceDeclarationBinding(pDecl);
+            }
+        }
+        return hr;
+    }
+    HRESULT STDMETHODCALLTYPE GetVertexDeclaration(IDirect3DVertexDeclaration9** ppDecl) override {
+        if (ppDecl && m_boundDeclaration) {
+            m_boundDeclaration->AddRef();
+            *ppDecl = m_boundDeclaration;
+            return D3D_OK;
+        }
+        return m_real->GetVertexDeclaration(ppDecl);
+    }
+    HRESULT STDMETHODCALLTYPE SetFVF(DWORD FVF) override {
+        HRESULT hr = m_real->SetFVF(FVF);
+        if (SUCCEEDED(hr)) {
+            // SetFVF replaces the bound declaration with one the runtime owns.
+            BindVertexDeclaration(nullptr);
+            m_pretransformedInput = (FVF & D3DFVF_POSITION_MASK) == D3DFVF_XYZRHW;
+            if (g_traceWriter.IsOpen()) {
+                TraceFVF(FVF);
+            }
+        }
+        return hr;
+    }
     HRESULT STDMETHODCALLTYPE GetFVF(DWORD* pFVF) override { return m_real->GetFVF(pFVF); }
-    HRESULT STDMETHODCALLTYPE CreateVertexShader(const DWORD* pFunction, IDirect3DVertexShader9** ppShader) override { return m_real->CreateVertexShader(pFunction, ppShader); }
+    HRESULT STDMETHODCALLTYPE CreateVertexShader(const DWORD* pFunction, IDirect3DVertexShader9** ppShader) override {
+        HRESULT hr = m_real->CreateVertexShader(pFunction, ppShader);
+        if (SUCCEEDED(hr) && ppShader && *ppShader) {
+            WrappedD3D9VertexShader* wrapped = new WrappedD3D9VertexShader(*ppShader, this);
+            // Hash and parse the caller's bytecode once here so binding stays a pointer copy.
+            RegisterVertexShader(wrapped->Slot(), pFunction);
+            *ppShader = wrapped;
+        }
+        return hr;
+    }
     HRESULT STDMETHODCALLTYPE SetVertexShader(IDirect3DVertexShader9* pShader) override {
-        m_currentVertexShader = pShader;
-        g_activeShaderKey = reinterpret_cast<uintptr_t>(pShader);
-        GetShaderState(g_activeShaderKey, true);
-
-        if (pShader) {
-            uint32_t shaderHash = ComputeShaderBytecodeHash(pShader);
-            if (shaderHash != 0) {
-                g_shaderBytecodeHashes[g_activeShaderKey] = shaderHash;
-            }
+        PROXY_PROFILE_SCOPE(ProfilerZone_SetVertexShader);
+        if (g_traceWriter.IsOpen()) {
+            TraceShaderBinding(pShader);
+        }
+        WrappedD3D9VertexShader* wrapped = AsWrappedVertexShader(pShader);
+        BindVertexShaderSlot(pShader, wrapped);
+        if (pShader && !m_currentShaderSlot->hasRecord) {
+            RegisterVertexShaderFromRuntime(m_currentShaderSlot, pShader);
         }
 
-        return m_real->SetVertexShader(pShader);
+        return m_real->SetVertexShader(wrapped ? wrapped->Real() : pShader);
+    }
+    HRESULT STDMETHODCALLTYPE GetVertexShader(IDirect3DVertexShader9** ppShader) override {
+        if (ppShader && m_boundWrappedShader) {
+            m_boundWrappedShader->AddRef();
+            *ppShader = m_boundWrappedShader;
+            return D3D_OK;
+        }
+        return m_real->GetVertexShader(ppShader);
     }
-    HRESULT STDMETHODCALLTYPE GetVertexShader(IDirect3DVertexShader9** ppShader) override { return m_real->GetVertexShader(ppShader); }
     HRESULT STDMETHODCALLTYPE GetVertexShaderConstantF(UINT StartRegister, float* pConstantData, UINT Vector4fCount) override { return m_real->GetVertexShaderConstantF(StartRegister, pConstantData, Vector4fCount); }
     HRESULT STDMETHODCALLTYPE SetVertexShaderConstantI(UINT StartRegister, const int* pConstantData, UINT Vector4iCount) override { return m_real->SetVertexShaderConstantI(StartRegister, pConstantData, Vector4iCount); }
     HRESULT STDMETHODCALLTYPE GetVertexShaderConstantI(UINT StartRegister, int* pConstantData, UINT Vector4iCount) override { return m_real->GetVertexShaderConstantI(StartRegister, pConstantData, Vector4iCount); }
@@ -3642,11 +6562,166 @@ public:
     HRESULT STDMETHODCALLTYPE DrawTriPatch(UINT Handle, const float* pNumSegs, const D3DTRIPATCH_INFO* pTriPatchInfo) override { return m_real->DrawTriPatch(Handle, pNumSegs, pTriPatchInfo); }
     HRESULT STDMETHODCALLTYPE DeletePatch(UINT Handle) override { return m_real->DeletePatch(Handle); }
     HRESULT STDMETHODCALLTYPE CreateQuery(D3DQUERYTYPE Type, IDirect3DQuery9** ppQuery) override { return m_real->CreateQuery(Type, ppQuery); }
+
+    // IDirect3DDevice9Ex methods; overridden by WrappedD3D9DeviceEx.
+    HRESULT STDMETHODCALLTYPE SetConvolutionMonoKernel(UINT, UINT, float*, float*) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE ComposeRects(IDirect3DSurface9*, IDirect3DSurface9*, IDirect3DVertexBuffer9*, UINT, IDirect3DVertexBuffer9*, D3DCOMPOSERECTSOP, int, int) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE PresentEx(const RECT*, const RECT*, HWND, const RGNDATA*, DWORD) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE GetGPUThreadPriority(INT*) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE SetGPUThreadPriority(INT) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE WaitForVBlank(UINT) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE CheckResourceResidency(IDirect3DResource9**, UINT32) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE SetMaximumFrameLatency(UINT) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE GetMaximumFrameLatency(UINT*) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE CheckDeviceState(HWND) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE CreateRenderTargetEx(UINT, UINT, D3DFORMAT, D3DMULTISAMPLE_TYPE, DWORD, BOOL, IDirect3DSurface9**, HANDLE*, DWORD) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE CreateOffscreenPlainSurfaceEx(UINT, UINT, D3DFORMAT, D3DPOOL, IDirect3DSurface9**, HANDLE*, DWORD) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE CreateDepthStencilSurfaceEx(UINT, UINT, D3DFORMAT, D3DMULTISAMPLE_TYPE, DWORD, BOOL, IDirect3DSurface9**, HANDLE*, DWORD) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE ResetEx(D3DPRESENT_PARAMETERS*, D3DDISPLAYMODEEX*) override { return D3DERR_INVALIDCALL; }
+    HRESULT STDMETHODCALLTYPE GetDisplayModeEx(UINT, D3DDISPLAYMODEEX*, D3DDISPLAYROTATION*) override { return D3DERR_INVALIDCALL; }
+};
+
+// Rewrites present parameters for ForceFlipEx. Flip model needs at least two back
+// buffers, no multisampling and no lockable back buffer; parameters that cannot
+// satisfy that are left alone. Returns true when something was changed.
+static bool ApplyFlipExOverride(D3DPRESENT_PARAMETERS* params) {
+    if (!g_config.forceFlipEx || !params || params->SwapEffect == D3DSWAPEFFECT_FLIPEX) {
+        return false;
+    }
+    if (params->MultiSampleType != D3DMULTISAMPLE_NONE || (params->Flags & D3DPRESENTFLAG_LOCKABLE_BACKBUFFER)) {
+        LogMsg("ForceFlipEx: skipped (multisampled or lockable back buffer)");
+        return false;
+    }
+    params->SwapEffect = D3DSWAPEFFECT_FLIPEX;
+    params->BackBufferCount = (std::max)(params->BackBufferCount, 2u);
+    return true;
+}
+
+// After a successful forced call: hands the game back the swap effect and back
+// buffer count it asked for, keeping whatever else the runtime filled in.
+static void RestoreFlipExOverride(D3DPRESENT_PARAMETERS* params, const D3DPRESENT_PARAMETERS& original) {
+    params->SwapEffect = original.SwapEffect;
+    params->BackBufferCount = original.BackBufferCount;
+}
+
+/**
+ * Wrapped IDirect3DDevice9Ex - devices from CreateDeviceEx. Every IDirect3DDevice9
+ * hook is inherited; PresentEx and ResetEx run the same per-frame and reset work.
+ */
+class WrappedD3D9DeviceEx final : public WrappedD3D9Device {
+private:
+    IDirect3DDevice9Ex* m_realEx;
+
+public:
+    WrappedD3D9DeviceEx(IDirect3DDevice9Ex* real) : WrappedD3D9Device(real), m_realEx(real) {
+        if (g_config.maxFrameLatency > 0) {
+            HRESULT hr = m_realEx->SetMaximumFrameLatency(static_cast<UINT>(g_config.maxFrameLatency));
+            LogMsg("MaxFrameLatency=%d: %s", g_config.maxFrameLatency, SUCCEEDED(hr) ? "applied" : "rejected by runtime");
+        }
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObj) override {
+        if (ppvObj && (riid == IID_IUnknown || riid == IID_IDirect3DDevice9 || riid == IID_IDirect3DDevice9Ex)) {
+            *ppvObj = static_cast<IDirect3DDevice9Ex*>(this);
+            AddRef();
+            return S_OK;
+        }
+        return WrappedD3D9Device::QueryInterface(riid, ppvObj);
+    }
+
+    HRESULT STDMETHODCALLTYPE SetConvolutionMonoKernel(UINT width, UINT height, float* rows, float* columns) override { return m_realEx->SetConvolutionMonoKernel(width, height, rows, columns); }
+    HRESULT STDMETHODCALLTYPE ComposeRects(IDirect3DSurface9* pSrc, IDirect3DSurface9* pDst, IDirect3DVertexBuffer9* pSrcRectDescs, UINT NumRects, IDirect3DVertexBuffer9* pDstRectDescs, D3DCOMPOSERECTSOP Operation, int Xoffset, int Yoffset) override { return m_realEx->ComposeRects(pSrc, pDst, pSrcRectDescs, NumRects, pDstRectDescs, Operation, Xoffset, Yoffset); }
+    HRESULT STDMETHODCALLTYPE PresentEx(const RECT* pSourceRect, const RECT* pDestRect, HWND hDestWindowOverride,
+                                         const RGNDATA* pDirtyRegion, DWORD dwFlags) override {
+        BeginPresent();
+        return m_realEx->PresentEx(pSourceRect, pDestRect, hDestWindowOverride, pDirtyRegion, dwFlags);
+    }
+    HRESULT STDMETHODCALLTYPE GetGPUThreadPriority(INT* pPriority) override { return m_realEx->GetGPUThreadPriority(pPriority); }
+    HRESULT STDMETHODCALLTYPE SetGPUThreadPriority(INT Priority) override { return m_realEx->SetGPUThreadPriority(Priority); }
+    HRESULT STDMETHODCALLTYPE WaitForVBlank(UINT iSwapChain) override { return m_realEx->WaitForVBlank(iSwapChain); }
+    HRESULT STDMETHODCALLTYPE CheckResourceResidency(IDirect3DResource9** pResourceArray, UINT32 NumResources) override { return m_realEx->CheckResourceResidency(pResourceArray, NumResources); }
+    // MaxFrameLatency > 0 pins the queue depth; the game's own request is ignored.
+    HRESULT STDMETHODCALLTYPE SetMaximumFrameLatency(UINT MaxLatency) override {
+        if (g_config.maxFrameLatency > 0) {
+            MaxLatency = static_cast<UINT>(g_config.maxFrameLatency);
+        }
+        return m_realEx->SetMaximumFrameLatency(MaxLatency);
+    }
+    HRESULT STDMETHODCALLTYPE GetMaximumFrameLatency(UINT* pMaxLatency) override { return m_realEx->GetMaximumFrameLatency(pMaxLatency); }
+    HRESULT STDMETHODCALLTYPE CheckDeviceState(HWND hDestinationWindow) override { return m_realEx->CheckDeviceState(hDestinationWindow); }
+    HRESULT STDMETHODCALLTYPE CreateRenderTargetEx(UINT Width, UINT Height, D3DFORMAT Format, D3DMULTISAMPLE_TYPE MultiSample, DWORD MultisampleQuality, BOOL Lockable, IDirect3DSurface9** ppSurface, HANDLE* pSharedHandle, DWORD Usage) override { return m_realEx->CreateRenderTargetEx(Width, Height, Format, MultiSample, MultisampleQuality, Lockable, ppSurface, pSharedHandle, Usage); }
+    HRESULT STDMETHODCALLTYPE CreateOffscreenPlainSurfaceEx(UINT Width, UINT Height, D3DFORMAT Format, D3DPOOL Pool, IDirect3DSurface9** ppSurface, HANDLE* pSharedHandle, DWORD Usage) override { return m_realEx->CreateOffscreenPlainSurfaceEx(Width, Height, Format, Pool, ppSurface, pSharedHandle, Usage); }
+    HRESULT STDMETHODCALLTYPE CreateDepthStencilSurfaceEx(UINT Width, UINT Height, D3DFORMAT Format, D3DMULTISAMPLE_TYPE MultiSample, DWORD MultisampleQuality, BOOL Discard, IDirect3DSurface9** ppSurface, HANDLE* pSharedHandle, DWORD Usage) override { return m_realEx->CreateDepthStencilSurfaceEx(Width, Height, Format, MultiSample, MultisampleQuality, Discard, ppSurface, pSharedHandle, Usage); }
+    HRESULT STDMETHODCALLTYPE ResetEx(D3DPRESENT_PARAMETERS* pPresentationParameters, D3DDISPLAYMODEEX* pFullscreenDisplayMode) override {
+        BeginReset();
+        D3DPRESENT_PARAMETERS original = pPresentationParameters ? *pPresentationParameters : D3DPRESENT_PARAMETERS{};
+        const bool forced = ApplyFlipExOverride(pPresentationParameters);
+        HRESULT hr = m_realEx->ResetEx(pPresentationParameters, pFullscreenDisplayMode);
+        if (FAILED(hr) && forced) {
+            LogMsg("ResetEx with forced FLIPEX failed (0x%08X), retrying with the game's swap effect", hr);
+            *pPresentationParameters = original;
+            hr = m_realEx->ResetEx(pPresentationParameters, pFullscreenDisplayMode);
+        } else if (forced) {
+            RestoreFlipExOverride(pPresentationParameters, original);
+        }
+        EndReset(hr);
+        return hr;
+    }
+    HRESULT STDMETHODCALLTYPE GetDisplayModeEx(UINT iSwapChain, D3DDISPLAYMODEEX* pMode, D3DDISPLAYROTATION* pRotation) override { return m_realEx->GetDisplayModeEx(iSwapChain, pMode, pRotation); }
 };
 
 /**
  * Wrapped IDirect3D9 - intercepts CreateDevice to return wrapped devices
  */
+HRESULT STDMETHODCALLTYPE WrappedD3D9StateBlock::GetDevice(IDirect3DDevice9** ppDevice) {
+    if (!ppDevice) {
+        return D3DERR_INVALIDCALL;
+    }
+    m_device->AddRef();
+    *ppDevice = m_device;
+    return D3D_OK;
+}
+
+HRESULT STDMETHODCALLTYPE WrappedD3D9VertexShader::GetDevice(IDirect3DDevice9** ppDevice) {
+    if (!ppDevice) {
+        return D3DERR_INVALIDCALL;
+    }
+    m_device->AddRef();
+    *ppDevice = m_device;
+    return D3D_OK;
+}
+
+HRESULT STDMETHODCALLTYPE WrappedD3D9VertexDeclaration::GetDevice(IDirect3DDevice9** ppDevice) {
+    if (!ppDevice) {
+        return D3DERR_INVALIDCALL;
+    }
+    m_device->AddRef();
+    *ppDevice = m_device;
+    return D3D_OK;
+}
+
+HRESULT STDMETHODCALLTYPE WrappedD3D9StateBlock::Capture() {
+    HRESULT hr = m_real->Capture();
+    if (SUCCEEDED(hr)) {
+        m_device->CaptureStateBlockTransforms(m_transformMask, &m_transforms);
+    }
+    return hr;
+}
+
+HRESULT STDMETHODCALLTYPE WrappedD3D9StateBlock::Apply() {
+    HRESULT hr = m_real->Apply();
+    if (SUCCEEDED(hr)) {
+        m_device->ApplyStateBlockTransforms(m_transformMask, m_transforms);
+        m_device->ResyncVertexShaderBinding();
+        m_device->ResyncVertexInput();
+    } else {
+        m_device->InvalidateTransformShadow();
+    }
+    m_device->InvalidateViewportDependentState();
+    m_device->SyncRenderPassViewport();
+    return hr;
+}
+
 class WrappedD3D9 : public IDirect3D9 {
 private:
     IDirect3D9* m_real;
@@ -3825,13 +6900,23 @@ public:
     {
         LogMsg("CreateDeviceEx called");
         IDirect3DDevice9Ex* realDevice = nullptr;
+        D3DPRESENT_PARAMETERS original = pPresentationParameters ? *pPresentationParameters : D3DPRESENT_PARAMETERS{};
+        const bool forced = ApplyFlipExOverride(pPresentationParameters);
         HRESULT hr = m_real->CreateDeviceEx(Adapter, DeviceType, hFocusWindow, BehaviorFlags,
                                             pPresentationParameters, pFullscreenDisplayMode, &realDevice);
+        if (FAILED(hr) && forced) {
+            // The runtime (or Remix) does not support flip model for this setup.
+            LogMsg("CreateDeviceEx with forced FLIPEX failed (0x%08X), retrying with the game's swap effect", hr);
+            *pPresentationParameters = original;
+            hr = m_real->CreateDeviceEx(Adapter, DeviceType, hFocusWindow, BehaviorFlags,
+                                        pPresentationParameters, pFullscreenDisplayMode, &realDevice);
+        } else if (forced) {
+            LogMsg("ForceFlipEx: swap effect FLIPEX, %u back buffers", pPresentationParameters->BackBufferCount);
+            RestoreFlipExOverride(pPresentationParameters, original);
+        }
         if (SUCCEEDED(hr) && realDevice) {
-            // Note: We wrap as IDirect3DDevice9, but the game expects IDirect3DDevice9Ex
-            // This is a simplification - a full implementation would need a WrappedD3D9DeviceEx
-            LogMsg("CreateDeviceEx succeeded, wrapping device (as base Device9)");
-            *ppReturnedDeviceInterface = (IDirect3DDevice9Ex*)new WrappedD3D9Device(realDevice);
+            LogMsg("CreateDeviceEx succeeded, wrapping device");
+            *ppReturnedDeviceInterface = new WrappedD3D9DeviceEx(realDevice);
         } else {
             LogMsg("CreateDeviceEx failed: 0x%08X", hr);
             *ppReturnedDeviceInterface = nullptr;
@@ -3840,86 +6925,78 @@ public:
     }
 };
 
-// Load configuration from ini file
-void LoadConfig() {
-    char path[MAX_PATH];
-    GetModuleFileNameA(nullptr, path, MAX_PATH);
-
-    char* lastSlash = strrchr(path, '\\');
-    if (lastSlash) {
-        strcpy(lastSlash + 1, "camera_proxy.ini");
-    }
-
-    g_config.viewMatrixRegister = GetPrivateProfileIntA("CameraProxy", "ViewMatrixRegister", -1, path);
-    g_config.projMatrixRegister = GetPrivateProfileIntA("CameraProxy", "ProjMatrixRegister", -1, path);
-    g_config.worldMatrixRegister = GetPrivateProfileIntA("CameraProxy", "WorldMatrixRegister", -1, path);
-    g_iniViewMatrixRegister = g_config.viewMatrixRegister;
-    g_iniProjMatrixRegister = g_config.projMatrixRegister;
-    g_iniWorldMatrixRegister = g_config.worldMatrixRegister;
-    g_config.enableLogging = GetPrivateProfileIntA("CameraProxy", "EnableLogging", 1, path) != 0;
-    g_config.logAllConstants = GetPrivateProfileIntA("CameraProxy", "LogAllConstants", 0, path) != 0;
-    g_config.autoDetectMatrices = GetPrivateProfileIntA("CameraProxy", "AutoDetectMatrices", 0, path) != 0;
-    g_config.enableMemoryScanner = GetPrivateProfileIntA("CameraProxy", "EnableMemoryScanner", 0, path) != 0;
-    g_config.memoryScannerIntervalSec = GetPrivateProfileIntA("CameraProxy", "MemoryScannerIntervalSec", 0, path);
-    g_config.memoryScannerMaxResults = GetPrivateProfileIntA("CameraProxy", "MemoryScannerMaxResults", 25, path);
-    GetPrivateProfileStringA("CameraProxy", "MemoryScannerModule", "", g_config.memoryScannerModule,
-                             MAX_PATH, path);
-    g_config.useRemixRuntime = GetPrivateProfileIntA("CameraProxy", "UseRemixRuntime", 1, path) != 0;
-    g_config.emitFixedFunctionTransforms = GetPrivateProfileIntA("CameraProxy", "EmitFixedFunctionTransforms", 1, path) != 0;
-    GetPrivateProfileStringA("CameraProxy", "GameProfile", "", g_config.gameProfile,
-                             static_cast<DWORD>(sizeof(g_config.gameProfile)), path);
-    g_activeGameProfile = ParseGameProfile(g_config.gameProfile);
-    ConfigureActiveProfileLayout();
-    g_profileCoreRegistersSeen[0] = g_profileCoreRegistersSeen[1] = g_profileCoreRegistersSeen[2] = false;
-    g_profileOptionalRegistersSeen[0] = g_profileOptionalRegistersSeen[1] = false;
-    g_profileViewDerivedFromInverse = false;
-    g_profileStatusMessage[0] = '\0';
-    g_profileDisableStructuralDetection = false;
-    if (g_config.gameProfile[0] != '\0' && g_activeGameProfile == GameProfile_None) {
-        snprintf(g_profileStatusMessage, sizeof(g_profileStatusMessage),
-                 "Unknown GameProfile='%s'. Falling back to structural detection.", g_config.gameProfile);
-    }
-    g_config.imguiScale = GetPrivateProfileIntA("CameraProxy", "ImGuiScalePercent", 100, path) / 100.0f;
-    if (g_config.imguiScale < 0.5f) g_config.imguiScale = 0.5f;
-    if (g_config.imguiScale > 3.0f) g_config.imguiScale = 3.0f;
-    GetPrivateProfileStringA("CameraProxy", "RemixDllName", "d3d9_remix.dll", g_config.remixDllName,
-                             MAX_PATH, path);
-    g_probeTransposedLayouts = GetPrivateProfileIntA("CameraProxy", "ProbeTransposedLayouts", 1, path) != 0;
-    g_probeInverseView = GetPrivateProfileIntA("CameraProxy", "ProbeInverseView", 1, path) != 0;
-    g_overrideScopeMode = GetPrivateProfileIntA("CameraProxy", "OverrideScopeMode", Override_Sticky, path);
-    g_overrideNFrames = GetPrivateProfileIntA("CameraProxy", "OverrideNFrames", 3, path);
-    g_config.hotkeyToggleMenuVk = GetPrivateProfileIntA("CameraProxy", "HotkeyToggleMenuVK", VK_F10, path);
-    g_config.hotkeyTogglePauseVk = GetPrivateProfileIntA("CameraProxy", "HotkeyTogglePauseVK", VK_F9, path);
-    g_config.hotkeyEmitMatricesVk = GetPrivateProfileIntA("CameraProxy", "HotkeyEmitMatricesVK", VK_F8, path);
-    g_config.hotkeyResetMatrixOverridesVk = GetPrivateProfileIntA("CameraProxy", "HotkeyResetMatrixOverridesVK", VK_F7, path);
-    g_config.enableCombinedMVP = GetPrivateProfileIntA("CameraProxy", "EnableCombinedMVP", 0, path) != 0;
-    g_config.combinedMVPRequireWorld = GetPrivateProfileIntA("CameraProxy", "CombinedMVPRequireWorld", 0, path) != 0;
-    g_config.combinedMVPAssumeIdentityWorld = GetPrivateProfileIntA("CameraProxy", "CombinedMVPAssumeIdentityWorld", 1, path) != 0;
-    g_config.combinedMVPForceDecomposition = GetPrivateProfileIntA("CameraProxy", "CombinedMVPForceDecomposition", 0, path) != 0;
-    g_config.combinedMVPLogDecomposition = GetPrivateProfileIntA("CameraProxy", "CombinedMVPLogDecomposition", 0, path) != 0;
-
-    g_config.experimentalCustomProjectionEnabled =
-        GetPrivateProfileIntA("CameraProxy", "ExperimentalCustomProjectionEnabled", 0, path) != 0;
-    g_config.experimentalCustomProjectionMode =
-        GetPrivateProfileIntA("CameraProxy", "ExperimentalCustomProjectionMode", 2, path);
-    g_config.experimentalCustomProjectionOverrideDetectedProjection =
-        GetPrivateProfileIntA("CameraProxy", "ExperimentalCustomProjectionOverrideDetectedProjection", 0, path) != 0;
-    g_config.experimentalCustomProjectionOverrideCombinedMVP =
-        GetPrivateProfileIntA("CameraProxy", "ExperimentalCustomProjectionOverrideCombinedMVP", 0, path) != 0;
-    g_config.mgrrUseAutoProjectionWhenC4Invalid =
-        GetPrivateProfileIntA("CameraProxy", "MGRRUseAutoProjectionWhenC4Invalid", 0, path) != 0;
-
-    char customBuf[64] = {};
-    GetPrivateProfileStringA("CameraProxy", "ExperimentalCustomProjectionAutoFovDeg", "60.0", customBuf, sizeof(customBuf), path);
-    g_config.experimentalCustomProjectionAutoFovDeg = (float)atof(customBuf);
-    GetPrivateProfileStringA("CameraProxy", "ExperimentalCustomProjectionAutoNearZ", "0.1", customBuf, sizeof(customBuf), path);
-    g_config.experimentalCustomProjectionAutoNearZ = (float)atof(customBuf);
-    GetPrivateProfileStringA("CameraProxy", "ExperimentalCustomProjectionAutoFarZ", "1000.0", customBuf, sizeof(customBuf), path);
-    g_config.experimentalCustomProjectionAutoFarZ = (float)atof(customBuf);
-    GetPrivateProfileStringA("CameraProxy", "ExperimentalCustomProjectionAutoAspectFallback", "1.7777778", customBuf, sizeof(customBuf), path);
-    g_config.experimentalCustomProjectionAutoAspectFallback = (float)atof(customBuf);
-    g_config.experimentalCustomProjectionAutoHandedness =
-        GetPrivateProfileIntA("CameraProxy", "ExperimentalCustomProjectionAutoHandedness", ProjectionHandedness_Left, path);
+// Reads every camera_proxy.ini key into config in one pass over the file.
+static void ParseConfig(const ConfigIniFile& ini, ProxyConfig* out) {
+    ProxyConfig& config = *out;
+    config.viewMatrixRegister = ini.GetInt("ViewMatrixRegister", -1);
+    config.projMatrixRegister = ini.GetInt("ProjMatrixRegister", -1);
+    config.worldMatrixRegister = ini.GetInt("WorldMatrixRegister", -1);
+    config.enableLogging = ini.GetBool("EnableLogging", true);
+    config.logAllConstants = ini.GetBool("LogAllConstants", false);
+    config.autoDetectMatrices = ini.GetBool("AutoDetectMatrices", false);
+    config.enableMemoryScanner = ini.GetBool("EnableMemoryScanner", false);
+    config.memoryScannerIntervalSec = ini.GetInt("MemoryScannerIntervalSec", 0);
+    config.memoryScannerMaxResults = ini.GetInt("MemoryScannerMaxResults", 25);
+    ini.GetString("MemoryScannerModule", "", config.memoryScannerModule, sizeof(config.memoryScannerModule));
+    config.memoryScannerAllRegions = ini.GetBool("MemoryScannerAllRegions", false);
+    config.memoryScannerThreads = ini.GetInt("MemoryScannerThreads", 0);
+    ini.GetString("TraceCapturePath", "camera_proxy.trace", config.traceCapturePath, sizeof(config.traceCapturePath));
+    config.traceCaptureOnStart = ini.GetBool("TraceCaptureOnStart", false);
+    config.layoutCacheEnabled = ini.GetBool("LayoutCacheEnabled", true);
+    ini.GetString("LayoutCacheFile", "camera_proxy_layouts.bin", config.layoutCacheFile, sizeof(config.layoutCacheFile));
+    config.useRemixRuntime = ini.GetBool("UseRemixRuntime", true);
+    config.emitFixedFunctionTransforms = ini.GetBool("EmitFixedFunctionTransforms", true);
+    config.emitTransformsOnChangeOnly = ini.GetBool("EmitTransformsOnChangeOnly", false);
+    config.useSimdMatrixKernels = ini.GetBool("UseSIMDMatrixKernels", true);
+    config.asyncClassification = ini.GetBool("AsyncClassification", false);
+    config.configHotReload = ini.GetBool("ConfigHotReload", true);
+    config.passFiltering = ini.GetBool("PassFiltering", true);
+    ini.GetString("PassPolicies", "", config.passPolicies, sizeof(config.passPolicies));
+    config.skipScreenSpaceDraws = ini.GetBool("SkipScreenSpaceDraws", true);
+    ini.GetString("ScreenSpaceShaders", "", config.screenSpaceShaders, sizeof(config.screenSpaceShaders));
+    ini.GetString("GameProfile", "", config.gameProfile, sizeof(config.gameProfile));
+    config.presentTaskBudgetUs = (std::max)(0, ini.GetInt("PresentTaskBudgetUs", 200));
+    config.sharedCameraExport = ini.GetBool("SharedCameraExport", false);
+    config.perfMarkers = ini.GetBool("PerfMarkers", false);
+    config.forceFlipEx = ini.GetBool("ForceFlipEx", false);
+    config.maxFrameLatency = (std::min)((std::max)(0, ini.GetInt("MaxFrameLatency", 0)), 16);
+    ini.GetString("SharedCameraExportName", "CameraProxyCamera", config.sharedCameraExportName,
+                  sizeof(config.sharedCameraExportName));
+    config.imguiScale = ini.GetInt("ImGuiScalePercent", 100) / 100.0f;
+    if (config.imguiScale < 0.5f) config.imguiScale = 0.5f;
+    if (config.imguiScale > 3.0f) config.imguiScale = 3.0f;
+    ini.GetString("RemixDllName", "d3d9_remix.dll", config.remixDllName, sizeof(config.remixDllName));
+    config.probeTransposedLayouts = ini.GetBool("ProbeTransposedLayouts", true);
+    config.probeInverseView = ini.GetBool("ProbeInverseView", true);
+    config.layoutLockThreshold = (std::max)(0, ini.GetInt("LayoutLockThreshold", 8));
+    config.bonePaletteMinBones = (std::max)(0, ini.GetInt("BonePaletteMinBones", 8));
+    config.overrideScopeMode = ini.GetInt("OverrideScopeMode", Override_Sticky);
+    config.overrideNFrames = ini.GetInt("OverrideNFrames", 3);
+    config.hotkeyToggleMenuVk = ini.GetInt("HotkeyToggleMenuVK", VK_F10);
+    config.hotkeyTogglePauseVk = ini.GetInt("HotkeyTogglePauseVK", VK_F9);
+    config.hotkeyEmitMatricesVk = ini.GetInt("HotkeyEmitMatricesVK", VK_F8);
+    config.hotkeyResetMatrixOverridesVk = ini.GetInt("HotkeyResetMatrixOverridesVK", VK_F7);
+    config.enableCombinedMVP = ini.GetBool("EnableCombinedMVP", false);
+    config.combinedMVPRequireWorld = ini.GetBool("CombinedMVPRequireWorld", false);
+    config.combinedMVPAssumeIdentityWorld = ini.GetBool("CombinedMVPAssumeIdentityWorld", true);
+    config.combinedMVPForceDecomposition = ini.GetBool("CombinedMVPForceDecomposition", false);
+    config.combinedMVPLogDecomposition = ini.GetBool("CombinedMVPLogDecomposition", false);
+
+    config.experimentalCustomProjectionEnabled = ini.GetBool("ExperimentalCustomProjectionEnabled", false);
+    config.experimentalCustomProjectionMode = ini.GetInt("ExperimentalCustomProjectionMode", 2);
+    config.experimentalCustomProjectionOverrideDetectedProjection =
+        ini.GetBool("ExperimentalCustomProjectionOverrideDetectedProjection", false);
+    config.experimentalCustomProjectionOverrideCombinedMVP =
+        ini.GetBool("ExperimentalCustomProjectionOverrideCombinedMVP", false);
+    config.mgrrUseAutoProjectionWhenC4Invalid = ini.GetBool("MGRRUseAutoProjectionWhenC4Invalid", false);
+
+    config.experimentalCustomProjectionAutoFovDeg = ini.GetFloat("ExperimentalCustomProjectionAutoFovDeg", 60.0f);
+    config.experimentalCustomProjectionAutoNearZ = ini.GetFloat("ExperimentalCustomProjectionAutoNearZ", 0.1f);
+    config.experimentalCustomProjectionAutoFarZ = ini.GetFloat("ExperimentalCustomProjectionAutoFarZ", 1000.0f);
+    config.experimentalCustomProjectionAutoAspectFallback =
+        ini.GetFloat("ExperimentalCustomProjectionAutoAspectFallback", 1.7777778f);
+    config.experimentalCustomProjectionAutoHandedness =
+        ini.GetInt("ExperimentalCustomProjectionAutoHandedness", ProjectionHandedness_Left);
 
     D3DMATRIX defaultManualProjection = {};
     CreateProjectionMatrixWithHandedness(&defaultManualProjection,
@@ -3928,36 +7005,74 @@ void LoadConfig() {
                                          0.1f,
                                          1000.0f,
                                          ProjectionHandedness_Left);
-    g_config.experimentalCustomProjectionManualMatrix = defaultManualProjection;
-    float* manualValues = reinterpret_cast<float*>(&g_config.experimentalCustomProjectionManualMatrix);
+    float* manualValues = reinterpret_cast<float*>(&config.experimentalCustomProjectionManualMatrix);
     const float* defaultManualValues = reinterpret_cast<const float*>(&defaultManualProjection);
     for (int i = 0; i < 16; ++i) {
         int row = (i / 4) + 1;
         int col = (i % 4) + 1;
         char key[64] = {};
         snprintf(key, sizeof(key), "ExperimentalCustomProjectionM%d%d", row, col);
-        snprintf(customBuf, sizeof(customBuf), "%.7g", defaultManualValues[i]);
-        GetPrivateProfileStringA("CameraProxy", key, customBuf, customBuf, sizeof(customBuf), path);
-        manualValues[i] = (float)atof(customBuf);
+        manualValues[i] = ini.GetFloat(key, defaultManualValues[i]);
+    }
+
+    config.minFOV = ini.GetFloat("MinFOV", 0.1f);
+    config.maxFOV = ini.GetFloat("MaxFOV", 2.5f);
+}
+
+// Load configuration from ini file
+void LoadConfig() {
+    GetModuleFileNameA(nullptr, g_configIniPath, MAX_PATH);
+    char* lastSlash = strrchr(g_configIniPath, '\\');
+    if (lastSlash) {
+        strcpy(lastSlash + 1, "camera_proxy.ini");
+    }
+
+    ConfigIniFile ini;
+    ini.Load(g_configIniPath, "CameraProxy");
+    ParseConfig(ini, &g_config);
+    ApplyConfigGlobals();
+    ApplyGameProfileConfig();
+}
+
+// Watcher thread: parse the edited file and leave it for the next Present.
+static void OnConfigFileChanged(const char* path) {
+    ConfigIniFile ini;
+    if (!ini.Load(path, "CameraProxy")) {
+        return;
     }
+    ProxyConfig* reloaded = new ProxyConfig();
+    ParseConfig(ini, reloaded);
+    delete g_reloadedConfig.exchange(reloaded, std::memory_order_acq_rel);
+}
 
-    char buf[64];
-    GetPrivateProfileStringA("CameraProxy", "MinFOV", "0.1", buf, sizeof(buf), path);
-    g_config.minFOV = (float)atof(buf);
-    GetPrivateProfileStringA("CameraProxy", "MaxFOV", "2.5", buf, sizeof(buf), path);
-    g_config.maxFOV = (float)atof(buf);
+static void OnConfigWritesFlushed(size_t keyCount, bool succeeded) {
+    if (!succeeded) {
+        LogMsg("WARNING: Failed to save %u key(s) to camera_proxy.ini.", static_cast<unsigned>(keyCount));
+    }
 }
 
 // DLL entry point
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
     if (fdwReason == DLL_PROCESS_ATTACH) {
         DisableThreadLibraryCalls(hinstDLL);
+        // The DLL image: g_cameraMatrices, the tracked matrices and other statics.
+        ProxyRegisterAllocationOf(hinstDLL);
 
         LoadConfig();
+        ApplyReconstructionConfig();
+        SelectMatrixKernels(g_config.useSimdMatrixKernels);
+        g_traceCaptureRequested = g_config.traceCaptureOnStart;
 
         if (g_config.enableLogging) {
             g_logFile = fopen("camera_proxy.log", "w");
+            if (g_logFile) {
+                // The writer owns all file I/O; keep CRT buffering large so a
+                // batch turns into a single write.
+                setvbuf(g_logFile, nullptr, _IOFBF, 64 * 1024);
+            }
             LogMsg("=== DMC4 Camera Proxy for D3D9 ===");
+            LogMsg("Matrix kernels: %s (CPU: SSE2=%d AVX=%d)", ActiveMatrixKernels().name,
+                   DetectedCpuFeatures().sse2 ? 1 : 0, DetectedCpuFeatures().avx ? 1 : 0);
             LogMsg("View matrix register override: %s", g_config.viewMatrixRegister >= 0 ? "ENABLED" : "auto");
             if (g_config.viewMatrixRegister >= 0) {
                 LogMsg("  View override range: c%d-c%d", g_config.viewMatrixRegister, g_config.viewMatrixRegister + 3);
@@ -3976,6 +7091,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
             LogMsg("Use Remix runtime: %s", g_config.useRemixRuntime ? "ENABLED" : "disabled");
             LogMsg("Remix runtime DLL: %s", g_config.remixDllName);
             LogMsg("Emit fixed-function transforms: %s", g_config.emitFixedFunctionTransforms ? "ENABLED" : "disabled");
+            LogMsg("Emit transforms on change only: %s", g_config.emitTransformsOnChangeOnly ? "ENABLED" : "disabled");
             LogMsg("Combined MVP handling: %s", g_config.enableCombinedMVP ? "ENABLED" : "disabled");
             LogMsg("Combined MVP require world: %s", g_config.combinedMVPRequireWorld ? "yes" : "no");
             LogMsg("Combined MVP assume identity world: %s", g_config.combinedMVPAssumeIdentityWorld ? "yes" : "no");
@@ -4007,7 +7123,13 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
             LogMsg("ImGui scale: %.2fx", g_config.imguiScale);
             LogMsg("Probe transposed layouts: %s", g_probeTransposedLayouts ? "ENABLED" : "disabled");
             LogMsg("Probe inverse view: %s", g_probeInverseView ? "ENABLED" : "disabled");
+            LogMsg("Layout lock threshold: %d%s", g_layoutLockThreshold, g_layoutLockThreshold == 0 ? " (learning disabled)" : "");
+            LogMsg("Bone palette min bones: %d%s", g_bonePaletteMinBones, g_bonePaletteMinBones == 0 ? " (detection disabled)" : "");
             LogMsg("Override scope mode: %d (N=%d)", g_overrideScopeMode, g_overrideNFrames);
+            LogMsg("Present task budget: %d us%s", g_config.presentTaskBudgetUs,
+                   g_config.presentTaskBudgetUs == 0 ? " (unlimited)" : "");
+            LogMsg("Force FLIPEX (Ex devices): %s, max frame latency: %d%s", g_config.forceFlipEx ? "ENABLED" : "disabled",
+                   g_config.maxFrameLatency, g_config.maxFrameLatency == 0 ? " (game default)" : "");
             LogMsg("Hotkeys (VK): menu=%d pause=%d emit=%d resetOverrides=%d",
                    g_config.hotkeyToggleMenuVk,
                    g_config.hotkeyTogglePauseVk,
@@ -4018,9 +7140,18 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
                 LogMsg("Memory scanner module: %s", g_config.memoryScannerModule[0]
                                                    ? g_config.memoryScannerModule
                                                    : "<main module>");
+                LogMsg("Memory scanner scope: %s", g_config.memoryScannerAllRegions
+                                                   ? "all committed RW regions"
+                                                   : "module allocation");
             }
         }
 
+        if (!g_configWatcher.Start(g_configIniPath, "CameraProxy",
+                                   g_config.configHotReload ? OnConfigFileChanged : nullptr,
+                                   OnConfigWritesFlushed)) {
+            LogMsg("WARNING: Failed to start camera_proxy.ini watcher thread; overlay changes are saved at unload.");
+        }
+
         // Load the real D3D9 runtime (Remix or system, based on config)
         g_hD3D9 = LoadTargetD3D9();
 
@@ -4034,18 +7165,37 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
             g_origD3DPERF_SetMarker = (D3DPERF_SetMarker_t)GetProcAddress(g_hD3D9, "D3DPERF_SetMarker");
             g_origD3DPERF_SetOptions = (D3DPERF_SetOptions_t)GetProcAddress(g_hD3D9, "D3DPERF_SetOptions");
             g_origD3DPERF_SetRegion = (D3DPERF_SetRegion_t)GetProcAddress(g_hD3D9, "D3DPERF_SetRegion");
+            ProxyMarkersSetRuntime(g_origD3DPERF_BeginEvent, g_origD3DPERF_EndEvent, g_origD3DPERF_SetMarker);
             LogMsg("Loaded target d3d9 runtime successfully");
             LogMsg("  Direct3DCreate9: %p", g_origDirect3DCreate9);
             LogMsg("  Direct3DCreate9Ex: %p", g_origDirect3DCreate9Ex);
         } else {
             LogMsg("ERROR: Failed to load target d3d9 runtime!");
         }
+
+        // No thread is created under the loader lock; lines logged so far wait in the ring.
+        if (g_logFile) {
+            g_logWriterStart.store(LogWriter_Pending, std::memory_order_release);
+        }
     }
     else if (fdwReason == DLL_PROCESS_DETACH) {
+        g_traceWriter.Close();
+        CloseSharedCameraExport();
+        ProxyMarkersShutdown();
+        g_configWatcher.Stop(lpvReserved != nullptr);
+        delete g_reloadedConfig.exchange(nullptr);
+        delete g_memoryScanPublished.exchange(nullptr);
+        g_asyncClassifier.Stop();
         if (g_logFile) {
+            // Keeps the lines below from starting a writer under the loader lock.
+            g_logWriterStart.store(LogWriter_Off, std::memory_order_release);
             LogMsg("=== Camera Proxy unloading ===");
             LogMsg("Total frames: %d", g_frameCount);
-            fclose(g_logFile);
+            // A writer killed mid-batch may hold the CRT's lock on the file.
+            if (StopLogWriter()) {
+                fclose(g_logFile);
+            }
+            g_logFile = nullptr;
         }
         if (g_hD3D9) {
             FreeLibrary(g_hD3D9);
@@ -4054,6 +7204,248 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
     return TRUE;
 }
 
+// Feeds a captured trace through a WrappedD3D9Device over NullD3D9Device. The
+// classifier and transform emission run exactly as in the game; the summary
+// (including a digest of every SetTransform the proxy emitted) is logged and
+// written next to the trace as <trace>.replay.txt for diffing between builds.
+static bool ReplayCameraTrace(const char* path) {
+    ConstantTraceReader reader;
+    if (!reader.Open(path)) {
+        LogMsg("Trace replay: cannot open %s (missing file or wrong version)", path);
+        return false;
+    }
+
+    // The wrapper owns the only reference; its final Release deletes both.
+    NullD3D9Device* nullDevice = new NullD3D9Device();
+    WrappedD3D9Device* device = new WrappedD3D9Device(nullDevice);
+    std::unordered_map<uint64_t, WrappedD3D9VertexShader*> shaders;
+    std::unordered_map<uint64_t, WrappedD3D9VertexDeclaration*> declarations;
+    // Surfaces stay alive until the end of the replay so no stand-in address is
+    // reused while a render pass key still names it.
+    std::unordered_map<uint64_t, ReplaySurface*> surfaces;
+    std::vector<ReplaySurface*> replaySurfaces;
+    g_traceReplayActive = true;
+    // Replay starts from a cold classifier and never writes the game's layout cache.
+    g_config.layoutCacheEnabled = false;
+    ResetLearnedLayouts();
+    memset(g_manualBindings, 0, sizeof(g_manualBindings));
+
+    TraceRecordHeader header = {};
+    std::vector<uint8_t> payload;
+    unsigned long long records = 0;
+    unsigned long long uploads = 0;
+    unsigned long long draws = 0;
+    unsigned long long malformed = 0;
+    const int64_t start = ProfilerNow();
+    while (reader.Next(&header, &payload)) {
+        records++;
+        const uint8_t* data = payload.data();
+        const size_t size = payload.size();
+        switch (header.type) {
+        case TraceRecord_Shader: {
+            if (size <= sizeof(uint64_t)) {
+                malformed++;
+                break;
+            }
+            uint64_t key = 0;
+            memcpy(&key, data, sizeof(key));
+            // Replayed shaders go through the same wrapper as the game's. A key seen
+            // again is a new shader created at a freed address.
+            WrappedD3D9VertexShader*& shader = shaders[key];
+            if (shader) {
+                shader->Release();
+            }
+            shader = new WrappedD3D9VertexShader(new ReplayVertexShader(data + sizeof(key), size - sizeof(key)), device);
+            break;
+        }
+        case TraceRecord_SetVertexShader: {
+            if (size != sizeof(uint64_t)) {
+                malformed++;
+                break;
+            }
+            uint64_t key = 0;
+            memcpy(&key, data, sizeof(key));
+            auto it = shaders.find(key);
+            device->SetVertexShader(it != shaders.end() ? it->second : nullptr);
+            break;
+        }
+        case TraceRecord_SetVertexShaderConstantF: {
+            uint32_t range[2] = {};
+            if (size < sizeof(range)) {
+                malformed++;
+                break;
+            }
+            memcpy(range, data, sizeof(range));
+            if (size != sizeof(range) + static_cast<size_t>(range[1]) * 4 * sizeof(float)) {
+                malformed++;
+                break;
+            }
+            device->SetVertexShaderConstantF(range[0], reinterpret_cast<const float*>(data + sizeof(range)), range[1]);
+            uploads++;
+            break;
+        }
+        case TraceRecord_SetViewport:
+            if (size != sizeof(D3DVIEWPORT9)) {
+                malformed++;
+                break;
+            }
+            device->SetViewport(reinterpret_cast<const D3DVIEWPORT9*>(data));
+            break;
+        case TraceRecord_BeginScene:
+            device->BeginScene();
+            break;
+        case TraceRecord_Present:
+            device->Present(nullptr, nullptr, nullptr, nullptr);
+            break;
+        case TraceRecord_Draw: {
+            TraceDrawPayload draw = {};
+            if (size != sizeof(draw)) {
+                malformed++;
+                break;
+            }
+            memcpy(&draw, data, sizeof(draw));
+            const D3DPRIMITIVETYPE type = static_cast<D3DPRIMITIVETYPE>(draw.primitiveType);
+            if (draw.kind == TraceDraw_IndexedPrimitive) {
+                device->DrawIndexedPrimitive(type, 0, 0, 0, 0, draw.primitiveCount);
+            } else if (draw.kind == TraceDraw_PrimitiveUP) {
+                device->DrawPrimitiveUP(type, draw.primitiveCount, nullptr, 0);
+            } else if (draw.kind == TraceDraw_IndexedPrimitiveUP) {
+                device->DrawIndexedPrimitiveUP(type, 0, 0, draw.primitiveCount, nullptr, D3DFMT_INDEX16, nullptr, 0);
+            } else {
+                device->DrawPrimitive(type, 0, draw.primitiveCount);
+            }
+            draws++;
+            break;
+        }
+        case TraceRecord_SetRenderTarget:
+        case TraceRecord_SetDepthStencilSurface: {
+            TraceSurfacePayload surface = {};
+            if (size != sizeof(surface)) {
+                malformed++;
+                break;
+            }
+            memcpy(&surface, data, sizeof(surface));
+            ReplaySurface* replaySurface = nullptr;
+            if (surface.key != 0) {
+                D3DSURFACE_DESC desc = {};
+                desc.Width = surface.width;
+                desc.Height = surface.height;
+                desc.Format = static_cast<D3DFORMAT>(surface.format);
+                desc.Usage = surface.usage;
+                desc.Type = D3DRTYPE_SURFACE;
+                // A key with a new description is a new surface created at a freed address.
+                ReplaySurface*& known = surfaces[surface.key];
+                if (!known || known->Desc().Width != desc.Width || known->Desc().Height != desc.Height ||
+                    known->Desc().Format != desc.Format || known->Desc().Usage != desc.Usage) {
+                    known = new ReplaySurface(desc);
+                    replaySurfaces.push_back(known);
+                }
+                replaySurface = known;
+            }
+            if (header.type == TraceRecord_SetRenderTarget) {
+                device->SetRenderTarget(0, replaySurface);
+            } else {
+                device->SetDepthStencilSurface(replaySurface);
+            }
+            break;
+        }
+        case TraceRecord_SetFVF: {
+            uint32_t fvf = 0;
+            if (size != sizeof(fvf)) {
+                malformed++;
+                break;
+            }
+            memcpy(&fvf, data, sizeof(fvf));
+            device->SetFVF(fvf);
+            break;
+        }
+        case TraceRecord_VertexDeclaration: {
+            const size_t elementBytes = size > sizeof(uint64_t) ? size - sizeof(uint64_t) : 0;
+            if (elementBytes == 0 || elementBytes % sizeof(D3DVERTEXELEMENT9) != 0) {
+                malformed++;
+                break;
+            }
+            uint64_t key = 0;
+            memcpy(&key, data, sizeof(key));
+            const size_t count = elementBytes / sizeof(D3DVERTEXELEMENT9);
+            std::vector<D3DVERTEXELEMENT9> elements(count);
+            memcpy(elements.data(), data + sizeof(key), elementBytes);
+            if (elements.back().Stream != 0xFF) {
+                malformed++;
+                break;
+            }
+            // Wrapped like the game's; a key seen again is a new declaration at a freed address.
+            WrappedD3D9VertexDeclaration*& decl = declarations[key];
+            if (decl) {
+                decl->Release();
+            }
+            decl = new WrappedD3D9VertexDeclaration(new ReplayVertexDeclaration(elements.data(), count), device,
+                                                    IsPretransformedDeclaration(elements.data()));
+            break;
+        }
+        case TraceRecord_SetVertexDeclaration: {
+            if (size != sizeof(uint64_t)) {
+                malformed++;
+                break;
+            }
+            uint64_t key = 0;
+            memcpy(&key, data, sizeof(key));
+            auto it = declarations.find(key);
+            device->SetVertexDeclaration(it != declarations.end() ? it->second : nullptr);
+            break;
+        }
+        default:
+            malformed++;
+            break;
+        }
+    }
+    if (reader.Oversized()) {
+        malformed++;
+        LogMsg("Trace replay: record %llu (type %u) claims %u payload bytes, more than the %u allowed; stopping",
+               records + 1, static_cast<unsigned>(header.type), header.payloadBytes,
+               TraceMaxPayloadBytes(header.type));
+    }
+    const double elapsedMs = ProfilerTicksToMicros(ProfilerNow() - start) / 1000.0;
+
+    char summary[1024];
+    snprintf(summary, sizeof(summary),
+             "trace=%s\nrecords=%llu\nframes=%llu\nuploads=%llu\ndraws=%llu\nmalformed=%llu\n"
+             "transforms_emitted=%llu\ntransform_digest=0x%08X\n"
+             "layout_full_scans=%llu\nlayout_incremental_scans=%llu\nlayout_locked_uploads=%llu\n"
+             "layout_validation_failures=%llu\n"
+             "kernels=%s\nelapsed_ms=%.1f\n",
+             path, records, nullDevice->presentCount, uploads, draws, malformed,
+             nullDevice->transformCount, nullDevice->transformDigest,
+             static_cast<unsigned long long>(g_layoutFullScans),
+             static_cast<unsigned long long>(g_layoutIncrementalScans),
+             static_cast<unsigned long long>(g_layoutLockedUploads),
+             static_cast<unsigned long long>(g_layoutValidationFailures),
+             ActiveMatrixKernels().name, elapsedMs);
+    LogMsg("Trace replay complete:\n%s", summary);
+
+    char resultPath[MAX_PATH + 16];
+    snprintf(resultPath, sizeof(resultPath), "%s.replay.txt", path);
+    if (FILE* result = fopen(resultPath, "w")) {
+        fputs(summary, result);
+        fclose(result);
+    }
+
+    device->SetVertexShader(nullptr);
+    device->SetVertexDeclaration(nullptr);
+    device->Release();
+    for (auto& entry : shaders) {
+        entry.second->Release();
+    }
+    for (auto& entry : declarations) {
+        entry.second->Release();
+    }
+    for (ReplaySurface* surface : replaySurfaces) {
+        surface->Release();
+    }
+    g_traceReplayActive = false;
+    return malformed == 0;
+}
+
 // Exported functions - these are what the game calls
 // Named with Proxy_ prefix to avoid conflict with SDK declarations
 // The .def file maps these to the real export names
@@ -4063,6 +7455,21 @@ extern "C" {
         return &g_cameraMatrices;
     }
 
+    // rundll32 entry point: rundll32 <dir>\d3d9.dll,ReplayCameraTrace <trace file>
+    void CALLBACK Proxy_ReplayCameraTrace(HWND, HINSTANCE, LPSTR lpszCmdLine, int) {
+        char path[MAX_PATH] = {};
+        const char* src = lpszCmdLine ? lpszCmdLine : "";
+        while (*src == ' ' || *src == '"') {
+            src++;
+        }
+        snprintf(path, sizeof(path), "%s", src[0] ? src : g_config.traceCapturePath);
+        size_t len = strlen(path);
+        while (len > 0 && (path[len - 1] == ' ' || path[len - 1] == '"' || path[len - 1] == '\r' || path[len - 1] == '\n')) {
+            path[--len] = '\0';
+        }
+        ReplayCameraTrace(path);
+    }
+
     IDirect3D9* WINAPI Proxy_Direct3DCreate9(UINT SDKVersion) {
         LogMsg("Direct3DCreate9 called (SDK version: %d)", SDKVersion);
 
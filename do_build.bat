@@ -4,7 +4,7 @@ cd /d E:\Benchmarks\dmc4_camera_proxy
 echo Current directory: %CD% >> build_log.txt
 echo. >> build_log.txt
 echo Compiling... >> build_log.txt
-cl /LD /EHsc /O2 /MD d3d9_proxy.cpp /link /DEF:d3d9.def /OUT:d3d9.dll >> build_log.txt 2>&1
+cl /LD /EHsc /O2 /MD d3d9_proxy.cpp camera_reconstruction.cpp /link /DEF:d3d9.def /OUT:d3d9.dll >> build_log.txt 2>&1
 echo. >> build_log.txt
 echo Build exit code: %ERRORLEVEL% >> build_log.txt
 dir *.dll >> build_log.txt 2>&1
@@ -0,0 +1,183 @@
+/*
+ * On-disk cache of learned shader register layouts.
+ *
+ * One small binary file per game (camera_proxy_layouts.bin next to
+ * camera_proxy.ini) holding the locked LearnedUploadLayout entries and the
+ * overlay's manual matrix bindings, keyed by shader bytecode hash instead of the
+ * per-run interface pointer. The file is memory-mapped once, when the first
+ * device is created, to pre-seed the learned layouts before the first draw;
+ * seeded layouts are still validated against every upload, so a stale entry
+ * only costs one full scan. Saves are serialized on the render thread and
+ * written by a background thread.
+ *
+ * A cache is ignored when it was written for another executable (moduleHash)
+ * or with different classifier settings (settingsHash).
+ *
+ * Layout (little endian):
+ *   LayoutCacheFileHeader
+ *   LayoutCacheLayoutEntry[layoutCount]
+ *   LayoutCacheBindingEntry[bindingCount]
+ */
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char kLayoutCacheMagic[4] = { 'C', 'P', 'L', 'C' };
+static constexpr uint32_t kLayoutCacheVersion = 1;
+static constexpr int kLayoutCacheMaxWindows = 8;
+
+struct LayoutCacheFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t moduleHash;
+    uint32_t settingsHash;
+    uint32_t layoutCount;
+    uint32_t bindingCount;
+};
+
+struct LayoutCacheWindow {
+    uint8_t baseRegister;
+    uint8_t rows;
+    uint8_t orientation;
+    uint8_t classification;
+};
+
+struct LayoutCacheLayoutEntry {
+    uint32_t shaderHash;
+    uint16_t startRegister;
+    uint16_t vector4fCount;
+    uint32_t windowCount;
+    LayoutCacheWindow windows[kLayoutCacheMaxWindows];
+};
+
+struct LayoutCacheBindingEntry {
+    uint32_t slot;
+    uint32_t shaderHash;
+    int32_t baseRegister;
+    int32_t rows;
+};
+
+// Read-only view of a cache file; entries stay valid until Close().
+class MappedLayoutCache {
+public:
+    ~MappedLayoutCache() { Close(); }
+
+    // Maps path and checks magic, version, keys and size. Returns false (with
+    // nothing mapped) for a missing, foreign or truncated file.
+    bool Open(const char* path, uint32_t moduleHash, uint32_t settingsHash) {
+        Close();
+        m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            m_file = nullptr;
+            return false;
+        }
+        LARGE_INTEGER size = {};
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(LayoutCacheFileHeader)) ||
+            size.QuadPart > 64 * 1024 * 1024) {
+            Close();
+            return false;
+        }
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!m_view) {
+            Close();
+            return false;
+        }
+        const LayoutCacheFileHeader* header = Header();
+        const uint64_t expected = sizeof(LayoutCacheFileHeader) +
+                                  static_cast<uint64_t>(header->layoutCount) * sizeof(LayoutCacheLayoutEntry) +
+                                  static_cast<uint64_t>(header->bindingCount) * sizeof(LayoutCacheBindingEntry);
+        if (memcmp(header->magic, kLayoutCacheMagic, sizeof(header->magic)) != 0 ||
+            header->version != kLayoutCacheVersion ||
+            header->moduleHash != moduleHash ||
+            header->settingsHash != settingsHash ||
+            expected != static_cast<uint64_t>(size.QuadPart)) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (m_view) {
+            UnmapViewOfFile(m_view);
+            m_view = nullptr;
+        }
+        if (m_mapping) {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+        if (m_file) {
+            CloseHandle(m_file);
+            m_file = nullptr;
+        }
+    }
+
+    uint32_t LayoutCount() const { return m_view ? Header()->layoutCount : 0; }
+    uint32_t BindingCount() const { return m_view ? Header()->bindingCount : 0; }
+
+    const LayoutCacheLayoutEntry* Layouts() const {
+        return reinterpret_cast<const LayoutCacheLayoutEntry*>(Header() + 1);
+    }
+
+    const LayoutCacheBindingEntry* Bindings() const {
+        return reinterpret_cast<const LayoutCacheBindingEntry*>(Layouts() + LayoutCount());
+    }
+
+private:
+    const LayoutCacheFileHeader* Header() const {
+        return static_cast<const LayoutCacheFileHeader*>(m_view);
+    }
+
+    HANDLE m_file = nullptr;
+    HANDLE m_mapping = nullptr;
+    LPVOID m_view = nullptr;
+};
+
+// Builds the complete file image; cheap enough for the render thread.
+static inline std::vector<uint8_t> SerializeLayoutCache(uint32_t moduleHash,
+                                                        uint32_t settingsHash,
+                                                        const std::vector<LayoutCacheLayoutEntry>& layouts,
+                                                        const std::vector<LayoutCacheBindingEntry>& bindings) {
+    LayoutCacheFileHeader header = {};
+    memcpy(header.magic, kLayoutCacheMagic, sizeof(header.magic));
+    header.version = kLayoutCacheVersion;
+    header.moduleHash = moduleHash;
+    header.settingsHash = settingsHash;
+    header.layoutCount = static_cast<uint32_t>(layouts.size());
+    header.bindingCount = static_cast<uint32_t>(bindings.size());
+    const size_t layoutBytes = layouts.size() * sizeof(LayoutCacheLayoutEntry);
+    const size_t bindingBytes = bindings.size() * sizeof(LayoutCacheBindingEntry);
+    std::vector<uint8_t> bytes(sizeof(header) + layoutBytes + bindingBytes);
+    memcpy(bytes.data(), &header, sizeof(header));
+    if (layoutBytes > 0) {
+        memcpy(bytes.data() + sizeof(header), layouts.data(), layoutBytes);
+    }
+    if (bindingBytes > 0) {
+        memcpy(bytes.data() + sizeof(header) + layoutBytes, bindings.data(), bindingBytes);
+    }
+    return bytes;
+}
+
+// Writes a serialized cache to path.tmp and swaps it in, so a crash mid-write
+// never leaves a truncated cache behind.
+static inline bool WriteLayoutCacheBytes(const char* path, const std::vector<uint8_t>& bytes) {
+    char tempPath[MAX_PATH + 8];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE* file = fopen(tempPath, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = bytes.empty() || fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || !MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileA(tempPath);
+        return false;
+    }
+    return true;
+}
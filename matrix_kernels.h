@@ -0,0 +1,330 @@
+/**
+ * SSE2 matrix kernels for the camera proxy.
+ *
+ * Every kernel here mirrors a scalar reference in camera_reconstruction.cpp.
+ * Unless noted otherwise it evaluates the same IEEE operations in the same order,
+ * lane by lane, so results are bit-identical to the scalar path on an SSE2 float
+ * pipeline (the MSVC x86 default). Do not build this file with FMA contraction
+ * enabled. Exceptions: LooksLikeMatrixSSE2 (summation order) and
+ * InvertMatrix4x4SSE2 (sign of exact zeros), both documented below.
+ *
+ * The proxy selects between the scalar and SSE2 tables at startup (see
+ * SelectMatrixKernels in camera_reconstruction.cpp). SSE2 is the baseline for the
+ * 32-bit build; AVX is detected for reporting only, since 4x4 float kernels gain
+ * nothing from 8-wide registers without batching several matrices per call.
+ */
+#pragma once
+
+#include <windows.h>
+#include <d3d9types.h>
+#include <emmintrin.h>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+struct CpuFeatures {
+    bool sse2 = false;
+    bool avx = false;
+};
+
+static inline CpuFeatures DetectCpuFeatures() {
+    CpuFeatures features = {};
+    unsigned int ecx = 0;
+    unsigned int edx = 0;
+#if defined(_MSC_VER)
+    int regs[4] = {};
+    __cpuid(regs, 1);
+    ecx = static_cast<unsigned int>(regs[2]);
+    edx = static_cast<unsigned int>(regs[3]);
+#else
+    unsigned int eax = 0;
+    unsigned int ebx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return features;
+    }
+#endif
+    features.sse2 = (edx & (1u << 26)) != 0;
+    // AVX needs both the CPU bit and OS support for saving YMM state (OSXSAVE + XCR0).
+    const bool osxsave = (ecx & (1u << 27)) != 0;
+    if (osxsave && (ecx & (1u << 28)) != 0) {
+#if defined(_MSC_VER)
+        const unsigned long long xcr0 = _xgetbv(0);
+#else
+        unsigned int xcr0Lo = 0;
+        unsigned int xcr0Hi = 0;
+        __asm__ volatile("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+        const unsigned long long xcr0 = (static_cast<unsigned long long>(xcr0Hi) << 32) | xcr0Lo;
+#endif
+        features.avx = (xcr0 & 0x6) == 0x6;
+    }
+    return features;
+}
+
+static inline __m128 LoadMatrixRow(const D3DMATRIX& m, int row) {
+    return _mm_loadu_ps(reinterpret_cast<const float*>(&m) + row * 4);
+}
+
+static inline void StoreMatrixRow(D3DMATRIX* m, int row, __m128 value) {
+    _mm_storeu_ps(reinterpret_cast<float*>(m) + row * 4, value);
+}
+
+static inline __m128 AbsPs(__m128 v) {
+    return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+}
+
+// out.row(i) = ((a_i1*b.row1 + a_i2*b.row2) + a_i3*b.row3) + a_i4*b.row4, the scalar order.
+static inline D3DMATRIX MultiplyMatrixSSE2(const D3DMATRIX& a, const D3DMATRIX& b) {
+    const __m128 b0 = LoadMatrixRow(b, 0);
+    const __m128 b1 = LoadMatrixRow(b, 1);
+    const __m128 b2 = LoadMatrixRow(b, 2);
+    const __m128 b3 = LoadMatrixRow(b, 3);
+    const float* av = reinterpret_cast<const float*>(&a);
+    D3DMATRIX out;
+    for (int row = 0; row < 4; row++) {
+        const float* ar = av + row * 4;
+        __m128 r = _mm_mul_ps(_mm_set1_ps(ar[0]), b0);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(ar[1]), b1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(ar[2]), b2));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(ar[3]), b3));
+        StoreMatrixRow(&out, row, r);
+    }
+    return out;
+}
+
+static inline D3DMATRIX TransposeMatrixSSE2(const D3DMATRIX& m) {
+    __m128 r0 = LoadMatrixRow(m, 0);
+    __m128 r1 = LoadMatrixRow(m, 1);
+    __m128 r2 = LoadMatrixRow(m, 2);
+    __m128 r3 = LoadMatrixRow(m, 3);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    D3DMATRIX out;
+    StoreMatrixRow(&out, 0, r0);
+    StoreMatrixRow(&out, 1, r1);
+    StoreMatrixRow(&out, 2, r2);
+    StoreMatrixRow(&out, 3, r3);
+    return out;
+}
+
+// Finite test is exact. The abs sum is accumulated in four lanes rather than left to
+// right, so it can differ from the scalar sum by a few ulp; the verdict can only
+// differ when the sum lands within ~1e-6 relative of the 0.001 / 10000 bounds.
+static inline bool LooksLikeMatrixSSE2(const float* data) {
+    const __m128i expMask = _mm_set1_epi32(0x7F800000);
+    __m128 sum = _mm_setzero_ps();
+    int nonFinite = 0;
+    for (int i = 0; i < 16; i += 4) {
+        const __m128 v = _mm_loadu_ps(data + i);
+        const __m128i bits = _mm_and_si128(_mm_castps_si128(v), expMask);
+        nonFinite |= _mm_movemask_epi8(_mm_cmpeq_epi32(bits, expMask));
+        sum = _mm_add_ps(sum, AbsPs(v));
+    }
+    if (nonFinite) {
+        return false;
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    const float total = _mm_cvtss_f32(sum);
+    return !(total < 0.001f || total > 10000.0f);
+}
+
+// Lane i of the result holds Dot3(a_i, b_i) = (ax*bx + ay*by) + az*bz for four row pairs.
+static inline __m128 Dot3x4SSE2(__m128 a0, __m128 b0, __m128 a1, __m128 b1,
+                                __m128 a2, __m128 b2, __m128 a3, __m128 b3) {
+    __m128 p0 = _mm_mul_ps(a0, b0);
+    __m128 p1 = _mm_mul_ps(a1, b1);
+    __m128 p2 = _mm_mul_ps(a2, b2);
+    __m128 p3 = _mm_mul_ps(a3, b3);
+    _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+    return _mm_add_ps(_mm_add_ps(p0, p1), p2);
+}
+
+// Same checks and thresholds as LooksLikeViewStrict; the six Dot3 terms and three
+// row lengths are computed four at a time with identical per-lane arithmetic.
+static inline bool LooksLikeViewStrictSSE2(const D3DMATRIX& m) {
+    const __m128 r0 = LoadMatrixRow(m, 0);
+    const __m128 r1 = LoadMatrixRow(m, 1);
+    const __m128 r2 = LoadMatrixRow(m, 2);
+
+    const __m128 lengths = _mm_sqrt_ps(Dot3x4SSE2(r0, r0, r1, r1, r2, r2, r0, r0));
+    const __m128 lengthError = AbsPs(_mm_sub_ps(lengths, _mm_set1_ps(1.0f)));
+    if (_mm_movemask_ps(_mm_cmpgt_ps(lengthError, _mm_set1_ps(0.05f))) & 0x7) {
+        return false;
+    }
+
+    const __m128 cross = AbsPs(Dot3x4SSE2(r0, r1, r0, r2, r1, r2, r0, r1));
+    if (_mm_movemask_ps(_mm_cmpgt_ps(cross, _mm_set1_ps(0.05f))) & 0x7) {
+        return false;
+    }
+
+    if (fabsf(m._14) > 0.01f || fabsf(m._24) > 0.01f || fabsf(m._34) > 0.01f) return false;
+    if (fabsf(m._44 - 1.0f) > 0.01f) return false;
+
+    const float det = m._11 * (m._22 * m._33 - m._23 * m._32) -
+                      m._12 * (m._21 * m._33 - m._23 * m._31) +
+                      m._13 * (m._21 * m._32 - m._22 * m._31);
+    return fabsf(det - 1.0f) <= 0.1f;
+}
+
+// True when |_12|,|_13|,|_21|,|_23|,|_31|,|_32|,|_14|,|_24| are all <= epsilon
+// (NaN passes, matching the scalar `fabsf(x) > eps` rejections).
+static inline bool ProjectionOffDiagonalWithinSSE2(const D3DMATRIX& m, float epsilon) {
+    const __m128 eps = _mm_set1_ps(epsilon);
+    // Row 0 lanes 1-3 (_12,_13,_14), row 1 lanes 0,2,3 (_21,_23,_24), row 2 lanes 0-1 (_31,_32).
+    const int r0 = _mm_movemask_ps(_mm_cmpgt_ps(AbsPs(LoadMatrixRow(m, 0)), eps)) & 0xE;
+    const int r1 = _mm_movemask_ps(_mm_cmpgt_ps(AbsPs(LoadMatrixRow(m, 1)), eps)) & 0xD;
+    const int r2 = _mm_movemask_ps(_mm_cmpgt_ps(AbsPs(LoadMatrixRow(m, 2)), eps)) & 0x3;
+    return (r0 | r1 | r2) == 0;
+}
+
+// Cofactor operands for InvertMatrix4x4Deterministic, one row per output group of
+// four, one column per lane: inv[k] = sign[k] * (((((T0 - T1) - T2) + T3) + T4) - T5)
+// with Tn = (m[a] * m[b]) * m[c]. This is the scalar expansion with the leading sign
+// factored out, which IEEE negation makes exact; the only observable difference is
+// that an exactly-cancelling cofactor can come out as -0.0f instead of +0.0f.
+static const uint8_t kInverseCofactorTerms[4][6][4][3] = {
+    // inv[0..3]
+    { { { 5, 10, 15}, { 1, 10, 15}, { 1,  6, 15}, { 1,  6, 11} },
+      { { 5, 11, 14}, { 1, 11, 14}, { 1,  7, 14}, { 1,  7, 10} },
+      { { 9,  6, 15}, { 9,  2, 15}, { 5,  2, 15}, { 5,  2, 11} },
+      { { 9,  7, 14}, { 9,  3, 14}, { 5,  3, 14}, { 5,  3, 10} },
+      { {13,  6, 11}, {13,  2, 11}, {13,  2,  7}, { 9,  2,  7} },
+      { {13,  7, 10}, {13,  3, 10}, {13,  3,  6}, { 9,  3,  6} } },
+    // inv[4..7]
+    { { { 4, 10, 15}, { 0, 10, 15}, { 0,  6, 15}, { 0,  6, 11} },
+      { { 4, 11, 14}, { 0, 11, 14}, { 0,  7, 14}, { 0,  7, 10} },
+      { { 8,  6, 15}, { 8,  2, 15}, { 4,  2, 15}, { 4,  2, 11} },
+      { { 8,  7, 14}, { 8,  3, 14}, { 4,  3, 14}, { 4,  3, 10} },
+      { {12,  6, 11}, {12,  2, 11}, {12,  2,  7}, { 8,  2,  7} },
+      { {12,  7, 10}, {12,  3, 10}, {12,  3,  6}, { 8,  3,  6} } },
+    // inv[8..11]
+    { { { 4,  9, 15}, { 0,  9, 15}, { 0,  5, 15}, { 0,  5, 11} },
+      { { 4, 11, 13}, { 0, 11, 13}, { 0,  7, 13}, { 0,  7,  9} },
+      { { 8,  5, 15}, { 8,  1, 15}, { 4,  1, 15}, { 4,  1, 11} },
+      { { 8,  7, 13}, { 8,  3, 13}, { 4,  3, 13}, { 4,  3,  9} },
+      { {12,  5, 11}, {12,  1, 11}, {12,  1,  7}, { 8,  1,  7} },
+      { {12,  7,  9}, {12,  3,  9}, {12,  3,  5}, { 8,  3,  5} } },
+    // inv[12..15]
+    { { { 4,  9, 14}, { 0,  9, 14}, { 0,  5, 14}, { 0,  5, 10} },
+      { { 4, 10, 13}, { 0, 10, 13}, { 0,  6, 13}, { 0,  6,  9} },
+      { { 8,  5, 14}, { 8,  1, 14}, { 4,  1, 14}, { 4,  1, 10} },
+      { { 8,  6, 13}, { 8,  2, 13}, { 4,  2, 13}, { 4,  2,  9} },
+      { {12,  5, 10}, {12,  1, 10}, {12,  1,  6}, { 8,  1,  6} },
+      { {12,  6,  9}, {12,  2,  9}, {12,  2,  5}, { 8,  2,  5} } },
+};
+
+static inline __m128 GatherCofactorOperand(const float* m, const uint8_t (*lanes)[3], int factor) {
+    return _mm_setr_ps(m[lanes[0][factor]], m[lanes[1][factor]], m[lanes[2][factor]], m[lanes[3][factor]]);
+}
+
+static inline bool InvertMatrix4x4SSE2(const D3DMATRIX& in, D3DMATRIX* out, float* outDeterminant) {
+    if (!out) {
+        return false;
+    }
+    const float* m = reinterpret_cast<const float*>(&in);
+    // Output groups alternate +,-,+,- and -,+,-,+ across lanes.
+    const __m128 signEven = _mm_castsi128_ps(_mm_setr_epi32(0, static_cast<int>(0x80000000u), 0, static_cast<int>(0x80000000u)));
+    const __m128 signOdd = _mm_castsi128_ps(_mm_setr_epi32(static_cast<int>(0x80000000u), 0, static_cast<int>(0x80000000u), 0));
+
+    __m128 inv[4];
+    for (int group = 0; group < 4; group++) {
+        __m128 terms[6];
+        for (int t = 0; t < 6; t++) {
+            const uint8_t (*lanes)[3] = kInverseCofactorTerms[group][t];
+            terms[t] = _mm_mul_ps(_mm_mul_ps(GatherCofactorOperand(m, lanes, 0),
+                                             GatherCofactorOperand(m, lanes, 1)),
+                                  GatherCofactorOperand(m, lanes, 2));
+        }
+        __m128 acc = _mm_sub_ps(terms[0], terms[1]);
+        acc = _mm_sub_ps(acc, terms[2]);
+        acc = _mm_add_ps(acc, terms[3]);
+        acc = _mm_add_ps(acc, terms[4]);
+        acc = _mm_sub_ps(acc, terms[5]);
+        inv[group] = _mm_xor_ps(acc, (group & 1) ? signOdd : signEven);
+    }
+
+    // det = m0*inv0 + m1*inv4 + m2*inv8 + m3*inv12, summed left to right as in the scalar path.
+    const float det = m[0] * _mm_cvtss_f32(inv[0]) + m[1] * _mm_cvtss_f32(inv[1]) +
+                      m[2] * _mm_cvtss_f32(inv[2]) + m[3] * _mm_cvtss_f32(inv[3]);
+    if (outDeterminant) {
+        *outDeterminant = det;
+    }
+    if (fabsf(det) <= 1e-8f) {
+        return false;
+    }
+
+    const __m128 detInv = _mm_set1_ps(1.0f / det);
+    for (int group = 0; group < 4; group++) {
+        StoreMatrixRow(out, group, _mm_mul_ps(inv[group], detInv));
+    }
+    return true;
+}
+
+// Scalar-order Dot3 on the xyz lanes of two rows: (ax*bx + ay*by) + az*bz.
+static inline float Dot3RowSSE2(__m128 a, __m128 b) {
+    const __m128 p = _mm_mul_ps(a, b);
+    const __m128 xy = _mm_add_ss(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(_mm_add_ss(xy, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+// Gram-Schmidt on rows 0/1 plus cross product, matching OrthonormalizeViewMatrix
+// operation for operation (lane-wise divides, multiplies and subtracts).
+static inline void OrthonormalizeViewMatrixSSE2(D3DMATRIX* view) {
+    if (!view) {
+        return;
+    }
+    const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    __m128 r0 = _mm_and_ps(LoadMatrixRow(*view, 0), xyzMask);
+    __m128 r1 = _mm_and_ps(LoadMatrixRow(*view, 1), xyzMask);
+
+    const float len0 = sqrtf(Dot3RowSSE2(r0, r0));
+    if (len0 > 1e-6f) {
+        r0 = _mm_and_ps(_mm_div_ps(r0, _mm_set1_ps(len0)), xyzMask);
+    }
+
+    const float dot01 = Dot3RowSSE2(r1, r0);
+    r1 = _mm_sub_ps(r1, _mm_mul_ps(_mm_set1_ps(dot01), r0));
+
+    const float len1 = sqrtf(Dot3RowSSE2(r1, r1));
+    if (len1 > 1e-6f) {
+        r1 = _mm_and_ps(_mm_div_ps(r1, _mm_set1_ps(len1)), xyzMask);
+    }
+
+    // r2 = (r0.y*r1.z - r0.z*r1.y, r0.z*r1.x - r0.x*r1.z, r0.x*r1.y - r0.y*r1.x)
+    const __m128 r0yzx = _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 r1yzx = _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 r0zxy = _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(3, 1, 0, 2));
+    const __m128 r1zxy = _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(3, 1, 0, 2));
+    const __m128 r2 = _mm_sub_ps(_mm_mul_ps(r0yzx, r1zxy), _mm_mul_ps(r0zxy, r1yzx));
+
+    StoreMatrixRow(view, 0, r0);
+    StoreMatrixRow(view, 1, r1);
+    StoreMatrixRow(view, 2, _mm_and_ps(r2, xyzMask));
+    view->_44 = 1.0f;
+}
+
+// Memory scanner prefilter. Per float: bit 0 = |x| <= 10000 (clear for NaN/Inf),
+// bit 1 = |x| >= 0.00005. A 16-float window can only pass LooksLikeMatrix when
+// every flag has bit 0 and at least one has bit 1 (16 * 0.00005 < 0.001).
+static inline void ClassifyScanFloatsSSE2(const float* data, size_t count, uint8_t* flags) {
+    const __m128 maxMagnitude = _mm_set1_ps(10000.0f);
+    const __m128 minMagnitude = _mm_set1_ps(0.00005f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 a = AbsPs(_mm_loadu_ps(data + i));
+        const int inRange = _mm_movemask_ps(_mm_cmple_ps(a, maxMagnitude));
+        const int significant = _mm_movemask_ps(_mm_cmpge_ps(a, minMagnitude));
+        for (int k = 0; k < 4; ++k) {
+            flags[i + k] = static_cast<uint8_t>(((inRange >> k) & 1) | (((significant >> k) & 1) << 1));
+        }
+    }
+    for (; i < count; ++i) {
+        const float a = fabsf(data[i]);
+        flags[i] = static_cast<uint8_t>((a <= 10000.0f ? 1 : 0) | (a >= 0.00005f ? 2 : 0));
+    }
+}
@@ -0,0 +1,324 @@
+/*
+ * GPU-less IDirect3DDevice9 used to replay captured traces (see constant_trace.h).
+ *
+ * Every method succeeds or reports D3DERR_NOTAVAILABLE without touching
+ * hardware. The few calls replay depends on keep state: SetViewport/GetViewport
+ * remember the viewport so aspect-dependent paths behave as in the game, and
+ * SetTransform folds every emitted matrix into a digest that regression runs
+ * can compare between builds.
+ */
+#pragma once
+
+#include <windows.h>
+#include <d3d9.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Stand-in for a game vertex shader: only GetFunction is meaningful, which is
+// what the proxy uses to hash and parse bytecode it did not see created.
+class ReplayVertexShader : public IDirect3DVertexShader9 {
+public:
+    ReplayVertexShader(const void* bytecode, size_t size)
+        : m_bytecode(static_cast<const uint8_t*>(bytecode), static_cast<const uint8_t*>(bytecode) + size) {}
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppvObj) override {
+        if (ppvObj) *ppvObj = nullptr;
+        return E_NOINTERFACE;
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = --m_refCount;
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override {
+        if (ppDevice) *ppDevice = nullptr;
+        return D3DERR_NOTAVAILABLE;
+    }
+    HRESULT STDMETHODCALLTYPE GetFunction(void* pData, UINT* pSizeOfData) override {
+        if (!pSizeOfData) {
+            return D3DERR_INVALIDCALL;
+        }
+        if (pData) {
+            if (*pSizeOfData < m_bytecode.size()) {
+                return D3DERR_INVALIDCALL;
+            }
+            memcpy(pData, m_bytecode.data(), m_bytecode.size());
+        }
+        *pSizeOfData = static_cast<UINT>(m_bytecode.size());
+        return D3D_OK;
+    }
+
+private:
+    std::vector<uint8_t> m_bytecode;
+    ULONG m_refCount = 1;
+};
+
+// Stand-in for a game render target or depth-stencil surface: only GetDesc is
+// meaningful, which is what the render pass tracker reads.
+class ReplaySurface : public IDirect3DSurface9 {
+public:
+    explicit ReplaySurface(const D3DSURFACE_DESC& desc) : m_desc(desc) {}
+
+    const D3DSURFACE_DESC& Desc() const { return m_desc; }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppvObj) override {
+        if (ppvObj) *ppvObj = nullptr;
+        return E_NOINTERFACE;
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = --m_refCount;
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override {
+        if (ppDevice) *ppDevice = nullptr;
+        return D3DERR_NOTAVAILABLE;
+    }
+    HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, const void*, DWORD, DWORD) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, void*, DWORD*) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE FreePrivateData(REFGUID) override { return D3DERR_NOTAVAILABLE; }
+    DWORD STDMETHODCALLTYPE SetPriority(DWORD) override { return 0; }
+    DWORD STDMETHODCALLTYPE GetPriority() override { return 0; }
+    void STDMETHODCALLTYPE PreLoad() override {}
+    D3DRESOURCETYPE STDMETHODCALLTYPE GetType() override { return D3DRTYPE_SURFACE; }
+    HRESULT STDMETHODCALLTYPE GetContainer(REFIID, void** ppContainer) override {
+        if (ppContainer) *ppContainer = nullptr;
+        return E_NOINTERFACE;
+    }
+    HRESULT STDMETHODCALLTYPE GetDesc(D3DSURFACE_DESC* pDesc) override {
+        if (!pDesc) {
+            return D3DERR_INVALIDCALL;
+        }
+        *pDesc = m_desc;
+        return D3D_OK;
+    }
+    HRESULT STDMETHODCALLTYPE LockRect(D3DLOCKED_RECT*, const RECT*, DWORD) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE UnlockRect() override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE GetDC(HDC*) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE ReleaseDC(HDC) override { return D3DERR_NOTAVAILABLE; }
+
+private:
+    D3DSURFACE_DESC m_desc;
+    ULONG m_refCount = 1;
+};
+
+// Stand-in for a game vertex declaration: GetDeclaration returns the captured
+// elements, which is how the proxy detects POSITIONT input.
+class ReplayVertexDeclaration : public IDirect3DVertexDeclaration9 {
+public:
+    ReplayVertexDeclaration(const D3DVERTEXELEMENT9* elements, size_t count)
+        : m_elements(elements, elements + count) {}
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppvObj) override {
+        if (ppvObj) *ppvObj = nullptr;
+        return E_NOINTERFACE;
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = --m_refCount;
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE GetDevice(IDirect3DDevice9** ppDevice) override {
+        if (ppDevice) *ppDevice = nullptr;
+        return D3DERR_NOTAVAILABLE;
+    }
+    HRESULT STDMETHODCALLTYPE GetDeclaration(D3DVERTEXELEMENT9* pElement, UINT* pNumElements) override {
+        if (!pNumElements) {
+            return D3DERR_INVALIDCALL;
+        }
+        if (pElement) {
+            memcpy(pElement, m_elements.data(), m_elements.size() * sizeof(D3DVERTEXELEMENT9));
+        }
+        *pNumElements = static_cast<UINT>(m_elements.size());
+        return D3D_OK;
+    }
+
+private:
+    std::vector<D3DVERTEXELEMENT9> m_elements;
+    ULONG m_refCount = 1;
+};
+
+class NullD3D9Device : public IDirect3DDevice9 {
+public:
+    unsigned long long transformCount = 0;
+    unsigned long long presentCount = 0;
+    uint32_t transformDigest = 2166136261u;
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppvObj) override {
+        if (ppvObj) *ppvObj = nullptr;
+        return E_NOINTERFACE;
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = --m_refCount;
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+    HRESULT STDMETHODCALLTYPE SetVertexShaderConstantF(UINT, const float*, UINT) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE Present(const RECT*, const RECT*, HWND, const RGNDATA*) override {
+        presentCount++;
+        return D3D_OK;
+    }
+    HRESULT STDMETHODCALLTYPE BeginScene() override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE SetTransform(D3DTRANSFORMSTATETYPE State, const D3DMATRIX* pMatrix) override {
+        if (!pMatrix) {
+            return D3DERR_INVALIDCALL;
+        }
+        // FNV-1a over (state, matrix bits) in call order.
+        const uint32_t state = static_cast<uint32_t>(State);
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&state);
+        for (size_t i = 0; i < sizeof(state); ++i) {
+            transformDigest = (transformDigest ^ bytes[i]) * 16777619u;
+        }
+        bytes = reinterpret_cast<const uint8_t*>(pMatrix);
+        for (size_t i = 0; i < sizeof(D3DMATRIX); ++i) {
+            transformDigest = (transformDigest ^ bytes[i]) * 16777619u;
+        }
+        transformCount++;
+        return D3D_OK;
+    }
+    HRESULT STDMETHODCALLTYPE SetViewport(const D3DVIEWPORT9* pViewport) override {
+        if (!pViewport) {
+            return D3DERR_INVALIDCALL;
+        }
+        m_viewport = *pViewport;
+        m_hasViewport = true;
+        return D3D_OK;
+    }
+    HRESULT STDMETHODCALLTYPE GetViewport(D3DVIEWPORT9* pViewport) override {
+        if (!pViewport || !m_hasViewport) {
+            return D3DERR_INVALIDCALL;
+        }
+        *pViewport = m_viewport;
+        return D3D_OK;
+    }
+
+    // Everything below is inert.
+    HRESULT STDMETHODCALLTYPE TestCooperativeLevel() override { return D3D_OK; }
+    UINT STDMETHODCALLTYPE GetAvailableTextureMem() override { return 0; }
+    HRESULT STDMETHODCALLTYPE EvictManagedResources() override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetDirect3D(IDirect3D9** ppD3D9) override { if (ppD3D9) *ppD3D9 = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE GetDeviceCaps(D3DCAPS9* pCaps) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE GetDisplayMode(UINT iSwapChain, D3DDISPLAYMODE* pMode) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE GetCreationParameters(D3DDEVICE_CREATION_PARAMETERS* pParameters) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetCursorProperties(UINT XHotSpot, UINT YHotSpot, IDirect3DSurface9* pCursorBitmap) override { return D3D_OK; }
+    void STDMETHODCALLTYPE SetCursorPosition(int X, int Y, DWORD Flags) override {}
+    BOOL STDMETHODCALLTYPE ShowCursor(BOOL bShow) override { return FALSE; }
+    HRESULT STDMETHODCALLTYPE CreateAdditionalSwapChain(D3DPRESENT_PARAMETERS* pPresentationParameters, IDirect3DSwapChain9** pSwapChain) override { if (pSwapChain) *pSwapChain = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE GetSwapChain(UINT iSwapChain, IDirect3DSwapChain9** pSwapChain) override { if (pSwapChain) *pSwapChain = nullptr; return D3DERR_NOTAVAILABLE; }
+    UINT STDMETHODCALLTYPE GetNumberOfSwapChains() override { return 0; }
+    HRESULT STDMETHODCALLTYPE Reset(D3DPRESENT_PARAMETERS* pPresentationParameters) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetBackBuffer(UINT iSwapChain, UINT iBackBuffer, D3DBACKBUFFER_TYPE Type, IDirect3DSurface9** ppBackBuffer) override { if (ppBackBuffer) *ppBackBuffer = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE GetRasterStatus(UINT iSwapChain, D3DRASTER_STATUS* pRasterStatus) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetDialogBoxMode(BOOL bEnableDialogs) override { return D3D_OK; }
+    void STDMETHODCALLTYPE SetGammaRamp(UINT iSwapChain, DWORD Flags, const D3DGAMMARAMP* pRamp) override {}
+    void STDMETHODCALLTYPE GetGammaRamp(UINT iSwapChain, D3DGAMMARAMP* pRamp) override {}
+    HRESULT STDMETHODCALLTYPE CreateTexture(UINT Width, UINT Height, UINT Levels, DWORD Usage, D3DFORMAT Format, D3DPOOL Pool, IDirect3DTexture9** ppTexture, HANDLE* pSharedHandle) override { if (ppTexture) *ppTexture = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE CreateVolumeTexture(UINT Width, UINT Height, UINT Depth, UINT Levels, DWORD Usage, D3DFORMAT Format, D3DPOOL Pool, IDirect3DVolumeTexture9** ppVolumeTexture, HANDLE* pSharedHandle) override { if (ppVolumeTexture) *ppVolumeTexture = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE CreateCubeTexture(UINT EdgeLength, UINT Levels, DWORD Usage, D3DFORMAT Format, D3DPOOL Pool, IDirect3DCubeTexture9** ppCubeTexture, HANDLE* pSharedHandle) override { if (ppCubeTexture) *ppCubeTexture = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE CreateVertexBuffer(UINT Length, DWORD Usage, DWORD FVF, D3DPOOL Pool, IDirect3DVertexBuffer9** ppVertexBuffer, HANDLE* pSharedHandle) override { if (ppVertexBuffer) *ppVertexBuffer = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE CreateIndexBuffer(UINT Length, DWORD Usage, D3DFORMAT Format, D3DPOOL Pool, IDirect3DIndexBuffer9** ppIndexBuffer, HANDLE* pSharedHandle) override { if (ppIndexBuffer) *ppIndexBuffer = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE CreateRenderTarget(UINT Width, UINT Height, D3DFORMAT Format, D3DMULTISAMPLE_TYPE MultiSample, DWORD MultisampleQuality, BOOL Lockable, IDirect3DSurface9** ppSurface, HANDLE* pSharedHandle) override { if (ppSurface) *ppSurface = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE CreateDepthStencilSurface(UINT Width, UINT Height, D3DFORMAT Format, D3DMULTISAMPLE_TYPE MultiSample, DWORD MultisampleQuality, BOOL Discard, IDirect3DSurface9** ppSurface, HANDLE* pSharedHandle) override { if (ppSurface) *ppSurface = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE UpdateSurface(IDirect3DSurface9* pSourceSurface, const RECT* pSourceRect, IDirect3DSurface9* pDestinationSurface, const POINT* pDestPoint) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE UpdateTexture(IDirect3DBaseTexture9* pSourceTexture, IDirect3DBaseTexture9* pDestinationTexture) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetRenderTargetData(IDirect3DSurface9* pRenderTarget, IDirect3DSurface9* pDestSurface) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE GetFrontBufferData(UINT iSwapChain, IDirect3DSurface9* pDestSurface) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE StretchRect(IDirect3DSurface9* pSourceSurface, const RECT* pSourceRect, IDirect3DSurface9* pDestSurface, const RECT* pDestRect, D3DTEXTUREFILTERTYPE Filter) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE ColorFill(IDirect3DSurface9* pSurface, const RECT* pRect, D3DCOLOR color) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE CreateOffscreenPlainSurface(UINT Width, UINT Height, D3DFORMAT Format, D3DPOOL Pool, IDirect3DSurface9** ppSurface, HANDLE* pSharedHandle) override { if (ppSurface) *ppSurface = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetRenderTarget(DWORD RenderTargetIndex, IDirect3DSurface9* pRenderTarget) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetRenderTarget(DWORD RenderTargetIndex, IDirect3DSurface9** ppRenderTarget) override { if (ppRenderTarget) *ppRenderTarget = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetDepthStencilSurface(IDirect3DSurface9* pNewZStencil) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetDepthStencilSurface(IDirect3DSurface9** ppZStencilSurface) override { if (ppZStencilSurface) *ppZStencilSurface = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE EndScene() override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE Clear(DWORD Count, const D3DRECT* pRects, DWORD Flags, D3DCOLOR Color, float Z, DWORD Stencil) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetTransform(D3DTRANSFORMSTATETYPE State, D3DMATRIX* pMatrix) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE MultiplyTransform(D3DTRANSFORMSTATETYPE State, const D3DMATRIX* pMatrix) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE SetMaterial(const D3DMATERIAL9* pMaterial) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetMaterial(D3DMATERIAL9* pMaterial) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetLight(DWORD Index, const D3DLIGHT9* pLight) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetLight(DWORD Index, D3DLIGHT9* pLight) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE LightEnable(DWORD Index, BOOL Enable) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetLightEnable(DWORD Index, BOOL* pEnable) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetClipPlane(DWORD Index, const float* pPlane) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetClipPlane(DWORD Index, float* pPlane) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetRenderState(D3DRENDERSTATETYPE State, DWORD Value) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetRenderState(D3DRENDERSTATETYPE State, DWORD* pValue) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE CreateStateBlock(D3DSTATEBLOCKTYPE Type, IDirect3DStateBlock9** ppSB) override { if (ppSB) *ppSB = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE BeginStateBlock() override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE EndStateBlock(IDirect3DStateBlock9** ppSB) override { if (ppSB) *ppSB = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetClipStatus(const D3DCLIPSTATUS9* pClipStatus) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetClipStatus(D3DCLIPSTATUS9* pClipStatus) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE GetTexture(DWORD Stage, IDirect3DBaseTexture9** ppTexture) override { if (ppTexture) *ppTexture = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetTexture(DWORD Stage, IDirect3DBaseTexture9* pTexture) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetTextureStageState(DWORD Stage, D3DTEXTURESTAGESTATETYPE Type, DWORD* pValue) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetTextureStageState(DWORD Stage, D3DTEXTURESTAGESTATETYPE Type, DWORD Value) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetSamplerState(DWORD Sampler, D3DSAMPLERSTATETYPE Type, DWORD* pValue) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetSamplerState(DWORD Sampler, D3DSAMPLERSTATETYPE Type, DWORD Value) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE ValidateDevice(DWORD* pNumPasses) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetPaletteEntries(UINT PaletteNumber, const PALETTEENTRY* pEntries) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetPaletteEntries(UINT PaletteNumber, PALETTEENTRY* pEntries) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetCurrentTexturePalette(UINT PaletteNumber) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetCurrentTexturePalette(UINT* PaletteNumber) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetScissorRect(const RECT* pRect) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetScissorRect(RECT* pRect) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetSoftwareVertexProcessing(BOOL bSoftware) override { return D3D_OK; }
+    BOOL STDMETHODCALLTYPE GetSoftwareVertexProcessing() override { return FALSE; }
+    HRESULT STDMETHODCALLTYPE SetNPatchMode(float nSegments) override { return D3D_OK; }
+    float STDMETHODCALLTYPE GetNPatchMode() override { return 0.0f; }
+    HRESULT STDMETHODCALLTYPE DrawPrimitive(D3DPRIMITIVETYPE PrimitiveType, UINT StartVertex, UINT PrimitiveCount) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE DrawIndexedPrimitive(D3DPRIMITIVETYPE PrimitiveType, INT BaseVertexIndex, UINT MinVertexIndex, UINT NumVertices, UINT startIndex, UINT primCount) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE DrawPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType, UINT PrimitiveCount, const void* pVertexStreamZeroData, UINT VertexStreamZeroStride) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE DrawIndexedPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType, UINT MinVertexIndex, UINT NumVertices, UINT PrimitiveCount, const void* pIndexData, D3DFORMAT IndexDataFormat, const void* pVertexStreamZeroData, UINT VertexStreamZeroStride) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE ProcessVertices(UINT SrcStartIndex, UINT DestIndex, UINT VertexCount, IDirect3DVertexBuffer9* pDestBuffer, IDirect3DVertexDeclaration9* pVertexDecl, DWORD Flags) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE CreateVertexDeclaration(const D3DVERTEXELEMENT9* pVertexElements, IDirect3DVertexDeclaration9** ppDecl) override { if (ppDecl) *ppDecl = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetVertexDeclaration(IDirect3DVertexDeclaration9** ppDecl) override { if (ppDecl) *ppDecl = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetFVF(DWORD FVF) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetFVF(DWORD* pFVF) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE CreateVertexShader(const DWORD* pFunction, IDirect3DVertexShader9** ppShader) override { if (ppShader) *ppShader = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetVertexShader(IDirect3DVertexShader9* pShader) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetVertexShader(IDirect3DVertexShader9** ppShader) override { if (ppShader) *ppShader = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE GetVertexShaderConstantF(UINT StartRegister, float* pConstantData, UINT Vector4fCount) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetVertexShaderConstantI(UINT StartRegister, const int* pConstantData, UINT Vector4iCount) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetVertexShaderConstantI(UINT StartRegister, int* pConstantData, UINT Vector4iCount) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetVertexShaderConstantB(UINT StartRegister, const BOOL* pConstantData, UINT BoolCount) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetVertexShaderConstantB(UINT StartRegister, BOOL* pConstantData, UINT BoolCount) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetStreamSource(UINT StreamNumber, IDirect3DVertexBuffer9* pStreamData, UINT OffsetInBytes, UINT Stride) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetStreamSource(UINT StreamNumber, IDirect3DVertexBuffer9** ppStreamData, UINT* pOffsetInBytes, UINT* pStride) override { if (ppStreamData) *ppStreamData = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetStreamSourceFreq(UINT StreamNumber, UINT Setting) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetStreamSourceFreq(UINT StreamNumber, UINT* pSetting) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetIndices(IDirect3DIndexBuffer9* pIndexData) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetIndices(IDirect3DIndexBuffer9** ppIndexData) override { if (ppIndexData) *ppIndexData = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE CreatePixelShader(const DWORD* pFunction, IDirect3DPixelShader9** ppShader) override { if (ppShader) *ppShader = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetPixelShader(IDirect3DPixelShader9* pShader) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetPixelShader(IDirect3DPixelShader9** ppShader) override { if (ppShader) *ppShader = nullptr; return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetPixelShaderConstantF(UINT StartRegister, const float* pConstantData, UINT Vector4fCount) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetPixelShaderConstantF(UINT StartRegister, float* pConstantData, UINT Vector4fCount) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetPixelShaderConstantI(UINT StartRegister, const int* pConstantData, UINT Vector4iCount) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetPixelShaderConstantI(UINT StartRegister, int* pConstantData, UINT Vector4iCount) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE SetPixelShaderConstantB(UINT StartRegister, const BOOL* pConstantData, UINT BoolCount) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE GetPixelShaderConstantB(UINT StartRegister, BOOL* pConstantData, UINT BoolCount) override { return D3DERR_NOTAVAILABLE; }
+    HRESULT STDMETHODCALLTYPE DrawRectPatch(UINT Handle, const float* pNumSegs, const D3DRECTPATCH_INFO* pRectPatchInfo) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE DrawTriPatch(UINT Handle, const float* pNumSegs, const D3DTRIPATCH_INFO* pTriPatchInfo) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE DeletePatch(UINT Handle) override { return D3D_OK; }
+    HRESULT STDMETHODCALLTYPE CreateQuery(D3DQUERYTYPE Type, IDirect3DQuery9** ppQuery) override { if (ppQuery) *ppQuery = nullptr; return D3DERR_NOTAVAILABLE; }
+
+private:
+    ULONG m_refCount = 1;
+    D3DVIEWPORT9 m_viewport = {};
+    bool m_hasViewport = false;
+};
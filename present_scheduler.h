@@ -0,0 +1,141 @@
+/*
+ * Budgeted housekeeping for Present.
+ *
+ * Work that does not have to happen every frame (memory-tracking validation,
+ * the memory-scanner timer, layout cache autosave, periodic status logging) is
+ * registered as a task with a frame interval. Each Present runs the due tasks
+ * round-robin until the per-frame microsecond budget is spent; the rest wait
+ * for a later frame. A task that has waited maxDeferFrames past its interval
+ * runs regardless of the budget, so nothing starves behind a slow neighbour.
+ *
+ * Only the render thread touches a scheduler.
+ */
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+
+class PresentScheduler {
+public:
+    typedef void (*TaskFn)(void* context);
+
+    static constexpr int kMaxTasks = 16;
+
+    struct TaskStats {
+        const char* name = "";
+        uint32_t intervalFrames = 1;
+        uint32_t maxDeferFrames = 0;
+        uint64_t runs = 0;
+        uint64_t deferrals = 0;
+        uint32_t lastMicros = 0;
+        uint32_t maxMicros = 0;
+        uint64_t totalMicros = 0;
+    };
+
+    // Returns the task index, or -1 when the table is full.
+    int Register(const char* name, uint32_t intervalFrames, uint32_t maxDeferFrames, TaskFn fn) {
+        if (m_taskCount >= kMaxTasks || !fn) {
+            return -1;
+        }
+        Task& task = m_tasks[m_taskCount];
+        task.fn = fn;
+        task.stats.name = name;
+        task.stats.intervalFrames = intervalFrames > 0 ? intervalFrames : 1;
+        task.stats.maxDeferFrames = maxDeferFrames;
+        // Spread tasks with the same interval over different frames.
+        task.dueFrame = static_cast<uint64_t>(m_taskCount) % task.stats.intervalFrames;
+        return m_taskCount++;
+    }
+
+    // 0 = no budget: every due task runs every frame.
+    void SetBudgetMicros(uint32_t budgetMicros) { m_budgetMicros = budgetMicros; }
+    uint32_t BudgetMicros() const { return m_budgetMicros; }
+
+    void RunFrame(uint64_t frame, void* context) {
+        if (m_taskCount == 0) {
+            return;
+        }
+        const int64_t start = Now();
+        const int64_t budgetTicks = MicrosToTicks(m_budgetMicros);
+        int ran = 0;
+        for (int n = 0; n < m_taskCount; ++n) {
+            Task& task = m_tasks[(m_next + n) % m_taskCount];
+            if (frame < task.dueFrame) {
+                continue;
+            }
+            const uint64_t overdue = frame - task.dueFrame;
+            if (m_budgetMicros > 0 && ran > 0 && Now() - start >= budgetTicks &&
+                overdue < task.stats.maxDeferFrames) {
+                task.stats.deferrals++;
+                continue;
+            }
+            const int64_t taskStart = Now();
+            task.fn(context);
+            const uint32_t micros = TicksToMicros(Now() - taskStart);
+            task.dueFrame = frame + task.stats.intervalFrames;
+            task.stats.runs++;
+            task.stats.lastMicros = micros;
+            task.stats.totalMicros += micros;
+            if (micros > task.stats.maxMicros) {
+                task.stats.maxMicros = micros;
+            }
+            ran++;
+        }
+        // Whoever was skipped this frame goes first next frame.
+        m_next = (m_next + 1) % m_taskCount;
+        m_lastFrameMicros = TicksToMicros(Now() - start);
+        if (m_lastFrameMicros > m_maxFrameMicros) {
+            m_maxFrameMicros = m_lastFrameMicros;
+        }
+    }
+
+    void ResetStats() {
+        for (int i = 0; i < m_taskCount; ++i) {
+            TaskStats& stats = m_tasks[i].stats;
+            stats.runs = 0;
+            stats.deferrals = 0;
+            stats.lastMicros = 0;
+            stats.maxMicros = 0;
+            stats.totalMicros = 0;
+        }
+        m_maxFrameMicros = 0;
+    }
+
+    int TaskCount() const { return m_taskCount; }
+    const TaskStats& Stats(int index) const { return m_tasks[index].stats; }
+    uint32_t LastFrameMicros() const { return m_lastFrameMicros; }
+    uint32_t MaxFrameMicros() const { return m_maxFrameMicros; }
+
+private:
+    struct Task {
+        TaskFn fn = nullptr;
+        TaskStats stats;
+        uint64_t dueFrame = 0;
+    };
+
+    static int64_t Now() {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart;
+    }
+
+    int64_t Frequency() {
+        if (m_frequency <= 0) {
+            LARGE_INTEGER frequency;
+            QueryPerformanceFrequency(&frequency);
+            m_frequency = frequency.QuadPart > 0 ? frequency.QuadPart : 1;
+        }
+        return m_frequency;
+    }
+
+    int64_t MicrosToTicks(uint32_t micros) { return static_cast<int64_t>(micros) * Frequency() / 1000000; }
+    uint32_t TicksToMicros(int64_t ticks) { return static_cast<uint32_t>(ticks * 1000000 / Frequency()); }
+
+    Task m_tasks[kMaxTasks];
+    int m_taskCount = 0;
+    int m_next = 0;
+    uint32_t m_budgetMicros = 0;
+    uint32_t m_lastFrameMicros = 0;
+    uint32_t m_maxFrameMicros = 0;
+    int64_t m_frequency = 0;
+};
@@ -0,0 +1,187 @@
+/*
+ * The proxy's own memory, kept apart so the memory scanner can leave it out.
+ *
+ * Every C++ allocation of the DLL (the operator new / delete replacements in
+ * d3d9_proxy.cpp) and every ImGui allocation comes from a private heap. The reservations backing that
+ * heap, the DLL image, the shared-camera view and the stacks of the proxy's
+ * own threads are recorded in a small table that any thread reads without a
+ * lock. Those ranges hold the proxy's copies of the camera (published
+ * matrices, constant pools, trace buffers, earlier scan results), which would
+ * otherwise outrank the game's own in an all-regions scan and could be picked
+ * up by pointer tracking.
+ *
+ * Slots are claimed with a compare-exchange and cleared when a range goes away
+ * (a released large block, an exited thread), so the table does not fill up
+ * across scans. A reader may briefly miss a range that is being registered;
+ * it never sees a half-written one.
+ */
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+struct ProxyOwnedRange {
+    // 0 = free slot, kProxyRangeClaimed = being written.
+    std::atomic<uintptr_t> begin;
+    std::atomic<uintptr_t> end;
+};
+
+static constexpr int kMaxProxyOwnedRanges = 256;
+static constexpr uintptr_t kProxyRangeClaimed = 1;
+// HeapAlloc serves larger blocks from their own VirtualAlloc reservation.
+static constexpr size_t kProxyHeapLargeBlockBytes = 512 * 1024;
+
+static ProxyOwnedRange g_proxyOwnedRanges[kMaxProxyOwnedRanges] = {};
+// Highest slot index ever used + 1; readers stop there.
+static std::atomic<int> g_proxyOwnedRangeSlots{0};
+static std::atomic<uint32_t> g_proxyOwnedRangesDropped{0};
+static std::atomic<HANDLE> g_proxyHeap{nullptr};
+// HeapCreate failed and allocations come from the process heap, which the game
+// shares: nothing of it may be registered.
+static std::atomic<bool> g_proxyHeapShared{false};
+
+static inline bool ProxyOwnsRange(uintptr_t begin, uintptr_t end) {
+    const int slots = (std::min)(g_proxyOwnedRangeSlots.load(std::memory_order_acquire), kMaxProxyOwnedRanges);
+    for (int i = 0; i < slots; i++) {
+        const uintptr_t ownedBegin = g_proxyOwnedRanges[i].begin.load(std::memory_order_acquire);
+        if (ownedBegin <= kProxyRangeClaimed) {
+            continue;
+        }
+        if (begin < g_proxyOwnedRanges[i].end.load(std::memory_order_relaxed) && ownedBegin < end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline bool ProxyOwnsAddress(uintptr_t address) {
+    return ProxyOwnsRange(address, address + 1);
+}
+
+static inline void ProxyRegisterOwnedRange(uintptr_t begin, uintptr_t end) {
+    if (begin <= kProxyRangeClaimed || end <= begin) {
+        return;
+    }
+    for (int i = 0; i < kMaxProxyOwnedRanges; i++) {
+        uintptr_t expected = 0;
+        if (!g_proxyOwnedRanges[i].begin.compare_exchange_strong(expected, kProxyRangeClaimed,
+                                                                 std::memory_order_acq_rel)) {
+            continue;
+        }
+        g_proxyOwnedRanges[i].end.store(end, std::memory_order_relaxed);
+        g_proxyOwnedRanges[i].begin.store(begin, std::memory_order_release);
+        int slots = g_proxyOwnedRangeSlots.load(std::memory_order_relaxed);
+        while (slots < i + 1 &&
+               !g_proxyOwnedRangeSlots.compare_exchange_weak(slots, i + 1, std::memory_order_acq_rel)) {
+        }
+        return;
+    }
+    g_proxyOwnedRangesDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+static inline void ProxyUnregisterOwnedRange(uintptr_t begin) {
+    const int slots = (std::min)(g_proxyOwnedRangeSlots.load(std::memory_order_acquire), kMaxProxyOwnedRanges);
+    for (int i = 0; i < slots; i++) {
+        uintptr_t expected = begin;
+        if (g_proxyOwnedRanges[i].begin.compare_exchange_strong(expected, kProxyRangeClaimed,
+                                                                std::memory_order_acq_rel)) {
+            g_proxyOwnedRanges[i].end.store(0, std::memory_order_relaxed);
+            g_proxyOwnedRanges[i].begin.store(0, std::memory_order_release);
+        }
+    }
+}
+
+// Whole reservation containing address, from its allocation base to the first
+// region of another allocation. Returns the allocation base, or 0.
+static inline uintptr_t ProxyRegisterAllocationOf(const void* address) {
+    MEMORY_BASIC_INFORMATION info = {};
+    if (VirtualQuery(address, &info, sizeof(info)) == 0 || !info.AllocationBase) {
+        return 0;
+    }
+    BYTE* const base = static_cast<BYTE*>(info.AllocationBase);
+    BYTE* end = base;
+    while (VirtualQuery(end, &info, sizeof(info)) != 0 && info.AllocationBase == base) {
+        end = static_cast<BYTE*>(info.BaseAddress) + info.RegionSize;
+    }
+    ProxyRegisterOwnedRange(reinterpret_cast<uintptr_t>(base), reinterpret_cast<uintptr_t>(end));
+    return reinterpret_cast<uintptr_t>(base);
+}
+
+static inline HANDLE ProxyHeap() {
+    HANDLE heap = g_proxyHeap.load(std::memory_order_acquire);
+    if (heap) {
+        return heap;
+    }
+    // May run during static initialisation, before DllMain.
+    HANDLE created = HeapCreate(0, 0, 0);
+    const bool shared = created == nullptr;
+    if (shared) {
+        created = GetProcessHeap();
+    }
+    HANDLE expected = nullptr;
+    if (!g_proxyHeap.compare_exchange_strong(expected, created, std::memory_order_acq_rel)) {
+        if (!shared) {
+            HeapDestroy(created);
+        }
+        return expected;
+    }
+    g_proxyHeapShared.store(shared, std::memory_order_release);
+    return created;
+}
+
+static inline void* ProxyHeapAlloc(size_t bytes) {
+    HANDLE heap = ProxyHeap();
+    void* block = HeapAlloc(heap, 0, bytes > 0 ? bytes : 1);
+    // Only a new heap segment or a large block lands outside the known ranges.
+    if (block && !g_proxyHeapShared.load(std::memory_order_relaxed) &&
+        !ProxyOwnsAddress(reinterpret_cast<uintptr_t>(block))) {
+        ProxyRegisterAllocationOf(block);
+    }
+    return block;
+}
+
+static inline void ProxyHeapFree(void* block) {
+    if (!block) {
+        return;
+    }
+    HANDLE heap = ProxyHeap();
+    uintptr_t base = 0;
+    if (!g_proxyHeapShared.load(std::memory_order_relaxed) && HeapSize(heap, 0, block) >= kProxyHeapLargeBlockBytes) {
+        MEMORY_BASIC_INFORMATION info = {};
+        if (VirtualQuery(block, &info, sizeof(info)) != 0) {
+            base = reinterpret_cast<uintptr_t>(info.AllocationBase);
+        }
+    }
+    HeapFree(heap, 0, block);
+    if (base != 0) {
+        // A block with its own reservation is gone once freed; a big block inside a
+        // heap segment leaves the segment committed or reserved.
+        MEMORY_BASIC_INFORMATION info = {};
+        if (VirtualQuery(reinterpret_cast<const void*>(base), &info, sizeof(info)) != 0 && info.State == MEM_FREE) {
+            ProxyUnregisterOwnedRange(base);
+        }
+    }
+}
+
+// Registers the calling thread's stack for the lifetime of a proxy-owned thread.
+class ScopedProxyThreadStack {
+public:
+    ScopedProxyThreadStack() {
+        const int marker = 0;
+        m_base = ProxyRegisterAllocationOf(&marker);
+    }
+    ~ScopedProxyThreadStack() {
+        if (m_base != 0) {
+            ProxyUnregisterOwnedRange(m_base);
+        }
+    }
+
+    ScopedProxyThreadStack(const ScopedProxyThreadStack&) = delete;
+    ScopedProxyThreadStack& operator=(const ScopedProxyThreadStack&) = delete;
+
+private:
+    uintptr_t m_base = 0;
+};
@@ -0,0 +1,199 @@
+/*
+ * Optional PIX / Nsight markers (and ETW events) around the proxy's own work.
+ *
+ * With PerfMarkers=1 the proxy wraps its constant processing, transform
+ * emission, overlay rendering and memory-scanner hand-off in D3DPERF events on
+ * the runtime it chains to, so the work shows up between the game's calls in a
+ * GPU capture. A D3DPERF marker is also set whenever a matrix slot's source
+ * changes. D3DPERF calls are only made from the thread that created the device;
+ * sources that change on the classifier worker are reported through ETW only.
+ *
+ * Build with /DCAMERA_PROXY_ETW=1 (build.bat etw) to also register the
+ * TraceLogging provider "CameraProxy". Its GUID is the name hash, so
+ * `wpr`/`tracelog` can enable it as *CameraProxy and the same regions appear
+ * in WPA next to the game and driver. When PerfMarkers=0 every hook pays one
+ * predictable branch.
+ */
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+#include <cwchar>
+
+#ifndef CAMERA_PROXY_ETW
+#define CAMERA_PROXY_ETW 0
+#endif
+
+#if CAMERA_PROXY_ETW
+#include <TraceLoggingProvider.h>
+#include <winmeta.h>
+#pragma comment(lib, "advapi32.lib")
+#endif
+
+enum ProxyMarkerRegion {
+    ProxyMarker_ConstantProcessing = 0,
+    ProxyMarker_TransformEmission,
+    ProxyMarker_Overlay,
+    ProxyMarker_MemoryScannerHandoff,
+    ProxyMarker_Count
+};
+
+struct ProxyMarkerRegionInfo {
+    const wchar_t* label;
+    const char* etwName;
+    DWORD color;
+};
+
+static const ProxyMarkerRegionInfo kProxyMarkerRegionInfo[ProxyMarker_Count] = {
+    { L"CameraProxy: constants", "ConstantProcessing", 0xFF4080FFu },
+    { L"CameraProxy: emit transforms", "TransformEmission", 0xFFFF8040u },
+    { L"CameraProxy: overlay", "Overlay", 0xFF40C040u },
+    { L"CameraProxy: memory scanner", "MemoryScannerHandoff", 0xFFC040C0u },
+};
+
+// Emitted inside the transform region; index = bit 0 World, 1 View, 2 Projection.
+static const wchar_t* const kProxyMarkerEmitSlots[8] = {
+    L"sent: none", L"sent: W", L"sent: V", L"sent: W+V",
+    L"sent: P", L"sent: W+P", L"sent: V+P", L"sent: W+V+P",
+};
+
+typedef int (WINAPI* ProxyMarkerBeginFn)(DWORD, LPCWSTR);
+typedef int (WINAPI* ProxyMarkerEndFn)(void);
+typedef void (WINAPI* ProxyMarkerSetFn)(DWORD, LPCWSTR);
+
+struct ProxyMarkerState {
+    bool enabled = false;
+    DWORD renderThreadId = 0;
+    ProxyMarkerBeginFn beginEvent = nullptr;
+    ProxyMarkerEndFn endEvent = nullptr;
+    ProxyMarkerSetFn setMarker = nullptr;
+};
+
+static ProxyMarkerState g_proxyMarkers = {};
+
+#if CAMERA_PROXY_ETW
+// {9B5691DE-87C2-5495-F018-50F7E8C8CF6A} = EventSource name hash of "CameraProxy".
+TRACELOGGING_DEFINE_PROVIDER(g_proxyEtwProvider, "CameraProxy",
+                             (0x9b5691de, 0x87c2, 0x5495, 0xf0, 0x18, 0x50, 0xf7, 0xe8, 0xc8, 0xcf, 0x6a));
+static bool g_proxyEtwRegistered = false;
+#endif
+
+// Entry points of the chained runtime; any may be null (plain system d3d9 without PIX).
+static inline void ProxyMarkersSetRuntime(ProxyMarkerBeginFn beginEvent, ProxyMarkerEndFn endEvent,
+                                          ProxyMarkerSetFn setMarker) {
+    g_proxyMarkers.beginEvent = beginEvent;
+    g_proxyMarkers.endEvent = endEvent;
+    g_proxyMarkers.setMarker = setMarker;
+}
+
+static inline void ProxyMarkersSetRenderThread(DWORD threadId) {
+    g_proxyMarkers.renderThreadId = threadId;
+}
+
+static inline void ProxyMarkersEnable(bool enabled) {
+#if CAMERA_PROXY_ETW
+    if (enabled && !g_proxyEtwRegistered) {
+        g_proxyEtwRegistered = SUCCEEDED(TraceLoggingRegister(g_proxyEtwProvider));
+    }
+#endif
+    g_proxyMarkers.enabled = enabled;
+}
+
+// DLL detach.
+static inline void ProxyMarkersShutdown() {
+    g_proxyMarkers.enabled = false;
+#if CAMERA_PROXY_ETW
+    if (g_proxyEtwRegistered) {
+        TraceLoggingUnregister(g_proxyEtwProvider);
+        g_proxyEtwRegistered = false;
+    }
+#endif
+}
+
+static inline bool ProxyMarkersOnRenderThread() {
+    return GetCurrentThreadId() == g_proxyMarkers.renderThreadId;
+}
+
+class ScopedProxyMarker {
+public:
+    explicit ScopedProxyMarker(ProxyMarkerRegion region) : m_region(region) {
+        if (!g_proxyMarkers.enabled) {
+            return;
+        }
+        m_active = true;
+        if (g_proxyMarkers.beginEvent && ProxyMarkersOnRenderThread()) {
+            g_proxyMarkers.beginEvent(kProxyMarkerRegionInfo[region].color, kProxyMarkerRegionInfo[region].label);
+            m_d3dperf = true;
+        }
+#if CAMERA_PROXY_ETW
+        TraceLoggingWrite(g_proxyEtwProvider, "Region",
+                          TraceLoggingOpcode(WINEVENT_OPCODE_START),
+                          TraceLoggingString(kProxyMarkerRegionInfo[region].etwName, "Name"));
+#endif
+    }
+
+    ~ScopedProxyMarker() { End(); }
+
+    // Ends the region early, e.g. before forwarding the call the region describes.
+    void End() {
+        if (!m_active) {
+            return;
+        }
+        m_active = false;
+        if (m_d3dperf && g_proxyMarkers.endEvent) {
+            g_proxyMarkers.endEvent();
+        }
+#if CAMERA_PROXY_ETW
+        TraceLoggingWrite(g_proxyEtwProvider, "Region",
+                          TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+                          TraceLoggingString(kProxyMarkerRegionInfo[m_region].etwName, "Name"));
+#endif
+    }
+
+    ScopedProxyMarker(const ScopedProxyMarker&) = delete;
+    ScopedProxyMarker& operator=(const ScopedProxyMarker&) = delete;
+
+private:
+    ProxyMarkerRegion m_region;
+    bool m_active = false;
+    bool m_d3dperf = false;
+};
+
+static inline void ProxyMarkerEmittedSlots(unsigned slotMask) {
+    if (!g_proxyMarkers.enabled) {
+        return;
+    }
+    if (g_proxyMarkers.setMarker && ProxyMarkersOnRenderThread()) {
+        g_proxyMarkers.setMarker(kProxyMarkerRegionInfo[ProxyMarker_TransformEmission].color,
+                                 kProxyMarkerEmitSlots[slotMask & 7u]);
+    }
+#if CAMERA_PROXY_ETW
+    TraceLoggingWrite(g_proxyEtwProvider, "TransformsSent",
+                      TraceLoggingUInt32(slotMask, "SlotMask"));
+#endif
+}
+
+// slotName: "World", "View", ... ; label: MatrixSourceInfo::sourceLabel.
+static inline void ProxyMarkerSourceChanged(const char* slotName, const char* label, int baseRegister,
+                                            uint32_t shaderHash) {
+    if (!g_proxyMarkers.enabled) {
+        return;
+    }
+    if (g_proxyMarkers.setMarker && ProxyMarkersOnRenderThread()) {
+        wchar_t text[128];
+        swprintf(text, sizeof(text) / sizeof(text[0]), L"CameraProxy: %hs source -> c%d %08X (%hs)",
+                 slotName, baseRegister, shaderHash, label ? label : "");
+        g_proxyMarkers.setMarker(0xFFFFFF00u, text);
+    }
+#if CAMERA_PROXY_ETW
+    TraceLoggingWrite(g_proxyEtwProvider, "MatrixSourceChanged",
+                      TraceLoggingString(slotName, "Slot"),
+                      TraceLoggingString(label ? label : "", "Source"),
+                      TraceLoggingInt32(baseRegister, "BaseRegister"),
+                      TraceLoggingHexUInt32(shaderHash, "ShaderHash"));
+#endif
+}
+
+#define PROXY_MARKER_CONCAT_INNER(a, b) a##b
+#define PROXY_MARKER_CONCAT(a, b) PROXY_MARKER_CONCAT_INNER(a, b)
+#define PROXY_MARKER_SCOPE(region) ScopedProxyMarker PROXY_MARKER_CONCAT(proxyMarker_, __LINE__)(region)
@@ -0,0 +1,248 @@
+/*
+ * Optional per-hook CPU cost instrumentation for the camera proxy.
+ *
+ * Build with /DCAMERA_PROXY_PROFILER=1 (see build.bat) to enable it. When the
+ * macro is 0 (default) PROXY_PROFILE_SCOPE expands to nothing and the proxy
+ * pays no QueryPerformanceCounter cost.
+ *
+ * Render-thread zones accumulate into plain integers. The classifier zone also
+ * runs on the async classifier's worker, so it accumulates into atomics that
+ * Present drains. Each Present closes the frame: the per-zone call count, total
+ * ticks and slowest single call are pushed into a rolling window from which the
+ * overlay computes average / p50 / p99 per-frame cost.
+ */
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#ifndef CAMERA_PROXY_PROFILER
+#define CAMERA_PROXY_PROFILER 0
+#endif
+
+enum ProfilerZone {
+    ProfilerZone_SetVertexShaderConstantF = 0,
+    ProfilerZone_SetVertexShader,
+    ProfilerZone_Classifier,
+    ProfilerZone_EmitTransforms,
+    ProfilerZone_DrawPrimitive,
+    ProfilerZone_DrawIndexedPrimitive,
+    ProfilerZone_DrawPrimitiveUP,
+    ProfilerZone_DrawIndexedPrimitiveUP,
+    ProfilerZone_ImGuiOverlay,
+    ProfilerZone_Count
+};
+
+struct ProfilerZoneInfo {
+    const char* name;
+    // true when the zone also covers the call forwarded to the real device.
+    bool includesRuntimeCall;
+    // true when the zone may be entered off the render thread.
+    bool anyThread;
+};
+
+static const ProfilerZoneInfo kProfilerZoneInfo[ProfilerZone_Count] = {
+    { "SetVertexShaderConstantF", true, false },
+    { "SetVertexShader", true, false },
+    { "Classifier (structural scan)", false, true },
+    { "EmitFixedFunctionTransforms", false, false },
+    { "DrawPrimitive", false, false },
+    { "DrawIndexedPrimitive", false, false },
+    { "DrawPrimitiveUP", false, false },
+    { "DrawIndexedPrimitiveUP", false, false },
+    { "RenderImGuiOverlay", false, false },
+};
+
+static constexpr int kProfilerWindowFrames = 240;
+
+struct ProfilerFrameSample {
+    uint32_t calls;
+    uint32_t totalMicros;
+    uint32_t maxCallMicros;
+};
+
+struct ProfilerZoneAccumulator {
+    uint32_t calls;
+    int64_t totalTicks;
+    int64_t maxCallTicks;
+};
+
+// Accumulator for anyThread zones; drained by the render thread at Present.
+struct ProfilerSharedAccumulator {
+    std::atomic<uint32_t> calls{0};
+    std::atomic<int64_t> totalTicks{0};
+    std::atomic<int64_t> maxCallTicks{0};
+};
+
+struct ProfilerZoneSummary {
+    uint32_t lastCalls = 0;
+    double lastMicros = 0.0;
+    double avgCalls = 0.0;
+    double avgMicros = 0.0;
+    double p50Micros = 0.0;
+    double p99Micros = 0.0;
+    double maxCallMicros = 0.0;
+};
+
+struct ProfilerState {
+    int64_t frequency = 0;
+    ProfilerZoneAccumulator current[ProfilerZone_Count] = {};
+    ProfilerFrameSample history[ProfilerZone_Count][kProfilerWindowFrames] = {};
+    int historyHead = 0;
+    int historyCount = 0;
+    unsigned long long framesRecorded = 0;
+};
+
+static ProfilerState g_profiler = {};
+static ProfilerSharedAccumulator g_profilerShared[ProfilerZone_Count];
+
+static inline int64_t ProfilerNow() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+static inline uint32_t ProfilerTicksToMicros(int64_t ticks) {
+    if (g_profiler.frequency <= 0) {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        g_profiler.frequency = frequency.QuadPart;
+    }
+    return static_cast<uint32_t>((ticks * 1000000) / (g_profiler.frequency > 0 ? g_profiler.frequency : 1));
+}
+
+class ScopedProfilerTimer {
+public:
+    explicit ScopedProfilerTimer(ProfilerZone zone) : m_zone(zone), m_start(ProfilerNow()) {}
+    ~ScopedProfilerTimer() {
+        const int64_t elapsed = ProfilerNow() - m_start;
+        if (kProfilerZoneInfo[m_zone].anyThread) {
+            ProfilerSharedAccumulator& shared = g_profilerShared[m_zone];
+            shared.calls.fetch_add(1, std::memory_order_relaxed);
+            shared.totalTicks.fetch_add(elapsed, std::memory_order_relaxed);
+            int64_t maxCall = shared.maxCallTicks.load(std::memory_order_relaxed);
+            while (elapsed > maxCall &&
+                   !shared.maxCallTicks.compare_exchange_weak(maxCall, elapsed, std::memory_order_relaxed)) {
+            }
+            return;
+        }
+        ProfilerZoneAccumulator& acc = g_profiler.current[m_zone];
+        acc.calls++;
+        acc.totalTicks += elapsed;
+        if (elapsed > acc.maxCallTicks) {
+            acc.maxCallTicks = elapsed;
+        }
+    }
+
+private:
+    ScopedProfilerTimer(const ScopedProfilerTimer&) = delete;
+    ScopedProfilerTimer& operator=(const ScopedProfilerTimer&) = delete;
+
+    ProfilerZone m_zone;
+    int64_t m_start;
+};
+
+// Moves the anyThread zones' totals into g_profiler.current. Render thread.
+static inline void ProfilerDrainSharedZones() {
+    for (int zone = 0; zone < ProfilerZone_Count; ++zone) {
+        if (!kProfilerZoneInfo[zone].anyThread) {
+            continue;
+        }
+        ProfilerSharedAccumulator& shared = g_profilerShared[zone];
+        ProfilerZoneAccumulator& acc = g_profiler.current[zone];
+        acc.calls += shared.calls.exchange(0, std::memory_order_relaxed);
+        acc.totalTicks += shared.totalTicks.exchange(0, std::memory_order_relaxed);
+        acc.maxCallTicks = (std::max)(acc.maxCallTicks, shared.maxCallTicks.exchange(0, std::memory_order_relaxed));
+    }
+}
+
+// Closes the current frame; call once per Present.
+static inline void ProfilerEndFrame() {
+    ProfilerDrainSharedZones();
+    const int slot = g_profiler.historyHead;
+    for (int zone = 0; zone < ProfilerZone_Count; ++zone) {
+        ProfilerZoneAccumulator& acc = g_profiler.current[zone];
+        ProfilerFrameSample& sample = g_profiler.history[zone][slot];
+        sample.calls = acc.calls;
+        sample.totalMicros = ProfilerTicksToMicros(acc.totalTicks);
+        sample.maxCallMicros = ProfilerTicksToMicros(acc.maxCallTicks);
+        acc = ProfilerZoneAccumulator{};
+    }
+    g_profiler.historyHead = (slot + 1) % kProfilerWindowFrames;
+    g_profiler.historyCount = (std::min)(g_profiler.historyCount + 1, kProfilerWindowFrames);
+    g_profiler.framesRecorded++;
+}
+
+static inline void ProfilerReset() {
+    const int64_t frequency = g_profiler.frequency;
+    ProfilerDrainSharedZones();
+    g_profiler = ProfilerState{};
+    g_profiler.frequency = frequency;
+}
+
+static inline ProfilerZoneSummary ProfilerSummarize(ProfilerZone zone) {
+    ProfilerZoneSummary summary = {};
+    const int count = g_profiler.historyCount;
+    if (count == 0) {
+        return summary;
+    }
+    uint32_t sorted[kProfilerWindowFrames];
+    double callSum = 0.0;
+    double microSum = 0.0;
+    uint32_t maxCall = 0;
+    for (int i = 0; i < count; ++i) {
+        const ProfilerFrameSample& sample = g_profiler.history[zone][i];
+        sorted[i] = sample.totalMicros;
+        callSum += sample.calls;
+        microSum += sample.totalMicros;
+        maxCall = (std::max)(maxCall, sample.maxCallMicros);
+    }
+    std::sort(sorted, sorted + count);
+    const int last = (g_profiler.historyHead + kProfilerWindowFrames - 1) % kProfilerWindowFrames;
+    summary.lastCalls = g_profiler.history[zone][last].calls;
+    summary.lastMicros = g_profiler.history[zone][last].totalMicros;
+    summary.avgCalls = callSum / count;
+    summary.avgMicros = microSum / count;
+    summary.p50Micros = sorted[(count - 1) / 2];
+    summary.p99Micros = sorted[((count - 1) * 99) / 100];
+    summary.maxCallMicros = maxCall;
+    return summary;
+}
+
+// Writes one summary row per zone. Returns false if the file cannot be opened.
+static inline bool ProfilerExportCsv(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "zone,includes_runtime_call,window_frames,last_calls,last_us,avg_calls,avg_us,p50_us,p99_us,max_call_us\n");
+    for (int zone = 0; zone < ProfilerZone_Count; ++zone) {
+        const ProfilerZoneSummary summary = ProfilerSummarize(static_cast<ProfilerZone>(zone));
+        fprintf(file, "%s,%d,%d,%u,%.0f,%.2f,%.2f,%.0f,%.0f,%.0f\n",
+                kProfilerZoneInfo[zone].name,
+                kProfilerZoneInfo[zone].includesRuntimeCall ? 1 : 0,
+                g_profiler.historyCount,
+                summary.lastCalls,
+                summary.lastMicros,
+                summary.avgCalls,
+                summary.avgMicros,
+                summary.p50Micros,
+                summary.p99Micros,
+                summary.maxCallMicros);
+    }
+    fclose(file);
+    return true;
+}
+
+#if CAMERA_PROXY_PROFILER
+#define PROXY_PROFILE_CONCAT_INNER(a, b) a##b
+#define PROXY_PROFILE_CONCAT(a, b) PROXY_PROFILE_CONCAT_INNER(a, b)
+#define PROXY_PROFILE_SCOPE(zone) ScopedProfilerTimer PROXY_PROFILE_CONCAT(proxyProfileScope_, __LINE__)(zone)
+#define PROXY_PROFILE_END_FRAME() ProfilerEndFrame()
+#else
+#define PROXY_PROFILE_SCOPE(zone) ((void)0)
+#define PROXY_PROFILE_END_FRAME() ((void)0)
+#endif
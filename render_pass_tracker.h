@@ -0,0 +1,314 @@
+/*
+ * Render pass tracking for per-pass classification policy.
+ *
+ * A pass is one combination of render target 0, depth-stencil surface and
+ * viewport size. The device reports every change of the three and asks for the
+ * current pass's policy on uploads and draws, so shadow-map, reflection and
+ * post-process passes can skip classification and SetTransform emission.
+ * Surface pointers are not AddRef'd, so the key also holds each surface's
+ * format, size and usage: a new surface that reuses a released one's address
+ * is a new pass and learns its own policy.
+ *
+ * Policies come from, in order: an overlay override on the pass, a PassPolicies
+ * entry for the viewport size, and a policy learned from the target itself:
+ *   - single-channel float (R32F/R16F) or NULL-format targets are depth/shadow
+ *     passes and are ignored;
+ *   - a back-buffer-sized target (the back buffer itself included) is always
+ *     classified, whatever its viewport, so letterboxed or split-screen views
+ *     keep their camera;
+ *   - on any other target, a viewport whose aspect ratio differs from the back
+ *     buffer's (shadow maps, cube faces, atlases) is ignored;
+ *   - everything else is classified.
+ *
+ * Only the render thread touches a tracker.
+ */
+#pragma once
+
+#include <windows.h>
+#include <d3d9.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+enum PassPolicy : uint8_t {
+    // No override: use the configured or learned policy.
+    PassPolicy_Auto = 0,
+    // Classify uploads and emit transforms at draws.
+    PassPolicy_Classify,
+    // Neither classify uploads nor emit transforms.
+    PassPolicy_Ignore,
+    // Keep the camera resolved in other passes and emit it at draws.
+    PassPolicy_EmitOnly,
+    PassPolicy_Count
+};
+
+static inline const char* PassPolicyLabel(PassPolicy policy) {
+    switch (policy) {
+        case PassPolicy_Auto: return "auto";
+        case PassPolicy_Classify: return "classify";
+        case PassPolicy_Ignore: return "ignore";
+        case PassPolicy_EmitOnly: return "emitonly";
+        default: return "unknown";
+    }
+}
+
+static inline PassPolicy ParsePassPolicy(const char* text) {
+    for (int policy = PassPolicy_Classify; policy < PassPolicy_Count; ++policy) {
+        if (_stricmp(text, PassPolicyLabel(static_cast<PassPolicy>(policy))) == 0) {
+            return static_cast<PassPolicy>(policy);
+        }
+    }
+    return PassPolicy_Auto;
+}
+
+struct RenderPassSurfaceDesc {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    D3DFORMAT format = D3DFMT_UNKNOWN;
+    DWORD usage = 0;
+
+    bool operator==(const RenderPassSurfaceDesc& other) const {
+        return width == other.width && height == other.height && format == other.format && usage == other.usage;
+    }
+};
+
+struct RenderPassKey {
+    uintptr_t renderTarget = 0;
+    uintptr_t depthStencil = 0;
+    RenderPassSurfaceDesc targetDesc;
+    RenderPassSurfaceDesc depthDesc;
+    uint32_t viewportWidth = 0;
+    uint32_t viewportHeight = 0;
+
+    bool operator==(const RenderPassKey& other) const {
+        return renderTarget == other.renderTarget && depthStencil == other.depthStencil &&
+               targetDesc == other.targetDesc && depthDesc == other.depthDesc &&
+               viewportWidth == other.viewportWidth && viewportHeight == other.viewportHeight;
+    }
+};
+
+struct RenderPassInfo {
+    RenderPassKey key;
+    uint32_t targetWidth = 0;
+    uint32_t targetHeight = 0;
+    D3DFORMAT targetFormat = D3DFMT_UNKNOWN;
+    PassPolicy overridePolicy = PassPolicy_Auto;
+    PassPolicy configuredPolicy = PassPolicy_Auto;
+    PassPolicy learnedPolicy = PassPolicy_Classify;
+    PassPolicy policy = PassPolicy_Classify;
+    uint64_t lastSeenFrame = 0;
+    uint32_t drawsThisFrame = 0;
+    uint32_t uploadsThisFrame = 0;
+    uint32_t drawsLastFrame = 0;
+    uint32_t uploadsLastFrame = 0;
+};
+
+// Viewport size -> policy, from the PassPolicies ini key.
+struct PassSizePolicy {
+    uint32_t width;
+    uint32_t height;
+    PassPolicy policy;
+};
+
+class RenderPassTracker {
+public:
+    // Passes not entered for this many frames are dropped (render targets that
+    // were released or recreated).
+    static constexpr uint64_t kEvictAfterFrames = 600;
+    static constexpr size_t kMaxPasses = 256;
+
+    // "WxH:policy" entries separated by ';' or ','; malformed entries are skipped.
+    void SetSizePolicies(const char* text) {
+        m_sizePolicies.clear();
+        char buffer[1024];
+        snprintf(buffer, sizeof(buffer), "%s", text ? text : "");
+        char* context = nullptr;
+        for (char* entry = strtok_s(buffer, ";,", &context); entry; entry = strtok_s(nullptr, ";,", &context)) {
+            unsigned width = 0;
+            unsigned height = 0;
+            char policyName[32] = {};
+            if (sscanf(entry, " %ux%u:%31s", &width, &height, policyName) != 3) {
+                continue;
+            }
+            const PassPolicy policy = ParsePassPolicy(policyName);
+            if (policy != PassPolicy_Auto) {
+                m_sizePolicies.push_back({ width, height, policy });
+            }
+        }
+        for (RenderPassInfo& pass : m_passes) {
+            pass.configuredPolicy = ConfiguredPolicy(pass.key);
+            Resolve(pass);
+        }
+    }
+
+    const std::vector<PassSizePolicy>& SizePolicies() const { return m_sizePolicies; }
+
+    // Device created or Reset: every surface pointer is new.
+    void Reset(uint32_t backBufferWidth, uint32_t backBufferHeight) {
+        m_passes.clear();
+        m_current = -1;
+        m_key = RenderPassKey();
+        m_backBufferWidth = backBufferWidth;
+        m_backBufferHeight = backBufferHeight;
+    }
+
+    void SetRenderTarget(IDirect3DSurface9* surface) {
+        m_key.renderTarget = reinterpret_cast<uintptr_t>(surface);
+        m_key.targetDesc = DescribeSurface(surface);
+        if (surface && m_key.targetDesc.width != 0) {
+            // Binding render target 0 resets the viewport to the whole surface.
+            m_key.viewportWidth = m_key.targetDesc.width;
+            m_key.viewportHeight = m_key.targetDesc.height;
+        }
+        m_current = -1;
+    }
+
+    void SetDepthStencil(IDirect3DSurface9* surface) {
+        m_key.depthStencil = reinterpret_cast<uintptr_t>(surface);
+        m_key.depthDesc = DescribeSurface(surface);
+        m_current = -1;
+    }
+
+    void SetViewport(uint32_t width, uint32_t height) {
+        if (width != m_key.viewportWidth || height != m_key.viewportHeight) {
+            m_key.viewportWidth = width;
+            m_key.viewportHeight = height;
+            m_current = -1;
+        }
+    }
+
+    // Current pass, entering it on first use after a state change. Never null.
+    RenderPassInfo& Current() {
+        if (m_current < 0) {
+            Enter();
+        }
+        return m_passes[static_cast<size_t>(m_current)];
+    }
+
+    PassPolicy CurrentPolicy() {
+        return Current().policy;
+    }
+
+    // Present: roll per-frame counters and drop passes that stopped appearing.
+    void EndFrame(uint64_t frame) {
+        m_frame = frame;
+        size_t kept = 0;
+        for (size_t i = 0; i < m_passes.size(); ++i) {
+            RenderPassInfo& pass = m_passes[i];
+            pass.drawsLastFrame = pass.drawsThisFrame;
+            pass.uploadsLastFrame = pass.uploadsThisFrame;
+            pass.drawsThisFrame = 0;
+            pass.uploadsThisFrame = 0;
+            if (frame - pass.lastSeenFrame > kEvictAfterFrames) {
+                continue;
+            }
+            if (kept != i) {
+                m_passes[kept] = pass;
+            }
+            kept++;
+        }
+        m_passes.resize(kept);
+        m_current = -1;
+    }
+
+    void SetOverride(size_t index, PassPolicy policy) {
+        if (index < m_passes.size()) {
+            m_passes[index].overridePolicy = policy;
+            Resolve(m_passes[index]);
+        }
+    }
+
+    const std::vector<RenderPassInfo>& Passes() const { return m_passes; }
+    uint32_t BackBufferWidth() const { return m_backBufferWidth; }
+    uint32_t BackBufferHeight() const { return m_backBufferHeight; }
+
+private:
+    static RenderPassSurfaceDesc DescribeSurface(IDirect3DSurface9* surface) {
+        RenderPassSurfaceDesc result;
+        D3DSURFACE_DESC desc = {};
+        if (surface && SUCCEEDED(surface->GetDesc(&desc))) {
+            result.width = desc.Width;
+            result.height = desc.Height;
+            result.format = desc.Format;
+            result.usage = desc.Usage;
+        }
+        return result;
+    }
+
+    void Enter() {
+        for (size_t i = 0; i < m_passes.size(); ++i) {
+            if (m_passes[i].key == m_key) {
+                m_current = static_cast<int>(i);
+                m_passes[i].lastSeenFrame = m_frame;
+                return;
+            }
+        }
+        if (m_passes.size() >= kMaxPasses) {
+            // Pathological target churn: reuse the least recently seen entry.
+            size_t oldest = 0;
+            for (size_t i = 1; i < m_passes.size(); ++i) {
+                if (m_passes[i].lastSeenFrame < m_passes[oldest].lastSeenFrame) {
+                    oldest = i;
+                }
+            }
+            m_passes.erase(m_passes.begin() + static_cast<std::ptrdiff_t>(oldest));
+        }
+        RenderPassInfo pass;
+        pass.key = m_key;
+        pass.targetWidth = m_key.targetDesc.width;
+        pass.targetHeight = m_key.targetDesc.height;
+        pass.targetFormat = m_key.targetDesc.format;
+        pass.lastSeenFrame = m_frame;
+        pass.configuredPolicy = ConfiguredPolicy(m_key);
+        pass.learnedPolicy = LearnPolicy(pass);
+        Resolve(pass);
+        m_passes.push_back(pass);
+        m_current = static_cast<int>(m_passes.size() - 1);
+    }
+
+    PassPolicy ConfiguredPolicy(const RenderPassKey& key) const {
+        for (const PassSizePolicy& entry : m_sizePolicies) {
+            if (entry.width == key.viewportWidth && entry.height == key.viewportHeight) {
+                return entry.policy;
+            }
+        }
+        return PassPolicy_Auto;
+    }
+
+    PassPolicy LearnPolicy(const RenderPassInfo& pass) const {
+        const D3DFORMAT nullFormat = static_cast<D3DFORMAT>(MAKEFOURCC('N', 'U', 'L', 'L'));
+        if (pass.targetFormat == D3DFMT_R32F || pass.targetFormat == D3DFMT_R16F || pass.targetFormat == nullFormat) {
+            return PassPolicy_Ignore;
+        }
+        if (m_backBufferWidth == 0 || m_backBufferHeight == 0 ||
+            pass.key.viewportWidth == 0 || pass.key.viewportHeight == 0) {
+            return PassPolicy_Classify;
+        }
+        if (pass.targetWidth == m_backBufferWidth && pass.targetHeight == m_backBufferHeight) {
+            return PassPolicy_Classify;
+        }
+        const float backBufferAspect = static_cast<float>(m_backBufferWidth) / static_cast<float>(m_backBufferHeight);
+        const float viewportAspect = static_cast<float>(pass.key.viewportWidth) / static_cast<float>(pass.key.viewportHeight);
+        if (std::fabs(viewportAspect - backBufferAspect) > backBufferAspect * 0.02f) {
+            return PassPolicy_Ignore;
+        }
+        return PassPolicy_Classify;
+    }
+
+    static void Resolve(RenderPassInfo& pass) {
+        pass.policy = pass.overridePolicy != PassPolicy_Auto ? pass.overridePolicy
+                    : pass.configuredPolicy != PassPolicy_Auto ? pass.configuredPolicy
+                    : pass.learnedPolicy;
+    }
+
+    std::vector<RenderPassInfo> m_passes;
+    std::vector<PassSizePolicy> m_sizePolicies;
+    RenderPassKey m_key;
+    int m_current = -1;
+    uint64_t m_frame = 0;
+    uint32_t m_backBufferWidth = 0;
+    uint32_t m_backBufferHeight = 0;
+};